@@ -0,0 +1,56 @@
+#include <iostream>
+#include <string>
+#include "isolate.hpp"
+#include "lox_array.hpp"
+
+/* 数值数组与解释执行的逐元素循环的对比
+ * 同样的求和、点积、缩放后计数，分别用 while 循环遍历列表和 array 模块的方法计算，输出每个元素的平均耗时。
+ * 用法: array_bench [elements]
+ * */
+
+// 数据在 setup 中生成，脚本只计时 work 部分
+static double nsPerElement(const std::string &setup, const std::string &work, size_t count) {
+    CompileOptions options;
+    options.useCache = false;
+    auto source = setup + "\nvar begin = clock_ns();\n" + work + "\nvar elapsed = clock_ns() - begin;\n";
+    auto program = Program::compile(Source::fromString(source, "<bench>"), options);
+    if (!program) return 0;
+
+    std::ostream discard{nullptr};
+    Context context{discard, std::cerr};
+    if (!context.run(*program)) return 0;
+    auto elapsed = std::dynamic_pointer_cast<LoxInt>(context.global("elapsed"));
+    return elapsed ? (double) elapsed->value_ / (double) count : 0;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    auto n = std::to_string(count);
+
+    auto listSetup = "var xs: list[float] = []; var i = 0;"
+                     "while (i < " + n + ") { xs.append(i * 0.5); i = i + 1; }";
+    auto arraySetup = "import array; var xs = array.f64(array.range(" + n + ").toList()).mul(0.5);";
+
+    struct Case {
+        const char *name;
+        std::string loop;
+        std::string vectorized;
+    };
+    Case cases[]{
+            {"sum", "var s = 0.0; var j = 0; while (j < " + n + ") { s = s + xs[j]; j = j + 1; }",
+                    "var s = xs.sum();"},
+            {"dot", "var s = 0.0; var j = 0; while (j < " + n + ") { s = s + xs[j] * xs[j]; j = j + 1; }",
+                    "var s = xs.dot(xs);"},
+            {"scale and count", "var c = 0; var j = 0; while (j < " + n + ") { if (xs[j] * 2.0 + 1.0 > 1000.0) { c = c + 1; } j = j + 1; }",
+                    "var c = xs.mul(2.0).add(1.0).gt(1000.0).sum();"},
+    };
+
+    std::cout << "simd: " << LoxArray::simd() << std::endl;
+    for (const auto &c: cases) {
+        auto loop = nsPerElement(listSetup, c.loop, count);
+        auto vectorized = nsPerElement(arraySetup, c.vectorized, count);
+        std::cout << c.name << ": " << loop << " / " << vectorized << " ns per element (while loop / array), "
+                  << loop / vectorized << "x" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "isolate.hpp"
+#include "lox_async.hpp"
+
+/* 异步 I/O 的重叠等待
+ * 同样 n 次等待（sleep 10ms、子进程 sleep 0.01、读取 1MB 的文件），依次 await 与先全部发起再 await 的耗时对比；
+ * 以及两个 Context 在两个线程上通过信箱来回传递消息的往返延迟。
+ * 用法: async_bench [operations] [round-trips]
+ * */
+
+static const char *functions =
+        "async fun one(i) { return await OPERATION; }\n"
+        "async fun sequential(n) {\n"
+        "    var i = 0;\n"
+        "    while (i < n) {\n"
+        "        await one(i);\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "}\n"
+        "async fun overlapped(n) {\n"
+        "    var futures: list[any] = [];\n"
+        "    var i = 0;\n"
+        "    while (i < n) {\n"
+        "        futures.append(one(i));\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    for (f in futures) await f;\n"
+        "}\n";
+
+static double seconds(Context &context, const char *function, int64_t count) {
+    std::vector<LoxValuePtr> args{LoxInt::of(count)};
+    auto begin = std::chrono::steady_clock::now();
+    context.call(function, args);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+static void compare(const std::string &name, const std::string &operation, int64_t count) {
+    auto source = std::string{functions};
+    source.replace(source.find("OPERATION"), 9, operation);
+    CompileOptions options;
+    options.useCache = false;
+    auto program = Program::compile(Source::fromString(source, "<bench>"), options);
+    if (!program) return;
+
+    std::ostream discard{nullptr};
+    Context context{discard, std::cerr};
+    if (!context.run(*program)) return;
+    auto sequential = seconds(context, "sequential", count);
+    auto overlapped = seconds(context, "overlapped", count);
+    std::cout << name << " x" << count << ": " << sequential * 1000 << " / " << overlapped * 1000
+              << " ms (sequential / overlapped), speedup " << sequential / overlapped << std::endl;
+}
+
+static const char *pinger =
+        "async fun main() {\n"
+        "    var i = 0;\n"
+        "    while (i < rounds()) {\n"
+        "        send(i);\n"
+        "        await receive();\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    finish();\n"
+        "}\n"
+        "main();\n";
+
+static const char *ponger =
+        "async fun main() {\n"
+        "    var message = await receive();\n"
+        "    while (message != nil) {\n"
+        "        send(message);\n"
+        "        message = await receive();\n"
+        "    }\n"
+        "}\n"
+        "main();\n";
+
+// 每个线程各有一个 Context，send 把消息放进对方的信箱（只接受能在线程之间共享的值，否则脚本中报错）
+static void pingPong(int64_t rounds) {
+    CompileOptions options;
+    options.useCache = false;
+    auto ping = Program::compile(Source::fromString(pinger, "<ping>"), options);
+    auto pong = Program::compile(Source::fromString(ponger, "<pong>"), options);
+    if (!ping or !pong) return;
+
+    Context a, b;
+    a.def("rounds", [rounds] { return rounds; });
+    a.def("send", [&b](const LoxValuePtr &message) { b.mailbox()->send(message); });
+    a.def("finish", [&b] { b.mailbox()->close(); });
+    b.def("send", [&a](const LoxValuePtr &message) { a.mailbox()->send(message); });
+
+    auto begin = std::chrono::steady_clock::now();
+    std::thread other{[&] { b.run(*pong); }};
+    a.run(*ping);
+    other.join();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "message round trip between two contexts: " << elapsed / (double) rounds * 1e6 << " us" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    int64_t count = argc > 1 ? std::stoll(argv[1]) : 32;
+    int64_t rounds = argc > 2 ? std::stoll(argv[2]) : 20000;
+
+    auto directory = std::filesystem::temp_directory_path() / "idun_async_bench";
+    std::filesystem::create_directories(directory);
+    std::string block(1 << 20, 'x');
+    for (int64_t i = 0; i < count; ++i) std::ofstream{directory / std::to_string(i)} << block;
+
+    compare("sleep(0.01)", "sleep(0.01)", count);
+    compare("exec(\"sleep 0.01\")", "exec(\"sleep 0.01\")", count);
+    compare("readFile(1MB)", "readFile(\"" + directory.string() + "/\" + i)", count);
+    pingPong(rounds);
+
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "idun.h"
+
+/* 通过 C 接口反复调用脚本函数的开销（次/秒）
+ * 用法: call_bench [calls]
+ * 程序只编译、执行一次，之后每次 idun_call 只执行函数体。
+ * */
+
+static const char *script =
+        "var base = 10;\n"
+        "fun add(a, b) { return a + b + base; }\n"
+        "fun scaled(n) { return twice(n) + 1; }\n";
+
+static idun_value *twice(idun_context *context, idun_value *const *args, size_t argc, void *userdata) {
+    (void) context, (void) argc, (void) userdata;
+    return idun_int(idun_as_int(args[0]) * 2);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    long calls = argc > 1 ? atol(argv[1]) : 1000000;
+
+    idun_program *program = idun_compile(script, strlen(script), "call_bench");
+    if (!program) {
+        fprintf(stderr, "%s\n", idun_error());
+        return 1;
+    }
+    idun_context *context = idun_context_new();
+    idun_register(context, "twice", 1, twice, NULL);
+    if (idun_run(context, program) != 0) {
+        fprintf(stderr, "%s\n", idun_error());
+        return 1;
+    }
+
+    idun_value *scaled_arg = idun_int(20);
+    idun_value *scaled = idun_call(context, "scaled", &scaled_arg, 1);
+    printf("scaled(20) = %lld\n", (long long) idun_as_int(scaled));
+    idun_value_free(scaled);
+    idun_value_free(scaled_arg);
+
+    int64_t sum = 0;
+    double begin = now();
+    for (long i = 0; i < calls; ++i) {
+        idun_value *args[2] = {idun_int(i), idun_int(1)};
+        idun_value *result = idun_call(context, "add", args, 2);
+        if (!result) {
+            fprintf(stderr, "%s\n", idun_error());
+            return 1;
+        }
+        sum += idun_as_int(result);
+        idun_value_free(result);
+        idun_value_free(args[0]);
+        idun_value_free(args[1]);
+    }
+    double elapsed = now() - begin;
+    printf("%ld calls in %.3f s: %.0f calls/s (checksum %lld)\n", calls, elapsed, (double) calls / elapsed,
+           (long long) sum);
+
+    idun_value *missing = idun_call(context, "nope", NULL, 0);
+    printf("missing function: %s\n", missing ? "found" : idun_error());
+
+    idun_context_free(context);
+    idun_program_free(program);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include "isolate.hpp"
+
+/* 生成器逐个产生元素与先生成完整列表的对比
+ * 同样对 0..n-1 求和，一方由生成器逐个产出，另一方先把所有元素放进列表再遍历，
+ * 输出每个元素的平均耗时（生成器每个元素有两次栈切换）和运行期间峰值内存的增长。
+ * 生成器先运行，峰值内存只增不减，两者的增长互不影响。
+ * 用法: generator_bench [elements]
+ * */
+
+static const char *functions =
+        "fun numbers(n) {\n"
+        "    var i = 0;\n"
+        "    while (i < n) {\n"
+        "        yield i;\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "}\n";
+
+static long peakKB() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct Result {
+    double nsPerElement{0};
+    long growthKB{0};
+};
+
+static Result run(const std::string &work, size_t count) {
+    CompileOptions options;
+    options.useCache = false;
+    auto source = std::string{functions} + "var begin = clock_ns();\n" + work + "\nvar elapsed = clock_ns() - begin;\n";
+    auto program = Program::compile(Source::fromString(source, "<bench>"), options);
+    if (!program) return {};
+
+    std::ostream discard{nullptr};
+    Context context{discard, std::cerr};
+    auto before = peakKB();
+    if (!context.run(*program)) return {};
+    auto elapsed = std::dynamic_pointer_cast<LoxInt>(context.global("elapsed"));
+    return {elapsed ? (double) elapsed->value_ / (double) count : 0, peakKB() - before};
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    auto n = std::to_string(count);
+
+    auto generator = run("var s = 0;\nfor (x in numbers(" + n + ")) s = s + x;", count);
+    auto list = run("var items: list[int] = [];\n"
+                    "var i = 0;\n"
+                    "while (i < " + n + ") {\n"
+                    "    items.append(i);\n"
+                    "    i = i + 1;\n"
+                    "}\n"
+                    "var s = 0;\n"
+                    "for (x in items) s = s + x;", count);
+
+    std::cout << "sum of " << count << " elements: " << generator.nsPerElement << " / " << list.nsPerElement
+              << " ns per element, peak memory +" << generator.growthKB << " / +" << list.growthKB
+              << " KB (generator / list)" << std::endl;
+    return 0;
+}
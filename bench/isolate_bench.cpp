@@ -0,0 +1,65 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "isolate.hpp"
+
+/* 隔离执行的吞吐量基准
+ * 同一个编译好的程序在 1、2、4 …… 个线程上各自用独立的 Context 反复运行，输出每秒运行次数以及相对单线程的加速比。
+ * 用法: isolate_bench [script] [runs-per-thread] [max-threads]
+ * 不指定脚本（或为空字符串）时使用内置的计算密集型脚本，模块在脚本所在目录中查找。
+ * */
+
+static const char *defaultScript =
+        "fun fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }\n"
+        "class Counter {\n"
+        "    fun init() { this.count = 0; }\n"
+        "    fun add(n) { this.count = this.count + n; return this; }\n"
+        "}\n"
+        "var counter = Counter();\n"
+        "var i = 0;\n"
+        "while (i < 2000) { counter.add(i % 7); i = i + 1; }\n"
+        "var result = fib(15) + counter.count;\n";
+
+int main(int argc, char **argv) {
+    bool builtin = argc < 2 or *argv[1] == '\0';
+    SourcePtr source = builtin ? Source::fromString(defaultScript, "<builtin>") : Source::fromFile(argv[1]);
+    if (!source) {
+        std::cerr << "Could not open file: " << argv[1] << std::endl;
+        return 1;
+    }
+    int runs = argc > 2 ? std::stoi(argv[2]) : 50;
+
+    CompileOptions options;
+    options.useCache = false;
+    auto program = Program::compile(source, options);
+    if (!program) return 1;
+
+    std::string script{builtin ? "" : argv[1]};
+    auto slash = script.rfind('/');
+    ModuleRegistry::instance().configure({slash == std::string::npos ? "." : script.substr(0, slash)}, options);
+
+    unsigned cores = argc > 3 ? (unsigned) std::stoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+    double baseline = 0;
+    for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&program, runs] {
+                std::ostream discard{nullptr};
+                Context context{discard, std::cerr};
+                for (int i = 0; i < runs; ++i) context.run(*program);
+            });
+        }
+        for (auto &worker: workers) worker.join();
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        double throughput = threads * runs / elapsed;
+        if (threads == 1) baseline = throughput;
+        std::cout << threads << " thread(s): " << throughput << " runs/s, speedup " << throughput / baseline
+                  << "x" << std::endl;
+        if (threads == cores) break;
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <string>
+#include "isolate.hpp"
+
+/* 惰性迭代器流水线与逐步生成中间列表的对比
+ * 同样的 map → filter → reduce，分别用迭代器的方法和每一步都生成新列表的 for 循环计算，输出每个元素的平均耗时；
+ * 再对 map → filter → take(10) 比较，迭代器取够元素后即停止，逐步计算的一方要处理所有元素。
+ * 用法: iterator_bench [elements]
+ * */
+
+static const char *functions =
+        "fun sq(x) { return x * x; }\n"
+        "fun even(x) { return x % 2 == 0; }\n"
+        "fun add(a, b) { return a + b; }\n";
+
+// 数据在计时之前生成，脚本只计时 work 部分
+static double nsPerElement(const std::string &work, size_t count) {
+    CompileOptions options;
+    options.useCache = false;
+    auto source = std::string{functions} + "var begin = clock_ns();\n" + work + "\nvar elapsed = clock_ns() - begin;\n";
+    auto program = Program::compile(Source::fromString(source, "<bench>"), options);
+    if (!program) return 0;
+
+    std::ostream discard{nullptr};
+    Context context{discard, std::cerr};
+    if (!context.run(*program)) return 0;
+    auto elapsed = std::dynamic_pointer_cast<LoxInt>(context.global("elapsed"));
+    return elapsed ? (double) elapsed->value_ / (double) count : 0;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 20000;
+    auto n = std::to_string(count);
+
+    auto eager = [&](const std::string &last) {
+        return "var squares: list[int] = [];\n"
+               "for (x in 1.." + n + ") squares.append(sq(x));\n"
+               "var evens: list[int] = [];\n"
+               "for (x in squares) { if (even(x)) evens.append(x); }\n" + last;
+    };
+    struct Case {
+        const char *name;
+        std::string lazy;
+        std::string eager;
+    };
+    Case cases[]{
+            {"map, filter, reduce", "var s = (1.." + n + ").map(sq).filter(even).reduce(add, 0);",
+                    eager("var s = 0;\nfor (x in evens) s = add(s, x);")},
+            {"map, filter, take(10)", "var s = (1.." + n + ").map(sq).filter(even).take(10).toList();",
+                    eager("var s = evens[:10];")},
+    };
+
+    for (const auto &c: cases) {
+        auto lazy = nsPerElement(c.lazy, count);
+        auto stepwise = nsPerElement(c.eager, count);
+        std::cout << c.name << ": " << lazy << " / " << stepwise
+                  << " ns per element (iterator / intermediate lists)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "lox_map.hpp"
+
+/* 字典与 std::unordered_map 的对比
+ * 对同一组字符串键分别测量插入、命中的查找、未命中的查找和更新已有的键，输出每次操作的平均耗时。
+ * std::unordered_map 以 std::string 为键（StringMap，以 string_view 查找，每次查找都重新计算哈希值），
+ * LoxMap 以 LoxString 为键（哈希值缓存在字符串中），与脚本中使用字典的方式相同。
+ * 用法: map_bench [keys]
+ * */
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+static double nsPerOp(size_t operations, F &&f) {
+    auto begin = Clock::now();
+    f();
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    return elapsed / (double) operations;
+}
+
+static void report(const char *name, double map, double unordered) {
+    std::cout << name << ": LoxMap " << map << " ns, std::unordered_map " << unordered << " ns" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+    std::vector<std::shared_ptr<LoxString>> keys, missing;
+    keys.reserve(count);
+    missing.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(std::make_shared<LoxString>("key_" + std::to_string(i * 7919)));
+        missing.push_back(std::make_shared<LoxString>("missing_" + std::to_string(i)));
+    }
+    auto one = LoxInt::of(1), two = LoxInt::of(2);
+
+    LoxMap map{ElementType::INT, true};
+    StringMap<LoxValuePtr> unordered;
+
+    // 插入时键的哈希值是第一次计算
+    auto mapInsert = nsPerOp(count, [&] {
+        for (const auto &key: keys) map.set(key, one);
+    });
+    auto unorderedInsert = nsPerOp(count, [&] {
+        for (const auto &key: keys) unordered.emplace(key->value_, one);
+    });
+    report("insert", mapInsert, unorderedInsert);
+
+    size_t found = 0;
+    auto mapHit = nsPerOp(count, [&] {
+        for (const auto &key: keys) found += map.get(*key) != nullptr;
+    });
+    auto unorderedHit = nsPerOp(count, [&] {
+        for (const auto &key: keys) found += unordered.find(key->value_) != unordered.end();
+    });
+    report("lookup (hit)", mapHit, unorderedHit);
+
+    auto mapMiss = nsPerOp(count, [&] {
+        for (const auto &key: missing) found += map.get(*key) != nullptr;
+    });
+    auto unorderedMiss = nsPerOp(count, [&] {
+        for (const auto &key: missing) found += unordered.find(key->value_) != unordered.end();
+    });
+    report("lookup (miss)", mapMiss, unorderedMiss);
+
+    auto mapUpdate = nsPerOp(count, [&] {
+        for (const auto &key: keys) map.set(key, two);
+    });
+    auto unorderedUpdate = nsPerOp(count, [&] {
+        for (const auto &key: keys) unordered.find(key->value_)->second = two;
+    });
+    report("update", mapUpdate, unorderedUpdate);
+
+    if (found != 2 * count or map.size() != count or unordered.size() != count) {
+        std::cerr << "unexpected result" << std::endl;
+        return 1;
+    }
+    return 0;
+}
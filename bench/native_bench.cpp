@@ -0,0 +1,88 @@
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include "isolate.hpp"
+
+/* 宿主函数调用的开销
+ * 脚本在循环中调用用 Context::def 注册的 C++ 函数，与结构相同但不调用宿主函数的循环对比，
+ * 输出平均每次调用的耗时和堆分配次数。
+ * 用法: native_bench [iterations]
+ * */
+
+static std::atomic<size_t> allocations{0};
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+// native 每轮平均调用 3.5 次宿主函数，参数和返回值都在小整数、bool 的范围内
+static const char *script =
+        "fun native(n) {\n"
+        "    var i = 0;\n"
+        "    var sum = 0;\n"
+        "    while (i < n) {\n"
+        "        sum = add(sum, clamp(i, 0, 3));\n"
+        "        if (odd(i)) { sum = sub(sum, 1); }\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return sum;\n"
+        "}\n"
+        "fun plain(n) {\n"
+        "    var i = 0;\n"
+        "    var sum = 0;\n"
+        "    while (i < n) {\n"
+        "        sum = sum;\n"
+        "        if (i % 2 == 1) { sum = sum; }\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return sum;\n"
+        "}\n";
+
+struct Measure {
+    double seconds;
+    size_t allocations;
+};
+
+static Measure measure(Context &context, const char *function, int64_t iterations) {
+    LoxValuePtr args[]{std::make_shared<LoxInt>(iterations)};
+    size_t before = allocations.load();
+    auto begin = std::chrono::steady_clock::now();
+    if (!context.call(function, args)) std::exit(1);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return {elapsed, allocations.load() - before};
+}
+
+int main(int argc, char **argv) {
+    int64_t iterations = argc > 1 ? std::stoll(argv[1]) : 200000;
+
+    CompileOptions options;
+    options.useCache = false;
+    auto program = Program::compile(Source::fromString(script, "<native_bench>"), options);
+    if (!program) return 1;
+
+    Context context;
+    context.def("add", [](int64_t a, int64_t b) { return (a + b) % 512; });
+    context.def("sub", [](int64_t a, int64_t b) { return a - b; });
+    context.def("clamp", [](int64_t x, int64_t low, int64_t high) { return std::min(std::max(x, low), high); });
+    context.def("odd", +[](int64_t x) { return x % 2 != 0; });
+    if (not context.run(*program)) return 1;
+
+    auto native = measure(context, "native", iterations);
+    auto plain = measure(context, "plain", iterations);
+
+    double calls = (double) iterations * 3.5;
+    std::cout << "native call: " << (native.seconds - plain.seconds) / calls * 1e9 << " ns" << std::endl;
+    std::cout << "allocations per native call: "
+              << ((double) native.allocations - (double) plain.allocations) / calls << std::endl;
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "lox_hamt.hpp"
+#include "lox_vector.hpp"
+
+/* 不可变集合派生新版本的开销
+ * 对 n 个元素的向量和字典各修改一个元素得到新版本，与复制整个 std::vector / StringMap 再修改对比，
+ * 输出每次派生的平均耗时，以及逐个追加建出整个集合的平均耗时。
+ * 用法: persistent_bench [elements]
+ * */
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+static double nsPerOp(size_t operations, F &&f) {
+    auto begin = Clock::now();
+    f();
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    return elapsed / (double) operations;
+}
+
+static size_t found = 0;
+
+static void runVector(size_t count) {
+    std::vector<LoxValuePtr> values;
+    for (size_t i = 0; i < count; ++i) values.push_back(LoxInt::of((int64_t) i));
+
+    PersistentVector built;
+    auto push = nsPerOp(count, [&] {
+        for (const auto &value: values) built = built.push(value);
+    });
+    PersistentVector vector{values};
+    // 修改次数不随 n 增加，避免完整复制的一方耗时过长
+    size_t rounds = 100;
+    auto derive = nsPerOp(rounds, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            auto next = vector.set((r * 7919) % count, values[r % count]);
+            found += next.size();
+        }
+    });
+    auto copy = nsPerOp(rounds, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            auto next = values;
+            next[(r * 7919) % count] = values[r % count];
+            found += next.size();
+        }
+    });
+    std::cout << "vector of " << count << ": set " << derive << " / " << copy
+              << " ns (PersistentVector / copy of std::vector), push " << push << " ns" << std::endl;
+}
+
+static void runMap(size_t count) {
+    std::vector<std::shared_ptr<LoxString>> keys;
+    for (size_t i = 0; i < count; ++i) keys.push_back(std::make_shared<LoxString>("key" + std::to_string(i)));
+    auto value = LoxInt::of(1);
+
+    PersistentMap map;
+    auto put = nsPerOp(count, [&] {
+        for (const auto &key: keys) map = map.set(key, value);
+    });
+    StringMap<LoxValuePtr> plain;
+    for (const auto &key: keys) plain.emplace(std::string{key->value_}, value);
+
+    size_t rounds = 100;
+    auto derive = nsPerOp(rounds, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            auto next = map.set(keys[(r * 7919) % count], LoxInt::of((int64_t) r));
+            found += next.size();
+        }
+    });
+    auto copy = nsPerOp(rounds, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            auto next = plain;
+            next.insert_or_assign(std::string{keys[(r * 7919) % count]->value_}, LoxInt::of((int64_t) r));
+            found += next.size();
+        }
+    });
+    std::cout << "map of " << count << ": put " << derive << " / " << copy
+              << " ns (PersistentMap / copy of StringMap), build " << put << " ns per key" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 100000;
+
+    runVector(count);
+    runMap(count);
+
+    if (found == 0) {
+        std::cerr << "unexpected result" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "scanner.hpp"
+#include "source.hpp"
+
+/* 词法分析吞吐量基准（MB/s）
+ * 用法: scanner_bench [script] [iterations]
+ * 不指定脚本时生成约 8MB 的代码作为输入。
+ * */
+
+static std::string generateSource(size_t targetSize) {
+    const std::string unit =
+            "// compute things\n"
+            "fun compute_value_42(alpha, beta_value, gamma) {\n"
+            "    var accumulator = alpha * 1024 + beta_value / 3.14159;\n"
+            "    /* block comment spanning\n"
+            "       two lines */\n"
+            "    while (accumulator < 100000 and gamma != nil) {\n"
+            "        accumulator += gamma << 2 | 7;\n"
+            "        if (accumulator >= 5000) { break; } elif (not gamma) { continue; }\n"
+            "    }\n"
+            "    return \"result: ${accumulator} of ${gamma}\";\n"
+            "}\n\n";
+    std::string source;
+    source.reserve(targetSize + unit.size());
+    while (source.size() < targetSize) source += unit;
+    return source;
+}
+
+int main(int argc, char **argv) {
+    SourcePtr source;
+    if (argc > 1) {
+        source = Source::fromFile(argv[1]);
+        if (!source) {
+            std::cerr << "Could not open file: " << argv[1] << std::endl;
+            return 1;
+        }
+    } else {
+        source = Source::fromString(generateSource(8 << 20), "<generated>");
+    }
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 20;
+
+    auto text = source->text();
+    double best = 0, total = 0;
+    size_t tokenCount = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        Scanner scanner{text};
+        auto tokens = scanner.getTokens();
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (!tokens) return 1;
+        tokenCount = tokens->size();
+
+        double mbps = (double) text.size() / (1 << 20) / elapsed;
+        best = std::max(best, mbps);
+        total += mbps;
+    }
+
+    std::cout << source->name() << ": " << text.size() << " bytes, " << tokenCount << " tokens\n"
+              << "best " << best << " MB/s, mean " << total / iterations << " MB/s over " << iterations
+              << " runs" << std::endl;
+    return 0;
+}
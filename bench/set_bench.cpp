@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "lox_set.hpp"
+
+/* 集合与 std::unordered_set 的对比
+ * 分别以连续的整数（位图）、分散的整数（哈希表）和不超过 8 个的整数（数组）测量插入、命中和未命中的查找，
+ * 以及两个集合的并集和交集，输出每个元素的平均耗时。
+ * 用法: set_bench [elements]
+ * */
+
+using Clock = std::chrono::steady_clock;
+
+template<typename F>
+static double nsPerOp(size_t operations, F &&f) {
+    auto begin = Clock::now();
+    f();
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    return elapsed / (double) operations;
+}
+
+static const char *modeName(SetMode mode) {
+    switch (mode) {
+        case SetMode::SMALL:return "small";
+        case SetMode::DENSE:return "dense";
+        case SetMode::HASH:return "hash";
+    }
+    return "?";
+}
+
+static size_t found = 0;
+
+// values 插入两种集合后以 values 和 missing 查找，rounds 次重复以测量很小的集合
+static void run(const char *name, const std::vector<int64_t> &values, const std::vector<int64_t> &missing, size_t rounds) {
+    auto operations = values.size() * rounds;
+    SetElements<int64_t> set;
+    std::unordered_set<int64_t> unordered;
+    auto setInsert = nsPerOp(operations, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            set.clear();
+            for (auto value: values) set.insert(value);
+        }
+    });
+    auto unorderedInsert = nsPerOp(operations, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            unordered.clear();
+            for (auto value: values) unordered.insert(value);
+        }
+    });
+    auto setHit = nsPerOp(operations, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            for (auto value: values) found += set.contains(value);
+        }
+    });
+    auto unorderedHit = nsPerOp(operations, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            for (auto value: values) found += unordered.count(value);
+        }
+    });
+    auto setMiss = nsPerOp(operations, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            for (auto value: missing) found += set.contains(value);
+        }
+    });
+    auto unorderedMiss = nsPerOp(operations, [&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            for (auto value: missing) found += unordered.count(value);
+        }
+    });
+    std::cout << name << " (" << modeName(set.mode()) << "): insert " << setInsert << " / " << unorderedInsert
+              << " ns, hit " << setHit << " / " << unorderedHit << " ns, miss " << setMiss << " / " << unorderedMiss
+              << " ns (SetElements / std::unordered_set)" << std::endl;
+}
+
+// 两个各有 count 个元素、一半重叠的集合
+static void runBulk(const char *name, size_t count, int64_t stride) {
+    SetElements<int64_t> a, b;
+    std::unordered_set<int64_t> ua, ub;
+    for (size_t i = 0; i < count; ++i) {
+        a.insert((int64_t) i * stride), ua.insert((int64_t) i * stride);
+        b.insert((int64_t) (i + count / 2) * stride), ub.insert((int64_t) (i + count / 2) * stride);
+    }
+    // 先测 SetElements：释放 std::unordered_set 的大量节点之后紧接着的分配很慢，会影响结果
+    auto setUnion = nsPerOp(count * 2, [&] { found += SetElements<int64_t>::unite(a, b).size(); });
+    auto setIntersect = nsPerOp(count * 2, [&] { found += SetElements<int64_t>::intersect(a, b).size(); });
+    auto unorderedUnion = nsPerOp(count * 2, [&] {
+        auto result = ua;
+        result.insert(ub.begin(), ub.end());
+        found += result.size();
+    });
+    auto unorderedIntersect = nsPerOp(count * 2, [&] {
+        std::unordered_set<int64_t> result;
+        for (auto value: ua) {
+            if (ub.count(value)) result.insert(value);
+        }
+        found += result.size();
+    });
+    std::cout << name << " (" << modeName(a.mode()) << "): union " << setUnion << " / " << unorderedUnion
+              << " ns, intersection " << setIntersect << " / " << unorderedIntersect
+              << " ns per element (SetElements / std::unordered_set)" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+    std::vector<int64_t> dense, denseMissing, sparse, sparseMissing, small, smallMissing;
+    for (size_t i = 0; i < count; ++i) {
+        dense.push_back((int64_t) i * 3);
+        denseMissing.push_back((int64_t) i * 3 + 1);
+        // 乘以一个大奇数，值分散在整个 int64 范围内
+        sparse.push_back((int64_t) (i * 0x9E3779B97F4A7C15ULL));
+        sparseMissing.push_back((int64_t) ((i + count) * 0x9E3779B97F4A7C15ULL));
+    }
+    for (int64_t i = 0; i < 6; ++i) {
+        small.push_back(i * 1000);
+        smallMissing.push_back(i * 1000 + 1);
+    }
+
+    run("dense ints", dense, denseMissing, 1);
+    run("sparse ints", sparse, sparseMissing, 1);
+    run("small ints", small, smallMissing, count / small.size());
+    runBulk("dense ints", count, 2);
+    runBulk("sparse ints", count, 0x9E3779B97F4A7C15LL);
+
+    if (found == 0) {
+        std::cerr << "unexpected result" << std::endl;
+        return 1;
+    }
+    return 0;
+}
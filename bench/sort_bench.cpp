@@ -0,0 +1,86 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "sort.hpp"
+
+/* 列表排序算法与 std::sort / std::stable_sort 的对比
+ * 对随机、有序、逆序、少量不同值四种输入，分别排序 int、float 和字符串，输出每个元素的平均耗时，
+ * 并检查结果与标准库的一致；最后比较归并排序与 std::stable_sort 的比较次数（脚本的比较函数调用一次的开销远大于其它部分）。
+ * 用法: sort_bench [elements]
+ * */
+
+using Clock = std::chrono::steady_clock;
+
+template<typename T, typename F>
+static double nsPerElement(std::vector<T> items, F &&sort, std::vector<T> &out) {
+    auto begin = Clock::now();
+    sort(items);
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    out = std::move(items);
+    return elapsed / (double) out.size();
+}
+
+static bool failed = false;
+
+template<typename T, typename F>
+static void compare(const char *name, const std::vector<T> &input, F &&sort) {
+    std::vector<T> expected, actual;
+    auto standard = nsPerElement(input, [](auto &items) { std::sort(items.begin(), items.end()); }, expected);
+    auto ours = nsPerElement(input, sort, actual);
+    if (actual != expected) failed = true;
+    std::cout << "  " << name << ": " << ours << " / " << standard << " ns per element (ours / std::sort)" << std::endl;
+}
+
+template<typename T, typename Make, typename F>
+static void run(const char *type, size_t count, Make &&make, F &&sort) {
+    std::mt19937_64 random{42};
+    std::vector<T> items;
+    for (size_t i = 0; i < count; ++i) items.push_back(make(random()));
+    std::cout << type << std::endl;
+    compare("random", items, sort);
+
+    auto sorted = items;
+    std::sort(sorted.begin(), sorted.end());
+    compare("sorted", sorted, sort);
+    std::vector<T> reversed{sorted.rbegin(), sorted.rend()};
+    compare("reversed", reversed, sort);
+
+    std::vector<T> few;
+    for (size_t i = 0; i < count; ++i) few.push_back(make(random() % 16));
+    compare("16 distinct values", few, sort);
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+    run<int64_t>("int (radixSort)", count, [](uint64_t r) { return (int64_t) (r % 2000000000) - 1000000000; }, [](auto &items) {
+        sorting::radixSort(items);
+    });
+    run<double>("float (pdqsort)", count, [](uint64_t r) { return (double) (r >> 11) * 0x1p-53 - 0.5; }, [](auto &items) {
+        sorting::pdqsort(items.begin(), items.end(), std::less<>{});
+    });
+    run<std::string>("str (pdqsort)", count / 4, [](uint64_t r) { return "key" + std::to_string(r); }, [](auto &items) {
+        sorting::pdqsort(items.begin(), items.end(), std::less<>{});
+    });
+
+    // 按 key 稳定排序，统计比较次数
+    std::mt19937_64 random{7};
+    std::vector<std::pair<int, size_t>> records;
+    for (size_t i = 0; i < count / 10; ++i) records.emplace_back((int) (random() % 1000), i);
+    size_t ours = 0, standard = 0;
+    auto merged = records, stable = records;
+    sorting::mergeSort(merged, [&](const auto &a, const auto &b) { return ++ours, a.first < b.first; });
+    std::stable_sort(stable.begin(), stable.end(), [&](const auto &a, const auto &b) { return ++standard, a.first < b.first; });
+    if (merged != stable) failed = true;
+    std::cout << "stable sort of " << records.size() << ": " << (double) ours / (double) records.size() << " / "
+              << (double) standard / (double) records.size() << " comparisons per element (mergeSort / std::stable_sort)"
+              << std::endl;
+
+    if (failed) {
+        std::cerr << "unexpected result" << std::endl;
+        return 1;
+    }
+    return 0;
+}
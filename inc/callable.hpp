@@ -1,14 +1,18 @@
 #pragma once
 
+#include <span>
 #include <vector>
 
 #include "value.hpp"
 #include "interpreter.hpp"
 
 struct LoxCallable : public LoxValue {
-    // 参数数量
+    // 参数数量，不定参数函数为最少的参数数量
     virtual size_t arity() = 0;
 
-    // 实际调用
-    virtual LoxValuePtr call(Interpreter &interpreter, std::vector<LoxValuePtr> &args) = 0;
-};
\ No newline at end of file
+    // 是否接受多于 arity() 个参数
+    virtual bool variadic() { return false; }
+
+    // 实际调用，参数由调用者持有，调用期间有效
+    virtual LoxValuePtr call(Interpreter &interpreter, std::span<LoxValuePtr> args) = 0;
+};
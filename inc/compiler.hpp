@@ -0,0 +1,74 @@
+#pragma once
+
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "source.hpp"
+#include "program_cache.hpp"
+#include "thread_pool.hpp"
+
+struct CompileOptions {
+    bool lazyParse{false};  // 函数体推迟到首次调用时再解析
+    bool useCache{true};    // 读写编译缓存
+    unsigned jobs{0};       // 并行编译模块的线程数，0 表示与 CPU 核数相同，1 表示只在首次访问时编译
+};
+
+// 编译源码，源码未改变时直接使用缓存的分析结果；出错时返回 nullptr，错误信息输出到 err
+std::unique_ptr<CompiledProgram> compile(const Source &source, const CompileOptions &options,
+                                         std::ostream &err = std::cerr);
+
+// 编译好的模块，词法单元引用 source 中的内容，二者生命周期相同
+struct CompiledModule {
+    std::string path;
+    SourcePtr source;
+    std::unique_ptr<CompiledProgram> program;
+};
+
+/* 模块注册表
+ * 每个模块在整个进程中只查找、编译一次（编译结果同样经过磁盘缓存），所有导入者共享同一份语法树。
+ * 模块名 a.b 对应搜索路径下的 a/b.idun，搜索路径依次为主脚本所在目录和 IDUN_PATH 中的目录。
+ * preload 沿导入关系在线程池中并行编译各个模块，主线程不必等待，直到真正访问某个模块时才等它编译完成。
+ * 编译结果和错误信息都按模块名保存，与各线程完成的先后无关；错误信息在首次加载该模块时输出。
+ * */
+class ModuleRegistry {
+public:
+    static ModuleRegistry &instance();
+
+    void configure(std::vector<std::string> searchPaths, CompileOptions options);
+
+    // 在后台编译 program 导入的模块以及它们间接导入的模块，立即返回
+    void preload(const CompiledProgram &program);
+
+    // 找不到或编译失败时返回 nullptr，失败的结果同样会被记下；编译错误在首次加载时输出到 err
+    std::shared_ptr<const CompiledModule> load(std::string_view name, std::ostream &err = std::cerr);
+
+    // 丢弃文件已被修改或删除的模块以及失败的结果，供常驻进程在每次运行前调用
+    void refresh();
+
+private:
+    struct Entry {
+        std::promise<void> promise;
+        std::shared_future<void> done{promise.get_future().share()};
+        std::shared_ptr<const CompiledModule> module;   // 编译失败时为空
+        std::string diagnostics;    // 编译时输出的错误信息
+        bool reported{false};
+    };
+
+    using EntryPtr = std::shared_ptr<Entry>;
+
+    // 编译模块并填写 entry，不持有锁
+    void build(std::string_view name, Entry &entry);
+
+    // 把 program 导入的、尚未登记的模块交给线程池，调用时须持有锁
+    void schedule(const CompiledProgram &program);
+
+    std::mutex mutex_;
+    std::vector<std::string> searchPaths_;
+    CompileOptions options_;
+    StringMap<EntryPtr> modules_;
+    std::unique_ptr<ThreadPool> pool_;  // 最后声明，析构时最先等待工作线程退出
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+#include "interpreter.hpp"
+
+/* 在自己的栈上执行脚本函数体的协程，生成器和异步函数的任务都基于它。
+ * 暂停时整个调用栈原样保留，不复制环境链，也不使用线程；每次切换只交换解释器当前的环境和编译单元。
+ * x86-64 上只保存寄存器并切换栈指针，其它平台使用 ucontext（每次切换还要保存信号掩码，多一次系统调用）。
+ * 脚本的求值是递归的，暂停点可能在很深的调用中，因此不能用 C++20 的无栈协程。
+ * 栈默认 256 KB，同时存在大量暂停的生成器时也不会耗尽地址空间；函数体中的递归深度受栈大小限制。
+ * */
+class Coroutine {
+public:
+    static constexpr size_t DEFAULT_STACK_SIZE = 256 << 10;
+
+    // 之后创建的协程栈的大小（字节），向上取整到页大小，至少 64 KB；可以在任何线程调用
+    static void setStackSize(size_t size);
+
+    static size_t stackSize();
+
+    // env 为已绑定参数的函数环境
+    Coroutine(FunctionStmt *declaration, std::shared_ptr<Environment> env, UnitPtr unit);
+
+    Coroutine(const Coroutine &) = delete;
+
+    Coroutine &operator=(const Coroutine &) = delete;
+
+    // 派生类的析构函数应先调用 close，使暂停中的函数体退出
+    virtual ~Coroutine();
+
+    // 结束暂停中的函数体（从暂停处抛出 coroutine_exit），尚未开始的不再执行
+    void close();
+
+    // 在协程中调用：剩余的栈空间已经不多，再调用脚本函数可能溢出
+    [[nodiscard]] bool stackLow() const;
+
+protected:
+    enum class State : uint8_t {
+        CREATED, SUSPENDED, RUNNING, DONE
+    };
+
+    // 切换到协程执行，直到它暂停或结束；第一次调用时开始执行函数体，分配不到栈时抛出 interpreter_error
+    void resume(Interpreter &interpreter);
+
+    // 在协程中调用：暂停并回到 resume 的调用处；被 close 恢复时抛出 coroutine_exit
+    void suspend();
+
+    FunctionStmt *declaration_;
+    const TokenBuffer *tokens_;     // 函数所在编译单元的词法单元，用于输出函数名
+    State state_{State::CREATED};
+    Interpreter *interpreter_{nullptr};   // 第一次 resume 时确定
+    LoxValuePtr value_;                   // 暂停时交给调用者的值；结束时为函数的返回值
+    std::exception_ptr error_;            // 函数体中未处理的错误
+
+private:
+    // 解释器执行协程时使用的状态，切换时与解释器的相应成员交换
+    struct Frame {
+        std::shared_ptr<Environment> env;
+        std::shared_ptr<Environment> global;
+        UnitPtr unit;
+        const TokenBuffer *tokens;
+        LoxValuePtr result;
+    };
+
+    // 协程栈上执行的第一个函数
+    static void start(Coroutine *self);
+
+    void run();
+
+    // 在新分配的栈上准备好第一次切换时执行 start
+    void prepare();
+
+    // 从调用 resume 处切换到协程的栈
+    void enter();
+
+    // 从协程的栈切换回调用 resume 处
+    void leave();
+
+    void swapFrame();
+
+    std::shared_ptr<Environment> env_;
+    Frame frame_;
+    bool closing_{false};
+
+    void *stack_{nullptr};
+    size_t stackSize_{0};
+#if defined(__x86_64__)
+    void *context_{nullptr}, *caller_{nullptr};     // 切换出去时保存的栈指针
+#else
+    ucontext_t context_{}, caller_{};
+#endif
+};
@@ -14,18 +14,26 @@ struct Environment : public std::enable_shared_from_this<Environment> {
 
     explicit Environment(std::shared_ptr<Environment> parent) : parentEnv{std::move(parent)} {};
 
-    void define(const std::string &name, LoxValuePtr value);
+    // let 定义的变量之后不能再赋值，var 重新定义同名变量时解除
+    void define(std::string_view name, LoxValuePtr value, bool let = false);
 
-    LoxValuePtr get(const TokenPtr &token);
+    LoxValuePtr get(const Token &token);
 
-    LoxValuePtr getAt(int distance, const std::string &name);
+    // 只查找当前环境，不存在时返回 nullptr
+    LoxValuePtr lookup(std::string_view name) const;
 
-    void assign(const TokenPtr &token, const LoxValuePtr &value);
+    LoxValuePtr getAt(int distance, std::string_view name);
 
-    void assignAt(int distance, const TokenPtr &token, LoxValuePtr value);
+    // 全局的 let 变量在运行时检查（局部变量由 Resolver 检查）
+    void assign(const Token &token, const LoxValuePtr &value);
+
+    void assignAt(int distance, std::string_view name, LoxValuePtr value);
 
 private:
-    std::unordered_map<std::string, LoxValuePtr> values;
+    friend class Snapshot;
+
+    StringMap<LoxValuePtr> values;
+    StringSet lets;
 
     std::shared_ptr<Environment> ancestor(int distance);
 };
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+/* 单线程的事件循环，每个解释器一个，第一次使用异步函数时创建
+ * 定时器按到期时间排在堆中，epoll_wait 的超时取最早的到期时间；管道等文件描述符用 epoll 等待可读；
+ * 普通文件不能用 epoll 等待，读写放到线程池执行，完成后回到事件循环的线程；
+ * 其它线程用 post 提交的回调通过 eventfd 唤醒 epoll_wait。
+ * 除 post 外的方法都只能在事件循环的线程上调用。
+ * */
+class EventLoop {
+public:
+    using Callback = std::function<void()>;
+
+    EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    // 先等待线程池中正在执行的操作结束，再丢弃尚未执行的回调
+    ~EventLoop();
+
+    // 下一轮执行
+    void defer(Callback callback);
+
+    // seconds 秒之后执行
+    void after(double seconds, Callback callback);
+
+    // fd 可读（或对端关闭）时执行一次
+    void whenReadable(int fd, Callback callback);
+
+    // 在线程池中执行 work，结束后在事件循环的线程上执行 done
+    void offload(Callback work, Callback done);
+
+    // 可以在任何线程调用：在事件循环的线程上执行 callback
+    void post(Callback callback);
+
+    // 没有定时器、文件描述符等待的外部事件（如等待消息）期间保持事件循环运行，与 release 成对使用
+    void hold() { ++holds_; }
+
+    void release() { --holds_; }
+
+    // 处理事件直到 done() 为真，或者没有任何待处理的事件；返回 done() 的结果
+    bool runUntil(const std::function<bool()> &done);
+
+    [[nodiscard]] bool running() const { return running_; }
+
+    /* 以下供宿主用 C++20 协程实现多步的异步操作：
+     *   LoopTask read(EventLoop &loop, int fd) {
+     *       co_await loop.readable(fd);
+     *       auto load = [path] { return loadFile(path); };
+     *       auto text = co_await loop.onPool(std::move(load));
+     *   }
+     * 协程创建后立即执行到第一个 co_await，结束时自动销毁；事件循环销毁时仍在等待的协程一并销毁。
+     * 交给 onPool 的 lambda 应先存入局部变量：GCC 12 把 co_await 表达式中作为实参的临时 lambda 逐字节复制，
+     * 捕获的 std::string 等对象析构时会释放错误的地址
+     * */
+    struct LoopTask {
+        struct promise_type {
+            LoopTask get_return_object() { return {}; }
+
+            std::suspend_never initial_suspend() noexcept { return {}; }
+
+            std::suspend_never final_suspend() noexcept { return {}; }
+
+            void return_void() {}
+
+            // 协程应自行捕获异常并交给等待结果的一方
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    auto sleep(double seconds) {
+        struct Awaiter {
+            EventLoop &loop;
+            double seconds;
+
+            bool await_ready() const { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) { loop.after(seconds, Resumer{handle}); }
+
+            void await_resume() const {}
+        };
+        return Awaiter{*this, seconds};
+    }
+
+    auto readable(int fd) {
+        struct Awaiter {
+            EventLoop &loop;
+            int fd;
+
+            bool await_ready() const { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) { loop.whenReadable(fd, Resumer{handle}); }
+
+            void await_resume() const {}
+        };
+        return Awaiter{*this, fd};
+    }
+
+    // 在线程池中执行 work 并取得其返回值，work 抛出的异常在 co_await 处重新抛出
+    template<typename F>
+    auto onPool(F work) {
+        using T = std::invoke_result_t<F &>;
+        struct Awaiter {
+            EventLoop &loop;
+            F work;
+            std::optional<T> result;
+            std::exception_ptr error;
+
+            bool await_ready() const { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                loop.offload([this] {
+                    try {
+                        result.emplace(work());
+                    } catch (...) {
+                        error = std::current_exception();
+                    }
+                }, Resumer{handle});
+            }
+
+            T await_resume() {
+                if (error) std::rethrow_exception(error);
+                return std::move(*result);
+            }
+        };
+        return Awaiter{*this, std::move(work), std::nullopt, nullptr};
+    }
+
+private:
+    // 恢复协程的回调；没有被调用就销毁时（事件循环销毁）一并销毁协程
+    class Resumer {
+    public:
+        explicit Resumer(std::coroutine_handle<> handle) : handle_{std::make_shared<Handle>(handle)} {}
+
+        void operator()() const { std::exchange(handle_->handle, nullptr).resume(); }
+
+    private:
+        struct Handle {
+            std::coroutine_handle<> handle;
+
+            ~Handle() {
+                if (handle) handle.destroy();
+            }
+        };
+
+        std::shared_ptr<Handle> handle_;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Timer {
+        Clock::time_point deadline;
+        uint64_t sequence;  // 到期时间相同的按加入的顺序执行
+        Callback callback;
+
+        bool operator>(const Timer &other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    // 还有会产生回调的事件
+    [[nodiscard]] bool pending();
+
+    // 等待事件，最多等待 timeout 毫秒（-1 为一直等待）
+    void poll(int timeout);
+
+    void runPosted();
+
+    int epoll_{-1};
+    int wakeup_{-1};    // eventfd，post 时写入以唤醒 epoll_wait
+    bool running_{false};
+
+    std::vector<Callback> ready_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers_;
+    uint64_t timerSequence_{0};
+    std::unordered_map<int, Callback> watches_;
+    size_t offloaded_{0};   // 线程池中尚未完成的操作
+    size_t holds_{0};
+
+    std::mutex mutex_;      // 保护 posted_
+    std::vector<Callback> posted_;
+
+    std::unique_ptr<ThreadPool> pool_;  // 第一次 offload 时创建
+};
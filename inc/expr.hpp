@@ -1,229 +1,378 @@
-#pragma once
-
-#include <vector>
-
-#include "token.hpp"
-
-struct AssignExpr;
-struct BinaryExpr;
-struct GroupingExpr;
-struct LiteralExpr;
-struct StrExpr;
-struct UnaryExpr;
-struct VariableExpr;
-struct LogicalExpr;
-struct CallExpr;
-struct GetExpr;
-struct SetExpr;
-struct ThisExpr;
-struct SuperExpr;
-
-struct Expr {
-    struct AbstractVisitor {
-        virtual void visitAssignExpr(std::shared_ptr<AssignExpr> expr) = 0;
-
-        virtual void visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) = 0;
-
-        virtual void visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) = 0;
-
-        virtual void visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) = 0;
-
-        virtual void visitStrExpr(std::shared_ptr<StrExpr> expr) = 0;
-
-        virtual void visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) = 0;
-
-        virtual void visitVariableExpr(std::shared_ptr<VariableExpr> expr) = 0;
-
-        virtual void visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) = 0;
-
-        virtual void visitCallExpr(std::shared_ptr<CallExpr> expr) = 0;
-
-        virtual void visitGetExpr(std::shared_ptr<GetExpr> expr) = 0;
-
-        virtual void visitSetExpr(std::shared_ptr<SetExpr> expr) = 0;
-
-        virtual void visitThisExpr(std::shared_ptr<ThisExpr> expr) = 0;
-
-        virtual void visitSuperExpr(std::shared_ptr<SuperExpr> expr) = 0;
-    };
-
-    virtual void accept(AbstractVisitor &visitor) = 0;
-
-    virtual ~Expr() = default;
-};
-
-using ExprPtr = std::shared_ptr<Expr>;
-
-struct AssignExpr : public Expr, public std::enable_shared_from_this<AssignExpr> {
-    std::shared_ptr<Token> name_;
-    std::shared_ptr<Expr> value_;
-
-    AssignExpr(std::shared_ptr<Token> name, std::shared_ptr<Expr> value)
-            : name_{std::move(name)}, value_{std::move(value)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitAssignExpr(shared_from_this());
-    }
-};
-
-using AssignExprPtr = std::shared_ptr<AssignExpr>;
-
-struct BinaryExpr : public Expr, public std::enable_shared_from_this<BinaryExpr> {
-    std::shared_ptr<Expr> left_;
-    std::shared_ptr<Token> op_;
-    std::shared_ptr<Expr> right_;
-
-    BinaryExpr(std::shared_ptr<Expr> left, std::shared_ptr<Token> op, std::shared_ptr<Expr> right)
-            : left_{std::move(left)}, op_{std::move(op)}, right_{std::move(right)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitBinaryExpr(shared_from_this());
-    }
-};
-
-using BinaryExprPtr = std::shared_ptr<BinaryExpr>;
-
-struct GroupingExpr : public Expr, public std::enable_shared_from_this<GroupingExpr> {
-    std::shared_ptr<Expr> expression_;
-
-    explicit GroupingExpr(std::shared_ptr<Expr> expression) : expression_{std::move(expression)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitGroupingExpr(shared_from_this());
-    }
-};
-
-using GroupingExprPtr = std::shared_ptr<GroupingExpr>;
-
-struct LiteralExpr : public Expr, public std::enable_shared_from_this<LiteralExpr> {
-    std::shared_ptr<LoxValue> value_;
-
-    explicit LiteralExpr(std::shared_ptr<LoxValue> value) : value_{std::move(value)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitLiteralExpr(shared_from_this());
-    }
-};
-
-using LiteralExprPtr = std::shared_ptr<LiteralExpr>;
-
-struct StrExpr : public Expr, public std::enable_shared_from_this<StrExpr> {
-    std::shared_ptr<std::vector<ExprPtr>> strs;
-
-    explicit StrExpr(std::shared_ptr<std::vector<ExprPtr>> strs) : strs{std::move(strs)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitStrExpr(shared_from_this());
-    }
-};
-
-using StrExprPtr = std::shared_ptr<StrExpr>;
-
-struct UnaryExpr : public Expr, public std::enable_shared_from_this<UnaryExpr> {
-    std::shared_ptr<Token> op_;
-    std::shared_ptr<Expr> right_;
-
-    UnaryExpr(std::shared_ptr<Token> op, std::shared_ptr<Expr> right) : op_{std::move(op)}, right_{std::move(right)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitUnaryExpr(shared_from_this());
-    }
-};
-
-using UnaryExprPtr = std::shared_ptr<UnaryExpr>;
-
-struct VariableExpr : public Expr, public std::enable_shared_from_this<VariableExpr> {
-    std::shared_ptr<Token> name_;
-
-    explicit VariableExpr(std::shared_ptr<Token> name) : name_{std::move(name)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitVariableExpr(shared_from_this());
-    }
-};
-
-using VariableExprPtr = std::shared_ptr<VariableExpr>;
-
-struct LogicalExpr : public Expr, public std::enable_shared_from_this<LogicalExpr> {
-    std::shared_ptr<Expr> left_;
-    std::shared_ptr<Token> op_;
-    std::shared_ptr<Expr> right_;
-
-    LogicalExpr(std::shared_ptr<Expr> left, std::shared_ptr<Token> op, std::shared_ptr<Expr> right)
-            : left_{std::move(left)}, op_{std::move(op)}, right_{std::move(right)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitLogicalExpr(shared_from_this());
-    }
-};
-
-using LogicalExprPtr = std::shared_ptr<LogicalExpr>;
-
-struct CallExpr : public Expr, public std::enable_shared_from_this<CallExpr> {
-    std::shared_ptr<Expr> callee_;
-    std::shared_ptr<Token> paren_;
-    std::shared_ptr<std::vector<ExprPtr>> args_;
-
-    CallExpr(std::shared_ptr<Expr> callee, std::shared_ptr<Token> paren, std::shared_ptr<std::vector<ExprPtr>> args)
-            : callee_{std::move(callee)}, paren_{std::move(paren)}, args_{std::move(args)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitCallExpr(shared_from_this());
-    }
-};
-
-using CallExprPtr = std::shared_ptr<CallExpr>;
-
-struct GetExpr : public Expr, public std::enable_shared_from_this<GetExpr> {
-    std::shared_ptr<Expr> expr_;
-    std::shared_ptr<Token> name_;
-
-    GetExpr(std::shared_ptr<Expr> expr_, std::shared_ptr<Token> name_) : expr_{std::move(expr_)}, name_{std::move(name_)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitGetExpr(shared_from_this());
-    }
-};
-
-using GetExprPtr = std::shared_ptr<GetExpr>;
-
-struct SetExpr : public Expr, public std::enable_shared_from_this<SetExpr> {
-    std::shared_ptr<Expr> expr_;
-    std::shared_ptr<Token> name_;
-    std::shared_ptr<Expr> value_;
-
-    SetExpr(std::shared_ptr<Expr> expr_, std::shared_ptr<Token> name_, std::shared_ptr<Expr> value_)
-            : expr_{std::move(expr_)}, name_{std::move(name_)}, value_{std::move(value_)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitSetExpr(shared_from_this());
-    }
-};
-
-using SetExprPtr = std::shared_ptr<SetExpr>;
-
-struct ThisExpr : public Expr, public std::enable_shared_from_this<ThisExpr> {
-    std::shared_ptr<Token> keyword_;
-
-    explicit ThisExpr(std::shared_ptr<Token> keyword_) : keyword_{std::move(keyword_)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitThisExpr(shared_from_this());
-    }
-};
-
-using ThisExprPtr = std::shared_ptr<ThisExpr>;
-
-struct SuperExpr : public Expr, public std::enable_shared_from_this<SuperExpr> {
-    std::shared_ptr<Token> keyword_;
-    std::shared_ptr<Token> method_;
-
-    SuperExpr(std::shared_ptr<Token> keyword_, std::shared_ptr<Token> method_)
-            : keyword_{std::move(keyword_)}, method_{std::move(method_)} {}
-
-    void accept(AbstractVisitor &visitor) override {
-        visitor.visitSuperExpr(shared_from_this());
-    }
-};
-
-using SuperExprPtr = std::shared_ptr<SuperExpr>;
\ No newline at end of file
+#pragma once
+
+#include <vector>
+
+#include "token.hpp"
+
+struct AssignExpr;
+struct BinaryExpr;
+struct GroupingExpr;
+struct LiteralExpr;
+struct StrExpr;
+struct UnaryExpr;
+struct VariableExpr;
+struct LogicalExpr;
+struct CallExpr;
+struct GetExpr;
+struct SetExpr;
+struct ThisExpr;
+struct SuperExpr;
+struct ListExpr;
+struct IndexExpr;
+struct IndexSetExpr;
+struct MapExpr;
+struct SetLiteralExpr;
+struct SliceExpr;
+struct AwaitExpr;
+
+struct Expr {
+    struct AbstractVisitor {
+        virtual void visitAssignExpr(AssignExpr *expr) = 0;
+
+        virtual void visitBinaryExpr(BinaryExpr *expr) = 0;
+
+        virtual void visitGroupingExpr(GroupingExpr *expr) = 0;
+
+        virtual void visitLiteralExpr(LiteralExpr *expr) = 0;
+
+        virtual void visitStrExpr(StrExpr *expr) = 0;
+
+        virtual void visitUnaryExpr(UnaryExpr *expr) = 0;
+
+        virtual void visitVariableExpr(VariableExpr *expr) = 0;
+
+        virtual void visitLogicalExpr(LogicalExpr *expr) = 0;
+
+        virtual void visitCallExpr(CallExpr *expr) = 0;
+
+        virtual void visitGetExpr(GetExpr *expr) = 0;
+
+        virtual void visitSetExpr(SetExpr *expr) = 0;
+
+        virtual void visitThisExpr(ThisExpr *expr) = 0;
+
+        virtual void visitSuperExpr(SuperExpr *expr) = 0;
+
+        virtual void visitListExpr(ListExpr *expr) = 0;
+
+        virtual void visitIndexExpr(IndexExpr *expr) = 0;
+
+        virtual void visitIndexSetExpr(IndexSetExpr *expr) = 0;
+
+        virtual void visitMapExpr(MapExpr *expr) = 0;
+
+        virtual void visitSetLiteralExpr(SetLiteralExpr *expr) = 0;
+
+        virtual void visitSliceExpr(SliceExpr *expr) = 0;
+
+        virtual void visitAwaitExpr(AwaitExpr *expr) = 0;
+    };
+
+    virtual void accept(AbstractVisitor &visitor) = 0;
+
+    virtual ~Expr() = default;
+};
+
+using ExprPtr = std::shared_ptr<Expr>;
+
+struct AssignExpr : public Expr, public std::enable_shared_from_this<AssignExpr> {
+    TokenId name_;
+    std::shared_ptr<Expr> value_;
+    int depth_{-1};     // Resolver 计算出的作用域深度，-1 表示全局变量
+
+    AssignExpr(TokenId name, std::shared_ptr<Expr> value)
+            : name_{name}, value_{std::move(value)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitAssignExpr(this);
+    }
+};
+
+using AssignExprPtr = std::shared_ptr<AssignExpr>;
+
+struct BinaryExpr : public Expr, public std::enable_shared_from_this<BinaryExpr> {
+    std::shared_ptr<Expr> left_;
+    TokenId op_;
+    std::shared_ptr<Expr> right_;
+
+    BinaryExpr(std::shared_ptr<Expr> left, TokenId op, std::shared_ptr<Expr> right)
+            : left_{std::move(left)}, op_{op}, right_{std::move(right)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitBinaryExpr(this);
+    }
+};
+
+using BinaryExprPtr = std::shared_ptr<BinaryExpr>;
+
+struct GroupingExpr : public Expr, public std::enable_shared_from_this<GroupingExpr> {
+    std::shared_ptr<Expr> expression_;
+
+    explicit GroupingExpr(std::shared_ptr<Expr> expression) : expression_{std::move(expression)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitGroupingExpr(this);
+    }
+};
+
+using GroupingExprPtr = std::shared_ptr<GroupingExpr>;
+
+struct LiteralExpr : public Expr, public std::enable_shared_from_this<LiteralExpr> {
+    std::shared_ptr<LoxValue> value_;
+    uint32_t slot_;     // 在所属程序中的编号
+
+    LiteralExpr(std::shared_ptr<LoxValue> value, uint32_t slot) : value_{std::move(value)}, slot_{slot} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitLiteralExpr(this);
+    }
+};
+
+using LiteralExprPtr = std::shared_ptr<LiteralExpr>;
+
+struct StrExpr : public Expr, public std::enable_shared_from_this<StrExpr> {
+    std::shared_ptr<std::vector<ExprPtr>> strs;
+
+    explicit StrExpr(std::shared_ptr<std::vector<ExprPtr>> strs) : strs{std::move(strs)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitStrExpr(this);
+    }
+};
+
+using StrExprPtr = std::shared_ptr<StrExpr>;
+
+struct UnaryExpr : public Expr, public std::enable_shared_from_this<UnaryExpr> {
+    TokenId op_;
+    std::shared_ptr<Expr> right_;
+
+    UnaryExpr(TokenId op, std::shared_ptr<Expr> right) : op_{op}, right_{std::move(right)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitUnaryExpr(this);
+    }
+};
+
+using UnaryExprPtr = std::shared_ptr<UnaryExpr>;
+
+struct VariableExpr : public Expr, public std::enable_shared_from_this<VariableExpr> {
+    TokenId name_;
+    int depth_{-1};     // Resolver 计算出的作用域深度，-1 表示全局变量
+
+    explicit VariableExpr(TokenId name) : name_{name} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitVariableExpr(this);
+    }
+};
+
+using VariableExprPtr = std::shared_ptr<VariableExpr>;
+
+struct LogicalExpr : public Expr, public std::enable_shared_from_this<LogicalExpr> {
+    std::shared_ptr<Expr> left_;
+    TokenId op_;
+    std::shared_ptr<Expr> right_;
+
+    LogicalExpr(std::shared_ptr<Expr> left, TokenId op, std::shared_ptr<Expr> right)
+            : left_{std::move(left)}, op_{op}, right_{std::move(right)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitLogicalExpr(this);
+    }
+};
+
+using LogicalExprPtr = std::shared_ptr<LogicalExpr>;
+
+struct CallExpr : public Expr, public std::enable_shared_from_this<CallExpr> {
+    std::shared_ptr<Expr> callee_;
+    TokenId paren_;
+    std::shared_ptr<std::vector<ExprPtr>> args_;
+    uint8_t intrinsic_{0};  // Resolver 识别出的 math 内建函数编号（见 LoxMath），0 表示普通调用
+
+    CallExpr(std::shared_ptr<Expr> callee, TokenId paren, std::shared_ptr<std::vector<ExprPtr>> args)
+            : callee_{std::move(callee)}, paren_{paren}, args_{std::move(args)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitCallExpr(this);
+    }
+};
+
+using CallExprPtr = std::shared_ptr<CallExpr>;
+
+struct GetExpr : public Expr, public std::enable_shared_from_this<GetExpr> {
+    std::shared_ptr<Expr> expr_;
+    TokenId name_;
+
+    GetExpr(std::shared_ptr<Expr> expr_, TokenId name_) : expr_{std::move(expr_)}, name_{name_} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitGetExpr(this);
+    }
+};
+
+using GetExprPtr = std::shared_ptr<GetExpr>;
+
+struct SetExpr : public Expr, public std::enable_shared_from_this<SetExpr> {
+    std::shared_ptr<Expr> expr_;
+    TokenId name_;
+    std::shared_ptr<Expr> value_;
+
+    SetExpr(std::shared_ptr<Expr> expr_, TokenId name_, std::shared_ptr<Expr> value_)
+            : expr_{std::move(expr_)}, name_{name_}, value_{std::move(value_)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitSetExpr(this);
+    }
+};
+
+using SetExprPtr = std::shared_ptr<SetExpr>;
+
+struct ThisExpr : public Expr, public std::enable_shared_from_this<ThisExpr> {
+    TokenId keyword_;
+    int depth_{-1};
+
+    explicit ThisExpr(TokenId keyword_) : keyword_{keyword_} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitThisExpr(this);
+    }
+};
+
+using ThisExprPtr = std::shared_ptr<ThisExpr>;
+
+struct SuperExpr : public Expr, public std::enable_shared_from_this<SuperExpr> {
+    TokenId keyword_;
+    TokenId method_;
+    int depth_{-1};
+
+    SuperExpr(TokenId keyword_, TokenId method_)
+            : keyword_{keyword_}, method_{method_} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitSuperExpr(this);
+    }
+};
+
+using SuperExprPtr = std::shared_ptr<SuperExpr>;
+
+// 类型标注，如 int、list[int]
+struct TypeAnnotation {
+    TokenId name_;
+    std::shared_ptr<TypeAnnotation> element_;   // 集合的元素类型，其它类型为空
+};
+
+using TypeAnnotationPtr = std::shared_ptr<TypeAnnotation>;
+
+// 列表字面量 [a, b, c]
+struct ListExpr : public Expr, public std::enable_shared_from_this<ListExpr> {
+    TokenId bracket_;
+    std::shared_ptr<std::vector<ExprPtr>> elements_;
+    TypeAnnotationPtr elementType_;     // 来自声明的类型标注（var l: list[int] = [...]），为空时由元素推断
+
+    ListExpr(TokenId bracket, std::shared_ptr<std::vector<ExprPtr>> elements)
+            : bracket_{bracket}, elements_{std::move(elements)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitListExpr(this);
+    }
+};
+
+using ListExprPtr = std::shared_ptr<ListExpr>;
+
+// 下标访问 a[i]
+struct IndexExpr : public Expr, public std::enable_shared_from_this<IndexExpr> {
+    ExprPtr object_;
+    TokenId bracket_;
+    ExprPtr index_;
+
+    IndexExpr(ExprPtr object, TokenId bracket, ExprPtr index)
+            : object_{std::move(object)}, bracket_{bracket}, index_{std::move(index)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitIndexExpr(this);
+    }
+};
+
+using IndexExprPtr = std::shared_ptr<IndexExpr>;
+
+// 下标赋值 a[i] = v
+struct IndexSetExpr : public Expr, public std::enable_shared_from_this<IndexSetExpr> {
+    ExprPtr object_;
+    TokenId bracket_;
+    ExprPtr index_;
+    ExprPtr value_;
+
+    IndexSetExpr(ExprPtr object, TokenId bracket, ExprPtr index, ExprPtr value)
+            : object_{std::move(object)}, bracket_{bracket}, index_{std::move(index)}, value_{std::move(value)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitIndexSetExpr(this);
+    }
+};
+
+using IndexSetExprPtr = std::shared_ptr<IndexSetExpr>;
+
+// 切片 a[i:j]，省略的 i、j 为空
+struct SliceExpr : public Expr, public std::enable_shared_from_this<SliceExpr> {
+    ExprPtr object_;
+    TokenId bracket_;
+    ExprPtr begin_;
+    ExprPtr end_;
+
+    SliceExpr(ExprPtr object, TokenId bracket, ExprPtr begin, ExprPtr end)
+            : object_{std::move(object)}, bracket_{bracket}, begin_{std::move(begin)}, end_{std::move(end)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitSliceExpr(this);
+    }
+};
+
+using SliceExprPtr = std::shared_ptr<SliceExpr>;
+
+// await future，等待异步函数等返回的 future 完成并取得其结果
+struct AwaitExpr : public Expr, public std::enable_shared_from_this<AwaitExpr> {
+    TokenId keyword_;
+    ExprPtr value_;
+
+    AwaitExpr(TokenId keyword, ExprPtr value)
+            : keyword_{keyword}, value_{std::move(value)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitAwaitExpr(this);
+    }
+};
+
+using AwaitExprPtr = std::shared_ptr<AwaitExpr>;
+
+// 字典字面量 {"a": x, "b": y}
+struct MapExpr : public Expr, public std::enable_shared_from_this<MapExpr> {
+    TokenId brace_;
+    std::shared_ptr<std::vector<ExprPtr>> keys_;
+    std::shared_ptr<std::vector<ExprPtr>> values_;
+    TypeAnnotationPtr valueType_;   // 来自声明的类型标注（var m: map[int] = {...}），为空时由值推断
+
+    MapExpr(TokenId brace, std::shared_ptr<std::vector<ExprPtr>> keys, std::shared_ptr<std::vector<ExprPtr>> values)
+            : brace_{brace}, keys_{std::move(keys)}, values_{std::move(values)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitMapExpr(this);
+    }
+};
+
+using MapExprPtr = std::shared_ptr<MapExpr>;
+
+// 集合字面量 {1, 2, 3}；SetExpr 是属性赋值，这里取名 SetLiteralExpr 以区分
+struct SetLiteralExpr : public Expr, public std::enable_shared_from_this<SetLiteralExpr> {
+    TokenId brace_;
+    std::shared_ptr<std::vector<ExprPtr>> elements_;
+    TypeAnnotationPtr elementType_; // 来自声明的类型标注（var s: set[int] = {}），为空时由元素推断
+
+    SetLiteralExpr(TokenId brace, std::shared_ptr<std::vector<ExprPtr>> elements)
+            : brace_{brace}, elements_{std::move(elements)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitSetLiteralExpr(this);
+    }
+};
+
+using SetLiteralExprPtr = std::shared_ptr<SetLiteralExpr>;
@@ -0,0 +1,101 @@
+#ifndef IDUN_H
+#define IDUN_H
+
+/* Idun 的 C 接口
+ * 编译一次、多次运行：idun_compile 得到只读的程序句柄，可同时交给多个线程；
+ * 每个线程创建自己的 idun_context，idun_run 执行顶层代码后即可用 idun_call 反复调用脚本中的函数，不再重新解析。
+ *
+ * 所有权：返回 idun_value * 的函数把所有权交给调用者，需用 idun_value_free 释放；
+ * 宿主函数收到的参数由 Idun 持有，只在调用期间有效，宿主函数返回的值则交给 Idun；
+ * 宿主函数也可以直接返回收到的某个参数，此时 Idun 只取出其中的值，不会释放该参数。
+ * 失败的函数返回 NULL 或非零值，原因可用 idun_error 取得。
+ * */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define IDUN_API __declspec(dllexport)
+#else
+#define IDUN_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct idun_program idun_program;
+typedef struct idun_context idun_context;
+typedef struct idun_value idun_value;
+
+typedef enum idun_type {
+    IDUN_NIL,
+    IDUN_BOOL,
+    IDUN_INT,
+    IDUN_FLOAT,
+    IDUN_STRING,
+    IDUN_OBJECT     /* 函数、类、实例、模块等 */
+} idun_type;
+
+/* 宿主函数，args 中共有 argc 个参数；返回 NULL 相当于返回 nil */
+typedef idun_value *(*idun_native)(idun_context *context, idun_value *const *args, size_t argc, void *userdata);
+
+/* 当前线程上一次失败的原因，没有时返回空字符串 */
+IDUN_API const char *idun_error(void);
+
+/* 编译源码，name 用于错误信息，可以为 NULL */
+IDUN_API idun_program *idun_compile(const char *source, size_t length, const char *name);
+
+IDUN_API idun_program *idun_compile_file(const char *path);
+
+IDUN_API void idun_program_free(idun_program *program);
+
+/* 设置查找模块的目录（之后还会查找环境变量 IDUN_PATH 中的目录），应在运行任何程序之前调用 */
+IDUN_API void idun_module_paths(const char *const *paths, size_t count);
+
+IDUN_API idun_context *idun_context_new(void);
+
+IDUN_API void idun_context_free(idun_context *context);
+
+/* 注册宿主函数，此后每次 idun_run 都会把它定义为全局函数 */
+IDUN_API int idun_register(idun_context *context, const char *name, size_t arity, idun_native function,
+                           void *userdata);
+
+/* 在全新的全局环境中执行程序的顶层代码 */
+IDUN_API int idun_run(idun_context *context, const idun_program *program);
+
+/* 调用上一次 idun_run 定义的全局函数 */
+IDUN_API idun_value *idun_call(idun_context *context, const char *name, idun_value *const *args, size_t argc);
+
+/* 读取上一次 idun_run 留下的全局变量 */
+IDUN_API idun_value *idun_global(idun_context *context, const char *name);
+
+IDUN_API idun_value *idun_nil(void);
+
+IDUN_API idun_value *idun_bool(int value);
+
+IDUN_API idun_value *idun_int(int64_t value);
+
+IDUN_API idun_value *idun_float(double value);
+
+IDUN_API idun_value *idun_string(const char *text, size_t length);
+
+IDUN_API void idun_value_free(idun_value *value);
+
+IDUN_API idun_type idun_type_of(const idun_value *value);
+
+IDUN_API int idun_as_bool(const idun_value *value);
+
+/* 浮点数会被截断 */
+IDUN_API int64_t idun_as_int(const idun_value *value);
+
+IDUN_API double idun_as_float(const idun_value *value);
+
+/* 返回的内容在 value 释放前有效，不是字符串时返回 NULL */
+IDUN_API const char *idun_as_string(const idun_value *value, size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IDUN_H */
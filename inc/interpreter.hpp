@@ -3,77 +3,156 @@
 #include "expr.hpp"
 #include "stmt.hpp"
 #include "environment.hpp"
+#include "lox_exception.hpp"
 
+#include <iostream>
 #include <vector>
 #include <sstream>
+#include <unordered_set>
+
+class LoxModule;
+class LoxList;
+class Coroutine;
+class EventLoop;
+class LoxFuture;
+class Mailbox;
+
+// 一个编译单元（主脚本或模块）在某个解释器中的运行状态
+struct Unit {
+    const TokenBuffer *tokens;
+    std::shared_ptr<Environment> global;
+    std::vector<LoxValuePtr> literals;  // 字面量的副本，以 LiteralExpr::slot_ 为下标，各个解释器互不共享
+};
+
+using UnitPtr = std::shared_ptr<Unit>;
 
 struct Interpreter : public Expr::AbstractVisitor, public Stmt::AbstractVisitor {
-    explicit Interpreter();
+    explicit Interpreter(std::ostream &out = std::cout, std::ostream &err = std::cerr);
+
+    // 先结束暂停中的协程，它们的函数体仍在使用解释器
+    ~Interpreter();
+
+    std::ostream &out;  // print 的输出位置
+    std::ostream &err;  // 运行时错误的输出位置
+
+    std::vector<std::string> arguments;    // 传给脚本的命令行参数
 
     LoxValuePtr result;
 
     std::shared_ptr<Environment> global;
     std::shared_ptr<Environment> env;
 
+    UnitPtr unit;   // 当前正在执行的代码所属的编译单元
+    const TokenBuffer *tokens{nullptr};   // 即 unit->tokens
+
     std::ostringstream string;  // 字符串拼接时的缓冲区
 
-    std::unordered_map<ExprPtr, int> locals; // 变量及其所属作用域
+    StringMap<std::shared_ptr<LoxModule>> modules;  // 已导入的模块，以完整的模块名为键
+
+    Coroutine *coroutine{nullptr};  // 正在执行函数体的协程（生成器或任务），yield、await 使它暂停
+    std::unordered_set<Coroutine *> coroutines;     // 已经开始而尚未结束的协程
+
+    std::unique_ptr<EventLoop> loop;    // 异步函数和异步内建函数使用的事件循环，第一次使用时创建
+    std::shared_ptr<Mailbox> mailbox;   // 宿主发来的消息，由 Context 设置
+    std::vector<std::shared_ptr<LoxFuture>> failed;  // 出错结束的任务，没有被 await 的在脚本结束时报告
 
     // Visitor methods for Expressions
-    void visitAssignExpr(AssignExprPtr expr) override;
+    void visitAssignExpr(AssignExpr *expr) override;
+
+    void visitBinaryExpr(BinaryExpr *expr) override;
+
+    void visitGroupingExpr(GroupingExpr *expr) override;
+
+    void visitLiteralExpr(LiteralExpr *expr) override;
+
+    void visitStrExpr(StrExpr *expr) override;
+
+    void visitUnaryExpr(UnaryExpr *expr) override;
+
+    void visitVariableExpr(VariableExpr *expr) override;
 
-    void visitBinaryExpr(BinaryExprPtr expr) override;
+    void visitLogicalExpr(LogicalExpr *expr) override;
 
-    void visitGroupingExpr(GroupingExprPtr expr) override;
+    void visitCallExpr(CallExpr *expr) override;
 
-    void visitLiteralExpr(LiteralExprPtr expr) override;
+    void visitGetExpr(GetExpr *expr) override;
 
-    void visitStrExpr(StrExprPtr expr) override;
+    void visitSetExpr(SetExpr *expr) override;
 
-    void visitUnaryExpr(UnaryExprPtr expr) override;
+    void visitThisExpr(ThisExpr *expr) override;
 
-    void visitVariableExpr(VariableExprPtr expr) override;
+    void visitSuperExpr(SuperExpr *expr) override;
 
-    void visitLogicalExpr(LogicalExprPtr expr) override;
+    void visitListExpr(ListExpr *expr) override;
 
-    void visitCallExpr(CallExprPtr expr) override;
+    void visitIndexExpr(IndexExpr *expr) override;
 
-    void visitGetExpr(GetExprPtr expr) override;
+    void visitIndexSetExpr(IndexSetExpr *expr) override;
 
-    void visitSetExpr(SetExprPtr expr) override;
+    void visitMapExpr(MapExpr *expr) override;
 
-    void visitThisExpr(ThisExprPtr expr) override;
+    void visitSetLiteralExpr(SetLiteralExpr *expr) override;
 
-    void visitSuperExpr(SuperExprPtr expr) override;
+    void visitSliceExpr(SliceExpr *expr) override;
+
+    void visitAwaitExpr(AwaitExpr *expr) override;
 
     // Visitor methods for Statements
-    void visitIfStmt(IfStmtPtr stmt) override;
+    void visitIfStmt(IfStmt *stmt) override;
+
+    void visitWhileStmt(WhileStmt *stmt) override;
 
-    void visitWhileStmt(WhileStmtPtr stmt) override;
+    void visitContinueStmt(ContinueStmt *stmt) override;
 
-    void visitContinueStmt(ContinueStmtPtr stmt) override;
+    void visitBreakStmt(BreakStmt *stmt) override;
 
-    void visitBreakStmt(BreakStmtPtr stmt) override;
+    void visitForStmt(ForStmt *stmt) override;
 
-    void visitForStmt(ForStmtPtr stmt) override;
+    void visitWhenStmt(WhenStmt *stmt) override;
 
-    void visitWhenStmt(WhenStmtPtr stmt) override;
+    void visitBlockStmt(BlockStmt *stmt) override;
 
-    void visitBlockStmt(BlockStmtPtr stmt) override;
+    void visitExpressionStmt(ExpressionStmt *stmt) override;
 
-    void visitExpressionStmt(ExpressionStmtPtr stmt) override;
+    void visitLetStmt(LetStmt *stmt) override;
 
-    void visitLetStmt(LetStmtPtr stmt) override;
+    void visitVarStmt(VarStmt *stmt) override;
 
-    void visitVarStmt(VarStmtPtr stmt) override;
+    void visitFunctionStmt(FunctionStmt *stmt) override;
 
-    void visitFunctionStmt(FunctionStmtPtr stmt) override;
+    void visitReturnStmt(ReturnStmt *stmt) override;
 
-    void visitReturnStmt(ReturnStmtPtr stmt) override;
+    void visitYieldStmt(YieldStmt *stmt) override;
 
-    void visitClassStmt(ClassStmtPtr stmt) override;
+    void visitClassStmt(ClassStmt *stmt) override;
+
+    void visitImportStmt(ImportStmt *stmt) override;
 
     // Helpers
+    // 直接调用 math 的内建函数，callee 不是数学模块时返回 false
+    bool callIntrinsic(CallExpr *expr);
+
+    // 求值 object.name
+    LoxValuePtr getMember(const LoxValuePtr &object, TokenId name);
+
+    // 检查下标是否为 [0, size) 内的整数，type 为被索引的值的类型，用于错误信息
+    size_t checkIndex(TokenId bracket, std::string_view type, size_t size, const LoxValuePtr &index) const;
+
+    // 检查切片的起止是否为整数且 0 <= begin <= end <= size，省略的起止为空
+    std::pair<size_t, size_t> checkSlice(TokenId bracket, size_t size, const LoxValuePtr &begin, const LoxValuePtr &end) const;
+
+    // 求值 value in container
+    bool contains(TokenId op, const LoxValuePtr &container, const LoxValuePtr &value);
+
+    static void defineNatives(Environment &environment);
+
+    // 把 C++ 函数注册为全局函数，参数和返回值按函数签名转换，定义见 native.hpp
+    template<typename F>
+    void def(std::string name, F function);
+
+    // 复制基本类型的值
+    static LoxValuePtr copyValue(const LoxValuePtr &value);
+
     static bool isTruth(const LoxValuePtr &value);
 
     static bool isEqual(const LoxValuePtr &a, const LoxValuePtr &b);
@@ -91,9 +170,13 @@ struct Interpreter : public Expr::AbstractVisitor, public Stmt::AbstractVisitor
     static double getFloat(const LoxValuePtr &value);
 
     // Checkers
-    static void checkNumberOp(TokenPtr op, const LoxValuePtr &value);
+    interpreter_error error(TokenId token, const std::string &msg) const {
+        return interpreter_error{(*tokens)[token], msg};
+    }
+
+    void checkNumberOp(TokenId op, const LoxValuePtr &value) const;
 
-    static void checkNumberOps(TokenPtr op, const LoxValuePtr &left, const LoxValuePtr &right);
+    void checkNumberOps(TokenId op, const LoxValuePtr &left, const LoxValuePtr &right) const;
 
     LoxValuePtr evaluate(const ExprPtr &expr);
 
@@ -101,10 +184,36 @@ struct Interpreter : public Expr::AbstractVisitor, public Stmt::AbstractVisitor
 
     void executeBlock(const std::shared_ptr<std::vector<StmtPtr>> &statements, std::shared_ptr<Environment> env);
 
-    LoxValuePtr lookupVariable(const TokenPtr &name, const ExprPtr &expr);
+    LoxValuePtr lookupVariable(TokenId name, int depth);
 
-    void resolve(const ExprPtr &expr, int depth);
+    void loadBody(FunctionStmt *function);
 
-    void interpret(const std::vector<StmtPtr> &statements);
+    EventLoop &eventLoop();
+
+    // 运行事件循环直到没有待处理的事件，重新抛出第一个没有被 await 的任务中的错误
+    void awaitTasks();
+
+    // 运行时出错返回 false
+    bool interpret(const std::vector<StmtPtr> &statements, const TokenBuffer &program);
 };
 
+// 执行其它编译单元的代码（如函数调用、模块初始化）时切换编译单元和全局环境，退出时恢复
+struct UnitGuard {
+    UnitGuard(Interpreter &interpreter, const UnitPtr &unit)
+            : interpreter_{interpreter}, unit_{unit}, global_{unit->global} {
+        std::swap(interpreter_.unit, unit_);
+        std::swap(interpreter_.global, global_);
+        interpreter_.tokens = unit->tokens;
+    }
+
+    ~UnitGuard() {
+        std::swap(interpreter_.unit, unit_);
+        std::swap(interpreter_.global, global_);
+        interpreter_.tokens = interpreter_.unit ? interpreter_.unit->tokens : nullptr;
+    }
+
+private:
+    Interpreter &interpreter_;
+    UnitPtr unit_;
+    std::shared_ptr<Environment> global_;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "source.hpp"
+#include "compiler.hpp"
+#include "native.hpp"
+
+struct Interpreter;
+class Mailbox;
+
+/* 隔离执行
+ * Program 是编译好的只读程序，可以同时交给多个线程；每个线程使用自己的 Context 运行它。
+ * 运行时只读取语法树而不复制其中的 shared_ptr，字面量在每个 Context 中各有一份副本，
+ * 多个线程之间不会争用同一个对象的引用计数。
+ * 为了保证只读，程序总是完整解析（忽略 lazyParse）；从多个线程导入模块时，模块注册表同样不能使用延迟解析。
+ * */
+class Program {
+public:
+    // 编译失败时返回 nullptr，错误信息输出到 err
+    static std::shared_ptr<const Program> compile(SourcePtr source, CompileOptions options = {},
+                                                  std::ostream &err = std::cerr);
+
+    [[nodiscard]] const CompiledProgram &compiled() const { return *program_; }
+
+    [[nodiscard]] const Source &source() const { return *source_; }
+
+private:
+    SourcePtr source_;
+    std::unique_ptr<CompiledProgram> program_;
+};
+
+using ProgramPtr = std::shared_ptr<const Program>;
+
+// 一个线程上的执行环境，不能同时在多个线程中使用
+class Context {
+public:
+    explicit Context(std::ostream &out = std::cout, std::ostream &err = std::cerr);
+
+    ~Context();
+
+    Context(const Context &) = delete;
+
+    Context &operator=(const Context &) = delete;
+
+    // 在全新的全局环境中运行 program，运行时出错返回 false。
+    // 顶层代码执行完后继续运行事件循环，直到所有异步任务结束（等待 receive 的任务在信箱关闭前一直等待）
+    bool run(const Program &program, std::vector<std::string> arguments = {});
+
+    // 上一次运行留下的全局变量，不存在时返回 nullptr
+    [[nodiscard]] LoxValuePtr global(std::string_view name) const;
+
+    using Native = NativeFunction::Function;
+
+    // 注册宿主函数，此后每次 run 都把它定义为全局函数；返回 nullptr 相当于返回 nil
+    void define(std::string name, size_t arity, Native function);
+
+    // 同上，参数和返回值按 function 的签名转换，见 native.hpp
+    template<typename F>
+    void def(std::string name, F function) {
+        define(makeNative(name, std::move(function)));
+    }
+
+    // 调用上一次运行定义的全局函数，不重新解析也不重新执行顶层代码；出错时把原因输出到 err 并返回 nullptr。
+    // 异步函数运行事件循环直到它的 future 完成，返回其结果。
+    // 参数可以是其它 Context 中 let 绑定的不可变集合，多个线程同时使用同一个不可变集合无需加锁
+    LoxValuePtr call(std::string_view name, std::span<LoxValuePtr> args);
+
+    // 发给脚本的消息，脚本用 receive() 取出；可以在其它线程（如另一个 Context 的宿主函数中）发送
+    [[nodiscard]] const std::shared_ptr<Mailbox> &mailbox() const { return mailbox_; }
+
+private:
+    void define(std::shared_ptr<NativeCallable> native);
+
+    std::ostream &out_;
+    std::ostream &err_;
+    std::unique_ptr<Interpreter> interpreter_;
+    std::vector<std::pair<std::string, LoxValuePtr>> natives_;
+    std::shared_ptr<Mailbox> mailbox_;
+};
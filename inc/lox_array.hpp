@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "lox_collection.hpp"
+
+struct Environment;
+
+// 数值数组的元素类型；MASK 是比较的结果，每个元素为一个字节的 0 或 1
+enum class ArrayType : uint8_t {
+    F64, I64, F32, MASK
+};
+
+/* 数值数组
+ * import array; 之后以 array.f64(x)、array.i64(x)、array.f32(x) 创建，x 为长度（元素都为 0）或列表，
+ * array.range(n) 为 0 到 n - 1 的 i64 数组。元素连续存放、不装箱。
+ * 逐元素运算（add、sub、mul、div）、归约（sum、min、max、mean、dot）和比较（lt、le、gt、ge、eq、ne，结果为 mask）
+ * 一次计算一个向量：首次使用时检测 CPU，支持 AVX2 时使用 256 位的指令，否则使用 SSE2（其它平台上由编译器决定）。
+ * cumsum（前缀和）、gather、scatter、select 逐个元素计算。
+ * 运算的另一方可以是同类型、同长度的数组，也可以是一个数；i64 的运算溢出时回绕。
+ * */
+class LoxArray : public LoxValue {
+public:
+    static constexpr std::string_view TYPE = "array";
+
+    static constexpr std::string_view MODULE = "array";
+
+    // 定义模块的成员
+    static void define(Environment &module);
+
+    // 当前使用的指令集："avx2"、"sse2" 或 "generic"
+    static std::string_view simd();
+
+    LoxArray(ArrayType type, size_t size);
+
+    ArrayType type() const { return type_; }
+
+    // 如 array[f64]，用于错误信息
+    std::string typeName() const;
+
+    size_t size() const;
+
+    // 下标由调用者检查
+    LoxValuePtr get(size_t index) const;
+
+    // 类型不符时返回 false
+    bool set(size_t index, const LoxValuePtr &value);
+
+    template<typename T>
+    std::vector<T> &items() { return std::get<std::vector<T>>(items_); }
+
+    template<typename T>
+    const std::vector<T> &items() const { return std::get<std::vector<T>>(items_); }
+
+    // 以元素的 std::vector 调用 f
+    template<typename F>
+    decltype(auto) visit(F &&f) { return std::visit(std::forward<F>(f), items_); }
+
+    std::ostream &operator<<(std::ostream &o) override;
+
+    using Method = CollectionMethod<LoxArray>;
+
+    static const Method *findMethod(std::string_view name);
+
+    // 不直接调用时（如 var f = a.sum;）把方法绑定到数组上
+    static LoxValuePtr bind(std::shared_ptr<LoxArray> array, const Method &method);
+
+private:
+    ArrayType type_;
+    // 与 ArrayType 的顺序相同
+    std::variant<std::vector<double>, std::vector<int64_t>, std::vector<float>, std::vector<uint8_t>> items_;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "coroutine.hpp"
+#include "event_loop.hpp"
+
+/* 异步操作的结果：调用异步函数或 sleep、readFile 等异步的内建函数时立即返回，操作完成时得到值或错误。
+ * 只在事件循环的线程上使用。
+ * */
+class LoxFuture : public LoxValue {
+public:
+    static constexpr std::string_view TYPE = "future";
+
+    [[nodiscard]] bool done() const { return done_; }
+
+    void resolve(LoxValuePtr value);
+
+    void reject(std::exception_ptr error);
+
+    // 完成时执行 callback，已经完成时立即执行
+    void then(EventLoop::Callback callback);
+
+    // 取得结果，出错时重新抛出错误；之后出错的 future 不再作为未处理的错误报告
+    LoxValuePtr get();
+
+    [[nodiscard]] bool observed() const { return observed_; }
+
+    std::ostream &operator<<(std::ostream &o) override;
+
+    // 以下启动异步的内建操作，操作完成时返回的 future 随之完成
+    // seconds 秒之后得到 nil
+    static std::shared_ptr<LoxFuture> sleep(EventLoop &loop, double seconds);
+
+    // 在线程池中读取整个文件
+    static std::shared_ptr<LoxFuture> readFile(EventLoop &loop, std::string path);
+
+    // 在线程池中写入整个文件（覆盖原有内容），得到 nil
+    static std::shared_ptr<LoxFuture> writeFile(EventLoop &loop, std::string path, std::string text);
+
+    // 用 /bin/sh -c 执行 command，通过管道读取其标准输出；退出状态不为 0 时出错
+    static std::shared_ptr<LoxFuture> exec(EventLoop &loop, std::string command);
+
+private:
+    void settle();
+
+    bool done_{false};
+    bool observed_{false};
+    LoxValuePtr value_;
+    std::exception_ptr error_;
+    std::vector<EventLoop::Callback> callbacks_;
+};
+
+/* 异步函数的一次调用：函数体在自己的栈上执行（见 Coroutine），遇到 await 未完成的 future 时暂停，
+ * future 完成后由事件循环恢复。函数返回时 future 得到返回值，出错时 future 得到错误。
+ * 任务由事件循环中等待的回调持有，不需要调用者保留引用。
+ * */
+class Task : public Coroutine, public std::enable_shared_from_this<Task> {
+public:
+    // 创建任务，函数体在事件循环的下一轮开始执行；返回任务的 future
+    static std::shared_ptr<LoxFuture> start(Interpreter &interpreter, FunctionStmt *declaration,
+                                            std::shared_ptr<Environment> env, UnitPtr unit);
+
+    Task(Interpreter &interpreter, FunctionStmt *declaration, std::shared_ptr<Environment> env, UnitPtr unit);
+
+    ~Task() override;
+
+    // 由 await 表达式在任务中调用，暂停任务直到 future 完成
+    void await(const std::shared_ptr<LoxFuture> &future);
+
+private:
+    // 执行到下一个 await 或函数结束
+    void step();
+
+    Interpreter &host_;
+    std::shared_ptr<LoxFuture> future_{std::make_shared<LoxFuture>()};
+};
+
+/* 宿主发给 Context 的消息，脚本用 receive() 取出。send 和 close 可以在任何线程调用。
+ * 消息在线程之间传递而不复制，只接受不可变的值（nil、bool、数、字符串、let 绑定的集合），
+ * 其它值（包括含有可变元素的不可变集合）抛出 native_error。
+ * */
+class Mailbox : public std::enable_shared_from_this<Mailbox> {
+public:
+    void send(LoxValuePtr message);
+
+    // 关闭后等待中和之后的 receive 得到 nil（已经送达的消息仍会依次取出）
+    void close();
+
+    // 取出下一条消息；没有消息时等待，期间事件循环不会因为无事可做而返回
+    std::shared_ptr<LoxFuture> receive(EventLoop &loop);
+
+    // 事件循环销毁前调用，丢弃等待中的 receive
+    void detach();
+
+private:
+    std::mutex mutex_;
+    std::deque<LoxValuePtr> messages_;
+    std::deque<std::shared_ptr<LoxFuture>> waiting_;
+    EventLoop *loop_{nullptr};  // 等待中的 receive 所在的事件循环
+    bool closed_{false};
+};
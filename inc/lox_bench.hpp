@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+struct Environment;
+
+/* 基准测试模块
+ * import bench;
+ * bench.run(f, n) 先调用 n / 10 次 f 预热，再逐次计时调用 n 次，返回的对象含有
+ * iterations、min、median、p99、mean（纳秒）以及 allocations（平均每次调用的堆分配次数）。
+ * bench.report(name, f, n) 同上，并输出一行结果。
+ * */
+struct LoxBench {
+    static constexpr std::string_view MODULE = "bench";
+
+    // 定义模块的成员
+    static void define(Environment &module);
+
+    // 返回当前线程累计的堆分配次数。分配次数只能由宿主程序统计（例如替换 operator new），
+    // 没有设置时 allocations 为 nil
+    using AllocationCounter = uint64_t (*)();
+
+    static void setAllocationCounter(AllocationCounter counter);
+};
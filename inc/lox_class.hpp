@@ -7,7 +7,9 @@
 
 class LoxClass : public LoxCallable, public std::enable_shared_from_this<LoxClass> {
 private:
-    std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods_;
+    friend class Snapshot;
+
+    StringMap<std::shared_ptr<LoxFunction>> methods_;
 
 public:
     std::string name_;
@@ -16,7 +18,7 @@ public:
     explicit LoxClass(
             std::string name_,
             std::shared_ptr<LoxClass> super_,
-            std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods_
+            StringMap<std::shared_ptr<LoxFunction>> methods_
     ) : name_(std::move(name_)), super_{std::move(super_)}, methods_{std::move(methods_)} {};
 
     size_t arity() override {
@@ -25,9 +27,9 @@ public:
         return init->arity();
     }
 
-    LoxValuePtr call(Interpreter &interpreter, std::vector<LoxValuePtr> &args) override;
+    LoxValuePtr call(Interpreter &interpreter, std::span<LoxValuePtr> args) override;
 
-    std::shared_ptr<LoxFunction> findMethod(const std::string &name) {
+    std::shared_ptr<LoxFunction> findMethod(std::string_view name) {
         auto it = methods_.find(name);
         if (it != methods_.end()) {
             return it->second;
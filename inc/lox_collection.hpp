@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "value.hpp"
+
+// 集合（list、map）的元素类型
+enum class ElementType : uint8_t {
+    INT, FLOAT, BOOL, STR, ANY
+};
+
+// 类型名对应的元素类型，不是元素类型时返回空
+std::optional<ElementType> elementTypeOf(std::string_view name);
+
+std::string_view elementTypeName(ElementType type);
+
+// 值本身的元素类型，nil、实例等都为 ANY
+ElementType elementTypeOf(const LoxValue *value);
+
+// 字面量中的值共同的元素类型：都是 int、都是 bool、都是 str，或都是数且含有 float（此时为 float），否则为 ANY
+ElementType commonElementType(std::span<const LoxValuePtr> values);
+
+// 值能否存入元素类型为 type 的集合（int 可以存入 float 的集合）
+bool acceptsElement(ElementType type, const LoxValue *value);
+
+// 存入元素类型为 type 的集合的值：float 的集合中存放的都是 float
+LoxValuePtr storedElement(ElementType type, const LoxValuePtr &value);
+
+// 集合类型的方法，参数类型不符时抛出 native_error
+template<typename T>
+struct CollectionMethod {
+    std::string_view name;
+    size_t arity;
+    LoxValuePtr (*call)(T &self, std::span<LoxValuePtr> args);
+};
+
+template<typename T, size_t N>
+const CollectionMethod<T> *findMethod(const CollectionMethod<T> (&methods)[N], std::string_view name) {
+    for (const auto &method: methods) {
+        if (method.name == name) return &method;
+    }
+    return nullptr;
+}
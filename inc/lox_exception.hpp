@@ -9,9 +9,14 @@ struct parsing_error : public std::runtime_error {
 };
 
 struct interpreter_error : public std::runtime_error {
-    TokenPtr token_;
+    Token token_;
 
-    interpreter_error(TokenPtr token, const std::string &msg) : token_{std::move(token)}, std::runtime_error{msg} {}
+    interpreter_error(const Token &token, const std::string &msg) : token_{token}, std::runtime_error{msg} {}
+};
+
+// 宿主函数的参数类型不符等错误，调用处会补上位置转为 interpreter_error
+struct native_error : public std::runtime_error {
+    explicit native_error(const std::string &msg) : std::runtime_error{msg} {}
 };
 
 struct return_value : public std::runtime_error {
@@ -26,4 +31,9 @@ struct continue_loop : public std::runtime_error {
 
 struct break_loop : public std::runtime_error {
     explicit break_loop() : std::runtime_error{""} {}
+};
+
+// 结束暂停中的协程（生成器、异步函数的任务）时从暂停处抛出，沿协程的调用栈退出函数体
+struct coroutine_exit : public std::runtime_error {
+    explicit coroutine_exit() : std::runtime_error{""} {}
 };
\ No newline at end of file
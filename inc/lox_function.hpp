@@ -7,27 +7,46 @@
 #include "callable.hpp"
 #include "stmt.hpp"
 #include "lox_exception.hpp"
+#include "lox_async.hpp"
+#include "lox_generator.hpp"
 
 class LoxFunction : public LoxCallable {
 private:
-    FunctionStmtPtr declaration_;
+    friend class Snapshot;
+
+    FunctionStmt *declaration_;     // 语法树由编译好的程序持有，不在线程间共享引用计数
     std::shared_ptr<Environment> closure_;
+    UnitPtr unit_;  // 函数定义所在的编译单元
     bool isInitializer_;
 
 public:
-    LoxFunction(FunctionStmtPtr declaration, std::shared_ptr<Environment> closure, bool isInitializer_)
-            : declaration_{std::move(declaration)}, closure_{std::move(closure)}, isInitializer_{isInitializer_} {};
+    LoxFunction(FunctionStmt *declaration, std::shared_ptr<Environment> closure, UnitPtr unit, bool isInitializer_)
+            : declaration_{declaration}, closure_{std::move(closure)}, unit_{std::move(unit)},
+              isInitializer_{isInitializer_} {};
 
     size_t arity() override {
         return declaration_->params_->size();
     };
 
-    LoxValuePtr call(Interpreter &interpreter, std::vector<LoxValuePtr> &args) override {
+    LoxValuePtr call(Interpreter &interpreter, std::span<LoxValuePtr> args) override {
+        UnitGuard unitGuard{interpreter, unit_};
+        if (not declaration_->body_) interpreter.loadBody(declaration_);
+
         auto env = std::make_shared<Environment>(closure_);
 
         // 这里将调用时传入的具体 参数值 与 参数变量 绑定
-        for (int i = 0; i < args.size(); ++i) {
-            env->define(declaration_->params_->at(i)->lexeme, args.at(i));
+        for (size_t i = 0; i < args.size(); ++i) {
+            env->define(unit_->tokens->lexeme(declaration_->params_->at(i)), args[i]);
+        }
+
+        // 生成器函数只绑定参数，函数体在迭代返回的生成器时才执行
+        if (declaration_->generator_) return std::make_shared<LoxGenerator>(declaration_, std::move(env), unit_);
+        // 异步函数同样只绑定参数，函数体作为任务在事件循环中执行
+        if (declaration_->async_) return Task::start(interpreter, declaration_, std::move(env), unit_);
+
+        // 协程的栈比线程的小，递归过深时报错而不是越过栈底
+        if (interpreter.coroutine and interpreter.coroutine->stackLow()) {
+            throw native_error{"Stack overflow in a generator or async function (see --stack-size)."};
         }
 
         try {
@@ -44,48 +63,17 @@ public:
 
         if (isInitializer_) return closure_->getAt(0, "this");
 
-        return std::make_shared<LoxNil>();
+        return LoxNil::instance();
     };
 
     std::shared_ptr<LoxFunction> bind(const std::shared_ptr<LoxValue> &instance) {
         auto env = std::make_shared<Environment>(closure_);
         env->define("this", instance);
-        return std::make_shared<LoxFunction>(declaration_, env, isInitializer_);
+        return std::make_shared<LoxFunction>(declaration_, env, unit_, isInitializer_);
     }
 
     std::ostream &operator<<(std::ostream &o) override {
-        o << "<function " << declaration_->name_->lexeme << ">";
-        return o;
-    };
-};
-
-struct NativePrint : public LoxCallable {
-    size_t arity() override { return 1; }; // todo: 设计不定参数函数
-
-    LoxValuePtr call(Interpreter &interpreter, std::vector<LoxValuePtr> &args) override {
-        for (const auto &arg: args) {
-            std::cout << *arg << std::endl;
-        }
-        return std::make_shared<LoxNil>();
-    };
-
-    std::ostream &operator<<(std::ostream &o) override {
-        o << "<native-function print>";
-        return o;
-    };
-};
-
-struct NativeClock : public LoxCallable {
-    size_t arity() override { return 0; };
-
-    LoxValuePtr call(Interpreter &interpreter, std::vector<LoxValuePtr> &args) override {
-        auto epoch = std::chrono::system_clock::now().time_since_epoch();
-        auto ms_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(epoch);
-        return std::make_shared<LoxFloat>(((double) ms_since_epoch.count()) / 1000.0F);
-    };
-
-    std::ostream &operator<<(std::ostream &o) override {
-        o << "<native-function clock>";
+        o << "<function " << unit_->tokens->lexeme(declaration_->name_) << ">";
         return o;
     };
 };
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string_view>
+
+#include "coroutine.hpp"
+
+/* 生成器：调用含有 yield 的函数时返回，函数体在 for 循环等取下一个元素时才执行，执行到 yield 暂停，
+ * 下次取元素时从暂停处继续，直到函数返回。生成器只能迭代一次。
+ * 函数体在生成器自己的栈上执行（见 Coroutine），暂停时不复制环境链，也不使用线程。
+ * */
+class LoxGenerator : public LoxValue, public Coroutine {
+public:
+    static constexpr std::string_view TYPE = "generator";
+
+    using Coroutine::Coroutine;
+
+    // 暂停中的生成器在销毁时先结束函数体，释放其中的环境
+    ~LoxGenerator() override;
+
+    // 执行到下一个 yield 并返回产出的值，函数体结束时返回空；函数体中的错误在这里抛出
+    LoxValuePtr next(Interpreter &interpreter);
+
+    // 由 yield 语句调用，暂停函数体直到下次 next
+    void yield(LoxValuePtr value);
+
+    std::ostream &operator<<(std::ostream &o) override;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "lox_collection.hpp"
+
+/* 持久化字典：哈希数组映射前缀树（HAMT），键为 str。
+ * 每一层取键的哈希值中的 5 位，节点用 32 位的位图记录哪些位置有内容，只为有内容的位置保存键值对或子节点；
+ * 64 位哈希值全部相同的键放在冲突节点中线性查找。
+ * 插入、删除得到新的字典，只复制从根到被修改位置的一条路径（O(log32 n)），其余节点与旧版本共享；
+ * 节点创建后不再修改，同一个字典可以在多个线程中同时读取和派生新版本，无需加锁。
+ * */
+class PersistentMap {
+public:
+    size_t size() const { return size_; }
+
+    // 键不存在时返回空指针
+    LoxValuePtr get(const LoxString &key) const;
+
+    // 插入或更新
+    PersistentMap set(const std::shared_ptr<LoxString> &key, LoxValuePtr value) const;
+
+    // 键不存在时返回与本字典相同的字典
+    PersistentMap remove(const LoxString &key) const;
+
+    // 按哈希值的顺序访问每个键值对
+    template<typename F>
+    void forEach(F &&f) const {
+        if (root_) visit(*root_, f);
+    }
+
+private:
+    static constexpr size_t BITS = 5;
+
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    // 键值对，或者（key 为空时）子节点
+    struct Entry {
+        std::shared_ptr<LoxString> key;
+        LoxValuePtr value;
+        size_t hash;
+        NodePtr child;
+    };
+
+    struct Node {
+        uint32_t bitmap{0};         // 第 i 位为 1 表示哈希值在这一层为 i 的位置有内容，冲突节点不使用
+        bool collision{false};
+        std::vector<Entry> entries; // 按位置排列
+    };
+
+    NodePtr root_;
+    size_t size_{0};
+
+    static const Entry *find(const Node *node, size_t hash, std::string_view key);
+
+    static NodePtr insert(const NodePtr &node, size_t shift, Entry entry, bool &added);
+
+    static NodePtr erase(const NodePtr &node, size_t shift, size_t hash, std::string_view key, bool &removed);
+
+    // 同一位置的两个键值对下沉到新的子节点
+    static NodePtr merge(size_t shift, Entry a, Entry b);
+
+    template<typename F>
+    static void visit(const Node &node, F &f) {
+        for (const auto &entry: node.entries) {
+            if (entry.child) visit(*entry.child, f);
+            else f(entry.key, entry.value);
+        }
+    }
+};
+
+/* 不可变字典
+ * let 绑定的字典冻结为不可变字典，不能修改，put、remove 返回新的字典并与原字典共享大部分节点；
+ * 值的类型检查与 map 相同。遍历顺序为哈希值的顺序，不是插入顺序。
+ * */
+class LoxHamt : public LoxValue {
+public:
+    static constexpr std::string_view TYPE = "immutable map";
+
+    LoxHamt(ElementType type, bool declared, PersistentMap items)
+            : type_{type}, declared_{declared}, items_{std::move(items)} {}
+
+    ElementType valueType() const { return type_; }
+
+    bool declared() const { return declared_; }
+
+    // 如 immutable map[int]，用于错误信息
+    std::string typeName() const;
+
+    size_t size() const { return items_.size(); }
+
+    const PersistentMap &items() const { return items_; }
+
+    LoxValuePtr get(const LoxString &key) const { return items_.get(key); }
+
+    // 派生的新版本，值的类型不符时返回空指针
+    std::shared_ptr<LoxHamt> set(const std::shared_ptr<LoxString> &key, const LoxValuePtr &value) const;
+
+    std::shared_ptr<LoxHamt> remove(const LoxString &key) const;
+
+    std::ostream &operator<<(std::ostream &o) override;
+
+    using Method = CollectionMethod<LoxHamt>;
+
+    static const Method *findMethod(std::string_view name);
+
+    static LoxValuePtr bind(std::shared_ptr<LoxHamt> map, const Method &method);
+
+private:
+    ElementType type_;
+    bool declared_;
+    PersistentMap items_;
+};
@@ -5,27 +5,38 @@
 
 class LoxInstance : public LoxValue, public std::enable_shared_from_this<LoxInstance> {
 private:
+    friend class Snapshot;
+
     std::shared_ptr<LoxClass> class_;
-    std::unordered_map<std::string, LoxValuePtr> fields_;
+    StringMap<LoxValuePtr> fields_;
 
 public:
     explicit LoxInstance(const std::shared_ptr<LoxClass> &class_) : class_(class_) {}
 
-    LoxValuePtr get(const std::shared_ptr<Token> &name) {
-        auto it = fields_.find(name->lexeme);
+    LoxValuePtr get(const Token &name) {
+        auto it = fields_.find(name.lexeme);
         if (it != fields_.end()) {
             return it->second;
         }
 
-        auto method = class_->findMethod(name->lexeme);
+        auto method = class_->findMethod(name.lexeme);
         if (method) return method->bind(shared_from_this());
 
-        throw interpreter_error{name, "Undefined property '" + name->lexeme + "'."};
+        throw interpreter_error{name, "Undefined property '" + std::string{name.lexeme} + "'."};
     }
 
-    void set(const std::shared_ptr<Token> &name, const std::shared_ptr<LoxValue> &value) {
+    void set(const Token &name, const std::shared_ptr<LoxValue> &value) {
         // todo: 这里实现 不允许自由创建类的字段
-        fields_.insert_or_assign(name->lexeme, value);
+        set(name.lexeme, value);
+    }
+
+    void set(std::string_view name, const std::shared_ptr<LoxValue> &value) {
+        auto it = fields_.find(name);
+        if (it != fields_.end()) {
+            it->second = value;
+        } else {
+            fields_.emplace(std::string{name}, value);
+        }
     }
 
     std::ostream &operator<<(std::ostream &o) override {
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "value.hpp"
+
+struct Interpreter;
+
+// 逐个接收元素的回调，返回 false 时停止迭代；只引用调用者的函数对象，不像 std::function 那样复制或分配
+class Sink {
+public:
+    template<typename F> requires (!std::is_same_v<F, Sink>)
+    Sink(F &f) : object_{&f}, call_{[](void *object, const LoxValuePtr &value) {
+        return (bool) (*static_cast<F *>(object))(value);
+    }} {}
+
+    bool operator()(const LoxValuePtr &value) const { return call_(object_, value); }
+
+private:
+    void *object_;
+    bool (*call_)(void *object, const LoxValuePtr &value);
+};
+
+/* 依次把 iterable 的每个元素交给 sink：字符串按字节、列表、不可变列表、数组按顺序，字典按插入顺序取键，
+ * 集合取元素，范围取每个整数，迭代器取经过各个阶段后的结果，生成器取它产出的值。
+ * 列表、字典、集合迭代的是开始时的元素，循环中修改它们不影响本次迭代；生成器中途停止后再次迭代时从暂停处继续。
+ * 不能迭代时返回空，sink 要求停止时返回 false；出错时抛出 native_error
+ * */
+std::optional<bool> forEach(Interpreter &interpreter, const LoxValuePtr &iterable, Sink sink);
+
+// 能否用 forEach 迭代
+bool isIterable(const LoxValue *value);
+
+// 范围 a..b，包含两端，a > b 时递减
+class LoxRange : public LoxValue {
+public:
+    static constexpr std::string_view TYPE = "range";
+
+    LoxRange(int64_t first, int64_t last) : first_{first}, last_{last} {}
+
+    int64_t first() const { return first_; }
+
+    int64_t last() const { return last_; }
+
+    // int 和 float 都可以判断是否在范围内
+    bool contains(const LoxValue *value) const;
+
+    std::ostream &operator<<(std::ostream &o) override;
+
+private:
+    int64_t first_, last_;
+};
+
+/* 惰性迭代器
+ * iter(x) 从可迭代的值创建，lines(path) 逐行读取文件，范围和生成器可以直接调用迭代器的方法（(1..10).map(f)）。
+ * map、filter、take、skip 只记下一个阶段，返回新的迭代器，原迭代器不变；
+ * reduce、count、toList 和 for 循环才开始迭代，每个元素依次经过所有阶段后才取下一个元素，
+ * 整个流水线是一个循环，阶段之间不产生中间集合。迭代器可以多次迭代，每次都从头开始（数据源是生成器时除外）。
+ * */
+class LoxIterator : public LoxValue {
+public:
+    static constexpr std::string_view TYPE = "iterator";
+
+    enum class StageKind : uint8_t {
+        MAP, FILTER, TAKE, SKIP
+    };
+
+    struct Stage {
+        StageKind kind;
+        LoxValuePtr function;   // MAP、FILTER 的函数，已检查参数个数
+        int64_t count;          // TAKE、SKIP 的元素个数
+    };
+
+    explicit LoxIterator(LoxValuePtr source) : source_{std::move(source)} {}
+
+    // 逐行读取文件（不含换行符），每次迭代重新打开；文件不能打开时抛出 native_error
+    static std::shared_ptr<LoxIterator> lines(std::string path);
+
+    // 在末尾加上一个阶段的新迭代器
+    std::shared_ptr<LoxIterator> then(Stage stage) const;
+
+    bool forEach(Interpreter &interpreter, Sink sink) const;
+
+    std::ostream &operator<<(std::ostream &o) override;
+
+    // 迭代器的方法需要调用脚本的函数，因此带有解释器参数
+    struct Method {
+        std::string_view name;
+        size_t arity;
+        LoxValuePtr (*call)(Interpreter &interpreter, LoxIterator &self, std::span<LoxValuePtr> args);
+    };
+
+    static const Method *findMethod(std::string_view name);
+
+    // 不直接调用时（如 var f = it.map;）把方法绑定到迭代器上
+    static LoxValuePtr bind(std::shared_ptr<LoxIterator> iterator, const Method &method);
+
+private:
+    LoxValuePtr source_;
+    std::vector<Stage> stages_;
+};
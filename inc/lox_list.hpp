@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "lox_collection.hpp"
+
+/* 列表
+ * int、float、bool 的列表以 std::vector<int64_t / double / uint8_t> 连续存储，不为每个元素分配对象，
+ * 取出元素时才装箱；str 和其它类型的列表存放 LoxValuePtr。
+ * 声明了元素类型的列表（var l: list[int]）只接受该类型的值，int 可以存入 float 的列表；
+ * 由字面量推断类型的列表在存入其它类型的值时转为装箱存储（ANY），之后不再检查类型。
+ * 切片（l[a:b]）与原列表共享存储，只记录起点和长度；任何一方修改前，若存储仍被共享或只用到其中一段，
+ * 先复制出自己的部分（写时复制），因此切片和原列表互不影响。
+ * */
+class LoxList : public LoxValue {
+public:
+    static constexpr std::string_view TYPE = "list";
+
+    LoxList(ElementType type, bool declared) : type_{type}, declared_{declared}, items_{std::make_shared<Items>()} {
+        if (type == ElementType::FLOAT) items_->emplace<std::vector<double>>();
+        else if (type == ElementType::BOOL) items_->emplace<std::vector<uint8_t>>();
+        else if (type != ElementType::INT) items_->emplace<std::vector<LoxValuePtr>>();
+    }
+
+    ElementType elementType() const { return type_; }
+
+    // 声明了元素类型（var l: list[int]）
+    bool declared() const { return declared_; }
+
+    // 如 list[int]，用于错误信息
+    std::string typeName() const;
+
+    size_t size() const { return size_; }
+
+    // 下标由调用者检查
+    LoxValuePtr get(size_t index) const;
+
+    // 类型不符时返回 false
+    bool set(size_t index, const LoxValuePtr &value);
+
+    bool append(const LoxValuePtr &value);
+
+    // 移除并返回最后一个元素，列表为空时返回空指针
+    LoxValuePtr pop();
+
+    void clear();
+
+    void reserve(size_t capacity);
+
+    // 按元素的自然顺序原地排序：int 用基数排序，float 和 str 用 pdqsort（NaN 排在最后），
+    // 装箱存储的列表中的元素都是数或都是 str 时也可以排序，否则抛出 native_error
+    void sort();
+
+    // 装箱后的所有元素
+    std::vector<LoxValuePtr> values() const;
+
+    // [begin, end) 的切片，不复制元素；下标由调用者检查
+    std::shared_ptr<LoxList> slice(size_t begin, size_t end) const;
+
+    std::ostream &operator<<(std::ostream &o) override;
+
+    using Method = CollectionMethod<LoxList>;
+
+    static const Method *findMethod(std::string_view name);
+
+    // 不直接调用时（如 var f = l.append;）把方法绑定到列表上
+    static LoxValuePtr bind(std::shared_ptr<LoxList> list, const Method &method);
+
+private:
+    using Items = std::variant<std::vector<int64_t>, std::vector<double>, std::vector<uint8_t>, std::vector<LoxValuePtr>>;
+
+    // 不超过这个长度的切片直接复制，不使原列表的存储一直存活
+    static constexpr size_t COPY_LIMIT = 16;
+
+    ElementType type_;
+    bool declared_;
+    std::shared_ptr<Items> items_;  // 可能与切片或原列表共享
+    size_t offset_{0};              // 本列表的元素是 items_ 中的 [offset_, offset_ + size_)
+    size_t size_{0};
+
+    // 修改前调用：存储被共享或只用到一段时复制出自己的元素
+    void detach();
+
+    // 把 value 转为存储类型后写入 out，类型不符时返回 false
+    template<typename T>
+    bool convert(const LoxValuePtr &value, T &out) const;
+
+    // 转为装箱存储
+    void box();
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "lox_collection.hpp"
+
+/* 字典
+ * 键固定为 str，map[T] 中的 T 是值的类型；类型的检查和推断与 list 相同。
+ * 索引是开放寻址的哈希表（Swiss table）：每个槽位对应一个控制字节，空槽为 EMPTY，删除过的为 DELETED，
+ * 否则为键的哈希值的低 7 位。查找时一次比较一组 16 个控制字节（SSE2），只有控制字节相同的槽位才比较键。
+ * 槽位中存放 entries_ 的下标，entries_ 按插入顺序保存键值对，遍历即为插入顺序。
+ * 键的哈希值缓存在 LoxString 中并随键值对保存，扩容时不重新计算；更新已有的键只替换值。
+ * */
+class LoxMap : public LoxValue {
+public:
+    static constexpr std::string_view TYPE = "map";
+
+    LoxMap(ElementType type, bool declared) : type_{type}, declared_{declared} {}
+
+    ElementType valueType() const { return type_; }
+
+    bool declared() const { return declared_; }
+
+    // 如 map[int]，用于错误信息
+    std::string typeName() const;
+
+    size_t size() const { return size_; }
+
+    // 键不存在时返回空指针
+    LoxValuePtr get(const LoxString &key) const;
+
+    // 插入或更新，值的类型不符时返回 false
+    bool set(const std::shared_ptr<LoxString> &key, const LoxValuePtr &value);
+
+    bool contains(const LoxString &key) const;
+
+    // 键不存在时返回 false
+    bool remove(const LoxString &key);
+
+    void clear();
+
+    // 预留 count 个键的空间，之后的插入不再扩容
+    void reserve(size_t count);
+
+    // 按插入顺序访问每个键值对
+    template<typename F>
+    void forEach(F &&f) const {
+        for (const auto &entry: entries_) {
+            if (entry.key) f(entry.key, entry.value);
+        }
+    }
+
+    std::ostream &operator<<(std::ostream &o) override;
+
+    using Method = CollectionMethod<LoxMap>;
+
+    static const Method *findMethod(std::string_view name);
+
+    // 不直接调用时（如 var f = m.get;）把方法绑定到字典上
+    static LoxValuePtr bind(std::shared_ptr<LoxMap> map, const Method &method);
+
+private:
+    struct Entry {
+        std::shared_ptr<LoxString> key;     // 删除后为空
+        LoxValuePtr value;
+        size_t hash;
+    };
+
+    static constexpr size_t NOT_FOUND = -1;
+
+    ElementType type_;
+    bool declared_;
+    std::vector<Entry> entries_;
+    std::vector<int8_t> ctrl_;      // capacity + 16 个，末尾的 16 个与开头的相同，从任意槽位起都能读出完整的一组
+    std::vector<uint32_t> slots_;   // entries_ 的下标
+    size_t size_{0};
+    size_t growthLeft_{0};          // 负载因子达到 7/8 之前还能占用的空槽数
+
+    size_t capacity() const { return slots_.size(); }
+
+    // 键所在的槽位，不存在时返回 NOT_FOUND
+    size_t find(std::string_view key, size_t hash) const;
+
+    // 以 capacity 个槽位重建索引，同时去掉 entries_ 中已删除的键值对
+    void rehash(size_t capacity);
+
+    // 为哈希值为 hash 的新键找到空槽并写入控制字节
+    size_t claim(size_t hash);
+
+    void setCtrl(size_t slot, int8_t value);
+};
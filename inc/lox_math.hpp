@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "value.hpp"
+
+struct Interpreter;
+struct Environment;
+
+/* 数学模块
+ * import math; 或直接使用全局的 Math 访问。
+ * 形如 math.sqrt(x) 的调用在 Resolver 中记下函数编号（CallExpr::intrinsic_），
+ * 运行时只要确认 math 确实是数学模块，就直接调用对应的函数，跳过成员查找和通用的调用过程。
+ * */
+struct LoxMath {
+    static constexpr std::string_view MODULE = "math";
+
+    // 内建函数最多的参数个数
+    static constexpr size_t MAX_ARITY = 3;
+
+    // 定义模块的成员
+    static void define(Environment &module);
+
+    // 名字和参数个数对应的内建函数编号，不是内建函数时返回 0
+    static uint8_t intrinsic(std::string_view name, size_t argc);
+
+    // 调用编号为 intrinsic 的函数，参数类型不符时抛出 native_error
+    static LoxValuePtr call(uint8_t intrinsic, Interpreter &interpreter, std::span<LoxValuePtr> args);
+
+    // 整数的乘方，按平方求幂；溢出时回绕
+    static int64_t power(int64_t base, int64_t exponent);
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <utility>
+
+#include "value.hpp"
+#include "compiler.hpp"
+#include "environment.hpp"
+
+struct Interpreter;
+struct Unit;
+
+using UnitPtr = std::shared_ptr<Unit>;
+
+/* 导入的模块
+ * import 只绑定名字，首次访问成员时才编译（已编译过则直接取注册表中的结果）并执行模块的顶层代码，
+ * 模块的全局变量保存在自己的环境中。
+ * */
+class LoxModule : public LoxValue {
+private:
+    friend class Snapshot;
+
+    std::string name_;
+    std::shared_ptr<const CompiledModule> module_;
+    UnitPtr unit_;  // 模块在当前解释器中的编译单元，为空表示尚未初始化
+
+    void initialize(Interpreter &interpreter, const Token &token);
+
+public:
+    explicit LoxModule(std::string name) : name_{std::move(name)} {}
+
+    // 用 C++ 实现的模块，导入时优先于同名的脚本
+    using Native = void (*)(Environment &module);
+
+    // 不存在时返回 nullptr
+    static Native findNative(std::string_view name);
+
+    [[nodiscard]] const std::string &name() const { return name_; }
+
+    LoxValuePtr get(Interpreter &interpreter, const Token &name);
+
+    std::ostream &operator<<(std::ostream &o) override {
+        return o << "<module " << name_ << ">";
+    }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "lox_collection.hpp"
+
+// 集合的存储方式
+enum class SetMode : uint8_t {
+    SMALL,  // 元素不多于 SetElements::SMALL 个：数组，线性查找
+    DENSE,  // int 集中在一个不大的范围内：位图
+    HASH    // 其它：开放寻址的哈希表
+};
+
+/* 一种元素类型的集合，T 为 int64_t、double 或 std::shared_ptr<LoxString>。
+ * 元素多于 SMALL 个时，int 的最大值与最小值之差小于元素个数的 DENSE_FACTOR 倍就改用位图（每个元素不超过 8 字节），
+ * 之后插入的值超出这个密度时转为哈希表；哈希表不再转回。
+ * */
+template<typename T>
+class SetElements {
+public:
+    static constexpr size_t SMALL = 8;
+    static constexpr uint64_t DENSE_FACTOR = 64;
+
+    // 查找时的参数类型，str 直接以 LoxString 查找
+    using Key = std::conditional_t<std::is_same_v<T, std::shared_ptr<LoxString>>, const LoxString &, T>;
+
+    SetMode mode() const { return mode_; }
+
+    size_t size() const { return size_; }
+
+    bool contains(Key key) const;
+
+    // 已经存在时返回 false
+    bool insert(const T &value);
+
+    bool remove(Key key);
+
+    void clear();
+
+    void reserve(size_t count);
+
+    void forEach(const std::function<void(const T &)> &f) const;
+
+    // 集合运算，结果为新的集合；两个位图之间按字（64 位）运算
+    static SetElements unite(const SetElements &a, const SetElements &b);
+
+    static SetElements intersect(const SetElements &a, const SetElements &b);
+
+    static SetElements subtract(const SetElements &a, const SetElements &b);
+
+private:
+    SetMode mode_{SetMode::SMALL};
+    size_t size_{0};
+    std::array<T, SMALL> small_{};
+    std::vector<uint64_t> bits_;    // DENSE：第 i 位对应 base_ + i
+    int64_t base_{0};
+    std::vector<T> slots_;          // HASH
+    std::vector<uint8_t> ctrl_;     // HASH：每个槽位的状态
+    size_t used_{0};                // HASH：已占用（含删除过）的槽位数
+
+    size_t findSlot(Key key) const;
+
+    void toHash(size_t count);
+
+    void insertHash(const T &value);
+
+    bool setBit(int64_t value);
+};
+
+/* 集合
+ * set[int]、set[float]、set[str] 分别以 int64_t、double、LoxString 为元素，不为每个元素装箱；
+ * 字面量 {1, 2, 3} 的元素类型按 list 的规则推断，只能是 int、float（可混有 int）或 str。
+ * x in s 直接以 x 的原始值查找。
+ * let 绑定的集合冻结为不可变的副本，add、remove、clear、reserve 报错，集合运算得到可修改的新集合。
+ * */
+class LoxSet : public LoxValue {
+public:
+    static constexpr std::string_view TYPE = "set";
+
+    // 元素类型只能是 INT、FLOAT、STR
+    explicit LoxSet(ElementType type);
+
+    static bool supports(ElementType type) {
+        return type == ElementType::INT or type == ElementType::FLOAT or type == ElementType::STR;
+    }
+
+    ElementType elementType() const { return type_; }
+
+    bool frozen() const { return frozen_; }
+
+    // 如 set[int]、immutable set[int]，用于错误信息
+    std::string typeName() const;
+
+    // 不可变的副本
+    std::shared_ptr<LoxSet> freeze() const;
+
+    SetMode mode() const;
+
+    size_t size() const;
+
+    // 类型不符的值不在集合中
+    bool contains(const LoxValue *value) const;
+
+    // 类型不符时返回空，已经存在时返回 false
+    std::optional<bool> insert(const LoxValuePtr &value);
+
+    bool remove(const LoxValue *value);
+
+    void clear();
+
+    void reserve(size_t count);
+
+    // 逐个装箱后访问每个元素
+    void forEach(const std::function<void(const LoxValuePtr &)> &f) const;
+
+    // 集合运算，元素类型不同时返回空指针；int 与 float 的集合运算的结果为 float 的集合
+    static std::shared_ptr<LoxSet> unite(const LoxSet &a, const LoxSet &b);
+
+    static std::shared_ptr<LoxSet> intersect(const LoxSet &a, const LoxSet &b);
+
+    static std::shared_ptr<LoxSet> subtract(const LoxSet &a, const LoxSet &b);
+
+    std::ostream &operator<<(std::ostream &o) override;
+
+    using Method = CollectionMethod<LoxSet>;
+
+    static const Method *findMethod(std::string_view name);
+
+    // 不直接调用时（如 var f = s.has;）把方法绑定到集合上
+    static LoxValuePtr bind(std::shared_ptr<LoxSet> set, const Method &method);
+
+private:
+    ElementType type_;
+    bool frozen_{false};
+    std::variant<SetElements<int64_t>, SetElements<double>, SetElements<std::shared_ptr<LoxString>>> elements_;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+#include "lox_collection.hpp"
+
+/* 持久化向量：32 叉的前缀树，每个叶子存放 32 个元素，最后不满 32 个的元素单独放在尾部。
+ * 追加、修改、删除最后一个元素都得到新的向量：只复制从根到被修改的叶子的一条路径（O(log32 n)），
+ * 其余节点与旧版本共享；在尾部追加和删除通常只复制尾部。
+ * 节点创建后不再修改，同一个向量可以在多个线程中同时读取和派生新版本，无需加锁。
+ * */
+class PersistentVector {
+public:
+    static constexpr size_t BITS = 5, WIDTH = 1 << BITS, MASK = WIDTH - 1;
+
+    PersistentVector();
+
+    // 自底向上一次建树，O(n)
+    explicit PersistentVector(std::span<const LoxValuePtr> values);
+
+    size_t size() const { return size_; }
+
+    // 下标由调用者检查
+    const LoxValuePtr &get(size_t index) const { return leafFor(index).values[index & MASK]; }
+
+    PersistentVector push(LoxValuePtr value) const;
+
+    PersistentVector set(size_t index, LoxValuePtr value) const;
+
+    // 删除最后一个元素，向量不能为空
+    PersistentVector pop() const;
+
+    // 按顺序访问每个元素，f 返回 false 时停止并返回 false
+    template<typename F>
+    bool forEach(F &&f) const {
+        for (size_t i = 0; i < size_; i += WIDTH) {
+            const auto &leaf = leafFor(i);
+            for (size_t j = 0; j < WIDTH and i + j < size_; ++j) {
+                if (!f(leaf.values[j])) return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    // 子节点在 shift_ - BITS 层以上是 Branch，最下一层是 Leaf
+    using NodePtr = std::shared_ptr<const void>;
+
+    struct Leaf {
+        std::array<LoxValuePtr, WIDTH> values;
+    };
+
+    struct Branch {
+        std::array<NodePtr, WIDTH> children;
+    };
+
+    std::shared_ptr<const Branch> root_;
+    std::shared_ptr<const Leaf> tail_;
+    size_t size_{0};
+    size_t shift_{BITS};    // 根节点所在的层，下标右移 shift_ 位得到根节点中的位置
+
+    // 尾部第一个元素的下标
+    size_t tailOffset() const { return size_ < WIDTH ? 0 : ((size_ - 1) >> BITS) << BITS; }
+
+    const Leaf &leafFor(size_t index) const;
+
+    // 把满的尾部放入树中，返回复制后的 parent
+    std::shared_ptr<const Branch> pushTail(size_t level, const Branch *parent, const NodePtr &tail) const;
+
+    static NodePtr newPath(size_t level, NodePtr node);
+
+    static NodePtr assoc(size_t level, const NodePtr &node, size_t index, LoxValuePtr value);
+
+    // 去掉树中最后一个叶子，节点变空时返回空指针
+    std::shared_ptr<const Branch> popTail(size_t level, const Branch *node) const;
+};
+
+/* 不可变列表
+ * let 绑定的列表冻结为不可变列表，不能修改，add、set、removeLast 返回新的列表并与原列表共享大部分节点；
+ * 元素类型的检查与 list 相同，元素统一装箱存放。
+ * */
+class LoxVector : public LoxValue {
+public:
+    static constexpr std::string_view TYPE = "immutable list";
+
+    LoxVector(ElementType type, bool declared, PersistentVector items)
+            : type_{type}, declared_{declared}, items_{std::move(items)} {}
+
+    ElementType elementType() const { return type_; }
+
+    bool declared() const { return declared_; }
+
+    // 如 immutable list[int]，用于错误信息
+    std::string typeName() const;
+
+    size_t size() const { return items_.size(); }
+
+    const PersistentVector &items() const { return items_; }
+
+    // 下标由调用者检查
+    const LoxValuePtr &get(size_t index) const { return items_.get(index); }
+
+    // 派生的新版本，类型不符时返回空指针
+    std::shared_ptr<LoxVector> push(const LoxValuePtr &value) const;
+
+    std::shared_ptr<LoxVector> set(size_t index, const LoxValuePtr &value) const;
+
+    // 列表不能为空
+    std::shared_ptr<LoxVector> pop() const;
+
+    // [begin, end) 的元素组成的新列表，复制元素的指针；下标由调用者检查
+    std::shared_ptr<LoxVector> slice(size_t begin, size_t end) const;
+
+    std::ostream &operator<<(std::ostream &o) override;
+
+    using Method = CollectionMethod<LoxVector>;
+
+    static const Method *findMethod(std::string_view name);
+
+    static LoxValuePtr bind(std::shared_ptr<LoxVector> vector, const Method &method);
+
+private:
+    ElementType type_;
+    bool declared_;
+    PersistentVector items_;
+
+    // 新版本的元素类型，不接受 value 时返回空
+    std::optional<ElementType> typeFor(const LoxValuePtr &value) const;
+};
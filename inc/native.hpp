@@ -0,0 +1,254 @@
+#pragma once
+
+#include <concepts>
+#include <format>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "callable.hpp"
+#include "lox_collection.hpp"
+#include "lox_exception.hpp"
+
+/* 宿主函数
+ * 用 makeNative / Interpreter::def 直接注册普通的 C++ 函数或 lambda，例如
+ *     interpreter.def("hypot", [](double x, double y) { return std::hypot(x, y); });
+ * 参数的拆箱、类型检查和返回值的装箱在编译期按函数签名生成：
+ *     int64_t 等整数类型 ← int；double ← int 或 float；bool ← bool；
+ *     std::string_view / const std::string& ← string；LoxValuePtr 原样传入。
+ * 第一个参数可以是 Interpreter&，最后一个参数可以是 std::span<LoxValuePtr>（接收剩余的参数，即不定参数函数）。
+ * 返回 void 相当于返回 nil；小整数、bool 和 nil 取缓存的对象，调用过程不分配内存。
+ * */
+struct NativeCallable : public LoxCallable {
+    explicit NativeCallable(std::string name) : name_{std::move(name)} {}
+
+    std::string name_;
+
+    std::ostream &operator<<(std::ostream &o) override {
+        return o << "<native-function " << name_ << ">";
+    };
+};
+
+namespace native {
+    // 参数的拆箱，类型不符时抛出 native_error
+    template<typename T>
+    struct Arg;
+
+    template<std::integral T>
+    struct Arg<T> {
+        static T get(const LoxValuePtr &value, size_t index) {
+            if (auto integer = dynamic_cast<LoxInt *>(value.get())) return static_cast<T>(integer->value_);
+            throw native_error{std::format("Argument {} must be an int.", index + 1)};
+        }
+    };
+
+    template<>
+    struct Arg<bool> {
+        static bool get(const LoxValuePtr &value, size_t index) {
+            if (auto boolean = dynamic_cast<LoxBool *>(value.get())) return boolean->value_;
+            throw native_error{std::format("Argument {} must be a bool.", index + 1)};
+        }
+    };
+
+    template<std::floating_point T>
+    struct Arg<T> {
+        static T get(const LoxValuePtr &value, size_t index) {
+            if (auto floating = dynamic_cast<LoxFloat *>(value.get())) return static_cast<T>(floating->value_);
+            if (auto integer = dynamic_cast<LoxInt *>(value.get())) return static_cast<T>(integer->value_);
+            throw native_error{std::format("Argument {} must be a number.", index + 1)};
+        }
+    };
+
+    template<>
+    struct Arg<std::string_view> {
+        static std::string_view get(const LoxValuePtr &value, size_t index) {
+            if (auto string = dynamic_cast<LoxString *>(value.get())) return string->value_;
+            throw native_error{std::format("Argument {} must be a string.", index + 1)};
+        }
+    };
+
+    template<>
+    struct Arg<std::string> {
+        static std::string get(const LoxValuePtr &value, size_t index) {
+            return std::string{Arg<std::string_view>::get(value, index)};
+        }
+    };
+
+    template<>
+    struct Arg<LoxValuePtr> {
+        static const LoxValuePtr &get(const LoxValuePtr &value, size_t) { return value; }
+    };
+
+    // 返回值的装箱
+    inline LoxValuePtr box(LoxValuePtr value) { return value ? std::move(value) : LoxNil::instance(); }
+
+    inline LoxValuePtr box(bool value) { return LoxBool::of(value); }
+
+    template<std::integral T>
+    LoxValuePtr box(T value) { return LoxInt::of(static_cast<int64_t>(value)); }
+
+    template<std::floating_point T>
+    LoxValuePtr box(T value) { return std::make_shared<LoxFloat>(static_cast<double>(value)); }
+
+    inline LoxValuePtr box(std::string value) { return std::make_shared<LoxString>(std::move(value)); }
+
+    inline LoxValuePtr box(std::string_view value) { return std::make_shared<LoxString>(std::string{value}); }
+
+    inline LoxValuePtr box(const char *value) { return std::make_shared<LoxString>(value); }
+
+    template<typename T>
+    inline constexpr bool isInterpreter = std::is_same_v<T, Interpreter &>;
+
+    template<typename T>
+    inline constexpr bool isRest = std::is_same_v<std::remove_cvref_t<T>, std::span<LoxValuePtr>>;
+
+    // 由函数签名得到的参数布局
+    template<typename... A>
+    struct Layout {
+        static constexpr size_t COUNT = sizeof...(A);
+
+        static constexpr bool interpreter = [] {
+            if constexpr (COUNT == 0) return false;
+            else return isInterpreter<std::tuple_element_t<0, std::tuple<A...>>>;
+        }();
+
+        static constexpr bool variadic = [] {
+            if constexpr (COUNT == 0) return false;
+            else return isRest<std::tuple_element_t<COUNT - 1, std::tuple<A...>>>;
+        }();
+
+        // 脚本需要传入的固定参数个数
+        static constexpr size_t ARITY = COUNT - interpreter - variadic;
+    };
+
+    template<typename F>
+    struct Signature : Signature<decltype(&F::operator())> {};
+
+    template<typename R, typename... A>
+    struct Signature<R (*)(A...)> {
+        using Result = R;
+        using Layout = native::Layout<A...>;
+        using Args = std::tuple<A...>;
+    };
+
+    template<typename R, typename... A>
+    struct Signature<R (*)(A...) noexcept> : Signature<R (*)(A...)> {};
+
+    template<typename C, typename R, typename... A>
+    struct Signature<R (C::*)(A...) const> : Signature<R (*)(A...)> {};
+
+    template<typename C, typename R, typename... A>
+    struct Signature<R (C::*)(A...)> : Signature<R (*)(A...)> {};
+
+    template<typename C, typename R, typename... A>
+    struct Signature<R (C::*)(A...) const noexcept> : Signature<R (*)(A...)> {};
+
+    template<typename C, typename R, typename... A>
+    struct Signature<R (C::*)(A...) noexcept> : Signature<R (*)(A...)> {};
+}
+
+namespace native {
+    // 第 I 个形参对应的实参；每次实例化只用到 interpreter 和 args 之一
+    template<typename F, size_t I>
+    decltype(auto) param([[maybe_unused]] Interpreter &interpreter, [[maybe_unused]] std::span<LoxValuePtr> args) {
+        using Layout = typename Signature<F>::Layout;
+        using T = std::tuple_element_t<I, typename Signature<F>::Args>;
+        if constexpr (isInterpreter<T>) {
+            return (interpreter);
+        } else if constexpr (isRest<T>) {
+            return args.subspan(Layout::ARITY);
+        } else {
+            constexpr size_t index = I - Layout::interpreter;
+            return Arg<std::remove_cvref_t<T>>::get(args[index], index);
+        }
+    }
+
+    // 没有形参时不使用 interpreter 和 args
+    template<typename F, size_t... I>
+    LoxValuePtr invoke(F &function, [[maybe_unused]] Interpreter &interpreter, [[maybe_unused]] std::span<LoxValuePtr> args,
+                       std::index_sequence<I...>) {
+        if constexpr (std::is_void_v<typename Signature<F>::Result>) {
+            std::invoke(function, param<F, I>(interpreter, args)...);
+            return LoxNil::instance();
+        } else {
+            return box(std::invoke(function, param<F, I>(interpreter, args)...));
+        }
+    }
+
+    // 按 F 的签名拆箱参数、调用 function 并装箱返回值，参数个数由调用者检查
+    template<typename F>
+    LoxValuePtr invoke(F &function, Interpreter &interpreter, std::span<LoxValuePtr> args) {
+        return invoke(function, interpreter, args, std::make_index_sequence<Signature<F>::Layout::COUNT>{});
+    }
+}
+
+// 按 F 的签名生成的宿主函数，函数对象直接保存在其中，调用时没有 std::function 的间接开销
+template<typename F>
+class TypedNative : public NativeCallable {
+    using Layout = typename native::Signature<F>::Layout;
+
+public:
+    TypedNative(std::string name, F function) : NativeCallable{std::move(name)}, function_{std::move(function)} {}
+
+    size_t arity() override { return Layout::ARITY; }
+
+    bool variadic() override { return Layout::variadic; }
+
+    LoxValuePtr call(Interpreter &interpreter, std::span<LoxValuePtr> args) override {
+        return native::invoke(function_, interpreter, args);
+    }
+
+private:
+    F function_;
+};
+
+template<typename F>
+std::shared_ptr<NativeCallable> makeNative(std::string name, F function) {
+    return std::make_shared<TypedNative<std::decay_t<F>>>(std::move(name), std::move(function));
+}
+
+template<typename F>
+void Interpreter::def(std::string name, F function) {
+    auto native = makeNative(name, std::move(function));
+    global->define(name, std::move(native));
+}
+
+// 绑定到对象上的集合方法，如 var f = list.append;
+template<typename T>
+class BoundMethod : public NativeCallable {
+public:
+    BoundMethod(std::shared_ptr<T> self, const CollectionMethod<T> &method)
+            : NativeCallable{std::string{method.name}}, self_{std::move(self)}, method_{method} {}
+
+    size_t arity() override { return method_.arity; }
+
+    LoxValuePtr call(Interpreter &, std::span<LoxValuePtr> args) override {
+        return method_.call(*self_, args);
+    }
+
+private:
+    std::shared_ptr<T> self_;
+    const CollectionMethod<T> &method_;
+};
+
+// 参数个数在运行时才确定的宿主函数，供 C 接口使用
+struct NativeFunction : public NativeCallable {
+    using Function = std::function<LoxValuePtr(std::span<LoxValuePtr> args)>;
+
+    NativeFunction(std::string name, size_t arity, Function function)
+            : NativeCallable{std::move(name)}, arity_{arity}, function_{std::move(function)} {}
+
+    size_t arity() override { return arity_; };
+
+    LoxValuePtr call(Interpreter &, std::span<LoxValuePtr> args) override {
+        return native::box(function_(args));
+    };
+
+private:
+    size_t arity_;
+    Function function_;
+};
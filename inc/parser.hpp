@@ -9,47 +9,134 @@
 #include <utility>
 #include <vector>
 #include <queue>
+#include <array>
+
+// 二元运算符的优先级，数值越大结合得越紧
+enum Precedence : uint8_t {
+    PREC_NONE,
+    PREC_OR,            // or ||
+    PREC_AND,           // and &&
+    PREC_EQUALITY,      // == !=
+    PREC_COMPARISON,    // < <= > >=
+    PREC_IN_IS,         // in is not-in not-is
+    PREC_RANGE,         // ..
+    PREC_BIT_OR,        // |
+    PREC_BIT_XOR,       // ^
+    PREC_BIT_AND,       // &
+    PREC_SHIFT,         // << >> >>>
+    PREC_TERM,          // + -
+    PREC_FACTOR,        // * / %
+    PREC_UNARY,         // - ! ~（前缀）
+    PREC_POWER,         // **
+    PREC_MAX = PREC_POWER
+};
+
+enum class Associativity : uint8_t {
+    LEFT, RIGHT, NONE
+};
+
+struct BinaryRule {
+    uint8_t precedence{PREC_NONE};
+    Associativity associativity{Associativity::LEFT};
+    bool logical{false};    // 短路求值的 and / or 生成 LogicalExpr
+};
+
+// 以 TokenType 为下标的二元运算符表，非二元运算符的优先级为 PREC_NONE
+inline constexpr auto binaryRules = [] {
+    std::array<BinaryRule, (size_t) TokenType::ENDMARKER + 1> rules{};
+    auto set = [&rules](TokenType type, Precedence precedence,
+                        Associativity associativity = Associativity::LEFT, bool logical = false) {
+        rules[(size_t) type] = BinaryRule{precedence, associativity, logical};
+    };
+    set(TokenType::OR, PREC_OR, Associativity::LEFT, true);
+    set(TokenType::AND, PREC_AND, Associativity::LEFT, true);
+    set(TokenType::EQUAL_EQUAL, PREC_EQUALITY);
+    set(TokenType::NOT_EQUAL, PREC_EQUALITY);
+    set(TokenType::LESS, PREC_COMPARISON);
+    set(TokenType::LESS_EQUAL, PREC_COMPARISON);
+    set(TokenType::GREATER, PREC_COMPARISON);
+    set(TokenType::GREATER_EQUAL, PREC_COMPARISON);
+    set(TokenType::IN, PREC_IN_IS, Associativity::NONE);
+    set(TokenType::IS, PREC_IN_IS, Associativity::NONE);
+    set(TokenType::NOTIN, PREC_IN_IS, Associativity::NONE);
+    set(TokenType::NOTIS, PREC_IN_IS, Associativity::NONE);
+    set(TokenType::RANGE, PREC_RANGE, Associativity::NONE);
+    set(TokenType::BIT_OR, PREC_BIT_OR);
+    set(TokenType::BIT_XOR, PREC_BIT_XOR);
+    set(TokenType::BIT_AND, PREC_BIT_AND);
+    set(TokenType::SHIFT_L, PREC_SHIFT);
+    set(TokenType::SHIFT_R, PREC_SHIFT);
+    set(TokenType::SHIFT_RA, PREC_SHIFT);
+    set(TokenType::PLUS, PREC_TERM);
+    set(TokenType::MINUS, PREC_TERM);
+    set(TokenType::STAR, PREC_FACTOR);
+    set(TokenType::SLASH, PREC_FACTOR);
+    set(TokenType::MOD, PREC_FACTOR);
+    set(TokenType::POWER, PREC_POWER, Associativity::RIGHT);
+    return rules;
+}();
+
+// 复合赋值运算符对应的二元运算符，不是复合赋值时返回 ENDMARKER
+constexpr TokenType compoundOperator(TokenType type) {
+    switch (type) {
+        case TokenType::PLUS_EQUAL:return TokenType::PLUS;
+        case TokenType::MINUS_EQUAL:return TokenType::MINUS;
+        case TokenType::STAR_EQUAL:return TokenType::STAR;
+        case TokenType::SLASH_EQUAL:return TokenType::SLASH;
+        case TokenType::MOD_EQUAL:return TokenType::MOD;
+        default:return TokenType::ENDMARKER;
+    }
+}
 
 class Parser {
 public:
-    explicit Parser(std::vector<TokenPtr> tokens) : tokens{std::move(tokens)} {};
+    explicit Parser(TokenBuffer &tokens, bool lazy = false, std::ostream &err = std::cerr)
+            : tokens{tokens}, err{err}, lazy_{lazy} {};
 
     std::optional<std::vector<StmtPtr>> parse();
 
+    // 解析延迟解析的函数体，失败时返回 nullptr
+    std::shared_ptr<std::vector<StmtPtr>> parseBody(TokenId begin);
+
 private:
-    std::vector<TokenPtr> tokens;
-    size_t current{0};
+    TokenBuffer &tokens;
+    std::ostream &err;  // 错误信息的输出位置
+    TokenId current{0};
+    bool lazy_{false};  // 只预解析函数体
     bool parsing_failed{false};
 
-    static parsing_error error(const TokenPtr &token, const std::string &msg) {
-        if (token->type == TokenType::ENDMARKER) {
-            std::cerr << "line " << token->line << " error at end: " << msg << std::endl;
+    parsing_error error(TokenId token, const std::string &msg) {
+        if (tokens.type(token) == TokenType::ENDMARKER) {
+            err << "line " << tokens.line(token) << " error at end: " << msg << std::endl;
         } else {
-            std::cerr << "line " << token->line << " error at '" << token->lexeme << "': " << msg << std::endl;
+            err << "line " << tokens.line(token) << " error at '" << tokens.lexeme(token) << "': " << msg
+                      << std::endl;
         }
         return parsing_error{""};
     };
 
     // Helpers
-    TokenPtr peek() { return tokens[current]; };
+    TokenId peek() { return current; };
 
-    TokenPtr previous() { return tokens[current - 1]; };
+    TokenId previous() { return current - 1; };
+
+    TokenType peekType() { return tokens.type(current); };
 
     bool atEnd() {
-        return peek()->type == TokenType::ENDMARKER;
+        return peekType() == TokenType::ENDMARKER;
     };
 
-    TokenPtr advance() {
+    TokenId advance() {
         if (not atEnd()) ++current;
         return previous();
     };
 
     bool check(TokenType tokenType) {
         if (atEnd()) return false;
-        return peek()->type == tokenType;
+        return peekType() == tokenType;
     };
 
-    TokenPtr consume(TokenType tokenType, const std::string &msg) {
+    TokenId consume(TokenType tokenType, const std::string &msg) {
         if (check(tokenType)) return advance();
         throw error(peek(), msg);
     };
@@ -72,34 +159,10 @@ private:
 
     ExprPtr parseAssignment();
 
-    ExprPtr parseOr();
-
-    ExprPtr parseAnd();
-
-    ExprPtr parseEquality();
-
-    ExprPtr parseComparison();
-
-    ExprPtr parseInIsExpr(bool needLeft = true);
-
-    ExprPtr parseRangeExpr();
-
-    ExprPtr parseBitOr();
-
-    ExprPtr parseBitXor();
-
-    ExprPtr parseBitAnd();
-
-    ExprPtr parseBitShift();
-
-    ExprPtr parseTerm();
-
-    ExprPtr parseFactor();
+    ExprPtr parseBinary(int minPrecedence = PREC_OR);
 
     ExprPtr parseUnary();
 
-    ExprPtr parsePower();
-
     ExprPtr parseCall();
 
     ExprPtr parsePrimary();
@@ -120,6 +183,8 @@ private:
 
     StmtPtr parseReturnStmt();
 
+    StmtPtr parseYieldStmt();
+
     StmtPtr parseEnumStmt();
 
     std::shared_ptr<std::vector<StmtPtr>> parseBlock();
@@ -128,6 +193,8 @@ private:
 
     StmtPtr parseStatement();
 
+    TypeAnnotationPtr parseType();
+
     StmtPtr parseLetDeclaration();
 
     StmtPtr parseVarDeclaration();
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "source.hpp"
+#include "stmt.hpp"
+
+// 前端（词法、语法、语义分析）的产物
+struct CompiledProgram {
+    TokenBuffer tokens;
+    std::vector<StmtPtr> statements;
+
+    explicit CompiledProgram(std::string_view source) : tokens{source} {}
+};
+
+/* 编译缓存
+ * 把分析完成的程序（词法单元流和带有作用域深度的语法树）序列化到缓存目录，
+ * 文件名取自源码内容的哈希和编译选项，文件中保存源码的副本，加载时与当前源码逐字节比较，
+ * 源码未改变时直接加载，跳过整个前端。
+ * 缓存目录依次取 $IDUN_CACHE_DIR、$XDG_CACHE_HOME/idun、$HOME/.cache/idun。
+ * */
+class ProgramCache {
+public:
+    // 格式改变时递增，旧版本的缓存会被忽略并重新生成
+    static constexpr uint32_t VERSION = 11;
+
+    ProgramCache(const Source &source, bool lazyParse);
+
+    // 缓存不存在或失效时返回 nullptr
+    std::unique_ptr<CompiledProgram> load() const;
+
+    // 写入失败（如目录不可写）时静默忽略
+    void store(const TokenBuffer &tokens, const std::vector<StmtPtr> &statements) const;
+
+    /* 程序的二进制编码，编译缓存和堆快照共用。
+     * functions 不为空时按先序给每个函数声明编号，解码时按同样的编号还原；
+     * decode 从 data 的开头读取并前移 data，program 的词法单元流须以原来的源码构造。
+     * */
+    static void encode(std::string &out, const TokenBuffer &tokens, const std::vector<StmtPtr> &statements,
+                       std::unordered_map<const FunctionStmt *, uint32_t> *functions = nullptr);
+
+    static bool decode(std::string_view &data, CompiledProgram &program,
+                       std::vector<FunctionStmtPtr> *functions = nullptr);
+
+    // 只用于识别内容是否改变，不具备抗碰撞性
+    static uint64_t contentHash(std::string_view data);
+
+private:
+    std::string_view source_;
+    uint64_t hash_;
+    uint32_t flags_;
+    std::string path_;
+};
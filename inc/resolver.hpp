@@ -1,5 +1,6 @@
 #pragma once
 
+#include <iostream>
 #include <unordered_map>
 #include <memory>
 #include <vector>
@@ -8,8 +9,6 @@
 #include "stmt.hpp"
 #include "token.hpp"
 
-struct Interpreter;
-
 struct Resolver : public Expr::AbstractVisitor, public Stmt::AbstractVisitor {
 public:
     enum class BlockType {
@@ -24,90 +23,122 @@ public:
         NONE, CLASS, SUBCLASS
     };
 
+    // 作用域中变量的状态，LET 为已定义的 let 变量
+    enum VariableState : uint8_t {
+        DECLARED, DEFINED, LET
+    };
+
 private:
-    Interpreter &interpreter;
+    const TokenBuffer &tokens;
+    std::ostream &err;  // 错误信息的输出位置
     bool has_error_{false};
 
-    std::vector<std::unordered_map<std::string, bool>> scopes;
+    std::vector<StringMap<uint8_t>> scopes;
+    StringSet globalLets;   // 全局的 let 变量，函数体延迟分析时不可见，此时由运行时检查
     BlockType currentBlock{BlockType::NONE};
     FunctionType currentFunction{FunctionType::NONE};
     ClassType currentClass{ClassType::NONE};
+    FunctionStmt *currentDeclaration{nullptr};  // 正在分析的函数，含有 yield 时标记为生成器；await 只能出现在异步函数中
 
     void resolve(const std::shared_ptr<std::vector<StmtPtr>> &stmts);
 
     void resolve(const StmtPtr &stmt);
 
-    void resolveLocal(const ExprPtr &expr, const TokenPtr &name);
+    // 变量所在作用域相对当前作用域的深度，全局变量返回 -1
+    int resolveLocal(TokenId name);
 
-    void resolveFunction(const FunctionStmtPtr &stmt, FunctionType type);
+    void resolveFunction(FunctionStmt *stmt, FunctionType type);
 
     void beginScope();
 
     void endScope();
 
-    void declare(const TokenPtr &name);
+    void declare(TokenId name);
+
+    void define(TokenId name, VariableState state = DEFINED);
 
-    void define(const TokenPtr &name);
+    void checkType(const TypeAnnotationPtr &type, ExprPtr &initializer);
 
 public:
-    explicit Resolver(Interpreter &interpreter) : interpreter{interpreter} {};
+    explicit Resolver(const TokenBuffer &tokens, std::ostream &err = std::cerr) : tokens{tokens}, err{err} {};
 
     // Visitor methods for Expressions
-    void visitAssignExpr(AssignExprPtr expr) override;
+    void visitAssignExpr(AssignExpr *expr) override;
+
+    void visitBinaryExpr(BinaryExpr *expr) override;
+
+    void visitGroupingExpr(GroupingExpr *expr) override;
+
+    void visitLiteralExpr(LiteralExpr *expr) override;
 
-    void visitBinaryExpr(BinaryExprPtr expr) override;
+    void visitStrExpr(StrExpr *expr) override;
 
-    void visitGroupingExpr(GroupingExprPtr expr) override;
+    void visitUnaryExpr(UnaryExpr *expr) override;
 
-    void visitLiteralExpr(LiteralExprPtr expr) override;
+    void visitVariableExpr(VariableExpr *expr) override;
 
-    void visitStrExpr(StrExprPtr expr) override;
+    void visitLogicalExpr(LogicalExpr *expr) override;
 
-    void visitUnaryExpr(UnaryExprPtr expr) override;
+    void visitCallExpr(CallExpr *expr) override;
 
-    void visitVariableExpr(VariableExprPtr expr) override;
+    void visitGetExpr(GetExpr *expr) override;
 
-    void visitLogicalExpr(LogicalExprPtr expr) override;
+    void visitSetExpr(SetExpr *expr) override;
 
-    void visitCallExpr(CallExprPtr expr) override;
+    void visitThisExpr(ThisExpr *expr) override;
 
-    void visitGetExpr(GetExprPtr expr) override;
+    void visitSuperExpr(SuperExpr *expr) override;
 
-    void visitSetExpr(SetExprPtr expr) override;
+    void visitListExpr(ListExpr *expr) override;
 
-    void visitThisExpr(ThisExprPtr expr) override;
+    void visitIndexExpr(IndexExpr *expr) override;
 
-    void visitSuperExpr(SuperExprPtr expr) override;
+    void visitIndexSetExpr(IndexSetExpr *expr) override;
+
+    void visitMapExpr(MapExpr *expr) override;
+
+    void visitSetLiteralExpr(SetLiteralExpr *expr) override;
+
+    void visitSliceExpr(SliceExpr *expr) override;
+
+    void visitAwaitExpr(AwaitExpr *expr) override;
 
     // Visitor methods for Statements
-    void visitIfStmt(IfStmtPtr stmt) override;
+    void visitIfStmt(IfStmt *stmt) override;
 
-    void visitWhileStmt(WhileStmtPtr stmt) override;
+    void visitWhileStmt(WhileStmt *stmt) override;
 
-    void visitContinueStmt(ContinueStmtPtr stmt) override;
+    void visitContinueStmt(ContinueStmt *stmt) override;
 
-    void visitBreakStmt(BreakStmtPtr stmt) override;
+    void visitBreakStmt(BreakStmt *stmt) override;
 
-    void visitForStmt(ForStmtPtr stmt) override;
+    void visitForStmt(ForStmt *stmt) override;
 
-    void visitWhenStmt(WhenStmtPtr stmt) override;
+    void visitWhenStmt(WhenStmt *stmt) override;
 
-    void visitBlockStmt(BlockStmtPtr stmt) override;
+    void visitBlockStmt(BlockStmt *stmt) override;
 
-    void visitExpressionStmt(ExpressionStmtPtr stmt) override;
+    void visitExpressionStmt(ExpressionStmt *stmt) override;
 
-    void visitLetStmt(LetStmtPtr stmt) override;
+    void visitLetStmt(LetStmt *stmt) override;
 
-    void visitVarStmt(VarStmtPtr stmt) override;
+    void visitVarStmt(VarStmt *stmt) override;
 
-    void visitFunctionStmt(FunctionStmtPtr stmt) override;
+    void visitFunctionStmt(FunctionStmt *stmt) override;
 
-    void visitReturnStmt(ReturnStmtPtr stmt) override;
+    void visitReturnStmt(ReturnStmt *stmt) override;
 
-    void visitClassStmt(ClassStmtPtr stmt) override;
+    void visitYieldStmt(YieldStmt *stmt) override;
+
+    void visitClassStmt(ClassStmt *stmt) override;
+
+    void visitImportStmt(ImportStmt *stmt) override;
 
     bool resolve(const std::vector<StmtPtr> &ast);
 
+    // 分析刚解析出的延迟函数体，恢复声明函数时的作用域
+    bool resolveBody(FunctionStmt *function);
+
     void resolve(const ExprPtr &expr);
 };
 
@@ -3,25 +3,47 @@
 #include <utility>
 #include <vector>
 #include <optional>
+#include <iostream>
+#include <array>
+#include <cstdint>
 
 #include "token.hpp"
 
+// 字符分类表，以字节值为下标，取代逐个范围比较
+enum CharClass : uint8_t {
+    CHAR_DIGIT = 1 << 0,    // 0-9
+    CHAR_ALPHA = 1 << 1,    // a-z A-Z _
+    CHAR_SPACE = 1 << 2,    // 除换行外的空白字符
+};
+
+inline constexpr std::array<uint8_t, 256> charClasses = [] {
+    std::array<uint8_t, 256> table{};
+    for (int c = '0'; c <= '9'; ++c) table[c] |= CHAR_DIGIT;
+    for (int c = 'a'; c <= 'z'; ++c) table[c] |= CHAR_ALPHA;
+    for (int c = 'A'; c <= 'Z'; ++c) table[c] |= CHAR_ALPHA;
+    table['_'] |= CHAR_ALPHA;
+    for (char c: {' ', '\t', '\r', '\f', '\v'}) table[(uint8_t) c] |= CHAR_SPACE;
+    return table;
+}();
 
 class Scanner {
 private:
-    std::string program;
-    std::vector<TokenPtr> tokens;
-    int current{0}, start{0}, line{1};
+    std::string_view program;   // 源码视图，由调用者保证其生命周期
+    std::ostream &err;          // 错误信息的输出位置
+    TokenBuffer tokens;
+    size_t current{0}, start{0}, limit{0}, lineStart{0};
+    uint32_t line{1};
     bool hasError{false};
 
 public:
-    explicit Scanner(std::string program) : program{std::move(program)} {};
+    explicit Scanner(std::string_view program, std::ostream &err = std::cerr)
+            : program{program}, err{err}, tokens{program}, limit{program.length()} {};
 
-    std::optional<std::vector<TokenPtr>> getTokens();
+    std::optional<TokenBuffer> getTokens();
 
 private:
     bool atEnd() {
-        return (current >= program.length());
+        return (current >= limit);
     };
 
     char advance() {
@@ -34,7 +56,7 @@ private:
     };
 
     char peekNext() {
-        if (current + 1 >= program.length()) return '\0';
+        if (current + 1 >= limit) return '\0';
         return program[current + 1];
     };
 
@@ -47,30 +69,58 @@ private:
         return false;
     };
 
-    void addToken(TokenType tokenType, const LoxValuePtr &value = nullptr) {
-        std::string lexeme = program.substr(start, current - start);
-        tokens.emplace_back(std::make_shared<Token>(tokenType, value, lexeme, line));
+    void newLine() {
+        line++;
+        lineStart = current;
+    }
+
+    uint32_t column() const {
+        return (uint32_t) (start - lineStart + 1);
+    }
+
+    void addToken(TokenType tokenType) {
+        tokens.add(tokenType, (uint32_t) start, (uint32_t) (current - start), line, column());
+    }
+
+    void addToken(TokenType tokenType, LoxValuePtr value) {
+        tokens.addLiteral(tokenType, (uint32_t) start, (uint32_t) (current - start), line, column(), std::move(value));
     }
 
     static bool isNum(char c) {
-        return (c >= '0' and c <= '9');
+        return charClasses[(uint8_t) c] & CHAR_DIGIT;
     };
 
     static bool isAlpha(char c) {
-        return (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z') or c == '_';
+        return charClasses[(uint8_t) c] & CHAR_ALPHA;
     }
 
     static bool isAlphaNum(char c) {
-        return (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z') or c == '_' or (c >= '0' and c <= '9');
+        return charClasses[(uint8_t) c] & (CHAR_ALPHA | CHAR_DIGIT);
     }
 
+    static bool isSpace(char c) {
+        return charClasses[(uint8_t) c] & CHAR_SPACE;
+    }
+
+    void scanTokens();
+
     void parseString();
 
     void parseNumber();
 
+    void numberError() {
+        err << "Line: " << line << ", Number literal out of range [" << program.substr(start, current - start)
+                  << "]" << std::endl;
+        hasError = true;
+    }
+
     void parseIdentifier();
 
     void parseComments();
 
-    void fillStrRefers(const std::string &str);
-};
\ No newline at end of file
+    void skipSpaces();
+
+    static TokenType identifierType(std::string_view text);
+
+    void fillStrRefers(std::string_view content);
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "source.hpp"
+#include "compiler.hpp"
+
+/* 常驻进程
+ * Idun --serve SOCK 在 Unix 域套接字上等待 “运行脚本 X，参数为 Y” 的请求，
+ * 编译好的脚本和模块一直留在内存中，文件修改后才重新编译；每个请求使用全新的 Interpreter，
+ * 脚本的输出和错误按帧实时发回给客户端（Idun --connect SOCK X Y...）。
+ * 请求依次处理，同一时刻只运行一个脚本：运行时间长的脚本会使之后的请求等待。
+ * 接收请求和发送输出时套接字 10 秒没有进展就断开连接，停住的客户端不会一直占用常驻进程。
+ *
+ * 请求：u32 字符串个数，随后是各个字符串（u32 长度 + 内容），第一个为脚本的绝对路径，其余为参数；
+ *       字符串个数、单个字符串和请求的总长度有上限，超出时只回复错误
+ * 响应：若干帧，每帧为 u8 类型 + u32 长度 + 内容，以 EXIT 帧（内容为 i32 退出码）结束
+ * */
+class Server {
+public:
+    enum class Frame : uint8_t {
+        OUTPUT, ERROR, EXIT
+    };
+
+    Server(std::string path, CompileOptions options) : path_{std::move(path)}, options_{options} {}
+
+    Server(const Server &) = delete;
+
+    Server &operator=(const Server &) = delete;
+
+    ~Server();
+
+    // 一直处理请求，只在无法监听套接字时返回 false
+    bool serve();
+
+    // 客户端：把请求发给 path 上的常驻进程并转发其输出，返回脚本的退出码
+    static int connect(const std::string &path, const std::string &script, const std::vector<std::string> &args);
+
+private:
+    struct Script {
+        SourcePtr source;
+        std::unique_ptr<CompiledProgram> program;
+    };
+
+    void handle(int client);
+
+    int run(const std::vector<std::string> &request, std::ostream &out, std::ostream &err);
+
+    // 取出编译好的脚本，文件修改过则重新编译；失败时返回 nullptr
+    const CompiledProgram *program(const std::string &path, std::ostream &err);
+
+    std::string path_;
+    CompileOptions options_;
+    int listener_{-1};
+    std::unordered_map<std::string, Script> scripts_;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "source.hpp"
+#include "program_cache.hpp"
+
+struct Interpreter;
+
+/* 堆快照
+ * 执行完准备脚本（建表、定义类、读取配置等）后，把 Interpreter::global 以及从它可达的所有对象
+ * （环境、函数、类、实例、基本类型的值、列表、字典、集合及其不可变版本）连同定义这些函数的程序一起写入文件。
+ * 之后的运行直接映射快照文件恢复全局环境，不再重新执行准备脚本。
+ * */
+class Snapshot {
+public:
+    // 格式改变时递增
+    static constexpr uint32_t VERSION = 10;
+
+    // 保存 interpreter 当前的全局状态，program 为刚执行过的准备脚本；失败时输出原因并返回 false
+    static bool save(const std::string &path, const CompiledProgram &program, const Interpreter &interpreter);
+
+    // 把快照恢复到 interpreter 的全局环境中，失败时返回 nullptr。
+    // 恢复出的函数引用快照中的程序，返回值须在 interpreter 使用期间保持存活
+    static std::shared_ptr<Snapshot> load(const std::string &path, Interpreter &interpreter);
+
+private:
+    class Writer;
+
+    class Reader;
+
+    SourcePtr file_;    // 映射的快照文件，准备脚本的源码直接引用其中的内容
+    std::unique_ptr<CompiledProgram> program_;
+};
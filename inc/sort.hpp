@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/* 列表排序使用的算法
+ * radixSort：64 位整数的 LSD 基数排序，按与最小值的差每次取一个字节分桶，只处理差值用到的字节；
+ * pdqsort：pattern-defeating quicksort，不稳定，用于浮点数和字符串，已有序、逆序、大量重复的输入接近线性，
+ *          划分多次严重失衡时改用堆排序，最坏 O(n log n)；less 必须是严格弱序；
+ * mergeSort：稳定的归并排序，用于脚本提供的比较函数，尽量减少比较的次数。
+ * */
+namespace sorting {
+    namespace detail {
+        // 少于这个长度的区间用插入排序
+        constexpr ptrdiff_t INSERTION_THRESHOLD = 24;
+        // 多于这个长度的区间用九个元素的中位数作为基准
+        constexpr ptrdiff_t NINTHER_THRESHOLD = 128;
+        // 部分插入排序移动元素的上限，超过时说明区间并不接近有序
+        constexpr size_t PARTIAL_INSERTION_LIMIT = 8;
+
+        template<typename It, typename Less>
+        void insertionSort(It begin, It end, Less &less) {
+            if (begin == end) return;
+            for (It current = begin + 1; current != end; ++current) {
+                It sift = current, previous = current - 1;
+                if (!less(*sift, *previous)) continue;
+                auto value = std::move(*sift);
+                do {
+                    *sift-- = std::move(*previous);
+                } while (sift != begin and less(value, *--previous));
+                *sift = std::move(value);
+            }
+        }
+
+        // begin 之前的元素不大于区间中的任何元素，不必检查边界
+        template<typename It, typename Less>
+        void unguardedInsertionSort(It begin, It end, Less &less) {
+            if (begin == end) return;
+            for (It current = begin + 1; current != end; ++current) {
+                It sift = current, previous = current - 1;
+                if (!less(*sift, *previous)) continue;
+                auto value = std::move(*sift);
+                do {
+                    *sift-- = std::move(*previous);
+                } while (less(value, *--previous));
+                *sift = std::move(value);
+            }
+        }
+
+        // 移动的元素超过上限时放弃并返回 false，区间仍是原来元素的一个排列
+        template<typename It, typename Less>
+        bool partialInsertionSort(It begin, It end, Less &less) {
+            if (begin == end) return true;
+            size_t moved = 0;
+            for (It current = begin + 1; current != end; ++current) {
+                It sift = current, previous = current - 1;
+                if (less(*sift, *previous)) {
+                    auto value = std::move(*sift);
+                    do {
+                        *sift-- = std::move(*previous);
+                    } while (sift != begin and less(value, *--previous));
+                    *sift = std::move(value);
+                    moved += (size_t) (current - sift);
+                }
+                if (moved > PARTIAL_INSERTION_LIMIT) return false;
+            }
+            return true;
+        }
+
+        template<typename It, typename Less>
+        void sort2(It a, It b, Less &less) {
+            if (less(*b, *a)) std::iter_swap(a, b);
+        }
+
+        template<typename It, typename Less>
+        void sort3(It a, It b, It c, Less &less) {
+            sort2(a, b, less);
+            sort2(b, c, less);
+            sort2(a, b, less);
+        }
+
+        /* 以 *begin 为基准划分，与基准相等的元素放在右边。
+         * 返回基准的新位置，以及划分前是否已经分好（没有交换过元素）
+         * */
+        template<typename It, typename Less>
+        std::pair<It, bool> partitionRight(It begin, It end, Less &less) {
+            auto pivot = std::move(*begin);
+            It first = begin, last = end;
+            // 基准取自三个元素的中位数，左边一定有不小于基准的元素作为哨兵
+            while (less(*++first, pivot));
+            if (first - 1 == begin) {
+                while (first < last and !less(*--last, pivot));
+            } else {
+                while (!less(*--last, pivot));
+            }
+            bool partitioned = first >= last;
+            while (first < last) {
+                std::iter_swap(first, last);
+                while (less(*++first, pivot));
+                while (!less(*--last, pivot));
+            }
+            It position = first - 1;
+            *begin = std::move(*position);
+            *position = std::move(pivot);
+            return {position, partitioned};
+        }
+
+        // 与基准相等的元素放在左边，用于前面的基准与本区间的基准相等（大量重复元素）的情况
+        template<typename It, typename Less>
+        It partitionLeft(It begin, It end, Less &less) {
+            auto pivot = std::move(*begin);
+            It first = begin, last = end;
+            while (less(pivot, *--last));
+            if (last + 1 == end) {
+                while (first < last and !less(pivot, *++first));
+            } else {
+                while (!less(pivot, *++first));
+            }
+            while (first < last) {
+                std::iter_swap(first, last);
+                while (less(pivot, *--last));
+                while (!less(pivot, *++first));
+            }
+            *begin = std::move(*last);
+            *last = std::move(pivot);
+            return last;
+        }
+
+        // 划分严重失衡时打乱两边的几个元素，破坏导致失衡的模式
+        template<typename It>
+        void breakPatterns(It begin, It pivot, It end) {
+            auto left = pivot - begin, right = end - (pivot + 1);
+            if (left >= INSERTION_THRESHOLD) {
+                std::iter_swap(begin, begin + left / 4);
+                std::iter_swap(pivot - 1, pivot - left / 4);
+                if (left > NINTHER_THRESHOLD) {
+                    std::iter_swap(begin + 1, begin + (left / 4 + 1));
+                    std::iter_swap(begin + 2, begin + (left / 4 + 2));
+                    std::iter_swap(pivot - 2, pivot - (left / 4 + 1));
+                    std::iter_swap(pivot - 3, pivot - (left / 4 + 2));
+                }
+            }
+            if (right >= INSERTION_THRESHOLD) {
+                std::iter_swap(pivot + 1, pivot + (1 + right / 4));
+                std::iter_swap(end - 1, end - right / 4);
+                if (right > NINTHER_THRESHOLD) {
+                    std::iter_swap(pivot + 2, pivot + (2 + right / 4));
+                    std::iter_swap(pivot + 3, pivot + (3 + right / 4));
+                    std::iter_swap(end - 2, end - (1 + right / 4));
+                    std::iter_swap(end - 3, end - (2 + right / 4));
+                }
+            }
+        }
+
+        // leftmost 为 false 时 begin 之前的元素不大于区间中的任何元素
+        template<typename It, typename Less>
+        void pdqsort(It begin, It end, Less &less, int badAllowed, bool leftmost) {
+            while (true) {
+                auto size = end - begin;
+                if (size < INSERTION_THRESHOLD) {
+                    if (leftmost) insertionSort(begin, end, less);
+                    else unguardedInsertionSort(begin, end, less);
+                    return;
+                }
+
+                auto half = size / 2;
+                if (size > NINTHER_THRESHOLD) {
+                    sort3(begin, begin + half, end - 1, less);
+                    sort3(begin + 1, begin + (half - 1), end - 2, less);
+                    sort3(begin + 2, begin + (half + 1), end - 3, less);
+                    sort3(begin + (half - 1), begin + half, begin + (half + 1), less);
+                    std::iter_swap(begin, begin + half);
+                } else {
+                    sort3(begin + half, begin, end - 1, less);
+                }
+
+                // 基准与左边的元素相等：相等的元素都放到左边，不必再排序
+                if (!leftmost and !less(*(begin - 1), *begin)) {
+                    begin = partitionLeft(begin, end, less) + 1;
+                    continue;
+                }
+
+                auto [pivot, partitioned] = partitionRight(begin, end, less);
+                auto left = pivot - begin, right = end - (pivot + 1);
+                if (left < size / 8 or right < size / 8) {
+                    if (--badAllowed == 0) {
+                        std::make_heap(begin, end, less);
+                        std::sort_heap(begin, end, less);
+                        return;
+                    }
+                    breakPatterns(begin, pivot, end);
+                } else if (partitioned and partialInsertionSort(begin, pivot, less)
+                           and partialInsertionSort(pivot + 1, end, less)) {
+                    // 没有交换过元素，两边多半已经有序
+                    return;
+                }
+
+                // 递归处理左边，右边在循环中继续
+                pdqsort(begin, pivot, less, badAllowed, leftmost);
+                begin = pivot + 1;
+                leftmost = false;
+            }
+        }
+
+        // 二分查找插入位置的插入排序，比较次数为 O(n log n)；相等的元素插在后面，保持稳定
+        template<typename T, typename Less>
+        void binaryInsertionSort(T *items, size_t n, Less &less) {
+            for (size_t i = 1; i < n; ++i) {
+                if (!less(items[i], items[i - 1])) continue;
+                auto position = std::upper_bound(items, items + i - 1, items[i], less);
+                auto value = std::move(items[i]);
+                std::move_backward(position, items + i, items + i + 1);
+                *position = std::move(value);
+            }
+        }
+
+        template<typename T, typename Less>
+        void mergeSort(T *items, T *buffer, size_t n, Less &less) {
+            if (n <= 16) return binaryInsertionSort(items, n, less);
+            size_t half = n / 2;
+            mergeSort(items, buffer, half, less);
+            mergeSort(items + half, buffer, n - half, less);
+            // 两半已经首尾相接
+            if (!less(items[half], items[half - 1])) return;
+
+            // 左半移到缓冲区，再与右半合并回原位；右半剩下的元素已经在最终位置上
+            std::move(items, items + half, buffer);
+            T *left = buffer, *leftEnd = buffer + half, *right = items + half, *rightEnd = items + n, *out = items;
+            while (left < leftEnd and right < rightEnd) {
+                *out++ = less(*right, *left) ? std::move(*right++) : std::move(*left++);
+            }
+            std::move(left, leftEnd, out);
+        }
+    }
+
+    template<typename It, typename Less>
+    void pdqsort(It begin, It end, Less less) {
+        if (end - begin < 2) return;
+        detail::pdqsort(begin, end, less, std::bit_width((size_t) (end - begin)), true);
+    }
+
+    // 比较函数抛出异常时，已经移入缓冲区的元素会丢失，调用者应对副本排序
+    template<typename T, typename Less>
+    void mergeSort(std::vector<T> &items, Less less) {
+        if (items.size() < 2) return;
+        std::vector<T> buffer(items.size() / 2);
+        detail::mergeSort(items.data(), buffer.data(), items.size(), less);
+    }
+
+    // 少于这个长度时基数排序的计数开销不划算
+    constexpr size_t RADIX_THRESHOLD = 256;
+
+    inline void radixSort(std::vector<int64_t> &items) {
+        if (items.size() < RADIX_THRESHOLD) return pdqsort(items.begin(), items.end(), std::less<>{});
+
+        // 一次遍历得到最小、最大值，顺带检查是否已经有序或逆序
+        int64_t low = items[0], high = items[0];
+        bool ascending = true, descending = true;
+        for (size_t i = 1; i < items.size(); ++i) {
+            low = std::min(low, items[i]);
+            high = std::max(high, items[i]);
+            ascending = ascending and items[i - 1] <= items[i];
+            descending = descending and items[i - 1] >= items[i];
+        }
+        if (ascending) return;
+        if (descending) return std::reverse(items.begin(), items.end());
+
+        // 按与最小值的差排序，只需处理差值实际用到的字节，正负混合的小整数也只要一两轮
+        auto key = [low](int64_t value) { return (uint64_t) value - (uint64_t) low; };
+        size_t bytes = ((size_t) std::bit_width(key(high)) + 7) / 8;
+
+        std::vector<size_t> counts(bytes * 256);
+        for (auto value: items) {
+            auto k = key(value);
+            for (size_t byte = 0; byte < bytes; ++byte) ++counts[byte * 256 + ((k >> (byte * 8)) & 0xff)];
+        }
+
+        std::vector<int64_t> buffer(items.size());
+        int64_t *from = items.data(), *to = buffer.data();
+        for (size_t byte = 0; byte < bytes; ++byte) {
+            auto count = counts.data() + byte * 256;
+            auto shift = byte * 8;
+            // 所有元素的这个字节都相同时顺序不变
+            if (count[(key(from[0]) >> shift) & 0xff] == items.size()) continue;
+            size_t offsets[256], offset = 0;
+            for (size_t bucket = 0; bucket < 256; ++bucket) {
+                offsets[bucket] = offset;
+                offset += count[bucket];
+            }
+            for (size_t i = 0; i < items.size(); ++i) to[offsets[(key(from[i]) >> shift) & 0xff]++] = from[i];
+            std::swap(from, to);
+        }
+        if (from != items.data()) std::memcpy(items.data(), from, items.size() * sizeof(int64_t));
+    }
+}
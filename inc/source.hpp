@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/* 脚本源码
+ * 文件通过 mmap 映射（映射失败时一次性读入），在整个运行期间保持存活，
+ * 词法单元的 lexeme 以 string_view 的形式直接引用其中的内容，不再复制。
+ * */
+class Source {
+public:
+    Source(const Source &) = delete;
+
+    Source &operator=(const Source &) = delete;
+
+    ~Source();
+
+    // 打开失败时返回 nullptr
+    static std::shared_ptr<Source> fromFile(const std::string &path);
+
+    static std::shared_ptr<Source> fromString(std::string text, std::string name = "<string>");
+
+    [[nodiscard]] std::string_view text() const { return {data_, size_}; }
+
+    [[nodiscard]] const std::string &name() const { return name_; }
+
+    // 打开时文件的修改时间（纳秒），不是来自文件时为 0
+    [[nodiscard]] int64_t modified() const { return modified_; }
+
+    // 文件当前的修改时间，文件不存在时返回 -1
+    static int64_t modifiedTime(const std::string &path);
+
+private:
+    Source() = default;
+
+    std::string name_;
+    const char *data_{nullptr};
+    size_t size_{0};
+    int64_t modified_{0};
+    void *mapping_{nullptr};    // mmap 的起始地址，为空表示内容保存在 buffer_ 中
+    std::string buffer_;
+};
+
+using SourcePtr = std::shared_ptr<Source>;
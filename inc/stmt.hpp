@@ -17,35 +17,41 @@ struct LetStmt;
 struct VarStmt;
 struct FunctionStmt;
 struct ReturnStmt;
+struct YieldStmt;
 struct ClassStmt;
+struct ImportStmt;
 
 struct Stmt {
     struct AbstractVisitor {
-        virtual void visitIfStmt(std::shared_ptr<IfStmt> stmt) = 0;
+        virtual void visitIfStmt(IfStmt *stmt) = 0;
 
-        virtual void visitForStmt(std::shared_ptr<ForStmt> stmt) = 0;
+        virtual void visitForStmt(ForStmt *stmt) = 0;
 
-        virtual void visitWhileStmt(std::shared_ptr<WhileStmt> stmt) = 0;
+        virtual void visitWhileStmt(WhileStmt *stmt) = 0;
 
-        virtual void visitContinueStmt(std::shared_ptr<ContinueStmt> stmt) = 0;
+        virtual void visitContinueStmt(ContinueStmt *stmt) = 0;
 
-        virtual void visitBreakStmt(std::shared_ptr<BreakStmt> stmt) = 0;
+        virtual void visitBreakStmt(BreakStmt *stmt) = 0;
 
-        virtual void visitWhenStmt(std::shared_ptr<WhenStmt> stmt) = 0;
+        virtual void visitWhenStmt(WhenStmt *stmt) = 0;
 
-        virtual void visitBlockStmt(std::shared_ptr<BlockStmt> stmt) = 0;
+        virtual void visitBlockStmt(BlockStmt *stmt) = 0;
 
-        virtual void visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) = 0;
+        virtual void visitExpressionStmt(ExpressionStmt *stmt) = 0;
 
-        virtual void visitLetStmt(std::shared_ptr<LetStmt> stmt) = 0;
+        virtual void visitLetStmt(LetStmt *stmt) = 0;
 
-        virtual void visitVarStmt(std::shared_ptr<VarStmt> stmt) = 0;
+        virtual void visitVarStmt(VarStmt *stmt) = 0;
 
-        virtual void visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) = 0;
+        virtual void visitFunctionStmt(FunctionStmt *stmt) = 0;
 
-        virtual void visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) = 0;
+        virtual void visitReturnStmt(ReturnStmt *stmt) = 0;
 
-        virtual void visitClassStmt(std::shared_ptr<ClassStmt> stmt) = 0;
+        virtual void visitYieldStmt(YieldStmt *stmt) = 0;
+
+        virtual void visitClassStmt(ClassStmt *stmt) = 0;
+
+        virtual void visitImportStmt(ImportStmt *stmt) = 0;
     };
 
     virtual void accept(AbstractVisitor &visitor) = 0;
@@ -64,7 +70,7 @@ struct IfStmt : public Stmt, public std::enable_shared_from_this<IfStmt> {
             : condition_{std::move(condition)}, thenStmt_{std::move(thenStmt)}, elseStmt_{std::move(elseStmt)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitIfStmt(shared_from_this());
+        visitor.visitIfStmt(this);
     }
 };
 
@@ -78,46 +84,46 @@ struct WhileStmt : public Stmt, public std::enable_shared_from_this<WhileStmt> {
             condition_{std::move(condition)}, statements_{std::move(statements)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitWhileStmt(shared_from_this());
+        visitor.visitWhileStmt(this);
     }
 };
 
 using WhileStmtPtr = std::shared_ptr<WhileStmt>;
 
 struct ContinueStmt : public Stmt, public std::enable_shared_from_this<ContinueStmt> {
-    TokenPtr keyword_;
+    TokenId keyword_;
 
-    explicit ContinueStmt(TokenPtr keyword_) : keyword_{std::move(keyword_)} {}
+    explicit ContinueStmt(TokenId keyword_) : keyword_{keyword_} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitContinueStmt(shared_from_this());
+        visitor.visitContinueStmt(this);
     }
 };
 
 using ContinueStmtPtr = std::shared_ptr<ContinueStmt>;
 
 struct BreakStmt : public Stmt, public std::enable_shared_from_this<BreakStmt> {
-    TokenPtr keyword_;
+    TokenId keyword_;
 
-    explicit BreakStmt(TokenPtr keyword_) : keyword_{std::move(keyword_)} {}
+    explicit BreakStmt(TokenId keyword_) : keyword_{keyword_} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitBreakStmt(shared_from_this());
+        visitor.visitBreakStmt(this);
     }
 };
 
 using BreakStmtPtr = std::shared_ptr<BreakStmt>;
 
 struct ForStmt : public Stmt, public std::enable_shared_from_this<ForStmt> {
-    TokenPtr variable_;
+    TokenId variable_;
     ExprPtr iterable_;
     StmtPtr body_;
 
-    ForStmt(TokenPtr variable_, ExprPtr iterable_, StmtPtr body_)
-            : variable_{std::move(variable_)}, iterable_{std::move(iterable_)}, body_{std::move(body_)} {}
+    ForStmt(TokenId variable_, ExprPtr iterable_, StmtPtr body_)
+            : variable_{variable_}, iterable_{std::move(iterable_)}, body_{std::move(body_)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitForStmt(shared_from_this());
+        visitor.visitForStmt(this);
     }
 };
 
@@ -132,7 +138,7 @@ struct WhenStmt : public Stmt, public std::enable_shared_from_this<WhenStmt> {
     WhenStmt(BranchStmtPtr branches, StmtPtr else_) : branches{std::move(branches)}, else_{std::move(else_)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitWhenStmt(shared_from_this());
+        visitor.visitWhenStmt(this);
     }
 };
 
@@ -144,7 +150,7 @@ struct BlockStmt : public Stmt, public std::enable_shared_from_this<BlockStmt> {
     explicit BlockStmt(std::shared_ptr<std::vector<StmtPtr>> statements) : statements_{std::move(statements)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitBlockStmt(shared_from_this());
+        visitor.visitBlockStmt(this);
     }
 };
 
@@ -156,82 +162,123 @@ struct ExpressionStmt : public Stmt, public std::enable_shared_from_this<Express
     explicit ExpressionStmt(ExprPtr expression) : expression_{std::move(expression)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitExpressionStmt(shared_from_this());
+        visitor.visitExpressionStmt(this);
     }
 };
 
 using ExpressionStmtPtr = std::shared_ptr<ExpressionStmt>;
 
 struct LetStmt : public Stmt, public std::enable_shared_from_this<LetStmt> {
-    TokenPtr name_;
+    TokenId name_;
     ExprPtr initializer_;
+    TypeAnnotationPtr type_;    // 可省略
 
-    LetStmt(TokenPtr name, ExprPtr initializer)
-            : name_{std::move(name)}, initializer_{std::move(initializer)} {}
+    LetStmt(TokenId name, ExprPtr initializer)
+            : name_{name}, initializer_{std::move(initializer)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitLetStmt(shared_from_this());
+        visitor.visitLetStmt(this);
     }
 };
 
 using LetStmtPtr = std::shared_ptr<LetStmt>;
 
 struct VarStmt : public Stmt, public std::enable_shared_from_this<VarStmt> {
-    TokenPtr name_;
+    TokenId name_;
     ExprPtr initializer_;
+    TypeAnnotationPtr type_;    // 可省略，未初始化的集合按标注的类型创建为空集合
 
-    VarStmt(TokenPtr name, ExprPtr initializer)
-            : name_{std::move(name)}, initializer_{std::move(initializer)} {}
+    VarStmt(TokenId name, ExprPtr initializer)
+            : name_{name}, initializer_{std::move(initializer)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitVarStmt(shared_from_this());
+        visitor.visitVarStmt(this);
     }
 };
 
 using VarStmtPtr = std::shared_ptr<VarStmt>;
 
-struct FunctionStmt : public Stmt, public std::enable_shared_from_this<FunctionStmt> {
-    TokenPtr name_;
-    std::shared_ptr<std::vector<TokenPtr>> params_;
-    std::shared_ptr<std::vector<StmtPtr>> body_;
+/* 延迟解析的函数体
+ * 预解析时只做括号匹配并记录函数体的起始位置，语义分析时保存当时的作用域，
+ * 函数第一次被调用时才完整解析和分析函数体。
+ * */
+struct LazyBody {
+    TokenBuffer *tokens;                    // 函数所在的词法单元流，解析时可能追加合成的词法单元
+    TokenId begin;                          // '{' 之后的第一个词法单元
+    std::vector<StringMap<uint8_t>> scopes; // 声明函数时 Resolver 的作用域
+    uint8_t functionType{0}, classType{0}, blockType{0};    // 对应 Resolver 中的枚举
+};
 
-    FunctionStmt(TokenPtr name, std::shared_ptr<std::vector<TokenPtr>> params,
+struct FunctionStmt : public Stmt, public std::enable_shared_from_this<FunctionStmt> {
+    TokenId name_;
+    std::shared_ptr<std::vector<TokenId>> params_;
+    std::shared_ptr<std::vector<StmtPtr>> body_;    // 延迟解析的函数在首次调用前为空
+    std::shared_ptr<LazyBody> lazy_;
+    bool generator_{false};     // 函数体含有 yield，由 Resolver 分析函数体时标记
+    bool async_{false};         // async fun，调用时返回 future，函数体作为任务在事件循环中执行
+
+    FunctionStmt(TokenId name, std::shared_ptr<std::vector<TokenId>> params,
                  std::shared_ptr<std::vector<StmtPtr>> body)
-            : name_{std::move(name)}, params_{std::move(params)}, body_{std::move(body)} {}
+            : name_{name}, params_{std::move(params)}, body_{std::move(body)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitFunctionStmt(shared_from_this());
+        visitor.visitFunctionStmt(this);
     }
 };
 
 using FunctionStmtPtr = std::shared_ptr<FunctionStmt>;
 
 struct ReturnStmt : public Stmt, public std::enable_shared_from_this<ReturnStmt> {
-    TokenPtr keyword_;
+    TokenId keyword_;
     ExprPtr value_;
 
-    ReturnStmt(TokenPtr keyword, ExprPtr value)
-            : keyword_{std::move(keyword)}, value_{std::move(value)} {}
+    ReturnStmt(TokenId keyword, ExprPtr value)
+            : keyword_{keyword}, value_{std::move(value)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitReturnStmt(shared_from_this());
+        visitor.visitReturnStmt(this);
     }
 };
 
 using ReturnStmtPtr = std::shared_ptr<ReturnStmt>;
 
+struct YieldStmt : public Stmt, public std::enable_shared_from_this<YieldStmt> {
+    TokenId keyword_;
+    ExprPtr value_;     // yield; 时为空，产出 nil
+
+    YieldStmt(TokenId keyword, ExprPtr value)
+            : keyword_{keyword}, value_{std::move(value)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitYieldStmt(this);
+    }
+};
+
+using YieldStmtPtr = std::shared_ptr<YieldStmt>;
+
 struct ClassStmt : public Stmt, public std::enable_shared_from_this<ClassStmt> {
-    TokenPtr name_;
+    TokenId name_;
     VariableExprPtr superClass_;
     std::shared_ptr<std::vector<FunctionStmtPtr>> methods_;
 
-    ClassStmt(TokenPtr name, VariableExprPtr superClass_, std::shared_ptr<std::vector<FunctionStmtPtr>> methods)
-            : name_{std::move(name)}, superClass_{std::move(superClass_)}, methods_{std::move(methods)} {}
+    ClassStmt(TokenId name, VariableExprPtr superClass_, std::shared_ptr<std::vector<FunctionStmtPtr>> methods)
+            : name_{name}, superClass_{std::move(superClass_)}, methods_{std::move(methods)} {}
 
     void accept(AbstractVisitor &visitor) override {
-        visitor.visitClassStmt(shared_from_this());
+        visitor.visitClassStmt(this);
     }
 };
 
 using ClassStmtPtr = std::shared_ptr<ClassStmt>;
 
+struct ImportStmt : public Stmt, public std::enable_shared_from_this<ImportStmt> {
+    std::shared_ptr<std::vector<TokenId>> path_;   // import a.b.c; 中的 a、b、c，模块绑定到最后一个名字
+
+    explicit ImportStmt(std::shared_ptr<std::vector<TokenId>> path) : path_{std::move(path)} {}
+
+    void accept(AbstractVisitor &visitor) override {
+        visitor.visitImportStmt(this);
+    }
+};
+
+using ImportStmtPtr = std::shared_ptr<ImportStmt>;
@@ -1,10 +1,16 @@
 #pragma once
 
 #include <memory>
-#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <ostream>
 #include "value.hpp"
 
-enum class TokenType {
+enum class TokenType : uint8_t {
     LEFT_PAREN, RIGHT_PAREN, LEFT_SQUARE, RIGHT_SQUARE, LEFT_BRACE, RIGHT_BRACE,    // ( ) [ ] { }
     PLUS, MINUS, STAR, SLASH, MOD, POWER,                                           // + - * / % ** ${
     COMMA, DOT, COLON, SEMICOLON, NEWLINE, RANGE, ARROW,                            // , . : ; '\n' .. ->
@@ -15,8 +21,8 @@ enum class TokenType {
 
     STR_START, STR_END,                                                             // 字符串的开始、结束
 
-    BREAK, CLASS, CONTINUE, ELSE, ELIF, ENUM, FALSE, FUN, FOR, IF, IMPORT,
-    IN, IS, LET, NIL, NOTIN, NOTIS, RETURN, SUPER, THIS, TRUE, VAR, WHEN, WHILE,
+    ASYNC, AWAIT, BREAK, CLASS, CONTINUE, ELSE, ELIF, ENUM, FALSE, FUN, FOR, IF, IMPORT,
+    IN, IS, LET, NIL, NOTIN, NOTIS, RETURN, SUPER, THIS, TRUE, VAR, WHEN, WHILE, YIELD,
 
     IDENTIFIER, INTEGER, FLOATING, STRING, ENDMARKER
 };
@@ -66,6 +72,8 @@ static const char *getTokenTypeStr(TokenType tokenType) {
         case TokenType::SHIFT_RA:return "SHIFT_RA";
         case TokenType::STR_START:return "STR_START";
         case TokenType::STR_END:return "STR_END";
+        case TokenType::ASYNC:return "ASYNC";
+        case TokenType::AWAIT:return "AWAIT";
         case TokenType::BREAK:return "BREAK";
         case TokenType::CLASS:return "CLASS";
         case TokenType::CONTINUE:return "CONTINUE";
@@ -88,6 +96,7 @@ static const char *getTokenTypeStr(TokenType tokenType) {
         case TokenType::VAR:return "VAR";
         case TokenType::WHEN:return "WHEN";
         case TokenType::WHILE:return "WHILE";
+        case TokenType::YIELD:return "YIELD";
         case TokenType::IDENTIFIER:return "IDENTIFIER";
         case TokenType::INTEGER:return "INTEGER";
         case TokenType::FLOATING:return "FLOATING";
@@ -97,60 +106,162 @@ static const char *getTokenTypeStr(TokenType tokenType) {
     }
 }
 
-static const std::unordered_map<std::string, TokenType> keywords = {
-        {"and",      TokenType::AND},
-        {"or",       TokenType::OR},
-        {"not",      TokenType::NOT},
-        {"break",    TokenType::BREAK},
-        {"break",    TokenType::BREAK},
-        {"break",    TokenType::BREAK},
-        {"class",    TokenType::CLASS},
-        {"continue", TokenType::CONTINUE},
-        {"else",     TokenType::ELSE},
-        {"elif",     TokenType::ELIF},
-        {"enum",     TokenType::ENUM},
-        {"false",    TokenType::FALSE},
-        {"fun",      TokenType::FUN},
-        {"for",      TokenType::FOR},
-        {"if",       TokenType::IF},
-        {"import",   TokenType::IMPORT},
-        {"in",       TokenType::IN},
-        {"is",       TokenType::IS},
-        {"let",      TokenType::LET},
-        {"nil",      TokenType::NIL},
-        {"return",   TokenType::RETURN},
-        {"super",    TokenType::SUPER},
-        {"this",     TokenType::THIS},
-        {"true",     TokenType::TRUE},
-        {"var",      TokenType::VAR},
-        {"when",     TokenType::WHEN},
-        {"while",    TokenType::WHILE}
-};
+using TokenId = uint32_t;     // 词法单元在 TokenBuffer 中的下标
 
+// 词法单元的只读视图，由 TokenBuffer 按需组装，不单独分配内存
 struct Token {
-    std::string lexeme;
-    LoxValuePtr value;
+    std::string_view lexeme;
     TokenType type;
-    int line;
-
-    Token(TokenType tokenType, LoxValuePtr value, std::string lexeme, int line)
-            : type{tokenType}, value{std::move(value)}, lexeme{std::move(lexeme)}, line{line} {}
+    uint32_t line;
+    uint32_t column;
 
-    friend std::ostream &operator<<(std::ostream &out, Token &token) {
-        out << '(' << token.line << ") " << '[' << getTokenTypeStr(token.type);
+    friend std::ostream &operator<<(std::ostream &out, const Token &token) {
+        out << '(' << token.line << ':' << token.column << ") " << '[' << getTokenTypeStr(token.type);
 
         if (token.type != TokenType::ENDMARKER) {
             out << " -> " << token.lexeme;
         }
 
-        out << ']';
+        return out << ']';
+    }
+};
+
+/* 紧凑的词法单元流（结构数组）
+ * 类型、行列号、lexeme 在源码中的位置分别存放在并列的数组中，以 32 位的 TokenId 索引；
+ * 字面量的值按 TokenId 顺序存放在单独的表中。语法树只保存 TokenId。
+ * */
+class TokenBuffer {
+public:
+    explicit TokenBuffer(std::string_view source) : source_{source} {}
+
+    void reserve(size_t count) {
+        if (count > capacity_) grow(count);
+    }
+
+    TokenId add(TokenType type, uint32_t offset, uint32_t length, uint32_t line, uint32_t column) {
+        if (size_ == capacity_) grow(capacity_ * 2);
+        types_[size_] = type;
+        lines_[size_] = line;
+        columns_[size_] = column;
+        offsets_[size_] = offset;
+        lengths_[size_] = length;
+        return size_++;
+    }
+
+    TokenId addLiteral(TokenType type, uint32_t offset, uint32_t length, uint32_t line, uint32_t column,
+                       LoxValuePtr value) {
+        auto id = add(type, offset, length, line, column);
+        literals_.emplace_back(id, std::move(value));
+        return id;
+    }
+
+    // 为已加入的词法单元补上字面量（加载编译缓存时使用），须按 TokenId 递增的顺序调用
+    void setLiteral(TokenId id, LoxValuePtr value) {
+        literals_.emplace_back(id, std::move(value));
+    }
+
+    // 语法分析时由已有的词法单元派生出新的运算符（如 `a += 1` 中的 `+`），位置沿用原词法单元
+    TokenId synthesize(TokenType type, TokenId origin) {
+        return add(type, SYNTHETIC, 0, lines_[origin], columns_[origin]);
+    }
+
+    [[nodiscard]] size_t size() const { return size_; }
+
+    [[nodiscard]] TokenType type(TokenId id) const { return types_[id]; }
+
+    [[nodiscard]] uint32_t line(TokenId id) const { return lines_[id]; }
+
+    [[nodiscard]] uint32_t column(TokenId id) const { return columns_[id]; }
 
-        if (token.type == TokenType::STRING || token.type == TokenType::INTEGER || token.type == TokenType::FLOATING) {
-            out << " (value=" << *(token.value) << ')';
+    [[nodiscard]] std::string_view lexeme(TokenId id) const {
+        if (offsets_[id] == SYNTHETIC) return spelling(types_[id]);
+        return source_.substr(offsets_[id], lengths_[id]);
+    }
+
+    // 字面量按 TokenId 递增的顺序加入，二分查找即可
+    [[nodiscard]] const LoxValuePtr &literal(TokenId id) const {
+        static const LoxValuePtr none;
+        auto it = std::lower_bound(literals_.begin(), literals_.end(), id,
+                                   [](const auto &entry, TokenId key) { return entry.first < key; });
+        if (it == literals_.end() or it->first != id) return none;
+        return it->second;
+    }
+
+    [[nodiscard]] Token operator[](TokenId id) const {
+        return Token{lexeme(id), types_[id], lines_[id], columns_[id]};
+    }
+
+    [[nodiscard]] std::string_view source() const { return source_; }
+
+    [[nodiscard]] const std::vector<std::pair<TokenId, LoxValuePtr>> &literals() const { return literals_; }
+
+    // 为字面量表达式分配编号，解释器按编号保存各自的字面量副本
+    uint32_t newLiteralSlot() { return literalSlots_++; }
+
+    // 编译缓存按列原样保存词法单元（字面量另行保存）
+    void saveColumns(std::string &out) const {
+        auto save = [this, &out](const auto &column) {
+            out.append(reinterpret_cast<const char *>(column.get()), size_ * sizeof(column[0]));
+        };
+        save(types_), save(lines_), save(columns_), save(offsets_), save(lengths_);
+    }
+
+    // 从 data 的开头读入 count 个词法单元并前移 data，数据不足时返回 false
+    bool restoreColumns(std::string_view &data, size_t count) {
+        if (data.size() / (sizeof(TokenType) + 4 * sizeof(uint32_t)) < count) return false;
+        reserve(size_ + count);
+        auto restore = [this, &data, count](auto &column) {
+            auto bytes = count * sizeof(column[0]);
+            std::memcpy(column.get() + size_, data.data(), bytes);
+            data.remove_prefix(bytes);
+        };
+        restore(types_), restore(lines_), restore(columns_), restore(offsets_), restore(lengths_);
+        size_ += count;
+        return true;
+    }
+
+private:
+    static constexpr uint32_t SYNTHETIC = UINT32_MAX;
+
+    static std::string_view spelling(TokenType type) {
+        switch (type) {
+            case TokenType::PLUS:return "+";
+            case TokenType::MINUS:return "-";
+            case TokenType::STAR:return "*";
+            case TokenType::SLASH:return "/";
+            case TokenType::MOD:return "%";
+            case TokenType::EQUAL_EQUAL:return "==";
+            case TokenType::NOTIN:return "not in";
+            case TokenType::NOTIS:return "not is";
+            default:return getTokenTypeStr(type);
         }
+    }
 
-        return out;
+    // 各列同步扩容，追加时只需检查一次容量
+    template<typename T>
+    void growColumn(std::unique_ptr<T[]> &column, size_t capacity) {
+        auto grown = std::make_unique_for_overwrite<T[]>(capacity);
+        if (size_) std::memcpy(grown.get(), column.get(), size_ * sizeof(T));
+        column = std::move(grown);
+    }
+
+    void grow(size_t capacity) {
+        capacity = std::max<size_t>(capacity, 64);
+        growColumn(types_, capacity);
+        growColumn(lines_, capacity);
+        growColumn(columns_, capacity);
+        growColumn(offsets_, capacity);
+        growColumn(lengths_, capacity);
+        capacity_ = capacity;
     }
-};
 
-using TokenPtr = std::shared_ptr<Token>;
+    std::string_view source_;
+    size_t size_{0}, capacity_{0};
+    std::unique_ptr<TokenType[]> types_;
+    std::unique_ptr<uint32_t[]> lines_;
+    std::unique_ptr<uint32_t[]> columns_;
+    std::unique_ptr<uint32_t[]> offsets_;
+    std::unique_ptr<uint32_t[]> lengths_;
+    std::vector<std::pair<TokenId, LoxValuePtr>> literals_;
+    uint32_t literalSlots_{0};
+};
@@ -1,7 +1,26 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <memory>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// 支持直接以 string_view 查找的字符串哈希，查找时无需临时构造 std::string
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+template<typename V>
+using StringMap = std::unordered_map<std::string, V, StringHash, std::equal_to<>>;
+
+using StringSet = std::unordered_set<std::string, StringHash, std::equal_to<>>;
 
 class LoxValue {
 public:
@@ -17,16 +36,77 @@ public:
 
 using LoxValuePtr = std::shared_ptr<LoxValue>;
 
+/* 字符串，内容不可变
+ * 切片与原字符串共享同一块内存，value_ 指向其中的一段，owner_ 使原字符串保持存活；
+ * 不超过 COPY_LIMIT 个字节的切片直接复制（放得进 std::string 内部的缓冲区，不分配内存），
+ * 以免很短的切片使很长的原字符串一直不能释放。单个字符的字符串取本线程缓存的对象。
+ * */
 struct LoxString : public LoxValue {
-    std::string value_;
+    std::string_view value_;
+
+    explicit LoxString(std::string value) : owned_{std::move(value)} { value_ = owned_; }
+
+    // owner 中的一段，由 slice 创建
+    LoxString(std::shared_ptr<const LoxString> owner, std::string_view value) : owner_{std::move(owner)} {
+        value_ = value;
+    }
 
-    explicit LoxString(std::string value) : value_{std::move(value)} {}
+    // value_ 可能指向自身的 owned_，不能复制
+    LoxString(const LoxString &) = delete;
+
+    LoxString &operator=(const LoxString &) = delete;
 
     ~LoxString() override = default;
 
+    static constexpr size_t COPY_LIMIT = 15;
+
+    static std::shared_ptr<LoxString> of(char c) {
+        thread_local const auto cache = [] {
+            std::array<std::shared_ptr<LoxString>, 256> strings;
+            for (int i = 0; i < 256; ++i) strings[i] = std::make_shared<LoxString>(std::string(1, (char) i));
+            return strings;
+        }();
+        return cache[(unsigned char) c];
+    }
+
+    // [begin, end) 的子串，下标由调用者检查
+    static std::shared_ptr<LoxString> slice(const std::shared_ptr<LoxString> &string, size_t begin, size_t end) {
+        auto part = string->value_.substr(begin, end - begin);
+        if (part.size() == string->value_.size()) return string;
+        if (part.size() == 1) return of(part[0]);
+        if (part.size() <= COPY_LIMIT) return std::make_shared<LoxString>(std::string{part});
+        std::shared_ptr<const LoxString> owner = string->owner_ ? string->owner_ : string;
+        return std::make_shared<LoxString>(std::move(owner), part);
+    }
+
+    // 以 '\0' 结尾的内容，供 C 接口使用；切片第一次调用时复制一份。
+    // 不可变的集合中的切片可能同时在多个线程中调用，复制只进行一次
+    const char *c_str() const {
+        if (!owner_) return owned_.c_str();
+        std::call_once(copied_, [this] { owned_ = value_; });
+        return owned_.c_str();
+    }
+
+    // 第一次使用时计算并缓存，同一个字符串对象反复作为 map 的键时不再重新计算；
+    // 不可变的集合可能在多个线程中共享同一个字符串，缓存用原子变量（0 表示尚未计算）
+    size_t hash() const {
+        auto hash = hash_.load(std::memory_order_relaxed);
+        if (hash == 0) {
+            hash = std::hash<std::string_view>{}(value_);
+            hash_.store(hash, std::memory_order_relaxed);
+        }
+        return hash;
+    }
+
     std::ostream &operator<<(std::ostream &o) override {
         return o << value_;
     };
+
+private:
+    mutable std::string owned_;             // 不是切片时的内容，或切片以 '\0' 结尾的副本
+    std::shared_ptr<const LoxString> owner_; // 是切片时内容所在的字符串
+    mutable std::once_flag copied_;          // 切片的 owned_ 是否已经复制
+    mutable std::atomic<size_t> hash_{0};
 };
 
 struct LoxInt : public LoxValue {
@@ -36,6 +116,19 @@ struct LoxInt : public LoxValue {
 
     ~LoxInt() override = default;
 
+    // 值不可变，[CACHE_MIN, CACHE_MAX) 内的整数直接取本线程缓存的对象，不再分配
+    static constexpr int64_t CACHE_MIN = -128, CACHE_MAX = 1024;
+
+    static LoxValuePtr of(int64_t value) {
+        if (value < CACHE_MIN or value >= CACHE_MAX) return std::make_shared<LoxInt>(value);
+        thread_local const auto cache = [] {
+            std::array<LoxValuePtr, CACHE_MAX - CACHE_MIN> values;
+            for (int64_t i = CACHE_MIN; i < CACHE_MAX; ++i) values[i - CACHE_MIN] = std::make_shared<LoxInt>(i);
+            return values;
+        }();
+        return cache[value - CACHE_MIN];
+    }
+
     std::ostream &operator<<(std::ostream &o) override {
         return o << value_;
     }
@@ -60,6 +153,11 @@ struct LoxBool : public LoxValue {
 
     ~LoxBool() override = default;
 
+    static LoxValuePtr of(bool value) {
+        thread_local const LoxValuePtr values[2]{std::make_shared<LoxBool>(false), std::make_shared<LoxBool>(true)};
+        return values[value];
+    }
+
     std::ostream &operator<<(std::ostream &o) override {
         return value_ ? o << "true" : o << "false";
     };
@@ -68,6 +166,11 @@ struct LoxBool : public LoxValue {
 struct LoxNil : public LoxValue {
     ~LoxNil() override = default;
 
+    static LoxValuePtr instance() {
+        thread_local const LoxValuePtr nil = std::make_shared<LoxNil>();
+        return nil;
+    }
+
     std::ostream &operator<<(std::ostream &o) override {
         return o << "nil";
     };
@@ -0,0 +1,233 @@
+#include "compiler.hpp"
+
+#include <cstdlib>
+#include <sstream>
+
+#include "scanner.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+#include "lox_module.hpp"
+
+namespace {
+    // 收集语句中出现的 import，包括代码块和函数体里的（尚未解析的函数体除外）
+    struct ImportCollector : public Stmt::AbstractVisitor {
+        explicit ImportCollector(const TokenBuffer &tokens) : tokens{tokens} {}
+
+        std::vector<std::string> names;
+
+        void collect(const std::vector<StmtPtr> &statements) {
+            for (const auto &stmt: statements) collect(stmt);
+        }
+
+        void collect(const StmtPtr &stmt) {
+            if (stmt) stmt->accept(*this);
+        }
+
+        void visitIfStmt(IfStmt *stmt) override {
+            collect(stmt->thenStmt_);
+            collect(stmt->elseStmt_);
+        }
+
+        void visitWhileStmt(WhileStmt *stmt) override { collect(stmt->statements_); }
+
+        void visitContinueStmt(ContinueStmt *) override {}
+
+        void visitBreakStmt(BreakStmt *) override {}
+
+        void visitForStmt(ForStmt *stmt) override { collect(stmt->body_); }
+
+        void visitWhenStmt(WhenStmt *stmt) override {
+            for (const auto &branch: *stmt->branches) collect(branch.second);
+            collect(stmt->else_);
+        }
+
+        void visitBlockStmt(BlockStmt *stmt) override { collect(*stmt->statements_); }
+
+        void visitExpressionStmt(ExpressionStmt *) override {}
+
+        void visitLetStmt(LetStmt *) override {}
+
+        void visitVarStmt(VarStmt *) override {}
+
+        void visitFunctionStmt(FunctionStmt *stmt) override {
+            if (stmt->body_) collect(*stmt->body_);
+        }
+
+        void visitReturnStmt(ReturnStmt *) override {}
+
+        void visitYieldStmt(YieldStmt *) override {}
+
+        void visitClassStmt(ClassStmt *stmt) override {
+            for (const auto &method: *stmt->methods_) visitFunctionStmt(method.get());
+        }
+
+        void visitImportStmt(ImportStmt *stmt) override {
+            std::string name;
+            for (auto part: *stmt->path_) {
+                if (not name.empty()) name += '.';
+                name += tokens.lexeme(part);
+            }
+            names.push_back(std::move(name));
+        }
+
+        const TokenBuffer &tokens;
+    };
+}
+
+std::unique_ptr<CompiledProgram> compile(const Source &source, const CompileOptions &options, std::ostream &err) {
+    ProgramCache cache{source, options.lazyParse};
+    if (options.useCache) {
+        if (auto program = cache.load()) return program;
+    }
+
+    // 词法解析
+    Scanner scanner{source.text(), err};
+    auto tokens = scanner.getTokens();
+    if (!tokens) return nullptr;
+
+    // 延迟解析的函数体会记下词法单元流的地址，先放到最终的位置再解析
+    auto program = std::make_unique<CompiledProgram>(source.text());
+    program->tokens = std::move(*tokens);
+
+    // 语法解析
+    Parser parser(program->tokens, options.lazyParse, err);
+    auto ast = parser.parse();
+    if (!ast) return nullptr;
+    program->statements = std::move(ast.value());
+
+    // 语义分析
+    Resolver resolver{program->tokens, err};
+    bool resolve_result = resolver.resolve(program->statements);
+    if (!resolve_result) return nullptr;
+
+    if (options.useCache) cache.store(program->tokens, program->statements);
+    return program;
+}
+
+ModuleRegistry &ModuleRegistry::instance() {
+    static ModuleRegistry registry;
+    return registry;
+}
+
+void ModuleRegistry::configure(std::vector<std::string> searchPaths, CompileOptions options) {
+    if (auto path = std::getenv("IDUN_PATH")) {
+        std::string_view paths{path};
+        while (not paths.empty()) {
+            auto end = std::min(paths.find(':'), paths.size());
+            if (end > 0) searchPaths.emplace_back(paths.substr(0, end));
+            paths.remove_prefix(std::min(end + 1, paths.size()));
+        }
+    }
+    if (options.jobs == 0) options.jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    std::lock_guard lock{mutex_};
+    // 配置不变时保留已经编译的模块
+    if (searchPaths == searchPaths_ and options.lazyParse == options_.lazyParse
+        and options.useCache == options_.useCache and options.jobs == options_.jobs) {
+        return;
+    }
+    searchPaths_ = std::move(searchPaths);
+    options_ = options;
+    modules_.clear();
+}
+
+void ModuleRegistry::preload(const CompiledProgram &program) {
+    std::lock_guard lock{mutex_};
+    schedule(program);
+}
+
+void ModuleRegistry::schedule(const CompiledProgram &program) {
+    if (options_.jobs <= 1) return;
+
+    ImportCollector collector{program.tokens};
+    collector.collect(program.statements);
+    for (const auto &name: collector.names) {
+        if (modules_.contains(name) or LoxModule::findNative(name)) continue;
+
+        auto entry = std::make_shared<Entry>();
+        modules_.emplace(name, entry);
+        if (!pool_) pool_ = std::make_unique<ThreadPool>(options_.jobs);
+        pool_->submit([this, name, entry] {
+            build(name, *entry);
+            if (entry->module) {
+                // 继续编译这个模块导入的模块
+                std::lock_guard lock{mutex_};
+                schedule(*entry->module->program);
+            }
+            entry->promise.set_value();
+        });
+    }
+}
+
+void ModuleRegistry::build(std::string_view name, Entry &entry) {
+    std::vector<std::string> searchPaths;
+    CompileOptions options;
+    {
+        std::lock_guard lock{mutex_};
+        searchPaths = searchPaths_;
+        options = options_;
+    }
+
+    std::string relative{name};
+    for (auto &c: relative) {
+        if (c == '.') c = '/';
+    }
+    relative += ".idun";
+
+    std::ostringstream err;
+    for (const auto &dir: searchPaths) {
+        auto path = dir.empty() ? relative : dir + '/' + relative;
+        auto source = Source::fromFile(path);
+        if (!source) continue;
+
+        auto program = compile(*source, options, err);
+        if (!program) {
+            err << "Could not compile module '" << name << "': " << path << std::endl;
+            break;
+        }
+        entry.module = std::make_shared<CompiledModule>(CompiledModule{path, std::move(source), std::move(program)});
+        break;
+    }
+    entry.diagnostics = std::move(err).str();
+}
+
+std::shared_ptr<const CompiledModule> ModuleRegistry::load(std::string_view name, std::ostream &err) {
+    EntryPtr entry;
+    bool owner = false;
+    {
+        std::lock_guard lock{mutex_};
+        if (auto it = modules_.find(name); it != modules_.end()) {
+            entry = it->second;
+        } else {
+            entry = std::make_shared<Entry>();
+            modules_.emplace(name, entry);
+            owner = true;
+        }
+    }
+
+    // 没有预先编译的模块直接在当前线程编译，正在后台编译的模块则等待其完成
+    if (owner) {
+        build(name, *entry);
+        if (entry->module) preload(*entry->module->program);
+        entry->promise.set_value();
+    }
+    entry->done.wait();
+
+    std::lock_guard lock{mutex_};
+    if (not entry->reported) {
+        err << entry->diagnostics;
+        entry->reported = true;
+    }
+    return entry->module;
+}
+
+void ModuleRegistry::refresh() {
+    std::lock_guard lock{mutex_};
+    std::erase_if(modules_, [](const auto &item) {
+        const auto &entry = item.second;
+        // 仍在后台编译的模块留到下一次
+        if (entry->done.wait_for(std::chrono::seconds{0}) != std::future_status::ready) return false;
+        if (!entry->module) return true;
+        return Source::modifiedTime(entry->module->path) != entry->module->source->modified();
+    });
+}
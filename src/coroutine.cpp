@@ -0,0 +1,263 @@
+#include "coroutine.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+    /* 协程栈只保留地址空间，实际用到的页才占用内存；
+     * 最低的一页不可访问，栈溢出时立即出错而不会改写其它内存
+     * */
+    std::atomic<size_t> configuredStackSize{Coroutine::DEFAULT_STACK_SIZE};
+
+    constexpr size_t MIN_STACK_SIZE = 64 << 10;
+
+    // 栈底保留给宿主函数（如排序）使用的空间
+    constexpr size_t STACK_RESERVE = 32 << 10;
+
+    size_t pageSize() {
+        static const auto size = (size_t) sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+    // 最近释放的栈，创建协程时优先复用，省去 mmap、mprotect 和 munmap；只保留当前大小的栈
+    struct StackPool {
+        static constexpr size_t CAPACITY = 16;
+        size_t size{0};
+        std::vector<void *> stacks;
+
+        void clear() {
+            for (auto stack: stacks) munmap(stack, size);
+            stacks.clear();
+        }
+
+        ~StackPool() {
+            clear();
+        }
+    };
+
+    thread_local StackPool pool;
+
+    // 失败时返回 nullptr
+    void *allocateStack(size_t size) {
+        if (pool.size != size) {
+            pool.clear();
+            pool.size = size;
+        }
+        if (!pool.stacks.empty()) {
+            auto stack = pool.stacks.back();
+            pool.stacks.pop_back();
+            return stack;
+        }
+        auto stack = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (stack == MAP_FAILED) return nullptr;
+        if (mprotect(stack, pageSize(), PROT_NONE) != 0) {
+            munmap(stack, size);
+            return nullptr;
+        }
+        return stack;
+    }
+
+    void releaseStack(void *stack, size_t size) {
+        if (pool.size == size and pool.stacks.size() < StackPool::CAPACITY) pool.stacks.push_back(stack);
+        else munmap(stack, size);
+    }
+}
+
+void Coroutine::setStackSize(size_t size) {
+    auto page = pageSize();
+    size = std::max(size, MIN_STACK_SIZE);
+    configuredStackSize = (size + page - 1) / page * page;
+}
+
+size_t Coroutine::stackSize() {
+    return configuredStackSize;
+}
+
+#if defined(__x86_64__)
+/* idun_switch_stack(from, to)：压入被调用者保存的寄存器和浮点控制字，栈指针存入 *from，
+ * 换到 to 指向的栈上按相反顺序恢复并返回。新栈第一次切换时返回到 idun_start_stack，
+ * 由它以 r12 为参数调用 r13（Coroutine::start）。
+ * */
+extern "C" void idun_switch_stack(void **from, void *to);
+extern "C" void idun_start_stack();
+
+asm(R"(
+    .text
+    .p2align 4
+    .globl idun_switch_stack
+    .hidden idun_switch_stack
+    .type idun_switch_stack, @function
+idun_switch_stack:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size idun_switch_stack, .-idun_switch_stack
+
+    .p2align 4
+    .globl idun_start_stack
+    .hidden idun_start_stack
+    .type idun_start_stack, @function
+idun_start_stack:
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .size idun_start_stack, .-idun_start_stack
+)");
+
+void Coroutine::prepare() {
+    // 栈顶按 idun_switch_stack 压栈的顺序放好初始值，返回地址之上留出对齐，使 call 之前栈指针是 16 的倍数
+    auto top = reinterpret_cast<uint64_t *>(static_cast<char *>(stack_) + stackSize_);
+    top[-3] = (uint64_t) (uintptr_t) idun_start_stack;
+    top[-4] = 0;                                // rbp
+    top[-5] = 0;                                // rbx
+    top[-6] = (uint64_t) (uintptr_t) this;      // r12
+    top[-7] = (uint64_t) (uintptr_t) start;     // r13
+    top[-8] = 0;                                // r14
+    top[-9] = 0;                                // r15
+    top[-10] = (uint64_t) 0x037f << 32 | 0x1f80;  // x87 控制字和 MXCSR 的默认值
+    context_ = top - 10;
+}
+
+void Coroutine::enter() {
+    idun_switch_stack(&caller_, context_);
+}
+
+void Coroutine::leave() {
+    idun_switch_stack(&context_, caller_);
+}
+#else
+
+void Coroutine::prepare() {
+    getcontext(&context_);
+    context_.uc_stack.ss_sp = static_cast<char *>(stack_) + pageSize();
+    context_.uc_stack.ss_size = stackSize_ - pageSize();
+    // makecontext 的参数是 int，指针拆成两半传递
+    auto address = (uint64_t) (uintptr_t) this;
+    auto entry = +[](unsigned high, unsigned low) {
+        start(reinterpret_cast<Coroutine *>((uintptr_t) ((uint64_t) high << 32 | low)));
+    };
+    makecontext(&context_, (void (*)()) entry, 2, (unsigned) (address >> 32), (unsigned) address);
+}
+
+void Coroutine::enter() {
+    swapcontext(&caller_, &context_);
+}
+
+void Coroutine::leave() {
+    swapcontext(&context_, &caller_);
+}
+#endif
+
+Coroutine::Coroutine(FunctionStmt *declaration, std::shared_ptr<Environment> env, UnitPtr unit)
+        : declaration_{declaration}, tokens_{unit->tokens}, env_{std::move(env)},
+          frame_{unit->global, unit->global, unit, unit->tokens, LoxNil::instance()} {}
+
+Coroutine::~Coroutine() {
+    if (stack_) releaseStack(stack_, stackSize_);
+}
+
+bool Coroutine::stackLow() const {
+    auto current = static_cast<char *>(__builtin_frame_address(0));
+    return current < static_cast<char *>(stack_) + pageSize() + STACK_RESERVE;
+}
+
+void Coroutine::close() {
+    if (state_ == State::CREATED) {
+        state_ = State::DONE;
+        env_ = nullptr;
+    }
+    if (state_ != State::SUSPENDED) return;
+    closing_ = true;
+    resume(*interpreter_);
+    error_ = nullptr;
+}
+
+void Coroutine::resume(Interpreter &interpreter) {
+    if (state_ == State::DONE) return;
+    if (state_ == State::CREATED) {
+        // 每个栈占用两个内存映射（栈和保护页），暂停的协程太多时可能超过 vm.max_map_count 或地址空间的限制
+        stackSize_ = stackSize();
+        stack_ = allocateStack(stackSize_);
+        if (!stack_) {
+            auto name = declaration_->name_;
+            throw interpreter_error{(*tokens_)[name], std::format("Cannot allocate a stack for '{}', too many "
+                                    "generators or async functions are suspended.", tokens_->lexeme(name))};
+        }
+        prepare();
+        interpreter_ = &interpreter;
+        interpreter.coroutines.insert(this);
+    }
+    auto previous = std::exchange(interpreter.coroutine, this);
+    swapFrame();
+    state_ = State::RUNNING;
+    enter();
+    swapFrame();
+    interpreter.coroutine = previous;
+
+    // 函数体已经结束，不再需要它的栈和环境
+    if (state_ == State::DONE) {
+        interpreter.coroutines.erase(this);
+        releaseStack(std::exchange(stack_, nullptr), stackSize_);
+        frame_ = {};
+    }
+}
+
+void Coroutine::suspend() {
+    state_ = State::SUSPENDED;
+    leave();
+    // 被 close 恢复时沿调用栈退出函数体
+    if (closing_) throw coroutine_exit{};
+}
+
+void Coroutine::start(Coroutine *self) {
+    self->run();
+    // 函数体已经结束，不会再切换回来
+    self->leave();
+}
+
+void Coroutine::run() {
+    LoxValuePtr returned = LoxNil::instance();
+    try {
+        interpreter_->executeBlock(declaration_->body_, std::move(env_));
+    } catch (return_value &value) {
+        returned = std::move(value.value_);
+    } catch (coroutine_exit &) {
+    } catch (...) {
+        error_ = std::current_exception();
+    }
+    value_ = std::move(returned);
+    state_ = State::DONE;
+}
+
+void Coroutine::swapFrame() {
+    auto &interpreter = *interpreter_;
+    std::swap(interpreter.env, frame_.env);
+    std::swap(interpreter.global, frame_.global);
+    std::swap(interpreter.unit, frame_.unit);
+    std::swap(interpreter.tokens, frame_.tokens);
+    std::swap(interpreter.result, frame_.result);
+}
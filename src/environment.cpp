@@ -1,27 +1,40 @@
 #include "environment.hpp"
 #include "lox_exception.hpp"
 
-void Environment::define(const std::string &name, LoxValuePtr value) {
-    values.insert_or_assign(name, value);
+void Environment::define(std::string_view name, LoxValuePtr value, bool let) {
+    values.insert_or_assign(std::string{name}, value);
+    if (let) {
+        lets.emplace(name);
+    } else if (!lets.empty()) {
+        if (auto it = lets.find(name); it != lets.end()) lets.erase(it);
+    }
 }
 
-LoxValuePtr Environment::get(const TokenPtr &token) {
-    auto it = values.find(token->lexeme);
+LoxValuePtr Environment::get(const Token &token) {
+    auto it = values.find(token.lexeme);
     if (it != values.end()) return it->second;
 
     if (parentEnv) return parentEnv->get(token);
 
-    throw interpreter_error{token, "Undefined variable '" + token->lexeme + '\''};
+    throw interpreter_error{token, "Undefined variable '" + std::string{token.lexeme} + '\''};
+}
+
+LoxValuePtr Environment::lookup(std::string_view name) const {
+    auto it = values.find(name);
+    return it != values.end() ? it->second : nullptr;
 }
 
-LoxValuePtr Environment::getAt(int distance, const std::string &name) {
+LoxValuePtr Environment::getAt(int distance, std::string_view name) {
     return ancestor(distance)->values.find(name)->second;
 }
 
-void Environment::assign(const TokenPtr &token, const LoxValuePtr &value) {
-    auto it = values.find(token->lexeme);
+void Environment::assign(const Token &token, const LoxValuePtr &value) {
+    auto it = values.find(token.lexeme);
 
     if (it != values.end()) {
+        if (!lets.empty() and lets.contains(token.lexeme)) {
+            throw interpreter_error{token, "Cannot assign to let variable '" + std::string{token.lexeme} + '\''};
+        }
         it->second = value;
         return;
     }
@@ -31,11 +44,17 @@ void Environment::assign(const TokenPtr &token, const LoxValuePtr &value) {
         return;
     }
 
-    throw interpreter_error{token, "Undefined variable '" + token->lexeme + '\''};
+    throw interpreter_error{token, "Undefined variable '" + std::string{token.lexeme} + '\''};
 }
 
-void Environment::assignAt(int distance, const TokenPtr &token, LoxValuePtr value) {
-    ancestor(distance)->values.insert_or_assign(token->lexeme, value);
+void Environment::assignAt(int distance, std::string_view name, LoxValuePtr value) {
+    auto &scope = ancestor(distance)->values;
+    auto it = scope.find(name);
+    if (it != scope.end()) {
+        it->second = std::move(value);
+    } else {
+        scope.emplace(std::string{name}, std::move(value));
+    }
 }
 
 std::shared_ptr<Environment> Environment::ancestor(int distance) {
@@ -0,0 +1,158 @@
+#include "event_loop.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "token.hpp"
+#include "value.hpp"
+#include "lox_exception.hpp"
+
+namespace {
+    // 读写文件的线程数，只是等待磁盘，不必与核数相同
+    constexpr unsigned POOL_THREADS = 4;
+
+    constexpr int MAX_EVENTS = 64;
+}
+
+EventLoop::EventLoop() {
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeup_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_ < 0 or wakeup_ < 0) throw native_error{"Cannot create the event loop."};
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeup_;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &event);
+}
+
+EventLoop::~EventLoop() {
+    pool_ = nullptr;
+    // 回调中可能持有等待中的协程，先移出再销毁，销毁时不会再访问这些容器
+    auto ready = std::move(ready_);
+    auto timers = std::move(timers_);
+    auto watches = std::move(watches_);
+    std::vector<Callback> posted;
+    {
+        std::lock_guard lock{mutex_};
+        posted = std::move(posted_);
+    }
+    close(wakeup_);
+    close(epoll_);
+}
+
+void EventLoop::defer(Callback callback) {
+    ready_.push_back(std::move(callback));
+}
+
+void EventLoop::after(double seconds, Callback callback) {
+    auto delay = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(std::max(seconds, 0.0)));
+    timers_.push({Clock::now() + delay, timerSequence_++, std::move(callback)});
+}
+
+void EventLoop::whenReadable(int fd, Callback callback) {
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        // 已经登记过（上次触发后 ONESHOT 使其停用）时重新启用
+        if (errno != EEXIST or epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &event) != 0) {
+            throw native_error{"Cannot wait for the file descriptor."};
+        }
+    }
+    watches_[fd] = std::move(callback);
+}
+
+void EventLoop::offload(Callback work, Callback done) {
+    if (!pool_) pool_ = std::make_unique<ThreadPool>(POOL_THREADS);
+    ++offloaded_;
+    pool_->submit([this, work = std::move(work), done = std::move(done)]() mutable {
+        work();
+        post([this, done = std::move(done)] {
+            --offloaded_;
+            done();
+        });
+    });
+}
+
+void EventLoop::post(Callback callback) {
+    {
+        std::lock_guard lock{mutex_};
+        posted_.push_back(std::move(callback));
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] auto written = write(wakeup_, &one, sizeof(one));
+}
+
+bool EventLoop::runUntil(const std::function<bool()> &done) {
+    running_ = true;
+    struct Stop {
+        bool &running;
+
+        ~Stop() { running = false; }
+    } stop{running_};
+
+    while (!done()) {
+        if (!ready_.empty()) {
+            // 本轮执行期间加入的回调留到下一轮，回调不断 defer 时也能处理其它事件
+            auto ready = std::move(ready_);
+            ready_.clear();
+            for (auto &callback: ready) callback();
+            poll(0);
+            continue;
+        }
+        if (!pending()) return done();
+
+        int timeout = -1;
+        if (!timers_.empty()) {
+            auto wait = std::chrono::duration<double, std::milli>(timers_.top().deadline - Clock::now()).count();
+            timeout = (int) std::clamp(std::ceil(wait), 0.0, (double) INT32_MAX);
+        }
+        poll(timeout);
+    }
+    return true;
+}
+
+bool EventLoop::pending() {
+    if (!timers_.empty() or !watches_.empty() or offloaded_ > 0 or holds_ > 0) return true;
+    std::lock_guard lock{mutex_};
+    return !posted_.empty();
+}
+
+void EventLoop::poll(int timeout) {
+    epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(epoll_, events, MAX_EVENTS, timeout);
+    for (int i = 0; i < count; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == wakeup_) {
+            uint64_t value;
+            [[maybe_unused]] auto read_ = read(wakeup_, &value, sizeof(value));
+            continue;
+        }
+        auto watch = watches_.find(fd);
+        if (watch == watches_.end()) continue;
+        auto callback = std::move(watch->second);
+        watches_.erase(watch);
+        // 描述符可能随后被关闭并复用，不保留登记
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+        callback();
+    }
+    runPosted();
+
+    auto now = Clock::now();
+    while (!timers_.empty() and timers_.top().deadline <= now) {
+        auto callback = std::move(const_cast<Timer &>(timers_.top()).callback);
+        timers_.pop();
+        callback();
+    }
+}
+
+void EventLoop::runPosted() {
+    std::vector<Callback> posted;
+    {
+        std::lock_guard lock{mutex_};
+        posted.swap(posted_);
+    }
+    for (auto &callback: posted) callback();
+}
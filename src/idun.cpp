@@ -0,0 +1,192 @@
+#include "idun.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "isolate.hpp"
+#include "lox_function.hpp"
+
+struct idun_program {
+    ProgramPtr program;
+};
+
+struct idun_context {
+    std::ostringstream err;     // 收集错误信息，失败时转存到 idun_error
+    Context context{std::cout, err};
+};
+
+struct idun_value {
+    LoxValuePtr value;
+};
+
+namespace {
+    thread_local std::string lastError;
+
+    void fail(std::string message) {
+        while (not message.empty() and message.back() == '\n') message.pop_back();
+        lastError = std::move(message);
+    }
+
+    void fail(std::ostringstream &err, const char *fallback) {
+        auto message = err.str();
+        err.str("");
+        fail(message.empty() ? fallback : std::move(message));
+    }
+
+    idun_value *wrap(LoxValuePtr value) {
+        return value ? new idun_value{std::move(value)} : nullptr;
+    }
+
+    template<typename T>
+    const T *as(const idun_value *value) {
+        return value ? dynamic_cast<const T *>(value->value.get()) : nullptr;
+    }
+
+    idun_program *compile(SourcePtr source) {
+        std::ostringstream err;
+        auto program = Program::compile(std::move(source), {}, err);
+        if (!program) {
+            fail(err, "compile error");
+            return nullptr;
+        }
+        return new idun_program{std::move(program)};
+    }
+}
+
+const char *idun_error(void) {
+    return lastError.c_str();
+}
+
+idun_program *idun_compile(const char *source, size_t length, const char *name) {
+    return compile(Source::fromString(std::string{source, length}, name ? name : "<string>"));
+}
+
+idun_program *idun_compile_file(const char *path) {
+    auto source = Source::fromFile(path);
+    if (!source) {
+        fail(std::string{"Could not open file: "} + path);
+        return nullptr;
+    }
+    return compile(std::move(source));
+}
+
+void idun_program_free(idun_program *program) {
+    delete program;
+}
+
+void idun_module_paths(const char *const *paths, size_t count) {
+    ModuleRegistry::instance().configure({paths, paths + count}, {});
+}
+
+idun_context *idun_context_new(void) {
+    return new idun_context;
+}
+
+void idun_context_free(idun_context *context) {
+    delete context;
+}
+
+int idun_register(idun_context *context, const char *name, size_t arity, idun_native function, void *userdata) {
+    if (!name or !function) {
+        fail("invalid native function");
+        return -1;
+    }
+    context->context.define(name, arity, [context, function, userdata](std::span<LoxValuePtr> args) {
+        std::vector<idun_value> values;
+        values.reserve(args.size());
+        for (const auto &arg: args) values.push_back({arg});
+        std::vector<idun_value *> pointers;
+        pointers.reserve(values.size());
+        for (auto &value: values) pointers.push_back(&value);
+
+        auto result = function(context, pointers.data(), pointers.size(), userdata);
+        if (!result) return LoxValuePtr{};
+        // 直接返回某个参数时参数仍归 Idun 所有，只取出其中的值
+        if (std::find(pointers.begin(), pointers.end(), result) != pointers.end()) return result->value;
+        auto value = std::move(result->value);
+        delete result;
+        return value;
+    });
+    return 0;
+}
+
+int idun_run(idun_context *context, const idun_program *program) {
+    if (not context->context.run(*program->program)) {
+        fail(context->err, "runtime error");
+        return -1;
+    }
+    return 0;
+}
+
+idun_value *idun_call(idun_context *context, const char *name, idun_value *const *args, size_t argc) {
+    std::vector<LoxValuePtr> values;
+    values.reserve(argc);
+    for (size_t i = 0; i < argc; ++i) {
+        values.push_back(args[i] ? args[i]->value : LoxNil::instance());
+    }
+    auto result = context->context.call(name, values);
+    if (!result) fail(context->err, "call failed");
+    return wrap(std::move(result));
+}
+
+idun_value *idun_global(idun_context *context, const char *name) {
+    auto value = context->context.global(name);
+    if (!value) fail(std::string{"Undefined variable '"} + name + "'");
+    return wrap(std::move(value));
+}
+
+idun_value *idun_nil(void) {
+    return wrap(LoxNil::instance());
+}
+
+idun_value *idun_bool(int value) {
+    return wrap(LoxBool::of(value != 0));
+}
+
+idun_value *idun_int(int64_t value) {
+    return wrap(LoxInt::of(value));
+}
+
+idun_value *idun_float(double value) {
+    return wrap(std::make_shared<LoxFloat>(value));
+}
+
+idun_value *idun_string(const char *text, size_t length) {
+    return wrap(std::make_shared<LoxString>(std::string{text, length}));
+}
+
+void idun_value_free(idun_value *value) {
+    delete value;
+}
+
+idun_type idun_type_of(const idun_value *value) {
+    if (!value or as<LoxNil>(value)) return IDUN_NIL;
+    if (as<LoxBool>(value)) return IDUN_BOOL;
+    if (as<LoxInt>(value)) return IDUN_INT;
+    if (as<LoxFloat>(value)) return IDUN_FLOAT;
+    if (as<LoxString>(value)) return IDUN_STRING;
+    return IDUN_OBJECT;
+}
+
+int idun_as_bool(const idun_value *value) {
+    return value ? Interpreter::isTruth(value->value) : 0;
+}
+
+int64_t idun_as_int(const idun_value *value) {
+    if (auto integer = as<LoxInt>(value)) return integer->value_;
+    if (auto floating = as<LoxFloat>(value)) return (int64_t) floating->value_;
+    return 0;
+}
+
+double idun_as_float(const idun_value *value) {
+    if (auto floating = as<LoxFloat>(value)) return floating->value_;
+    if (auto integer = as<LoxInt>(value)) return (double) integer->value_;
+    return 0;
+}
+
+const char *idun_as_string(const idun_value *value, size_t *length) {
+    auto string = as<LoxString>(value);
+    if (!string) return nullptr;
+    if (length) *length = string->value_.size();
+    return string->c_str();
+}
@@ -4,38 +4,209 @@
 #include <utility>
 #include <cmath>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <format>
 #include "lox_exception.hpp"
+#include "native.hpp"
 #include "lox_instance.hpp"
+#include "lox_array.hpp"
+#include "lox_async.hpp"
+#include "lox_generator.hpp"
+#include "lox_hamt.hpp"
+#include "lox_iterator.hpp"
+#include "lox_list.hpp"
+#include "lox_map.hpp"
+#include "lox_math.hpp"
+#include "lox_module.hpp"
+#include "lox_set.hpp"
+#include "lox_vector.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+#include "sort.hpp"
 
 #define CAST(TO_TYPE, FROM_VAL) std::dynamic_pointer_cast<TO_TYPE>(FROM_VAL)
 
-Interpreter::Interpreter() : result(std::make_shared<LoxNil>()), global(std::make_shared<Environment>()), env(global) {
-    global->define("print", std::make_shared<NativePrint>());
-    global->define("clock", std::make_shared<NativeClock>());
+namespace {
+    // 参数不多时放在栈上，调用本身不分配内存
+    struct Arguments {
+        std::array<LoxValuePtr, 8> inline_;
+        std::vector<LoxValuePtr> heap_;
+        std::span<LoxValuePtr> values;
+
+        explicit Arguments(size_t count) : values{inline_.data(), count} {
+            if (count > inline_.size()) {
+                heap_.resize(count);
+                values = heap_;
+            }
+        }
+    };
+
+    // 声明了类型的集合没有初始值时创建为空集合
+    LoxValuePtr emptyValue(const TokenBuffer &tokens, const TypeAnnotationPtr &type) {
+        if (!type or !type->element_) return LoxNil::instance();
+        auto element = elementTypeOf(tokens.lexeme(type->element_->name_)).value_or(ElementType::ANY);
+        if (tokens.lexeme(type->name_) == LoxList::TYPE) return std::make_shared<LoxList>(element, true);
+        if (tokens.lexeme(type->name_) == LoxMap::TYPE) return std::make_shared<LoxMap>(element, true);
+        if (tokens.lexeme(type->name_) == LoxSet::TYPE) return std::make_shared<LoxSet>(element);
+        return LoxNil::instance();
+    }
+
+    // let 绑定的列表、字典和集合（包括嵌套在其中的）冻结为不可变的版本，其它值不变
+    LoxValuePtr freeze(const LoxValuePtr &value) {
+        if (auto list = dynamic_cast<LoxList *>(value.get())) {
+            std::vector<LoxValuePtr> items;
+            items.reserve(list->size());
+            for (size_t i = 0; i < list->size(); ++i) items.push_back(freeze(list->get(i)));
+            return std::make_shared<LoxVector>(list->elementType(), list->declared(), PersistentVector{items});
+        }
+        if (auto map = dynamic_cast<LoxMap *>(value.get())) {
+            PersistentMap items;
+            map->forEach([&](const auto &key, const auto &item) { items = items.set(key, freeze(item)); });
+            return std::make_shared<LoxHamt>(map->valueType(), map->declared(), std::move(items));
+        }
+        if (auto set = dynamic_cast<LoxSet *>(value.get())) return set->frozen() ? value : set->freeze();
+        return value;
+    }
+
+    /* 以脚本提供的比较函数稳定地排序列表
+     * 比较函数只在开始时检查一次，之后每次比较复用同一组参数直接调用，不经过 visitCallExpr。
+     * 对列表的副本排序，比较函数出错时列表不变
+     * */
+    void sortBy(Interpreter &interpreter, LoxList &list, const LoxValuePtr &compare) {
+        auto function = dynamic_cast<LoxCallable *>(compare.get());
+        if (!function) throw native_error{"Argument 2 must be a function."};
+        if (function->variadic() ? function->arity() > 2 : function->arity() != 2) {
+            throw native_error{"The comparator must take 2 arguments."};
+        }
+        std::array<LoxValuePtr, 2> args;
+        auto less = [&](const LoxValuePtr &a, const LoxValuePtr &b) {
+            args[0] = a;
+            args[1] = b;
+            auto order = function->call(interpreter, args);
+            if (auto boolean = dynamic_cast<LoxBool *>(order.get())) return boolean->value_;
+            if (auto integer = dynamic_cast<LoxInt *>(order.get())) return integer->value_ < 0;
+            if (auto floating = dynamic_cast<LoxFloat *>(order.get())) return floating->value_ < 0;
+            throw native_error{"The comparator must return a bool or a number."};
+        };
+        auto items = list.values();
+        sorting::mergeSort(items, less);
+        if (items.size() != list.size()) throw native_error{"The list was modified while sorting."};
+        for (size_t i = 0; i < items.size(); ++i) list.set(i, items[i]);
+    }
+}
+
+Interpreter::Interpreter(std::ostream &out, std::ostream &err)
+        : out{out}, err{err}, result(LoxNil::instance()), global(std::make_shared<Environment>()), env(global) {
+    defineNatives(*global);
+}
+
+Interpreter::~Interpreter() {
+    while (!coroutines.empty()) (*coroutines.begin())->close();
+    if (mailbox) mailbox->detach();
+    // 事件循环中等待的回调持有任务，任务都已结束，此时销毁不会再执行脚本
+    loop = nullptr;
+}
+
+void Interpreter::defineNatives(Environment &environment) {
+    // 每个参数输出一行
+    environment.define("print", makeNative("print", [](Interpreter &interpreter, std::span<LoxValuePtr> args) {
+        for (const auto &arg: args) interpreter.out << *arg << std::endl;
+    }));
+    environment.define("clock", makeNative("clock", [] {
+        auto epoch = std::chrono::system_clock::now().time_since_epoch();
+        return (double) std::chrono::duration_cast<std::chrono::milliseconds>(epoch).count() / 1000.0;
+    }));
+    // 单调时钟，计时应使用这两个而不是 clock：纳秒（整数）和秒（浮点数）
+    environment.define("clock_ns", makeNative("clock_ns", [] {
+        auto epoch = std::chrono::steady_clock::now().time_since_epoch();
+        return (int64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(epoch).count();
+    }));
+    environment.define("monotonic", makeNative("monotonic", [] {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }));
+    /* 原地排序列表并返回它
+     * 没有比较函数时按自然顺序排序；compare(a, b) 返回 bool（a 是否排在 b 前）或数（小于 0 时 a 排在 b 前），
+     * 此时排序是稳定的
+     * */
+    environment.define("sort", makeNative("sort", [](Interpreter &interpreter, const LoxValuePtr &value,
+                                                     std::span<LoxValuePtr> compare) -> LoxValuePtr {
+        auto list = std::dynamic_pointer_cast<LoxList>(value);
+        if (!list) {
+            if (dynamic_cast<LoxVector *>(value.get())) throw native_error{"Cannot sort an immutable list, sort its toList() instead."};
+            throw native_error{"Argument 1 must be a list."};
+        }
+        if (compare.size() > 1) throw native_error{std::format("Expected at most 2 arguments but got {}.", compare.size() + 1)};
+        if (compare.empty()) list->sort();
+        else sortBy(interpreter, *list, compare[0]);
+        return list;
+    }));
+    // 可迭代的值的惰性迭代器，本身是迭代器时原样返回
+    environment.define("iter", makeNative("iter", [](const LoxValuePtr &value) -> LoxValuePtr {
+        if (dynamic_cast<LoxIterator *>(value.get())) return value;
+        if (!isIterable(value.get())) throw native_error{"Argument 1 must be iterable."};
+        return std::make_shared<LoxIterator>(value);
+    }));
+    // 逐行读取文件的迭代器
+    environment.define("lines", makeNative("lines", [](const std::string &path) -> LoxValuePtr {
+        return LoxIterator::lines(path);
+    }));
+    /* 异步的内建函数，立即返回 future：
+     * sleep(seconds)、readFile(path) 得到文件内容、writeFile(path, text)、exec(command) 得到命令的标准输出、
+     * receive() 得到宿主发来的下一条消息（宿主关闭信箱后得到 nil）
+     * */
+    environment.define("sleep", makeNative("sleep", [](Interpreter &interpreter, double seconds) -> LoxValuePtr {
+        return LoxFuture::sleep(interpreter.eventLoop(), seconds);
+    }));
+    environment.define("readFile", makeNative("readFile", [](Interpreter &interpreter, std::string path) -> LoxValuePtr {
+        return LoxFuture::readFile(interpreter.eventLoop(), std::move(path));
+    }));
+    environment.define("writeFile", makeNative("writeFile", [](Interpreter &interpreter, std::string path,
+                                                               std::string text) -> LoxValuePtr {
+        return LoxFuture::writeFile(interpreter.eventLoop(), std::move(path), std::move(text));
+    }));
+    environment.define("exec", makeNative("exec", [](Interpreter &interpreter, std::string command) -> LoxValuePtr {
+        return LoxFuture::exec(interpreter.eventLoop(), std::move(command));
+    }));
+    environment.define("receive", makeNative("receive", [](Interpreter &interpreter) -> LoxValuePtr {
+        if (!interpreter.mailbox) throw native_error{"There is no mailbox to receive messages from."};
+        return interpreter.mailbox->receive(interpreter.eventLoop());
+    }));
+    // 内建的数学模块，Math.sqrt(x) 等
+    environment.define("Math", std::make_shared<LoxModule>(std::string{LoxMath::MODULE}));
+    // 传给脚本的参数个数
+    environment.define("argc", makeNative("argc", [](Interpreter &interpreter) {
+        return (int64_t) interpreter.arguments.size();
+    }));
+    // 第 i 个参数，下标越界时返回 nil
+    environment.define("arg", makeNative("arg", [](Interpreter &interpreter, const LoxValuePtr &i) -> LoxValuePtr {
+        auto index = dynamic_cast<LoxInt *>(i.get());
+        if (!index or index->value_ < 0 or index->value_ >= (int64_t) interpreter.arguments.size()) return nullptr;
+        return std::make_shared<LoxString>(interpreter.arguments[index->value_]);
+    }));
 }
 
 // 访问赋值表达式
-void Interpreter::visitAssignExpr(AssignExprPtr expr) {
+void Interpreter::visitAssignExpr(AssignExpr *expr) {
     auto right = evaluate(expr->value_);
-    auto it = locals.find(expr);
-    if (it != locals.end()) {
-        env->assignAt(it->second, expr->name_, result);
+    if (expr->depth_ >= 0) {
+        env->assignAt(expr->depth_, tokens->lexeme(expr->name_), result);
     } else {
-        global->assign(expr->name_, result);
+        global->assign((*tokens)[expr->name_], result);
     }
 }
 
-void Interpreter::visitBinaryExpr(BinaryExprPtr expr) {
+void Interpreter::visitBinaryExpr(BinaryExpr *expr) {
     auto left = evaluate(expr->left_);
     auto right = evaluate(expr->right_);
 
-    switch (expr->op_->type) {
+    switch (tokens->type(expr->op_)) {
         case TokenType::MINUS: {
             checkNumberOps(expr->op_, left, right);
             if (isFloat(left) || isFloat(right)) {
                 result = std::make_shared<LoxFloat>(getFloat(left) - getFloat(right));
             } else {
-                result = std::make_shared<LoxInt>(getInt(left) - getInt(right));
+                result = LoxInt::of(getInt(left) - getInt(right));
             }
             break;
         }
@@ -43,12 +214,12 @@ void Interpreter::visitBinaryExpr(BinaryExprPtr expr) {
             checkNumberOps(expr->op_, left, right);
             if (isFloat(left) || isFloat(right)) {
                 auto val = getFloat(right);
-                if (val == 0) throw interpreter_error{expr->op_, "Division by 0"};
+                if (val == 0) throw error(expr->op_, "Division by 0");
                 result = std::make_shared<LoxFloat>(getFloat(left) / val);
             } else {
                 auto val = getInt(right);
-                if (val == 0) throw interpreter_error{expr->op_, "Division by 0"};
-                result = std::make_shared<LoxInt>(getInt(left) / val);
+                if (val == 0) throw error(expr->op_, "Division by 0");
+                result = LoxInt::of(getInt(left) / val);
             }
             break;
         }
@@ -57,25 +228,29 @@ void Interpreter::visitBinaryExpr(BinaryExprPtr expr) {
             if (isFloat(left) || isFloat(right)) {
                 result = std::make_shared<LoxFloat>(getFloat(left) * getFloat(right));
             } else {
-                result = std::make_shared<LoxInt>(getInt(left) * getInt(right));
+                result = LoxInt::of(getInt(left) * getInt(right));
             }
             break;
         }
         case TokenType::POWER: {
             checkNumberOps(expr->op_, left, right);
-            result = std::make_shared<LoxFloat>(pow(getFloat(left), getFloat(right)));
+            if (isFloat(left) || isFloat(right) || getInt(right) < 0) {
+                result = std::make_shared<LoxFloat>(pow(getFloat(left), getFloat(right)));
+            } else {
+                result = LoxInt::of(LoxMath::power(getInt(left), getInt(right)));
+            }
             break;
         }
         case TokenType::MOD: {
             checkNumberOps(expr->op_, left, right);
             if (isFloat(left) || isFloat(right)) {
                 auto val = getFloat(right);
-                if (val == 0) throw interpreter_error{expr->op_, "Remainder by 0 is undefined"};
+                if (val == 0) throw error(expr->op_, "Remainder by 0 is undefined");
                 result = std::make_shared<LoxFloat>(fmod(getFloat(left), getFloat(right)));
             } else {
                 auto val = getInt(right);
-                if (val == 0) throw interpreter_error{expr->op_, "Remainder by 0 is undefined"};
-                result = std::make_shared<LoxInt>(getInt(left) % getInt(right));
+                if (val == 0) throw error(expr->op_, "Remainder by 0 is undefined");
+                result = LoxInt::of(getInt(left) % getInt(right));
             }
             break;
         }
@@ -84,7 +259,7 @@ void Interpreter::visitBinaryExpr(BinaryExprPtr expr) {
                 if (isFloat(left) || isFloat(right)) {
                     result = std::make_shared<LoxFloat>(getFloat(left) + getFloat(right));
                 } else {
-                    result = std::make_shared<LoxInt>(getInt(left) + getInt(right));
+                    result = LoxInt::of(getInt(left) + getInt(right));
                 }
             } else {
                 // 字符串拼接
@@ -97,45 +272,45 @@ void Interpreter::visitBinaryExpr(BinaryExprPtr expr) {
         case TokenType::BIT_OR: {
             checkNumberOps(expr->op_, left, right);
             if (isFloat(left) || isFloat(right)) {
-                throw interpreter_error{expr->op_, "Wrong type argument to bit-complement"};
+                throw error(expr->op_, "Wrong type argument to bit-complement");
             } else {
-                result = std::make_shared<LoxInt>(getInt(left) | getInt(right));
+                result = LoxInt::of(getInt(left) | getInt(right));
             }
             break;
         }
         case TokenType::BIT_XOR: {
             checkNumberOps(expr->op_, left, right);
             if (isFloat(left) || isFloat(right)) {
-                throw interpreter_error{expr->op_, "Wrong type argument to bit-complement"};
+                throw error(expr->op_, "Wrong type argument to bit-complement");
             } else {
-                result = std::make_shared<LoxInt>(getInt(left) ^ getInt(right));
+                result = LoxInt::of(getInt(left) ^ getInt(right));
             }
             break;
         }
         case TokenType::BIT_AND: {
             checkNumberOps(expr->op_, left, right);
             if (isFloat(left) || isFloat(right)) {
-                throw interpreter_error{expr->op_, "Wrong type argument to bit-complement"};
+                throw error(expr->op_, "Wrong type argument to bit-complement");
             } else {
-                result = std::make_shared<LoxInt>(getInt(left) & getInt(right));
+                result = LoxInt::of(getInt(left) & getInt(right));
             }
             break;
         }
         case TokenType::SHIFT_L: {
             checkNumberOps(expr->op_, left, right);
             if (isFloat(left) || isFloat(right)) {
-                throw interpreter_error{expr->op_, "Wrong type argument to bit-complement"};
+                throw error(expr->op_, "Wrong type argument to bit-complement");
             } else {
-                result = std::make_shared<LoxInt>(getInt(left) << getInt(right));
+                result = LoxInt::of(getInt(left) << getInt(right));
             }
             break;
         }
         case TokenType::SHIFT_R: {
             checkNumberOps(expr->op_, left, right);
             if (isFloat(left) || isFloat(right)) {
-                throw interpreter_error{expr->op_, "Wrong type argument to bit-complement"};
+                throw error(expr->op_, "Wrong type argument to bit-complement");
             } else {
-                result = std::make_shared<LoxInt>(getInt(left) >> getInt(right));
+                result = LoxInt::of(getInt(left) >> getInt(right));
             }
             break;
         }
@@ -147,7 +322,7 @@ void Interpreter::visitBinaryExpr(BinaryExprPtr expr) {
             } else {
                 comp = getInt(left) > getInt(right);
             }
-            result = std::make_shared<LoxBool>(comp);
+            result = LoxBool::of(comp);
             break;
         }
         case TokenType::GREATER_EQUAL: {
@@ -158,7 +333,7 @@ void Interpreter::visitBinaryExpr(BinaryExprPtr expr) {
             } else {
                 comp = getInt(left) >= getInt(right);
             }
-            result = std::make_shared<LoxBool>(comp);
+            result = LoxBool::of(comp);
             break;
         }
         case TokenType::LESS: {
@@ -169,7 +344,7 @@ void Interpreter::visitBinaryExpr(BinaryExprPtr expr) {
             } else {
                 comp = getInt(left) < getInt(right);
             }
-            result = std::make_shared<LoxBool>(comp);
+            result = LoxBool::of(comp);
             break;
         }
         case TokenType::LESS_EQUAL: {
@@ -180,38 +355,56 @@ void Interpreter::visitBinaryExpr(BinaryExprPtr expr) {
             } else {
                 comp = getInt(left) <= getInt(right);
             }
-            result = std::make_shared<LoxBool>(comp);
+            result = LoxBool::of(comp);
             break;
         }
         case TokenType::NOT_EQUAL: {
-            result = std::make_shared<LoxBool>(!isEqual(left, right));
+            result = LoxBool::of(!isEqual(left, right));
             break;
         }
         case TokenType::EQUAL_EQUAL: {
-            result = std::make_shared<LoxBool>(isEqual(left, right));
+            result = LoxBool::of(isEqual(left, right));
+            break;
+        }
+        case TokenType::RANGE: {
+            if (!dynamic_cast<LoxInt *>(left.get()) or !dynamic_cast<LoxInt *>(right.get())) {
+                throw error(expr->op_, "Range bounds must be integers.");
+            }
+            result = std::make_shared<LoxRange>(getInt(left), getInt(right));
+            break;
+        }
+        case TokenType::IN: {
+            result = LoxBool::of(contains(expr->op_, right, left));
+            break;
+        }
+        case TokenType::NOTIN: {
+            result = LoxBool::of(!contains(expr->op_, right, left));
             break;
         }
-        case TokenType::IN:
-        case TokenType::NOTIN:
         case TokenType::IS:
         case TokenType::NOTIS: {
             // todo::
-            result = std::make_shared<LoxBool>(false);
+            result = LoxBool::of(false);
             break;
         }
         default:break;
     }
 }
 
-void Interpreter::visitGroupingExpr(GroupingExprPtr expr) {
+void Interpreter::visitGroupingExpr(GroupingExpr *expr) {
     result = evaluate(expr->expression_);
 }
 
-void Interpreter::visitLiteralExpr(LiteralExprPtr expr) {
-    result = expr->value_;
+// 字面量在每个解释器中各有一份副本，多个线程同时运行同一个程序时不会争用同一个对象的引用计数
+void Interpreter::visitLiteralExpr(LiteralExpr *expr) {
+    auto &literals = unit->literals;
+    if (expr->slot_ >= literals.size()) literals.resize(expr->slot_ + 1);
+    auto &value = literals[expr->slot_];
+    if (!value) value = copyValue(expr->value_);
+    result = value;
 }
 
-void Interpreter::visitStrExpr(StrExprPtr expr) {
+void Interpreter::visitStrExpr(StrExpr *expr) {
     string.str("");
     for (const auto &str: *expr->strs) {
         auto v = evaluate(str);
@@ -220,12 +413,12 @@ void Interpreter::visitStrExpr(StrExprPtr expr) {
     result = std::make_shared<LoxString>(string.str());
 }
 
-void Interpreter::visitUnaryExpr(UnaryExprPtr expr) {
+void Interpreter::visitUnaryExpr(UnaryExpr *expr) {
     auto right = evaluate(expr->right_);
 
-    switch (expr->op_->type) {
+    switch (tokens->type(expr->op_)) {
         case TokenType::NOT: {
-            result = std::make_shared<LoxBool>(!isTruth(right));
+            result = LoxBool::of(!isTruth(right));
             break;
         }
         case TokenType::MINUS: {
@@ -233,33 +426,33 @@ void Interpreter::visitUnaryExpr(UnaryExprPtr expr) {
             if (isFloat(right)) {
                 result = std::make_shared<LoxFloat>(-getFloat(right));
             } else {
-                result = std::make_shared<LoxInt>(-getInt(right));
+                result = LoxInt::of(-getInt(right));
             }
             break;
         }
         case TokenType::BIT_NOT: {
             checkNumberOp(expr->op_, right);
 
-            if (isFloat(right)) throw interpreter_error{expr->op_, "Wrong type argument to bit-complement"};
+            if (isFloat(right)) throw error(expr->op_, "Wrong type argument to bit-complement");
 
-            result = std::make_shared<LoxInt>(~getInt(right));
+            result = LoxInt::of(~getInt(right));
             break;
         }
         default:break;
     }
 }
 
-void Interpreter::visitVariableExpr(VariableExprPtr expr) {
-    result = lookupVariable(expr->name_, expr);
+void Interpreter::visitVariableExpr(VariableExpr *expr) {
+    result = lookupVariable(expr->name_, expr->depth_);
 }
 
-void Interpreter::visitLogicalExpr(LogicalExprPtr expr) {
+void Interpreter::visitLogicalExpr(LogicalExpr *expr) {
     auto left = evaluate(expr->left_);
-    if (expr->op_->type == TokenType::OR) {
+    if (tokens->type(expr->op_) == TokenType::OR) {
         if (isTruth(left)) {
             return;
         }
-    } else if (expr->op_->type == TokenType::AND) {
+    } else if (tokens->type(expr->op_) == TokenType::AND) {
         if (!isTruth(left)) {
             return;
         }
@@ -267,61 +460,346 @@ void Interpreter::visitLogicalExpr(LogicalExprPtr expr) {
     evaluate(expr->right_);
 }
 
-void Interpreter::visitCallExpr(CallExprPtr expr) {
-    auto callee = evaluate(expr->callee_);
-    std::vector<LoxValuePtr> args;
-    for (const auto &arg: *(expr->args_)) {
-        args.push_back(evaluate(arg));
+void Interpreter::visitCallExpr(CallExpr *expr) {
+    if (expr->intrinsic_ and callIntrinsic(expr)) return;
+
+    LoxValuePtr callee;
+    Arguments arguments{expr->args_->size()};
+    auto args = arguments.values;
+    auto evaluateArgs = [&] {
+        for (size_t i = 0; i < args.size(); ++i) {
+            args[i] = evaluate((*expr->args_)[i]);
+        }
+    };
+    if (auto get = dynamic_cast<GetExpr *>(expr->callee_.get())) {
+        auto object = evaluate(get->expr_);
+        // 列表、字典、集合的方法直接调用，不创建绑定的方法对象
+        auto callMethod = [&](auto &self) {
+            using T = std::remove_cvref_t<decltype(self)>;
+            auto method = T::findMethod(tokens->lexeme(get->name_));
+            if (!method) throw error(get->name_, std::format("Undefined {} method '{}'.", T::TYPE, tokens->lexeme(get->name_)));
+            if (args.size() != method->arity) {
+                throw error(expr->paren_, std::format("Expected {} arguments but got {}.", method->arity, args.size()));
+            }
+            evaluateArgs();
+            try {
+                if constexpr (std::is_same_v<T, LoxIterator>) result = method->call(*this, self, args);
+                else result = method->call(self, args);
+            } catch (native_error &e) {
+                throw error(expr->paren_, e.what());
+            }
+        };
+        if (auto list = dynamic_cast<LoxList *>(object.get())) return callMethod(*list);
+        if (auto map = dynamic_cast<LoxMap *>(object.get())) return callMethod(*map);
+        if (auto set = dynamic_cast<LoxSet *>(object.get())) return callMethod(*set);
+        if (auto vector = dynamic_cast<LoxVector *>(object.get())) return callMethod(*vector);
+        if (auto map = dynamic_cast<LoxHamt *>(object.get())) return callMethod(*map);
+        if (auto array = dynamic_cast<LoxArray *>(object.get())) return callMethod(*array);
+        if (auto iterator = dynamic_cast<LoxIterator *>(object.get())) return callMethod(*iterator);
+        // 范围和生成器直接使用迭代器的方法
+        if (dynamic_cast<LoxRange *>(object.get()) or dynamic_cast<LoxGenerator *>(object.get())) {
+            LoxIterator iterator{object};
+            return callMethod(iterator);
+        }
+        callee = getMember(object, get->name_);
+    } else {
+        callee = evaluate(expr->callee_);
     }
+    evaluateArgs();
     // 把 函数调用类型 转为 函数定义类型
-    if (auto function = CAST(LoxCallable, callee)) {
-        if (args.size() != function->arity()) {
-            throw interpreter_error{
-                    expr->paren_,
-                    std::format("Expected {} arguments but got {}.", function->arity(), args.size())
-            };
-        }
+    auto function = dynamic_cast<LoxCallable *>(callee.get());
+    if (!function) {
+        throw error(expr->paren_, "Can only call functions and classes.");
+    }
+    if (function->variadic() ? args.size() < function->arity() : args.size() != function->arity()) {
+        throw error(expr->paren_, std::format("Expected {}{} arguments but got {}.",
+                                              function->variadic() ? "at least " : "", function->arity(), args.size()));
+    }
+    try {
         result = function->call(*this, args);
-    } else {
-        throw interpreter_error{expr->paren_, "Can only call functions and classes."};
+    } catch (native_error &e) {
+        throw error(expr->paren_, e.what());
     }
 }
 
-void Interpreter::visitGetExpr(GetExprPtr expr) {
-    auto instance = evaluate(expr->expr_);
-    if (auto loxClass = CAST(LoxInstance, instance)) {
-        result = loxClass->get(expr->name_);
-        return;
+bool Interpreter::callIntrinsic(CallExpr *expr) {
+    // math 可能被同名的变量遮蔽，此时退回普通调用（求值一个变量没有副作用，可以重复）
+    auto object = evaluate(static_cast<GetExpr *>(expr->callee_.get())->expr_);
+    auto module = dynamic_cast<LoxModule *>(object.get());
+    if (!module or module->name() != LoxMath::MODULE) return false;
+
+    std::array<LoxValuePtr, LoxMath::MAX_ARITY> args;
+    for (size_t i = 0; i < expr->args_->size(); ++i) {
+        args[i] = evaluate((*expr->args_)[i]);
+    }
+    try {
+        result = LoxMath::call(expr->intrinsic_, *this, {args.data(), expr->args_->size()});
+    } catch (native_error &e) {
+        throw error(expr->paren_, e.what());
+    }
+    return true;
+}
+
+void Interpreter::visitGetExpr(GetExpr *expr) {
+    auto object = evaluate(expr->expr_);
+    result = getMember(object, expr->name_);
+}
+
+LoxValuePtr Interpreter::getMember(const LoxValuePtr &object, TokenId name) {
+    if (auto loxClass = CAST(LoxInstance, object)) {
+        return loxClass->get((*tokens)[name]);
     }
-    throw interpreter_error{expr->name_, "Only instances have properties."};
+    if (auto module = CAST(LoxModule, object)) {
+        return module->get(*this, (*tokens)[name]);
+    }
+    auto bindMethod = [&](const auto &self) {
+        using T = typename std::remove_cvref_t<decltype(self)>::element_type;
+        auto method = T::findMethod(tokens->lexeme(name));
+        if (!method) throw error(name, std::format("Undefined {} method '{}'.", T::TYPE, tokens->lexeme(name)));
+        return T::bind(self, *method);
+    };
+    if (auto list = CAST(LoxList, object)) return bindMethod(list);
+    if (auto map = CAST(LoxMap, object)) return bindMethod(map);
+    if (auto set = CAST(LoxSet, object)) return bindMethod(set);
+    if (auto vector = CAST(LoxVector, object)) return bindMethod(vector);
+    if (auto map = CAST(LoxHamt, object)) return bindMethod(map);
+    if (auto array = CAST(LoxArray, object)) return bindMethod(array);
+    if (auto iterator = CAST(LoxIterator, object)) return bindMethod(iterator);
+    if (CAST(LoxRange, object) or CAST(LoxGenerator, object)) return bindMethod(std::make_shared<LoxIterator>(object));
+    throw error(name, "Only instances have properties.");
 }
 
-void Interpreter::visitSetExpr(SetExprPtr expr) {
+void Interpreter::visitSetExpr(SetExpr *expr) {
     auto instance = evaluate(expr->expr_);
     auto loxClass = CAST(LoxInstance, instance);
     if (!loxClass) {
-        throw interpreter_error{expr->name_, "Only instances have fields."};
+        throw error(expr->name_, "Only instances have fields.");
     }
     std::shared_ptr<LoxValue> value = evaluate(expr->value_);
-    loxClass->set(expr->name_, value);
+    loxClass->set((*tokens)[expr->name_], value);
+}
+
+void Interpreter::visitListExpr(ListExpr *expr) {
+    auto &elements = *expr->elements_;
+    Arguments values{elements.size()};
+    for (size_t i = 0; i < elements.size(); ++i) {
+        values.values[i] = evaluate(elements[i]);
+    }
+    std::shared_ptr<LoxList> list;
+    if (expr->elementType_) {
+        auto type = elementTypeOf(tokens->lexeme(expr->elementType_->name_));
+        list = std::make_shared<LoxList>(type.value_or(ElementType::ANY), true);
+    } else {
+        list = std::make_shared<LoxList>(commonElementType(values.values), false);
+    }
+    list->reserve(elements.size());
+    for (const auto &value: values.values) {
+        if (!list->append(value)) throw error(expr->bracket_, "Cannot store this value in a " + list->typeName() + ".");
+    }
+    result = list;
+}
+
+void Interpreter::visitMapExpr(MapExpr *expr) {
+    auto count = expr->keys_->size();
+    Arguments keys{count}, values{count};
+    for (size_t i = 0; i < count; ++i) {
+        keys.values[i] = evaluate((*expr->keys_)[i]);
+        values.values[i] = evaluate((*expr->values_)[i]);
+    }
+    std::shared_ptr<LoxMap> map;
+    if (expr->valueType_) {
+        auto type = elementTypeOf(tokens->lexeme(expr->valueType_->name_));
+        map = std::make_shared<LoxMap>(type.value_or(ElementType::ANY), true);
+    } else {
+        map = std::make_shared<LoxMap>(commonElementType(values.values), false);
+    }
+    map->reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto key = CAST(LoxString, keys.values[i]);
+        if (!key) throw error(expr->brace_, "Map keys must be strings.");
+        if (!map->set(key, values.values[i])) throw error(expr->brace_, "Cannot store this value in a " + map->typeName() + ".");
+    }
+    result = map;
+}
+
+void Interpreter::visitSetLiteralExpr(SetLiteralExpr *expr) {
+    auto &elements = *expr->elements_;
+    Arguments values{elements.size()};
+    for (size_t i = 0; i < elements.size(); ++i) {
+        values.values[i] = evaluate(elements[i]);
+    }
+    auto type = expr->elementType_ ? elementTypeOf(tokens->lexeme(expr->elementType_->name_)).value_or(ElementType::ANY)
+                                   : commonElementType(values.values);
+    if (!LoxSet::supports(type)) throw error(expr->brace_, "A set can only hold int, float or str.");
+    auto set = std::make_shared<LoxSet>(type);
+    set->reserve(elements.size());
+    for (const auto &value: values.values) {
+        if (!set->insert(value)) throw error(expr->brace_, "Cannot add this value to a " + set->typeName() + ".");
+    }
+    result = set;
 }
 
-void Interpreter::visitThisExpr(ThisExprPtr expr) {
-    result = lookupVariable(expr->keyword_, expr);
+// x in c：集合和字典按原始值查找，列表逐个比较，字符串查找子串，范围比较两端
+bool Interpreter::contains(TokenId op, const LoxValuePtr &container, const LoxValuePtr &value) {
+    if (auto set = dynamic_cast<LoxSet *>(container.get())) return set->contains(value.get());
+    if (auto range = dynamic_cast<LoxRange *>(container.get())) return range->contains(value.get());
+    if (auto map = dynamic_cast<LoxMap *>(container.get())) {
+        auto key = dynamic_cast<LoxString *>(value.get());
+        return key and map->contains(*key);
+    }
+    if (auto list = dynamic_cast<LoxList *>(container.get())) {
+        for (size_t i = 0; i < list->size(); ++i) {
+            if (isEqual(list->get(i), value)) return true;
+        }
+        return false;
+    }
+    if (auto map = dynamic_cast<LoxHamt *>(container.get())) {
+        auto key = dynamic_cast<LoxString *>(value.get());
+        return key and map->get(*key);
+    }
+    if (auto vector = dynamic_cast<LoxVector *>(container.get())) {
+        return !vector->items().forEach([&](const LoxValuePtr &item) { return !isEqual(item, value); });
+    }
+    if (auto string = dynamic_cast<LoxString *>(container.get())) {
+        auto part = dynamic_cast<LoxString *>(value.get());
+        if (!part) throw error(op, "Only a string can be searched in a string.");
+        return string->value_.find(part->value_) != std::string::npos;
+    }
+    throw error(op, "Right operand of 'in' must be a set, map, list, range or string.");
 }
 
-void Interpreter::visitSuperExpr(SuperExprPtr expr) {
-    int distance = locals.at(expr);
+void Interpreter::visitIndexExpr(IndexExpr *expr) {
+    auto object = evaluate(expr->object_);
+    auto index = evaluate(expr->index_);
+    if (auto list = dynamic_cast<LoxList *>(object.get())) {
+        result = list->get(checkIndex(expr->bracket_, LoxList::TYPE, list->size(), index));
+        return;
+    }
+    // 字符串按字节索引，结果是缓存的单字符字符串
+    if (auto string = dynamic_cast<LoxString *>(object.get())) {
+        result = LoxString::of(string->value_[checkIndex(expr->bracket_, "str", string->value_.size(), index)]);
+        return;
+    }
+    if (auto map = dynamic_cast<LoxMap *>(object.get())) {
+        auto key = dynamic_cast<LoxString *>(index.get());
+        if (!key) throw error(expr->bracket_, "Map keys must be strings.");
+        result = map->get(*key);
+        if (!result) throw error(expr->bracket_, std::format("Undefined key '{}'.", key->value_));
+        return;
+    }
+    if (auto vector = dynamic_cast<LoxVector *>(object.get())) {
+        result = vector->get(checkIndex(expr->bracket_, LoxList::TYPE, vector->size(), index));
+        return;
+    }
+    if (auto map = dynamic_cast<LoxHamt *>(object.get())) {
+        auto key = dynamic_cast<LoxString *>(index.get());
+        if (!key) throw error(expr->bracket_, "Map keys must be strings.");
+        result = map->get(*key);
+        if (!result) throw error(expr->bracket_, std::format("Undefined key '{}'.", key->value_));
+        return;
+    }
+    if (auto array = dynamic_cast<LoxArray *>(object.get())) {
+        result = array->get(checkIndex(expr->bracket_, LoxArray::TYPE, array->size(), index));
+        return;
+    }
+    throw error(expr->bracket_, "Only lists, maps, arrays and strings can be indexed.");
+}
+
+void Interpreter::visitIndexSetExpr(IndexSetExpr *expr) {
+    auto object = evaluate(expr->object_);
+    auto index = evaluate(expr->index_);
+    if (auto list = dynamic_cast<LoxList *>(object.get())) {
+        auto i = checkIndex(expr->bracket_, LoxList::TYPE, list->size(), index);
+        auto value = evaluate(expr->value_);
+        if (!list->set(i, value)) throw error(expr->bracket_, "Cannot store this value in a " + list->typeName() + ".");
+        return;
+    }
+    if (auto map = dynamic_cast<LoxMap *>(object.get())) {
+        auto key = CAST(LoxString, index);
+        if (!key) throw error(expr->bracket_, "Map keys must be strings.");
+        auto value = evaluate(expr->value_);
+        if (!map->set(key, value)) throw error(expr->bracket_, "Cannot store this value in a " + map->typeName() + ".");
+        return;
+    }
+    if (auto array = dynamic_cast<LoxArray *>(object.get())) {
+        auto i = checkIndex(expr->bracket_, LoxArray::TYPE, array->size(), index);
+        auto value = evaluate(expr->value_);
+        if (!array->set(i, value)) throw error(expr->bracket_, "Cannot store this value in an " + array->typeName() + ".");
+        return;
+    }
+    if (dynamic_cast<LoxVector *>(object.get())) {
+        throw error(expr->bracket_, "Cannot modify an immutable list, use set() to get a modified copy.");
+    }
+    if (dynamic_cast<LoxHamt *>(object.get())) {
+        throw error(expr->bracket_, "Cannot modify an immutable map, use put() to get a modified copy.");
+    }
+    throw error(expr->bracket_, "Only lists, maps and arrays can be indexed.");
+}
+
+size_t Interpreter::checkIndex(TokenId bracket, std::string_view type, size_t size, const LoxValuePtr &index) const {
+    auto integer = dynamic_cast<LoxInt *>(index.get());
+    if (!integer) throw error(bracket, "Index must be an int.");
+    if (integer->value_ < 0 or (size_t) integer->value_ >= size) {
+        auto article = type.front() == 'a' ? "an" : "a";
+        throw error(bracket, std::format("Index {} out of range for {} {} of size {}.", integer->value_, article, type, size));
+    }
+    return (size_t) integer->value_;
+}
+
+std::pair<size_t, size_t> Interpreter::checkSlice(TokenId bracket, size_t size, const LoxValuePtr &begin,
+                                                  const LoxValuePtr &end) const {
+    auto bound = [&](const LoxValuePtr &value, size_t omitted) -> int64_t {
+        if (!value) return (int64_t) omitted;
+        auto integer = dynamic_cast<LoxInt *>(value.get());
+        if (!integer) throw error(bracket, "Slice bounds must be ints.");
+        return integer->value_;
+    };
+    auto first = bound(begin, 0), last = bound(end, size);
+    if (first < 0 or first > last or (size_t) last > size) {
+        throw error(bracket, std::format("Slice [{}:{}] out of range for size {}.", first, last, size));
+    }
+    return {(size_t) first, (size_t) last};
+}
+
+void Interpreter::visitSliceExpr(SliceExpr *expr) {
+    auto object = evaluate(expr->object_);
+    auto begin = expr->begin_ ? evaluate(expr->begin_) : nullptr;
+    auto end = expr->end_ ? evaluate(expr->end_) : nullptr;
+    // 切片与原值共享内容，不复制
+    if (auto list = dynamic_cast<LoxList *>(object.get())) {
+        auto [first, last] = checkSlice(expr->bracket_, list->size(), begin, end);
+        result = list->slice(first, last);
+        return;
+    }
+    if (auto vector = dynamic_cast<LoxVector *>(object.get())) {
+        auto [first, last] = checkSlice(expr->bracket_, vector->size(), begin, end);
+        result = vector->slice(first, last);
+        return;
+    }
+    if (auto string = CAST(LoxString, object)) {
+        auto [first, last] = checkSlice(expr->bracket_, string->value_.size(), begin, end);
+        result = LoxString::slice(string, first, last);
+        return;
+    }
+    throw error(expr->bracket_, "Only lists and strings can be sliced.");
+}
+
+void Interpreter::visitThisExpr(ThisExpr *expr) {
+    result = lookupVariable(expr->keyword_, expr->depth_);
+}
+
+void Interpreter::visitSuperExpr(SuperExpr *expr) {
+    int distance = expr->depth_;
     auto super_ = CAST(LoxClass, env->getAt(distance, "super"));
     auto instance = CAST(LoxInstance, env->getAt(distance - 1, "this"));
-    auto method = super_->findMethod(expr->method_->lexeme);
+    auto method = super_->findMethod(tokens->lexeme(expr->method_));
     if (!method) {
-        throw interpreter_error{expr->method_, "Undefined property '" + expr->method_->lexeme + "'."};
+        throw error(expr->method_, "Undefined property '" + std::string{tokens->lexeme(expr->method_)} + "'.");
     }
     result = method->bind(instance);
 }
 
-void Interpreter::visitIfStmt(IfStmtPtr stmt) {
+void Interpreter::visitIfStmt(IfStmt *stmt) {
     if (isTruth(evaluate(stmt->condition_))) {
         execute(stmt->thenStmt_);
     } else if (stmt->elseStmt_) {
@@ -329,7 +807,7 @@ void Interpreter::visitIfStmt(IfStmtPtr stmt) {
     }
 }
 
-void Interpreter::visitWhileStmt(WhileStmtPtr stmt) {
+void Interpreter::visitWhileStmt(WhileStmt *stmt) {
     while (isTruth(evaluate(stmt->condition_))) {
         try {
             execute(stmt->statements_);
@@ -341,20 +819,44 @@ void Interpreter::visitWhileStmt(WhileStmtPtr stmt) {
     }
 }
 
-void Interpreter::visitContinueStmt(ContinueStmtPtr stmt) {
+void Interpreter::visitContinueStmt(ContinueStmt *) {
     throw continue_loop{};
 }
 
-void Interpreter::visitBreakStmt(BreakStmtPtr stmt) {
+void Interpreter::visitBreakStmt(BreakStmt *) {
     throw break_loop{};
 }
 
-void Interpreter::visitForStmt(ForStmtPtr stmt) {
-    // todo:123
+void Interpreter::visitForStmt(ForStmt *stmt) {
+    auto iterable = evaluate(stmt->iterable_);
+
+    // 每次迭代使用新的环境，循环体中创建的闭包各自捕获当次的循环变量
+    auto previousEnv = env;
+    EnvGuard envGuard{env, previousEnv};
 
+    auto name = tokens->lexeme(stmt->variable_);
+    // 执行一次循环体，break 时返回 false
+    auto iterate = [&](LoxValuePtr value) {
+        env = std::make_shared<Environment>(previousEnv);
+        env->define(name, std::move(value));
+        try {
+            execute(stmt->body_);
+        } catch (continue_loop &_) {
+        } catch (break_loop &_) {
+            return false;
+        }
+        return true;
+    };
+    try {
+        if (!forEach(*this, iterable, iterate)) {
+            throw error(stmt->variable_, "Can only iterate over strings, lists, maps, sets, ranges, arrays, iterators and generators.");
+        }
+    } catch (native_error &e) {
+        throw error(stmt->variable_, e.what());
+    }
 }
 
-void Interpreter::visitWhenStmt(WhenStmtPtr stmt) {
+void Interpreter::visitWhenStmt(WhenStmt *stmt) {
     // when的所有分支
     for (const auto &conds_block: *stmt->branches) {
         // 判断该分支是否所有条件都为真
@@ -370,76 +872,125 @@ void Interpreter::visitWhenStmt(WhenStmtPtr stmt) {
     execute(stmt->else_);  // 任何分支都不为真则执行else语句
 }
 
-void Interpreter::visitBlockStmt(BlockStmtPtr stmt) {
+void Interpreter::visitBlockStmt(BlockStmt *stmt) {
     executeBlock(stmt->statements_, std::make_shared<Environment>(env));
 }
 
-void Interpreter::visitExpressionStmt(ExpressionStmtPtr stmt) {
+void Interpreter::visitExpressionStmt(ExpressionStmt *stmt) {
     evaluate(stmt->expression_);
 }
 
-void Interpreter::visitLetStmt(LetStmtPtr stmt) {
-    LoxValuePtr initVal = evaluate(stmt->initializer_);
-    env->define(stmt->name_->lexeme, initVal);
+void Interpreter::visitLetStmt(LetStmt *stmt) {
+    LoxValuePtr initVal = freeze(evaluate(stmt->initializer_));
+    env->define(tokens->lexeme(stmt->name_), initVal, true);
 }
 
-void Interpreter::visitVarStmt(VarStmtPtr stmt) {
+void Interpreter::visitVarStmt(VarStmt *stmt) {
     LoxValuePtr initVal;
     if (stmt->initializer_) {
         initVal = evaluate(stmt->initializer_);
     } else {
-        initVal = std::make_shared<LoxNil>();
+        initVal = emptyValue(*tokens, stmt->type_);
     }
 
-    env->define(stmt->name_->lexeme, initVal);
+    env->define(tokens->lexeme(stmt->name_), initVal);
 }
 
-void Interpreter::visitFunctionStmt(FunctionStmtPtr stmt) {
-    auto funcDef = std::make_shared<LoxFunction>(stmt, env, false);
+void Interpreter::visitFunctionStmt(FunctionStmt *stmt) {
+    auto funcDef = std::make_shared<LoxFunction>(stmt, env, unit, false);
     // 在当前作用域用函数名声明一个函数
-    env->define(stmt->name_->lexeme, funcDef);
+    env->define(tokens->lexeme(stmt->name_), funcDef);
 }
 
-void Interpreter::visitReturnStmt(ReturnStmtPtr stmt) {
+void Interpreter::visitReturnStmt(ReturnStmt *stmt) {
     LoxValuePtr retValue;
     if (stmt->value_) {
         retValue = evaluate(stmt->value_);
     } else {
-        retValue = std::make_shared<LoxNil>();
+        retValue = LoxNil::instance();
     }
     throw return_value{retValue};
 }
 
-void Interpreter::visitClassStmt(ClassStmtPtr stmt) {
+void Interpreter::visitYieldStmt(YieldStmt *stmt) {
+    auto value = stmt->value_ ? evaluate(stmt->value_) : LoxNil::instance();
+    auto generator = dynamic_cast<LoxGenerator *>(coroutine);
+    if (!generator) throw error(stmt->keyword_, "Can't yield outside a generator.");
+    generator->yield(std::move(value));
+}
+
+/* 在任务中 await 未完成的 future 时暂停任务，事件循环转而执行其它任务；
+ * 在顶层代码中直接运行事件循环，直到 future 完成
+ * */
+void Interpreter::visitAwaitExpr(AwaitExpr *expr) {
+    auto future = std::dynamic_pointer_cast<LoxFuture>(evaluate(expr->value_));
+    if (!future) throw error(expr->keyword_, "Can only await a future.");
+    if (!future->done()) {
+        if (auto task = dynamic_cast<Task *>(coroutine)) {
+            task->await(future);
+        } else if (loop and loop->running()) {
+            throw error(expr->keyword_, "Can't await here while the event loop is running.");
+        } else if (!eventLoop().runUntil([&] { return future->done(); })) {
+            throw error(expr->keyword_, "The awaited future can never complete.");
+        }
+    }
+    try {
+        result = future->get();
+    } catch (native_error &e) {
+        throw error(expr->keyword_, e.what());
+    }
+}
+
+void Interpreter::visitClassStmt(ClassStmt *stmt) {
     LoxValuePtr superClass = nullptr;
     std::shared_ptr<LoxClass> boolClass = nullptr;
     if (stmt->superClass_) {
         superClass = evaluate(stmt->superClass_);
         boolClass = std::dynamic_pointer_cast<LoxClass>(superClass);
         if (!boolClass) {
-            throw interpreter_error{stmt->superClass_->name_, "Superclass must be a class."};
+            throw error(stmt->superClass_->name_, "Superclass must be a class.");
         }
     }
-    env->define(stmt->name_->lexeme, nullptr);
+    env->define(tokens->lexeme(stmt->name_), nullptr);
 
     if (stmt->superClass_) {
         env = std::make_shared<Environment>(env);
         env->define("super", superClass);
     }
 
-    std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods;
+    StringMap<std::shared_ptr<LoxFunction>> methods;
     for (const auto &method: *stmt->methods_) {
-        auto function =
-                std::make_shared<LoxFunction>(method, env, method->name_->lexeme == "init");
-        methods.insert_or_assign(method->name_->lexeme, function);
+        auto methodName = tokens->lexeme(method->name_);
+        auto function = std::make_shared<LoxFunction>(method.get(), env, unit, methodName == "init");
+        methods.insert_or_assign(std::string{methodName}, function);
     }
-    auto loxClass = std::make_shared<LoxClass>(stmt->name_->lexeme, boolClass, methods);
+    auto loxClass = std::make_shared<LoxClass>(std::string{tokens->lexeme(stmt->name_)}, boolClass, methods);
 
     if (stmt->superClass_) {
         env = env->parentEnv;
     }
 
-    env->assign(stmt->name_, loxClass);
+    env->assign((*tokens)[stmt->name_], loxClass);
+}
+
+// 只绑定模块名，模块在首次访问成员时才加载并初始化
+void Interpreter::visitImportStmt(ImportStmt *stmt) {
+    std::string name;
+    for (auto part: *stmt->path_) {
+        if (not name.empty()) name += '.';
+        name += tokens->lexeme(part);
+    }
+    auto it = modules.find(name);
+    if (it == modules.end()) it = modules.emplace(name, std::make_shared<LoxModule>(name)).first;
+    env->define(tokens->lexeme(stmt->path_->back()), it->second);
+}
+
+LoxValuePtr Interpreter::copyValue(const LoxValuePtr &value) {
+    if (auto integer = CAST(LoxInt, value)) return LoxInt::of(integer->value_);
+    if (auto floating = CAST(LoxFloat, value)) return std::make_shared<LoxFloat>(floating->value_);
+    if (auto string = CAST(LoxString, value)) return std::make_shared<LoxString>(std::string{string->value_});
+    if (auto boolean = CAST(LoxBool, value)) return LoxBool::of(boolean->value_);
+    return LoxNil::instance();
 }
 
 bool Interpreter::isTruth(const LoxValuePtr &value) {
@@ -526,14 +1077,14 @@ double Interpreter::getFloat(const LoxValuePtr &value) {
     return CAST(LoxInt, value)->value_;
 }
 
-void Interpreter::checkNumberOp(TokenPtr op, const LoxValuePtr &value) {
+void Interpreter::checkNumberOp(TokenId op, const LoxValuePtr &value) const {
     if (isNum(value)) return;
-    throw interpreter_error{std::move(op), "Operand must be a number."};
+    throw error(op, "Operand must be a number.");
 }
 
-void Interpreter::checkNumberOps(TokenPtr op, const LoxValuePtr &left, const LoxValuePtr &right) {
+void Interpreter::checkNumberOps(TokenId op, const LoxValuePtr &left, const LoxValuePtr &right) const {
     if (isNum(left) && isNum(right)) return;
-    throw interpreter_error{std::move(op), "Operands must be numbers."};
+    throw error(op, "Operands must be numbers.");
 }
 
 LoxValuePtr Interpreter::evaluate(const ExprPtr &expr) {
@@ -557,26 +1108,54 @@ void Interpreter::executeBlock(const std::shared_ptr<std::vector<StmtPtr>> &stat
     }
 }
 
-LoxValuePtr Interpreter::lookupVariable(const TokenPtr &name, const ExprPtr &expr) {
-    auto it = locals.find(expr);
-
-    if (it != locals.end()) {
-        return env->getAt(it->second, name->lexeme);
+LoxValuePtr Interpreter::lookupVariable(TokenId name, int depth) {
+    if (depth >= 0) {
+        return env->getAt(depth, tokens->lexeme(name));
     } else {
-        return global->get(name);
+        return global->get((*tokens)[name]);
     }
 }
 
-void Interpreter::resolve(const ExprPtr &expr, int depth) {
-    locals.insert_or_assign(expr, depth);
+EventLoop &Interpreter::eventLoop() {
+    if (!loop) loop = std::make_unique<EventLoop>();
+    return *loop;
 }
 
-void Interpreter::interpret(const std::vector<StmtPtr> &statements) {
+void Interpreter::awaitTasks() {
+    if (!loop) return;
+    loop->runUntil([] { return false; });
+    auto pending = std::exchange(failed, {});
+    for (const auto &future: pending) {
+        if (!future->observed()) future->get();
+    }
+}
+
+// 首次调用延迟解析的函数时，解析并分析其函数体
+void Interpreter::loadBody(FunctionStmt *function) {
+    auto lazy = function->lazy_;
+    Parser parser{*lazy->tokens, true, err};
+    auto body = parser.parseBody(lazy->begin);
+    if (!body) throw error(function->name_, "Invalid function body.");
+
+    function->body_ = body;
+    Resolver resolver{*lazy->tokens, err};
+    if (!resolver.resolveBody(function)) {
+        function->body_ = nullptr;
+        throw error(function->name_, "Invalid function body.");
+    }
+    function->lazy_ = nullptr;
+}
+
+bool Interpreter::interpret(const std::vector<StmtPtr> &statements, const TokenBuffer &program) {
+    UnitGuard unitGuard{*this, std::make_shared<Unit>(Unit{&program, global, {}})};
     try {
         for (const auto &statement: statements) {
             execute(statement);
         }
+        awaitTasks();
     } catch (interpreter_error &error) {
-        std::cerr << "Line [" << error.token_->line << "]: " << error.what() << std::endl;
+        err << "Line [" << error.token_.line << "]: " << error.what() << std::endl;
+        return false;
     }
+    return true;
 }
\ No newline at end of file
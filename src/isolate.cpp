@@ -0,0 +1,81 @@
+#include "isolate.hpp"
+#include "interpreter.hpp"
+#include "lox_async.hpp"
+#include "lox_function.hpp"
+#include "native.hpp"
+
+std::shared_ptr<const Program> Program::compile(SourcePtr source, CompileOptions options, std::ostream &err) {
+    // 延迟解析会在运行时修改语法树
+    options.lazyParse = false;
+    auto compiled = ::compile(*source, options, err);
+    if (!compiled) return nullptr;
+
+    auto program = std::make_shared<Program>();
+    program->source_ = std::move(source);
+    program->program_ = std::move(compiled);
+    return program;
+}
+
+Context::Context(std::ostream &out, std::ostream &err)
+        : out_{out}, err_{err}, mailbox_{std::make_shared<Mailbox>()} {}
+
+Context::~Context() = default;
+
+bool Context::run(const Program &program, std::vector<std::string> arguments) {
+    interpreter_ = std::make_unique<Interpreter>(out_, err_);
+    interpreter_->arguments = std::move(arguments);
+    interpreter_->mailbox = mailbox_;
+    for (const auto &[name, native]: natives_) interpreter_->global->define(name, native);
+    const auto &compiled = program.compiled();
+    return interpreter_->interpret(compiled.statements, compiled.tokens);
+}
+
+LoxValuePtr Context::global(std::string_view name) const {
+    if (!interpreter_) return nullptr;
+    return interpreter_->global->lookup(name);
+}
+
+void Context::define(std::string name, size_t arity, Native function) {
+    define(std::make_shared<NativeFunction>(std::move(name), arity, std::move(function)));
+}
+
+void Context::define(std::shared_ptr<NativeCallable> native) {
+    if (interpreter_) interpreter_->global->define(native->name_, native);
+    natives_.emplace_back(native->name_, std::move(native));
+}
+
+LoxValuePtr Context::call(std::string_view name, std::span<LoxValuePtr> args) {
+    auto function = std::dynamic_pointer_cast<LoxCallable>(global(name));
+    if (!function) {
+        err_ << "Undefined function '" << name << "'." << std::endl;
+        return nullptr;
+    }
+    if (function->variadic() ? args.size() < function->arity() : args.size() != function->arity()) {
+        err_ << "Function '" << name << "' expected " << (function->variadic() ? "at least " : "")
+             << function->arity() << " arguments but got " << args.size() << "." << std::endl;
+        return nullptr;
+    }
+    try {
+        auto result = function->call(*interpreter_, args);
+        auto future = std::dynamic_pointer_cast<LoxFuture>(result);
+        if (!future) return result;
+        if (!interpreter_->eventLoop().runUntil([&] { return future->done(); })) {
+            err_ << "The future returned by '" << name << "' can never complete." << std::endl;
+            return nullptr;
+        }
+        return future->get();
+    } catch (interpreter_error &error) {
+        err_ << "Line [" << error.token_.line << "]: " << error.what() << std::endl;
+        return nullptr;
+    } catch (native_error &error) {
+        err_ << error.what() << std::endl;
+        return nullptr;
+    } catch (std::exception &error) {
+        // 宿主函数抛出的其它异常（如内存不足）也不越过嵌入的边界
+        err_ << "Internal error: " << error.what() << std::endl;
+        return nullptr;
+    } catch (...) {
+        err_ << "Internal error." << std::endl;
+        return nullptr;
+    }
+}
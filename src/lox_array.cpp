@@ -0,0 +1,465 @@
+#include "lox_array.hpp"
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <type_traits>
+
+#include "environment.hpp"
+#include "lox_list.hpp"
+#include "lox_vector.hpp"
+#include "native.hpp"
+
+namespace {
+    enum class BinaryOp : uint8_t {
+        ADD, SUB, MUL, DIV
+    };
+
+    enum class CompareOp : uint8_t {
+        LT, LE, GT, GE, EQ, NE
+    };
+
+    // 一种元素类型的计算函数，每个指令集各有一份
+    template<typename T>
+    struct Kernels {
+        void (*binary)(BinaryOp op, const T *a, const T *b, T *out, size_t n);
+        void (*binaryScalar)(BinaryOp op, const T *a, T b, T *out, size_t n);
+        // scalar 为真时 b 指向一个数
+        void (*compare)(CompareOp op, const T *a, const T *b, bool scalar, uint8_t *out, size_t n);
+        T (*sum)(const T *a, size_t n);
+        T (*dot)(const T *a, const T *b, size_t n);
+        T (*extreme)(bool max, const T *a, size_t n);
+    };
+
+    // 默认目标：x86-64 上为 SSE2，每个向量 16 字节
+    namespace generic {
+#define ARRAY_TARGET
+#define ARRAY_VECTOR_BYTES 16
+#include "lox_array_kernels.inc"
+#undef ARRAY_VECTOR_BYTES
+#undef ARRAY_TARGET
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+#define IDUN_ARRAY_AVX2
+    namespace avx2 {
+#define ARRAY_TARGET __attribute__((target("avx2")))
+#define ARRAY_VECTOR_BYTES 32
+#include "lox_array_kernels.inc"
+#undef ARRAY_VECTOR_BYTES
+#undef ARRAY_TARGET
+    }
+#endif
+
+    bool useAvx2() {
+#ifdef IDUN_ARRAY_AVX2
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    template<typename T>
+    const Kernels<T> &kernelsFor() {
+#ifdef IDUN_ARRAY_AVX2
+        if (useAvx2()) return avx2::kernels<T>;
+#endif
+        return generic::kernels<T>;
+    }
+
+    constexpr std::array<std::string_view, 4> typeNames{"f64", "i64", "f32", "mask"};
+
+    template<typename T>
+    constexpr bool isNumber = !std::is_same_v<T, uint8_t>;
+
+    // 值转为元素类型，类型不符时返回空；float 不能存入 i64 的数组
+    template<typename T>
+    std::optional<T> element(const LoxValue *value) {
+        if constexpr (std::is_same_v<T, uint8_t>) {
+            if (auto boolean = dynamic_cast<const LoxBool *>(value)) return (uint8_t) boolean->value_;
+        } else {
+            if (auto integer = dynamic_cast<const LoxInt *>(value)) return (T) integer->value_;
+            if constexpr (std::is_floating_point_v<T>) {
+                if (auto floating = dynamic_cast<const LoxFloat *>(value)) return (T) floating->value_;
+            }
+        }
+        return std::nullopt;
+    }
+
+    template<typename T>
+    LoxValuePtr boxElement(T value) {
+        if constexpr (std::is_same_v<T, uint8_t>) return LoxBool::of(value);
+        else return native::box(value);
+    }
+
+    // 运算的另一方为数组时检查类型和长度并返回其元素，为数时返回空指针
+    template<typename T>
+    const T *operandArray(const LoxArray &self, const LoxValuePtr &other) {
+        auto array = dynamic_cast<const LoxArray *>(other.get());
+        if (!array) return nullptr;
+        if (array->type() != self.type()) {
+            throw native_error{std::format("Expected an {} but got an {}.", self.typeName(), array->typeName())};
+        }
+        if (array->size() != self.size()) {
+            throw native_error{std::format("Array sizes differ: {} and {}.", self.size(), array->size())};
+        }
+        return array->items<T>().data();
+    }
+
+    template<typename T>
+    T operandScalar(const LoxArray &self, const LoxValuePtr &other) {
+        auto value = element<T>(other.get());
+        if (!value) {
+            throw native_error{std::format("Expected an {} or {}.", self.typeName(),
+                                           std::is_same_v<T, int64_t> ? "an int" : "a number")};
+        }
+        return *value;
+    }
+
+    // 没有整数除法的向量指令，逐个计算
+    void divide(const int64_t *a, const int64_t *b, int64_t scalar, int64_t *out, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            auto divisor = b ? b[i] : scalar;
+            if (divisor == 0) throw native_error{"Division by 0"};
+            // 最小的 int 除以 -1 溢出，与其它运算一样回绕
+            out[i] = divisor == -1 ? (int64_t) (0 - (uint64_t) a[i]) : a[i] / divisor;
+        }
+    }
+
+    LoxValuePtr arithmetic(LoxArray &self, BinaryOp op, const LoxValuePtr &other) {
+        auto result = std::make_shared<LoxArray>(self.type(), self.size());
+        self.visit([&](const auto &items) {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            if constexpr (!isNumber<T>) {
+                throw native_error{"Cannot do arithmetic on a mask."};
+            } else {
+                auto b = operandArray<T>(self, other);
+                T scalar = b ? T{} : operandScalar<T>(self, other);
+                auto out = result->items<T>().data();
+                if constexpr (std::is_same_v<T, int64_t>) {
+                    if (op == BinaryOp::DIV) return divide(items.data(), b, scalar, out, items.size());
+                }
+                // i64 的加、减、乘在计算函数中按无符号数计算，溢出时回绕
+                if (b) kernelsFor<T>().binary(op, items.data(), b, out, items.size());
+                else kernelsFor<T>().binaryScalar(op, items.data(), scalar, out, items.size());
+            }
+        });
+        return result;
+    }
+
+    LoxValuePtr compare(LoxArray &self, CompareOp op, const LoxValuePtr &other) {
+        auto result = std::make_shared<LoxArray>(ArrayType::MASK, self.size());
+        self.visit([&](const auto &items) {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            if constexpr (!isNumber<T>) {
+                throw native_error{"Cannot compare a mask."};
+            } else {
+                auto b = operandArray<T>(self, other);
+                T scalar = b ? T{} : operandScalar<T>(self, other);
+                kernelsFor<T>().compare(op, items.data(), b ? b : &scalar, !b, result->items<uint8_t>().data(), items.size());
+            }
+        });
+        return result;
+    }
+
+    // i64 按无符号数相加，溢出时回绕；mask 为 1 的个数
+    LoxValuePtr sum(LoxArray &self) {
+        return self.visit([](const auto &items) -> LoxValuePtr {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            if constexpr (!isNumber<T>) {
+                return LoxInt::of((int64_t) std::count(items.begin(), items.end(), 1));
+            } else {
+                return native::box(kernelsFor<T>().sum(items.data(), items.size()));
+            }
+        });
+    }
+
+    LoxValuePtr extreme(LoxArray &self, bool max) {
+        if (self.size() == 0) throw native_error{std::format("{}() of an empty array.", max ? "max" : "min")};
+        return self.visit([&](const auto &items) -> LoxValuePtr {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            if constexpr (!isNumber<T>) throw native_error{"Cannot compare a mask."};
+            else return native::box(kernelsFor<T>().extreme(max, items.data(), items.size()));
+        });
+    }
+
+    LoxValuePtr dot(LoxArray &self, const LoxValuePtr &other) {
+        if (!dynamic_cast<LoxArray *>(other.get())) throw native_error{"Expected an " + self.typeName() + "."};
+        return self.visit([&](const auto &items) -> LoxValuePtr {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            auto b = operandArray<T>(self, other);
+            if constexpr (!isNumber<T>) {
+                throw native_error{"Cannot do arithmetic on a mask."};
+            } else {
+                return native::box(kernelsFor<T>().dot(items.data(), b, items.size()));
+            }
+        });
+    }
+
+    // 前缀和依次依赖前一个结果，逐个计算，浮点数的舍入与逐个相加相同
+    LoxValuePtr cumsum(LoxArray &self) {
+        auto result = std::make_shared<LoxArray>(self.type(), self.size());
+        self.visit([&](const auto &items) {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            if constexpr (!isNumber<T>) {
+                throw native_error{"Cannot do arithmetic on a mask."};
+            } else {
+                using Sum = std::conditional_t<std::is_same_v<T, int64_t>, uint64_t, T>;
+                auto &out = result->items<T>();
+                Sum total{};
+                for (size_t i = 0; i < items.size(); ++i) out[i] = (T) (total += (Sum) items[i]);
+            }
+        });
+        return result;
+    }
+
+    const LoxArray &maskOf(const LoxArray &self, const LoxValuePtr &value) {
+        auto mask = dynamic_cast<const LoxArray *>(value.get());
+        if (!mask or mask->type() != ArrayType::MASK) throw native_error{"Expected an array[mask]."};
+        if (mask->size() != self.size()) {
+            throw native_error{std::format("Array sizes differ: {} and {}.", self.size(), mask->size())};
+        }
+        return *mask;
+    }
+
+    // 下标数组，每个下标都在 [0, size) 中
+    const std::vector<int64_t> &indicesOf(const LoxValuePtr &value, size_t size) {
+        auto indices = dynamic_cast<const LoxArray *>(value.get());
+        if (!indices or indices->type() != ArrayType::I64) throw native_error{"Indices must be an array[i64]."};
+        for (auto index: indices->items<int64_t>()) {
+            if (index < 0 or (size_t) index >= size) {
+                throw native_error{std::format("Index {} out of range for an array of size {}.", index, size)};
+            }
+        }
+        return indices->items<int64_t>();
+    }
+
+    // mask 为 1 的元素
+    LoxValuePtr select(LoxArray &self, const LoxValuePtr &value) {
+        const auto &mask = maskOf(self, value).items<uint8_t>();
+        auto result = std::make_shared<LoxArray>(self.type(), (size_t) std::count(mask.begin(), mask.end(), 1));
+        self.visit([&](const auto &items) {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            auto out = result->items<T>().begin();
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (mask[i]) *out++ = items[i];
+            }
+        });
+        return result;
+    }
+
+    // result[i] = self[indices[i]]
+    LoxValuePtr gather(LoxArray &self, const LoxValuePtr &value) {
+        const auto &indices = indicesOf(value, self.size());
+        auto result = std::make_shared<LoxArray>(self.type(), indices.size());
+        self.visit([&](const auto &items) {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            auto &out = result->items<T>();
+            for (size_t i = 0; i < indices.size(); ++i) out[i] = items[indices[i]];
+        });
+        return result;
+    }
+
+    // self[indices[i]] = values[i]（或同一个数），直接修改本数组
+    void scatter(LoxArray &self, const LoxValuePtr &indexValue, const LoxValuePtr &values) {
+        const auto &indices = indicesOf(indexValue, self.size());
+        self.visit([&](auto &items) {
+            using T = typename std::decay_t<decltype(items)>::value_type;
+            if (auto array = dynamic_cast<LoxArray *>(values.get())) {
+                if (array->type() != self.type()) {
+                    throw native_error{std::format("Expected an {} but got an {}.", self.typeName(), array->typeName())};
+                }
+                if (array->size() != indices.size()) {
+                    throw native_error{std::format("Array sizes differ: {} and {}.", indices.size(), array->size())};
+                }
+                const auto &source = array->items<T>();
+                for (size_t i = 0; i < indices.size(); ++i) items[indices[i]] = source[i];
+                return;
+            }
+            auto value = element<T>(values.get());
+            if (!value) throw native_error{"Cannot store this value in an " + self.typeName() + "."};
+            for (auto index: indices) items[index] = *value;
+        });
+    }
+
+    LoxValuePtr toList(LoxArray &self) {
+        constexpr std::array<ElementType, 4> elementTypes{ElementType::FLOAT, ElementType::INT, ElementType::FLOAT,
+                                                          ElementType::BOOL};
+        auto list = std::make_shared<LoxList>(elementTypes[(size_t) self.type()], false);
+        list->reserve(self.size());
+        self.visit([&](const auto &items) {
+            for (auto item: items) list->append(boxElement(item));
+        });
+        return list;
+    }
+
+    // 长度（元素都为 0）或列表
+    LoxValuePtr create(ArrayType type, const LoxValuePtr &source) {
+        if (auto length = dynamic_cast<LoxInt *>(source.get())) {
+            if (length->value_ < 0) throw native_error{"The size must not be negative."};
+            return std::make_shared<LoxArray>(type, (size_t) length->value_);
+        }
+        auto list = dynamic_cast<LoxList *>(source.get());
+        auto vector = dynamic_cast<LoxVector *>(source.get());
+        if (!list and !vector) throw native_error{"Expected a size or a list."};
+        auto size = list ? list->size() : vector->size();
+        auto array = std::make_shared<LoxArray>(type, size);
+        for (size_t i = 0; i < size; ++i) {
+            if (!array->set(i, list ? list->get(i) : vector->get(i))) {
+                throw native_error{std::format("Element {} cannot be stored in an {}.", i, array->typeName())};
+            }
+        }
+        return array;
+    }
+
+    const LoxArray::Method methods[]{
+            {"len", 0, [](LoxArray &array, std::span<LoxValuePtr>) {
+                return LoxInt::of((int64_t) array.size());
+            }},
+            // 以下返回新的数组
+            {"add", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return arithmetic(array, BinaryOp::ADD, args[0]);
+            }},
+            {"sub", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return arithmetic(array, BinaryOp::SUB, args[0]);
+            }},
+            {"mul", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return arithmetic(array, BinaryOp::MUL, args[0]);
+            }},
+            {"div", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return arithmetic(array, BinaryOp::DIV, args[0]);
+            }},
+            {"lt", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return compare(array, CompareOp::LT, args[0]);
+            }},
+            {"le", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return compare(array, CompareOp::LE, args[0]);
+            }},
+            {"gt", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return compare(array, CompareOp::GT, args[0]);
+            }},
+            {"ge", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return compare(array, CompareOp::GE, args[0]);
+            }},
+            {"eq", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return compare(array, CompareOp::EQ, args[0]);
+            }},
+            {"ne", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return compare(array, CompareOp::NE, args[0]);
+            }},
+            {"cumsum", 0, [](LoxArray &array, std::span<LoxValuePtr>) {
+                return cumsum(array);
+            }},
+            {"select", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return select(array, args[0]);
+            }},
+            {"gather", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return gather(array, args[0]);
+            }},
+            // 归约
+            {"sum", 0, [](LoxArray &array, std::span<LoxValuePtr>) {
+                return sum(array);
+            }},
+            {"min", 0, [](LoxArray &array, std::span<LoxValuePtr>) {
+                return extreme(array, false);
+            }},
+            {"max", 0, [](LoxArray &array, std::span<LoxValuePtr>) {
+                return extreme(array, true);
+            }},
+            {"mean", 0, [](LoxArray &array, std::span<LoxValuePtr>) -> LoxValuePtr {
+                if (array.size() == 0) throw native_error{"mean() of an empty array."};
+                auto total = sum(array);
+                auto integer = dynamic_cast<LoxInt *>(total.get());
+                auto value = integer ? (double) integer->value_ : static_cast<LoxFloat *>(total.get())->value_;
+                return native::box(value / (double) array.size());
+            }},
+            {"dot", 1, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                return dot(array, args[0]);
+            }},
+            {"scatter", 2, [](LoxArray &array, std::span<LoxValuePtr> args) {
+                scatter(array, args[0], args[1]);
+                return LoxNil::instance();
+            }},
+            {"toList", 0, [](LoxArray &array, std::span<LoxValuePtr>) {
+                return toList(array);
+            }},
+    };
+}
+
+void LoxArray::define(Environment &module) {
+    for (auto type: {ArrayType::F64, ArrayType::I64, ArrayType::F32}) {
+        auto name = typeNames[(size_t) type];
+        module.define(name, makeNative(std::string{name}, [type](const LoxValuePtr &source) {
+            return create(type, source);
+        }));
+    }
+    module.define("range", makeNative("range", [](int64_t size) -> LoxValuePtr {
+        if (size < 0) throw native_error{"The size must not be negative."};
+        auto array = std::make_shared<LoxArray>(ArrayType::I64, (size_t) size);
+        auto &items = array->items<int64_t>();
+        for (int64_t i = 0; i < size; ++i) items[i] = i;
+        return array;
+    }));
+    module.define("simd", std::make_shared<LoxString>(std::string{simd()}));
+}
+
+std::string_view LoxArray::simd() {
+    if (useAvx2()) return "avx2";
+#if defined(__SSE2__)
+    return "sse2";
+#else
+    return "generic";
+#endif
+}
+
+LoxArray::LoxArray(ArrayType type, size_t size) : type_{type} {
+    switch (type) {
+        case ArrayType::F64:items_.emplace<std::vector<double>>(size);
+            break;
+        case ArrayType::I64:items_.emplace<std::vector<int64_t>>(size);
+            break;
+        case ArrayType::F32:items_.emplace<std::vector<float>>(size);
+            break;
+        case ArrayType::MASK:items_.emplace<std::vector<uint8_t>>(size);
+            break;
+    }
+}
+
+std::string LoxArray::typeName() const {
+    return std::string{TYPE} + "[" + std::string{typeNames[(size_t) type_]} + "]";
+}
+
+size_t LoxArray::size() const {
+    return std::visit([](const auto &items) { return items.size(); }, items_);
+}
+
+LoxValuePtr LoxArray::get(size_t index) const {
+    return std::visit([index](const auto &items) { return boxElement(items[index]); }, items_);
+}
+
+bool LoxArray::set(size_t index, const LoxValuePtr &value) {
+    return std::visit([&](auto &items) {
+        using T = typename std::decay_t<decltype(items)>::value_type;
+        auto item = element<T>(value.get());
+        if (item) items[index] = *item;
+        return item.has_value();
+    }, items_);
+}
+
+std::ostream &LoxArray::operator<<(std::ostream &o) {
+    o << '[';
+    for (size_t i = 0; i < size(); ++i) {
+        if (i) o << ", ";
+        o << *get(i);
+    }
+    return o << ']';
+}
+
+const LoxArray::Method *LoxArray::findMethod(std::string_view name) {
+    return ::findMethod(methods, name);
+}
+
+LoxValuePtr LoxArray::bind(std::shared_ptr<LoxArray> array, const Method &method) {
+    return std::make_shared<BoundMethod<LoxArray>>(std::move(array), method);
+}
@@ -0,0 +1,289 @@
+#include "lox_async.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utility>
+
+#include "lox_hamt.hpp"
+#include "lox_set.hpp"
+#include "lox_vector.hpp"
+
+extern char **environ;
+
+namespace {
+    // 能否在线程之间共享：nil、bool、数、字符串，以及元素都能共享的不可变集合
+    bool shareable(const LoxValue *value) {
+        if (!value or dynamic_cast<const LoxNil *>(value) or dynamic_cast<const LoxBool *>(value)
+            or dynamic_cast<const LoxInt *>(value) or dynamic_cast<const LoxFloat *>(value)
+            or dynamic_cast<const LoxString *>(value)) {
+            return true;
+        }
+        if (auto set = dynamic_cast<const LoxSet *>(value)) return set->frozen();
+        if (auto vector = dynamic_cast<const LoxVector *>(value)) {
+            return vector->items().forEach([](const LoxValuePtr &item) { return shareable(item.get()); });
+        }
+        if (auto map = dynamic_cast<const LoxHamt *>(value)) {
+            bool result = true;
+            map->items().forEach([&result](const auto &, const LoxValuePtr &item) {
+                result = result and shareable(item.get());
+            });
+            return result;
+        }
+        return false;
+    }
+
+    // 协程被销毁时（事件循环销毁）也要关闭的文件描述符
+    struct Descriptor {
+        int fd{-1};
+
+        ~Descriptor() {
+            if (fd >= 0) close(fd);
+        }
+    };
+
+    /* 以下是异步内建函数的实现，每个都是事件循环上的 C++20 协程，
+     * 创建后执行到第一个 co_await 就返回，由事件循环在事件到达时恢复；结果或错误交给 future
+     * */
+    EventLoop::LoopTask sleepFor(EventLoop &loop, double seconds, std::shared_ptr<LoxFuture> future) {
+        co_await loop.sleep(seconds);
+        future->resolve(LoxNil::instance());
+    }
+
+    EventLoop::LoopTask readAll(EventLoop &loop, std::string path, std::shared_ptr<LoxFuture> future) {
+        try {
+            auto load = [path] {
+                std::ifstream file{path, std::ios::binary | std::ios::ate};
+                if (!file) throw native_error{std::format("Cannot open file '{}'.", path)};
+                // 按文件大小一次分配并读取，不经过 stringstream 逐块复制
+                std::string text((size_t) file.tellg(), '\0');
+                file.seekg(0);
+                if (!file.read(text.data(), (std::streamsize) text.size())) {
+                    throw native_error{std::format("Cannot read file '{}'.", path)};
+                }
+                return text;
+            };
+            auto text = co_await loop.onPool(std::move(load));
+            future->resolve(std::make_shared<LoxString>(std::move(text)));
+        } catch (...) {
+            future->reject(std::current_exception());
+        }
+    }
+
+    EventLoop::LoopTask writeAll(EventLoop &loop, std::string path, std::string text, std::shared_ptr<LoxFuture> future) {
+        try {
+            auto store = [path, text = std::move(text)] {
+                std::ofstream file{path, std::ios::binary | std::ios::trunc};
+                if (!file or !file.write(text.data(), (std::streamsize) text.size()) or !file.flush()) {
+                    throw native_error{std::format("Cannot write file '{}'.", path)};
+                }
+                return true;
+            };
+            co_await loop.onPool(std::move(store));
+            future->resolve(LoxNil::instance());
+        } catch (...) {
+            future->reject(std::current_exception());
+        }
+    }
+
+    // 子进程的标准输出接到管道，读端设为非阻塞，没有数据时在事件循环中等待可读
+    EventLoop::LoopTask run(EventLoop &loop, std::string command, std::shared_ptr<LoxFuture> future) {
+        try {
+            int fds[2];
+            if (pipe2(fds, O_CLOEXEC) != 0) throw native_error{"Cannot create a pipe."};
+            Descriptor output{fds[0]}, input{fds[1]};
+            fcntl(output.fd, F_SETFL, O_NONBLOCK);
+
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+            posix_spawn_file_actions_adddup2(&actions, input.fd, STDOUT_FILENO);
+            char shell[] = "sh", flag[] = "-c";
+            char *argv[] = {shell, flag, command.data(), nullptr};
+            pid_t pid;
+            int failed = posix_spawn(&pid, "/bin/sh", &actions, nullptr, argv, environ);
+            posix_spawn_file_actions_destroy(&actions);
+            if (failed) throw native_error{std::format("Cannot run command '{}'.", command)};
+            // 关闭写端，子进程退出后读端才能读到文件结束
+            close(std::exchange(input.fd, -1));
+
+            std::string text;
+            char buffer[4096];
+            while (true) {
+                auto count = read(output.fd, buffer, sizeof(buffer));
+                if (count > 0) {
+                    text.append(buffer, count);
+                } else if (count == 0) {
+                    break;
+                } else if (errno == EAGAIN) {
+                    co_await loop.readable(output.fd);
+                } else if (errno != EINTR) {
+                    break;
+                }
+            }
+
+            // 输出已经结束，子进程通常已经或即将退出，在线程池中等待以免阻塞事件循环
+            auto wait = [pid] {
+                int status = 0;
+                while (waitpid(pid, &status, 0) < 0 and errno == EINTR) {}
+                return status;
+            };
+            auto status = co_await loop.onPool(std::move(wait));
+            if (!WIFEXITED(status) or WEXITSTATUS(status) != 0) {
+                auto code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                throw native_error{std::format("Command '{}' exited with status {}.", command, code)};
+            }
+            future->resolve(std::make_shared<LoxString>(std::move(text)));
+        } catch (...) {
+            future->reject(std::current_exception());
+        }
+    }
+}
+
+void LoxFuture::resolve(LoxValuePtr value) {
+    value_ = std::move(value);
+    settle();
+}
+
+void LoxFuture::reject(std::exception_ptr error) {
+    error_ = std::move(error);
+    settle();
+}
+
+void LoxFuture::settle() {
+    done_ = true;
+    for (auto &callback: std::exchange(callbacks_, {})) callback();
+}
+
+void LoxFuture::then(EventLoop::Callback callback) {
+    if (done_) callback();
+    else callbacks_.push_back(std::move(callback));
+}
+
+LoxValuePtr LoxFuture::get() {
+    observed_ = true;
+    if (error_) std::rethrow_exception(error_);
+    return value_;
+}
+
+std::ostream &LoxFuture::operator<<(std::ostream &o) {
+    return o << "<future>";
+}
+
+std::shared_ptr<LoxFuture> LoxFuture::sleep(EventLoop &loop, double seconds) {
+    auto future = std::make_shared<LoxFuture>();
+    sleepFor(loop, seconds, future);
+    return future;
+}
+
+std::shared_ptr<LoxFuture> LoxFuture::readFile(EventLoop &loop, std::string path) {
+    auto future = std::make_shared<LoxFuture>();
+    readAll(loop, std::move(path), future);
+    return future;
+}
+
+std::shared_ptr<LoxFuture> LoxFuture::writeFile(EventLoop &loop, std::string path, std::string text) {
+    auto future = std::make_shared<LoxFuture>();
+    writeAll(loop, std::move(path), std::move(text), future);
+    return future;
+}
+
+std::shared_ptr<LoxFuture> LoxFuture::exec(EventLoop &loop, std::string command) {
+    auto future = std::make_shared<LoxFuture>();
+    run(loop, std::move(command), future);
+    return future;
+}
+
+std::shared_ptr<LoxFuture> Task::start(Interpreter &interpreter, FunctionStmt *declaration,
+                                       std::shared_ptr<Environment> env, UnitPtr unit) {
+    auto task = std::make_shared<Task>(interpreter, declaration, std::move(env), std::move(unit));
+    interpreter.eventLoop().defer([task] { task->step(); });
+    return task->future_;
+}
+
+Task::Task(Interpreter &interpreter, FunctionStmt *declaration, std::shared_ptr<Environment> env, UnitPtr unit)
+        : Coroutine{declaration, std::move(env), std::move(unit)}, host_{interpreter} {}
+
+Task::~Task() {
+    close();
+}
+
+void Task::await(const std::shared_ptr<LoxFuture> &future) {
+    future->then([self = shared_from_this()] {
+        self->host_.eventLoop().defer([self] { self->step(); });
+    });
+    suspend();
+}
+
+void Task::step() {
+    try {
+        resume(host_);
+    } catch (...) {
+        // 无法开始执行（如分配不到栈）
+        state_ = State::DONE;
+        error_ = std::current_exception();
+    }
+    if (state_ != State::DONE or future_->done()) return;
+    if (error_) {
+        future_->reject(std::exchange(error_, nullptr));
+        host_.failed.push_back(future_);
+    } else {
+        future_->resolve(std::move(value_));
+    }
+}
+
+void Mailbox::send(LoxValuePtr message) {
+    if (!shareable(message.get())) {
+        throw native_error{"Can only send nil, booleans, numbers, strings and immutable collections to a context."};
+    }
+    std::lock_guard lock{mutex_};
+    if (closed_) return;
+    if (waiting_.empty() or !loop_) {
+        messages_.push_back(std::move(message));
+        return;
+    }
+    loop_->post([loop = loop_, future = std::move(waiting_.front()), message = std::move(message)] {
+        loop->release();
+        future->resolve(message);
+    });
+    waiting_.pop_front();
+}
+
+void Mailbox::close() {
+    std::lock_guard lock{mutex_};
+    closed_ = true;
+    for (auto &future: waiting_) {
+        loop_->post([loop = loop_, future = std::move(future)] {
+            loop->release();
+            future->resolve(LoxNil::instance());
+        });
+    }
+    waiting_.clear();
+}
+
+std::shared_ptr<LoxFuture> Mailbox::receive(EventLoop &loop) {
+    auto future = std::make_shared<LoxFuture>();
+    std::lock_guard lock{mutex_};
+    if (!messages_.empty()) {
+        future->resolve(std::move(messages_.front()));
+        messages_.pop_front();
+    } else if (closed_) {
+        future->resolve(LoxNil::instance());
+    } else {
+        loop_ = &loop;
+        loop.hold();
+        waiting_.push_back(future);
+    }
+    return future;
+}
+
+void Mailbox::detach() {
+    std::lock_guard lock{mutex_};
+    for (size_t i = 0; i < waiting_.size(); ++i) loop_->release();
+    waiting_.clear();
+    loop_ = nullptr;
+}
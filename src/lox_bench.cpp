@@ -0,0 +1,89 @@
+#include "lox_bench.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include "lox_instance.hpp"
+#include "native.hpp"
+
+namespace {
+    std::atomic<LoxBench::AllocationCounter> allocationCounter{nullptr};
+
+    struct Stats {
+        int64_t iterations;
+        int64_t min, median, p99;
+        double mean;
+        std::optional<double> allocations;  // 平均每次调用的堆分配次数
+    };
+
+    int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Stats measure(Interpreter &interpreter, const LoxValuePtr &value, int64_t iterations) {
+        auto function = dynamic_cast<LoxCallable *>(value.get());
+        if (!function or function->arity() != 0) throw native_error{"Expected a function without parameters."};
+        if (iterations <= 0) throw native_error{"The number of iterations must be positive."};
+
+        for (int64_t i = 0; i < std::max<int64_t>(1, iterations / 10); ++i) function->call(interpreter, {});
+
+        // 计时的循环本身不分配内存，分配次数全部来自被测的函数
+        std::vector<int64_t> samples((size_t) iterations);
+        auto counter = allocationCounter.load();
+        uint64_t allocations = counter ? counter() : 0;
+        for (auto &sample: samples) {
+            auto begin = now();
+            function->call(interpreter, {});
+            sample = now() - begin;
+        }
+        if (counter) allocations = counter() - allocations;
+
+        std::sort(samples.begin(), samples.end());
+        double total = 0;
+        for (auto sample: samples) total += (double) sample;
+
+        Stats stats{iterations, samples.front(), samples[samples.size() / 2],
+                    samples[std::min(samples.size() - 1, samples.size() * 99 / 100)], total / (double) iterations,
+                    std::nullopt};
+        if (counter) stats.allocations = (double) allocations / (double) iterations;
+        return stats;
+    }
+
+    LoxValuePtr toInstance(const Stats &stats, const std::shared_ptr<LoxClass> &resultClass) {
+        auto instance = std::make_shared<LoxInstance>(resultClass);
+        instance->set("iterations", LoxInt::of(stats.iterations));
+        instance->set("min", LoxInt::of(stats.min));
+        instance->set("median", LoxInt::of(stats.median));
+        instance->set("p99", LoxInt::of(stats.p99));
+        instance->set("mean", std::make_shared<LoxFloat>(stats.mean));
+        instance->set("allocations", stats.allocations ? std::make_shared<LoxFloat>(*stats.allocations) : LoxNil::instance());
+        return instance;
+    }
+}
+
+void LoxBench::define(Environment &module) {
+    auto resultClass = std::make_shared<LoxClass>("BenchResult", nullptr, StringMap<std::shared_ptr<LoxFunction>>{});
+
+    module.define("run", makeNative("run", [resultClass](Interpreter &interpreter, const LoxValuePtr &function,
+                                                         int64_t iterations) {
+        return toInstance(measure(interpreter, function, iterations), resultClass);
+    }));
+
+    module.define("report", makeNative("report", [resultClass](Interpreter &interpreter, std::string_view name,
+                                                               const LoxValuePtr &function, int64_t iterations) {
+        auto stats = measure(interpreter, function, iterations);
+        interpreter.out << name << ": " << stats.iterations << " iterations, min " << stats.min << " ns, median "
+                        << stats.median << " ns, p99 " << stats.p99 << " ns";
+        if (stats.allocations) interpreter.out << ", " << *stats.allocations << " allocations/iter";
+        interpreter.out << std::endl;
+        return toInstance(stats, resultClass);
+    }));
+}
+
+void LoxBench::setAllocationCounter(AllocationCounter counter) {
+    allocationCounter = counter;
+}
@@ -1,6 +1,6 @@
 #include "lox_instance.hpp"
 
-LoxValuePtr LoxClass::call(Interpreter &interpreter, std::vector<LoxValuePtr> &args) {
+LoxValuePtr LoxClass::call(Interpreter &interpreter, std::span<LoxValuePtr> args) {
     auto instance = std::make_shared<LoxInstance>(shared_from_this());
     auto init = findMethod("init");
     if (init) init->bind(instance)->call(interpreter, args);
@@ -0,0 +1,62 @@
+#include "lox_collection.hpp"
+
+#include <array>
+#include <utility>
+
+namespace {
+    constexpr std::array<std::pair<std::string_view, ElementType>, 5> elementTypes{{
+            {"int", ElementType::INT},
+            {"float", ElementType::FLOAT},
+            {"bool", ElementType::BOOL},
+            {"str", ElementType::STR},
+            {"any", ElementType::ANY},
+    }};
+
+    bool isNumber(ElementType type) {
+        return type == ElementType::INT or type == ElementType::FLOAT;
+    }
+}
+
+std::optional<ElementType> elementTypeOf(std::string_view name) {
+    for (auto [typeName, type]: elementTypes) {
+        if (typeName == name) return type;
+    }
+    return std::nullopt;
+}
+
+std::string_view elementTypeName(ElementType type) {
+    return elementTypes[(size_t) type].first;
+}
+
+ElementType elementTypeOf(const LoxValue *value) {
+    if (dynamic_cast<const LoxInt *>(value)) return ElementType::INT;
+    if (dynamic_cast<const LoxFloat *>(value)) return ElementType::FLOAT;
+    if (dynamic_cast<const LoxBool *>(value)) return ElementType::BOOL;
+    if (dynamic_cast<const LoxString *>(value)) return ElementType::STR;
+    return ElementType::ANY;
+}
+
+ElementType commonElementType(std::span<const LoxValuePtr> values) {
+    if (values.empty()) return ElementType::ANY;
+    auto type = elementTypeOf(values.front().get());
+    for (const auto &value: values.subspan(1)) {
+        auto next = elementTypeOf(value.get());
+        if (next == type) continue;
+        if (!isNumber(next) or !isNumber(type)) return ElementType::ANY;
+        type = ElementType::FLOAT;
+    }
+    return type;
+}
+
+bool acceptsElement(ElementType type, const LoxValue *value) {
+    if (type == ElementType::ANY) return true;
+    auto actual = elementTypeOf(value);
+    return actual == type or (type == ElementType::FLOAT and actual == ElementType::INT);
+}
+
+LoxValuePtr storedElement(ElementType type, const LoxValuePtr &value) {
+    if (type == ElementType::FLOAT) {
+        if (auto integer = dynamic_cast<const LoxInt *>(value.get())) return std::make_shared<LoxFloat>((double) integer->value_);
+    }
+    return value;
+}
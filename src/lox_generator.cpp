@@ -0,0 +1,25 @@
+#include "lox_generator.hpp"
+
+#include <utility>
+
+LoxGenerator::~LoxGenerator() {
+    close();
+}
+
+LoxValuePtr LoxGenerator::next(Interpreter &interpreter) {
+    if (state_ == State::RUNNING) throw native_error{"The generator is already running."};
+    if (interpreter_ and interpreter_ != &interpreter) throw native_error{"The generator is used by another interpreter."};
+    resume(interpreter);
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+    if (state_ == State::DONE) return nullptr;
+    return std::move(value_);
+}
+
+void LoxGenerator::yield(LoxValuePtr value) {
+    value_ = std::move(value);
+    suspend();
+}
+
+std::ostream &LoxGenerator::operator<<(std::ostream &o) {
+    return o << "<generator " << tokens_->lexeme(declaration_->name_) << ">";
+}
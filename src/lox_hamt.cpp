@@ -0,0 +1,261 @@
+#include "lox_hamt.hpp"
+
+#include <bit>
+
+#include "lox_list.hpp"
+#include "lox_map.hpp"
+#include "native.hpp"
+
+namespace {
+    // 哈希值在 shift 这一层的位置
+    uint32_t bitFor(size_t hash, size_t shift) {
+        return shift < 64 ? 1u << ((hash >> shift) & 31) : 1u;
+    }
+
+    size_t positionOf(uint32_t bitmap, uint32_t bit) {
+        return (size_t) std::popcount(bitmap & (bit - 1));
+    }
+
+    const LoxString &keyOf(const LoxValuePtr &value) {
+        auto key = dynamic_cast<LoxString *>(value.get());
+        if (!key) throw native_error{"Map keys must be strings."};
+        return *key;
+    }
+
+    std::shared_ptr<LoxString> sharedKeyOf(const LoxValuePtr &value) {
+        keyOf(value);
+        return std::static_pointer_cast<LoxString>(value);
+    }
+
+    const LoxHamt::Method methods[]{
+            {"len", 0, [](LoxHamt &map, std::span<LoxValuePtr>) {
+                return LoxInt::of((int64_t) map.size());
+            }},
+            {"has", 1, [](LoxHamt &map, std::span<LoxValuePtr> args) {
+                return LoxBool::of(map.get(keyOf(args[0])) != nullptr);
+            }},
+            // 键不存在时返回第二个参数
+            {"get", 2, [](LoxHamt &map, std::span<LoxValuePtr> args) {
+                auto value = map.get(keyOf(args[0]));
+                return value ? value : args[1];
+            }},
+            // put 和 remove 返回新的字典，原字典不变
+            {"put", 2, [](LoxHamt &map, std::span<LoxValuePtr> args) -> LoxValuePtr {
+                auto result = map.set(sharedKeyOf(args[0]), args[1]);
+                if (!result) throw native_error{"Cannot store this value in an " + map.typeName() + "."};
+                return result;
+            }},
+            {"remove", 1, [](LoxHamt &map, std::span<LoxValuePtr> args) -> LoxValuePtr {
+                return map.remove(keyOf(args[0]));
+            }},
+            {"keys", 0, [](LoxHamt &map, std::span<LoxValuePtr>) -> LoxValuePtr {
+                auto keys = std::make_shared<LoxList>(ElementType::STR, false);
+                keys->reserve(map.size());
+                map.items().forEach([&](const auto &key, const auto &) { keys->append(key); });
+                return keys;
+            }},
+            {"values", 0, [](LoxHamt &map, std::span<LoxValuePtr>) -> LoxValuePtr {
+                auto values = std::make_shared<LoxList>(map.valueType(), false);
+                values->reserve(map.size());
+                map.items().forEach([&](const auto &, const auto &value) { values->append(value); });
+                return values;
+            }},
+            // 可修改的副本
+            {"toMap", 0, [](LoxHamt &map, std::span<LoxValuePtr>) -> LoxValuePtr {
+                auto copy = std::make_shared<LoxMap>(map.valueType(), false);
+                copy->reserve(map.size());
+                map.items().forEach([&](const auto &key, const auto &value) { copy->set(key, value); });
+                return copy;
+            }},
+    };
+}
+
+const PersistentMap::Entry *PersistentMap::find(const Node *node, size_t hash, std::string_view key) {
+    for (size_t shift = 0; node; shift += BITS) {
+        if (node->collision) {
+            for (const auto &entry: node->entries) {
+                if (entry.hash == hash and entry.key->value_ == key) return &entry;
+            }
+            return nullptr;
+        }
+        auto bit = bitFor(hash, shift);
+        if (!(node->bitmap & bit)) return nullptr;
+        const auto &entry = node->entries[positionOf(node->bitmap, bit)];
+        if (!entry.child) return entry.hash == hash and entry.key->value_ == key ? &entry : nullptr;
+        node = entry.child.get();
+    }
+    return nullptr;
+}
+
+LoxValuePtr PersistentMap::get(const LoxString &key) const {
+    auto entry = find(root_.get(), key.hash(), key.value_);
+    return entry ? entry->value : nullptr;
+}
+
+PersistentMap PersistentMap::set(const std::shared_ptr<LoxString> &key, LoxValuePtr value) const {
+    bool added = false;
+    PersistentMap result;
+    result.root_ = insert(root_, 0, Entry{key, std::move(value), key->hash(), nullptr}, added);
+    result.size_ = size_ + added;
+    return result;
+}
+
+PersistentMap PersistentMap::remove(const LoxString &key) const {
+    if (!root_) return *this;
+    bool removed = false;
+    auto root = erase(root_, 0, key.hash(), key.value_, removed);
+    if (!removed) return *this;
+    PersistentMap result;
+    result.root_ = std::move(root);
+    result.size_ = size_ - 1;
+    return result;
+}
+
+PersistentMap::NodePtr PersistentMap::insert(const NodePtr &node, size_t shift, Entry entry, bool &added) {
+    if (!node) {
+        auto leaf = std::make_shared<Node>();
+        leaf->bitmap = bitFor(entry.hash, shift);
+        leaf->entries.push_back(std::move(entry));
+        added = true;
+        return leaf;
+    }
+    if (node->collision) {
+        if (entry.hash != node->entries.front().hash) {
+            // 哈希值不同的键：冲突节点下沉一层，放到普通节点中
+            auto parent = std::make_shared<Node>();
+            parent->bitmap = bitFor(node->entries.front().hash, shift);
+            parent->entries.push_back(Entry{nullptr, nullptr, 0, node});
+            return insert(parent, shift, std::move(entry), added);
+        }
+        auto copy = std::make_shared<Node>(*node);
+        for (auto &existing: copy->entries) {
+            if (existing.key->value_ == entry.key->value_) {
+                existing.value = std::move(entry.value);
+                return copy;
+            }
+        }
+        copy->entries.push_back(std::move(entry));
+        added = true;
+        return copy;
+    }
+
+    auto bit = bitFor(entry.hash, shift);
+    auto position = positionOf(node->bitmap, bit);
+    auto copy = std::make_shared<Node>(*node);
+    if (!(node->bitmap & bit)) {
+        copy->bitmap |= bit;
+        copy->entries.insert(copy->entries.begin() + (ptrdiff_t) position, std::move(entry));
+        added = true;
+        return copy;
+    }
+    auto &existing = copy->entries[position];
+    if (existing.child) {
+        existing.child = insert(existing.child, shift + BITS, std::move(entry), added);
+    } else if (existing.hash == entry.hash and existing.key->value_ == entry.key->value_) {
+        existing.value = std::move(entry.value);
+    } else {
+        existing = Entry{nullptr, nullptr, 0, merge(shift + BITS, std::move(existing), std::move(entry))};
+        added = true;
+    }
+    return copy;
+}
+
+PersistentMap::NodePtr PersistentMap::merge(size_t shift, Entry a, Entry b) {
+    auto node = std::make_shared<Node>();
+    if (a.hash == b.hash) {
+        node->collision = true;
+        node->entries.push_back(std::move(a));
+        node->entries.push_back(std::move(b));
+        return node;
+    }
+    auto bitA = bitFor(a.hash, shift), bitB = bitFor(b.hash, shift);
+    if (bitA == bitB) {
+        node->bitmap = bitA;
+        node->entries.push_back(Entry{nullptr, nullptr, 0, merge(shift + BITS, std::move(a), std::move(b))});
+        return node;
+    }
+    node->bitmap = bitA | bitB;
+    if (bitA > bitB) std::swap(a, b);
+    node->entries.push_back(std::move(a));
+    node->entries.push_back(std::move(b));
+    return node;
+}
+
+PersistentMap::NodePtr
+PersistentMap::erase(const NodePtr &node, size_t shift, size_t hash, std::string_view key, bool &removed) {
+    if (node->collision) {
+        for (size_t i = 0; i < node->entries.size(); ++i) {
+            if (node->entries[i].hash != hash or node->entries[i].key->value_ != key) continue;
+            removed = true;
+            if (node->entries.size() == 1) return nullptr;
+            auto copy = std::make_shared<Node>(*node);
+            copy->entries.erase(copy->entries.begin() + (ptrdiff_t) i);
+            return copy;
+        }
+        return node;
+    }
+
+    auto bit = bitFor(hash, shift);
+    if (!(node->bitmap & bit)) return node;
+    auto position = positionOf(node->bitmap, bit);
+    const auto &existing = node->entries[position];
+    NodePtr child;
+    if (existing.child) {
+        child = erase(existing.child, shift + BITS, hash, key, removed);
+        if (!removed) return node;
+    } else {
+        if (existing.hash != hash or existing.key->value_ != key) return node;
+        removed = true;
+    }
+
+    auto copy = std::make_shared<Node>(*node);
+    if (child and (child->entries.size() > 1 or child->entries.front().child)) {
+        copy->entries[position].child = std::move(child);
+    } else if (child) {
+        // 只剩一个键值对的子节点并入本节点
+        copy->entries[position] = child->entries.front();
+    } else {
+        copy->bitmap &= ~bit;
+        copy->entries.erase(copy->entries.begin() + (ptrdiff_t) position);
+        if (copy->entries.empty()) return nullptr;
+    }
+    return copy;
+}
+
+std::string LoxHamt::typeName() const {
+    return std::string{TYPE} + "[" + std::string{elementTypeName(type_)} + "]";
+}
+
+std::shared_ptr<LoxHamt> LoxHamt::set(const std::shared_ptr<LoxString> &key, const LoxValuePtr &value) const {
+    auto type = type_;
+    if (!acceptsElement(type, value.get())) {
+        if (declared_) return nullptr;
+        type = ElementType::ANY;
+    }
+    return std::make_shared<LoxHamt>(type, declared_, items_.set(key, storedElement(type, value)));
+}
+
+std::shared_ptr<LoxHamt> LoxHamt::remove(const LoxString &key) const {
+    return std::make_shared<LoxHamt>(type_, declared_, items_.remove(key));
+}
+
+std::ostream &LoxHamt::operator<<(std::ostream &o) {
+    o << '{';
+    bool first = true;
+    items_.forEach([&](const auto &key, const auto &value) {
+        if (!first) o << ", ";
+        first = false;
+        o << '"' << key->value_ << "\": ";
+        if (auto string = dynamic_cast<LoxString *>(value.get())) o << '"' << string->value_ << '"';
+        else o << *value;
+    });
+    return o << '}';
+}
+
+const LoxHamt::Method *LoxHamt::findMethod(std::string_view name) {
+    return ::findMethod(methods, name);
+}
+
+LoxValuePtr LoxHamt::bind(std::shared_ptr<LoxHamt> map, const Method &method) {
+    return std::make_shared<BoundMethod<LoxHamt>>(std::move(map), method);
+}
@@ -0,0 +1,280 @@
+#include "lox_iterator.hpp"
+
+#include <array>
+#include <format>
+#include <fstream>
+
+#include "native.hpp"
+#include "lox_array.hpp"
+#include "lox_generator.hpp"
+#include "lox_hamt.hpp"
+#include "lox_list.hpp"
+#include "lox_map.hpp"
+#include "lox_set.hpp"
+#include "lox_vector.hpp"
+
+namespace {
+    // lines(path) 的数据源
+    class FileLines : public LoxValue {
+    public:
+        explicit FileLines(std::string path) : path_{std::move(path)} {}
+
+        bool forEach(Sink &sink) const {
+            std::ifstream file{path_};
+            if (!file) throw native_error{std::format("Cannot open file '{}'.", path_)};
+            std::string line;
+            while (std::getline(file, line)) {
+                if (!line.empty() and line.back() == '\r') line.pop_back();
+                if (!sink(std::make_shared<LoxString>(std::move(line)))) return false;
+                line = {};
+            }
+            return true;
+        }
+
+        std::ostream &operator<<(std::ostream &o) override {
+            return o << "<lines " << path_ << ">";
+        }
+
+    private:
+        std::string path_;
+    };
+
+    // 依次访问 items 中的值
+    bool forEachOf(const std::vector<LoxValuePtr> &items, Sink &sink) {
+        for (const auto &item: items) {
+            if (!sink(item)) return false;
+        }
+        return true;
+    }
+
+    // 检查 value 是接受 arity 个参数的函数
+    LoxCallable *callable(const LoxValuePtr &value, size_t arity) {
+        auto function = dynamic_cast<LoxCallable *>(value.get());
+        if (!function) throw native_error{"Argument 1 must be a function."};
+        if (function->variadic() ? function->arity() > arity : function->arity() != arity) {
+            throw native_error{std::format("The function must take {} argument{}.", arity, arity == 1 ? "" : "s")};
+        }
+        return function;
+    }
+
+    LoxValuePtr stage(LoxIterator &self, LoxIterator::StageKind kind, const LoxValuePtr &argument) {
+        if (kind == LoxIterator::StageKind::MAP or kind == LoxIterator::StageKind::FILTER) {
+            callable(argument, 1);
+            return self.then({kind, argument, 0});
+        }
+        auto count = native::Arg<int64_t>::get(argument, 0);
+        if (count < 0) throw native_error{"The count must not be negative."};
+        return self.then({kind, nullptr, count});
+    }
+
+    const LoxIterator::Method methods[]{
+            {"map", 1, [](Interpreter &, LoxIterator &self, std::span<LoxValuePtr> args) {
+                return stage(self, LoxIterator::StageKind::MAP, args[0]);
+            }},
+            {"filter", 1, [](Interpreter &, LoxIterator &self, std::span<LoxValuePtr> args) {
+                return stage(self, LoxIterator::StageKind::FILTER, args[0]);
+            }},
+            {"take", 1, [](Interpreter &, LoxIterator &self, std::span<LoxValuePtr> args) {
+                return stage(self, LoxIterator::StageKind::TAKE, args[0]);
+            }},
+            {"skip", 1, [](Interpreter &, LoxIterator &self, std::span<LoxValuePtr> args) {
+                return stage(self, LoxIterator::StageKind::SKIP, args[0]);
+            }},
+            // reduce(f, init)：依次以 f(累积值, 元素) 更新累积值
+            {"reduce", 2, [](Interpreter &interpreter, LoxIterator &self, std::span<LoxValuePtr> args) {
+                auto function = callable(args[0], 2);
+                std::array<LoxValuePtr, 2> params;
+                auto accumulated = args[1];
+                auto step = [&](const LoxValuePtr &item) {
+                    params[0] = std::move(accumulated);
+                    params[1] = item;
+                    accumulated = function->call(interpreter, params);
+                    return true;
+                };
+                self.forEach(interpreter, step);
+                return accumulated;
+            }},
+            {"count", 0, [](Interpreter &interpreter, LoxIterator &self, std::span<LoxValuePtr>) {
+                int64_t count = 0;
+                auto step = [&](const LoxValuePtr &) { return ++count; };
+                self.forEach(interpreter, step);
+                return LoxInt::of(count);
+            }},
+            // 元素类型按字面量的规则推断
+            {"toList", 0, [](Interpreter &interpreter, LoxIterator &self, std::span<LoxValuePtr>) -> LoxValuePtr {
+                std::vector<LoxValuePtr> items;
+                auto step = [&](const LoxValuePtr &item) {
+                    items.push_back(item);
+                    return true;
+                };
+                self.forEach(interpreter, step);
+                auto list = std::make_shared<LoxList>(commonElementType(items), false);
+                list->reserve(items.size());
+                for (const auto &item: items) list->append(item);
+                return list;
+            }},
+    };
+
+    class BoundIteratorMethod : public NativeCallable {
+    public:
+        BoundIteratorMethod(std::shared_ptr<LoxIterator> self, const LoxIterator::Method &method)
+                : NativeCallable{std::string{method.name}}, self_{std::move(self)}, method_{method} {}
+
+        size_t arity() override { return method_.arity; }
+
+        LoxValuePtr call(Interpreter &interpreter, std::span<LoxValuePtr> args) override {
+            return method_.call(interpreter, *self_, args);
+        }
+
+    private:
+        std::shared_ptr<LoxIterator> self_;
+        const LoxIterator::Method &method_;
+    };
+}
+
+std::optional<bool> forEach(Interpreter &interpreter, const LoxValuePtr &iterable, Sink sink) {
+    auto value = iterable.get();
+    if (auto string = dynamic_cast<LoxString *>(value)) {
+        // 每个字符取缓存的单字符字符串，不分配内存
+        for (auto c: string->value_) {
+            if (!sink(LoxString::of(c))) return false;
+        }
+        return true;
+    }
+    if (auto range = dynamic_cast<LoxRange *>(value)) {
+        int64_t step = range->first() <= range->last() ? 1 : -1;
+        for (auto i = range->first();; i += step) {
+            if (!sink(LoxInt::of(i))) return false;
+            if (i == range->last()) return true;
+        }
+    }
+    if (auto list = dynamic_cast<LoxList *>(value)) {
+        // 切片与列表共享存储，循环中修改列表会先复制，不影响遍历
+        auto items = list->slice(0, list->size());
+        for (size_t i = 0; i < items->size(); ++i) {
+            if (!sink(items->get(i))) return false;
+        }
+        return true;
+    }
+    if (auto vector = dynamic_cast<LoxVector *>(value)) return vector->items().forEach(sink);
+    if (auto array = dynamic_cast<LoxArray *>(value)) {
+        for (size_t i = 0; i < array->size(); ++i) {
+            if (!sink(array->get(i))) return false;
+        }
+        return true;
+    }
+    if (auto map = dynamic_cast<LoxMap *>(value)) {
+        std::vector<LoxValuePtr> keys;
+        keys.reserve(map->size());
+        map->forEach([&](const auto &key, const auto &) { keys.push_back(key); });
+        return forEachOf(keys, sink);
+    }
+    if (auto map = dynamic_cast<LoxHamt *>(value)) {
+        std::vector<LoxValuePtr> keys;
+        keys.reserve(map->size());
+        map->items().forEach([&](const auto &key, const auto &) { keys.push_back(key); });
+        return forEachOf(keys, sink);
+    }
+    if (auto set = dynamic_cast<LoxSet *>(value)) {
+        std::vector<LoxValuePtr> items;
+        items.reserve(set->size());
+        set->forEach([&](const LoxValuePtr &item) { items.push_back(item); });
+        return forEachOf(items, sink);
+    }
+    if (auto iterator = dynamic_cast<LoxIterator *>(value)) return iterator->forEach(interpreter, sink);
+    if (auto generator = dynamic_cast<LoxGenerator *>(value)) {
+        while (auto item = generator->next(interpreter)) {
+            if (!sink(item)) return false;
+        }
+        return true;
+    }
+    if (auto lines = dynamic_cast<FileLines *>(value)) return lines->forEach(sink);
+    return std::nullopt;
+}
+
+bool isIterable(const LoxValue *value) {
+    return dynamic_cast<const LoxString *>(value) or dynamic_cast<const LoxRange *>(value)
+           or dynamic_cast<const LoxList *>(value) or dynamic_cast<const LoxVector *>(value)
+           or dynamic_cast<const LoxArray *>(value) or dynamic_cast<const LoxMap *>(value)
+           or dynamic_cast<const LoxHamt *>(value) or dynamic_cast<const LoxSet *>(value)
+           or dynamic_cast<const LoxIterator *>(value) or dynamic_cast<const FileLines *>(value)
+           or dynamic_cast<const LoxGenerator *>(value);
+}
+
+bool LoxRange::contains(const LoxValue *value) const {
+    auto [low, high] = std::minmax(first_, last_);
+    if (auto integer = dynamic_cast<const LoxInt *>(value)) return low <= integer->value_ and integer->value_ <= high;
+    if (auto floating = dynamic_cast<const LoxFloat *>(value)) {
+        return (double) low <= floating->value_ and floating->value_ <= (double) high;
+    }
+    return false;
+}
+
+std::ostream &LoxRange::operator<<(std::ostream &o) {
+    return o << first_ << ".." << last_;
+}
+
+std::shared_ptr<LoxIterator> LoxIterator::lines(std::string path) {
+    // 创建时先检查一次，尽早报告错误
+    if (!std::ifstream{path}) throw native_error{std::format("Cannot open file '{}'.", path)};
+    return std::make_shared<LoxIterator>(std::make_shared<FileLines>(std::move(path)));
+}
+
+std::shared_ptr<LoxIterator> LoxIterator::then(Stage stage) const {
+    auto iterator = std::make_shared<LoxIterator>(source_);
+    iterator->stages_ = stages_;
+    iterator->stages_.push_back(std::move(stage));
+    return iterator;
+}
+
+bool LoxIterator::forEach(Interpreter &interpreter, Sink sink) const {
+    // take(0) 之后不会再有元素，不必从数据源取
+    for (const auto &stage: stages_) {
+        if (stage.kind == StageKind::TAKE and stage.count == 0) return true;
+    }
+    // 每次迭代各个阶段的计数和调用函数的参数，整个循环只分配一次
+    std::vector<int64_t> counts(stages_.size());
+    std::array<LoxValuePtr, 1> args;
+    bool full = false;  // 有 take 取够了元素，当前元素处理完后停止
+    auto step = [&](const LoxValuePtr &item) {
+        auto value = item;
+        for (size_t i = 0; i < stages_.size(); ++i) {
+            const auto &stage = stages_[i];
+            switch (stage.kind) {
+                case StageKind::MAP:
+                    args[0] = std::move(value);
+                    value = static_cast<LoxCallable *>(stage.function.get())->call(interpreter, args);
+                    break;
+                case StageKind::FILTER:
+                    args[0] = value;
+                    if (!Interpreter::isTruth(static_cast<LoxCallable *>(stage.function.get())->call(interpreter, args))) {
+                        return !full;
+                    }
+                    break;
+                case StageKind::SKIP:
+                    if (counts[i]++ < stage.count) return !full;
+                    break;
+                case StageKind::TAKE:
+                    if (++counts[i] == stage.count) full = true;
+                    break;
+            }
+        }
+        return sink(value) and !full;
+    };
+    return ::forEach(interpreter, source_, step).value_or(true);
+}
+
+std::ostream &LoxIterator::operator<<(std::ostream &o) {
+    return o << "<iterator>";
+}
+
+const LoxIterator::Method *LoxIterator::findMethod(std::string_view name) {
+    for (const auto &method: methods) {
+        if (method.name == name) return &method;
+    }
+    return nullptr;
+}
+
+LoxValuePtr LoxIterator::bind(std::shared_ptr<LoxIterator> iterator, const Method &method) {
+    return std::make_shared<BoundIteratorMethod>(std::move(iterator), method);
+}
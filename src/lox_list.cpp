@@ -0,0 +1,230 @@
+#include "lox_list.hpp"
+
+#include <cmath>
+#include <type_traits>
+
+#include "native.hpp"
+#include "sort.hpp"
+
+namespace {
+    using Boxed = std::vector<LoxValuePtr>;
+
+    const LoxList::Method methods[]{
+            {"append", 1, [](LoxList &list, std::span<LoxValuePtr> args) {
+                if (!list.append(args[0])) throw native_error{"Cannot append this value to a " + list.typeName() + "."};
+                return LoxNil::instance();
+            }},
+            {"pop", 0, [](LoxList &list, std::span<LoxValuePtr>) {
+                auto value = list.pop();
+                if (!value) throw native_error{"Pop from an empty list."};
+                return value;
+            }},
+            {"len", 0, [](LoxList &list, std::span<LoxValuePtr>) {
+                return LoxInt::of((int64_t) list.size());
+            }},
+            {"clear", 0, [](LoxList &list, std::span<LoxValuePtr>) {
+                list.clear();
+                return LoxNil::instance();
+            }},
+            // 预留容量，之后的 append 不再重新分配
+            {"reserve", 1, [](LoxList &list, std::span<LoxValuePtr> args) {
+                auto capacity = native::Arg<int64_t>::get(args[0], 0);
+                if (capacity < 0) throw native_error{"The capacity must not be negative."};
+                list.reserve((size_t) capacity);
+                return LoxNil::instance();
+            }},
+    };
+
+    // 按 key 排序装箱的元素，NaN 排在最后
+    template<typename K>
+    void sortByKey(Boxed &items, K (*key)(const LoxValue *)) {
+        std::vector<std::pair<K, LoxValuePtr>> keyed;
+        keyed.reserve(items.size());
+        for (auto &item: items) keyed.emplace_back(key(item.get()), std::move(item));
+        auto end = keyed.end();
+        if constexpr (std::is_floating_point_v<K>) {
+            end = std::stable_partition(keyed.begin(), keyed.end(), [](const auto &k) { return !std::isnan(k.first); });
+        }
+        sorting::pdqsort(keyed.begin(), end, [](const auto &a, const auto &b) { return a.first < b.first; });
+        for (size_t i = 0; i < items.size(); ++i) items[i] = std::move(keyed[i].second);
+    }
+
+    std::string_view stringKey(const LoxValue *value) {
+        return static_cast<const LoxString *>(value)->value_;
+    }
+
+    // long double 能精确表示所有 int，int 与 float 混合时也不会比错
+    long double numberKey(const LoxValue *value) {
+        if (auto integer = dynamic_cast<const LoxInt *>(value)) return (long double) integer->value_;
+        return static_cast<const LoxFloat *>(value)->value_;
+    }
+}
+
+std::string LoxList::typeName() const {
+    return std::string{TYPE} + "[" + std::string{elementTypeName(type_)} + "]";
+}
+
+template<typename T>
+bool LoxList::convert(const LoxValuePtr &value, T &out) const {
+    if constexpr (std::is_same_v<T, int64_t>) {
+        auto integer = dynamic_cast<const LoxInt *>(value.get());
+        if (integer) out = integer->value_;
+        return integer;
+    } else if constexpr (std::is_same_v<T, double>) {
+        if (auto floating = dynamic_cast<const LoxFloat *>(value.get())) {
+            out = floating->value_;
+            return true;
+        }
+        auto integer = dynamic_cast<const LoxInt *>(value.get());
+        if (integer) out = (double) integer->value_;
+        return integer;
+    } else if constexpr (std::is_same_v<T, uint8_t>) {
+        auto boolean = dynamic_cast<const LoxBool *>(value.get());
+        if (boolean) out = boolean->value_;
+        return boolean;
+    } else {
+        if (!acceptsElement(type_, value.get())) return false;
+        out = value;
+        return true;
+    }
+}
+
+LoxValuePtr LoxList::get(size_t index) const {
+    index += offset_;
+    return std::visit([index](const auto &items) -> LoxValuePtr {
+        using T = typename std::decay_t<decltype(items)>::value_type;
+        if constexpr (std::is_same_v<T, int64_t>) return LoxInt::of(items[index]);
+        else if constexpr (std::is_same_v<T, double>) return std::make_shared<LoxFloat>(items[index]);
+        else if constexpr (std::is_same_v<T, uint8_t>) return LoxBool::of(items[index]);
+        else return items[index];
+    }, *items_);
+}
+
+bool LoxList::set(size_t index, const LoxValuePtr &value) {
+    detach();
+    if (std::visit([&](auto &items) { return convert(value, items[index]); }, *items_)) return true;
+    if (declared_) return false;
+    box();
+    std::get<Boxed>(*items_)[index] = value;
+    return true;
+}
+
+bool LoxList::append(const LoxValuePtr &value) {
+    detach();
+    bool converted = std::visit([&](auto &items) {
+        typename std::decay_t<decltype(items)>::value_type item{};
+        if (!convert(value, item)) return false;
+        items.push_back(std::move(item));
+        return true;
+    }, *items_);
+    if (!converted) {
+        if (declared_) return false;
+        box();
+        std::get<Boxed>(*items_).push_back(value);
+    }
+    ++size_;
+    return true;
+}
+
+LoxValuePtr LoxList::pop() {
+    if (size_ == 0) return nullptr;
+    auto value = get(size_ - 1);
+    detach();
+    std::visit([](auto &items) { items.pop_back(); }, *items_);
+    --size_;
+    return value;
+}
+
+void LoxList::clear() {
+    // 共享的存储留给其它列表，换成新的空存储
+    if (items_.use_count() > 1) {
+        items_ = std::make_shared<Items>(std::visit([](const auto &items) -> Items {
+            return std::decay_t<decltype(items)>{};
+        }, *items_));
+    } else {
+        std::visit([](auto &items) { items.clear(); }, *items_);
+    }
+    offset_ = size_ = 0;
+}
+
+void LoxList::reserve(size_t capacity) {
+    detach();
+    std::visit([capacity](auto &items) { items.reserve(capacity); }, *items_);
+}
+
+void LoxList::sort() {
+    detach();
+    std::visit([this](auto &items) {
+        using T = typename std::decay_t<decltype(items)>::value_type;
+        if constexpr (std::is_same_v<T, int64_t>) {
+            sorting::radixSort(items);
+        } else if constexpr (std::is_same_v<T, double>) {
+            auto end = std::partition(items.begin(), items.end(), [](double x) { return !std::isnan(x); });
+            sorting::pdqsort(items.begin(), end, std::less<>{});
+        } else if constexpr (std::is_same_v<T, uint8_t>) {
+            auto falses = std::count(items.begin(), items.end(), 0);
+            std::fill(items.begin(), items.begin() + falses, 0);
+            std::fill(items.begin() + falses, items.end(), 1);
+        } else {
+            auto is = [&](auto predicate) { return std::all_of(items.begin(), items.end(), predicate); };
+            if (type_ == ElementType::STR or is([](const auto &item) { return dynamic_cast<LoxString *>(item.get()); })) {
+                sortByKey(items, stringKey);
+            } else if (is([](const auto &item) { return dynamic_cast<LoxInt *>(item.get()) or dynamic_cast<LoxFloat *>(item.get()); })) {
+                sortByKey(items, numberKey);
+            } else {
+                throw native_error{"Only lists of numbers or strings can be sorted without a comparator."};
+            }
+        }
+    }, *items_);
+}
+
+std::vector<LoxValuePtr> LoxList::values() const {
+    std::vector<LoxValuePtr> values;
+    values.reserve(size_);
+    for (size_t i = 0; i < size_; ++i) values.push_back(get(i));
+    return values;
+}
+
+std::shared_ptr<LoxList> LoxList::slice(size_t begin, size_t end) const {
+    // 复制的 LoxList 与本列表共享存储
+    auto list = std::make_shared<LoxList>(*this);
+    list->offset_ = offset_ + begin;
+    list->size_ = end - begin;
+    if (list->size_ <= COPY_LIMIT) list->detach();
+    return list;
+}
+
+void LoxList::detach() {
+    auto length = std::visit([](const auto &items) { return items.size(); }, *items_);
+    if (items_.use_count() == 1 and offset_ == 0 and size_ == length) return;
+    items_ = std::make_shared<Items>(std::visit([this](const auto &items) -> Items {
+        auto first = items.begin() + (ptrdiff_t) offset_;
+        return std::decay_t<decltype(items)>(first, first + (ptrdiff_t) size_);
+    }, *items_));
+    offset_ = 0;
+}
+
+void LoxList::box() {
+    items_ = std::make_shared<Items>(values());
+    type_ = ElementType::ANY;
+    offset_ = 0;
+}
+
+std::ostream &LoxList::operator<<(std::ostream &o) {
+    o << '[';
+    for (size_t i = 0; i < size(); ++i) {
+        if (i) o << ", ";
+        auto value = get(i);
+        if (auto string = dynamic_cast<LoxString *>(value.get())) o << '"' << string->value_ << '"';
+        else o << *value;
+    }
+    return o << ']';
+}
+
+const LoxList::Method *LoxList::findMethod(std::string_view name) {
+    return ::findMethod(methods, name);
+}
+
+LoxValuePtr LoxList::bind(std::shared_ptr<LoxList> list, const Method &method) {
+    return std::make_shared<BoundMethod<LoxList>>(std::move(list), method);
+}
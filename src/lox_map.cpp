@@ -0,0 +1,254 @@
+#include "lox_map.hpp"
+
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "lox_list.hpp"
+#include "native.hpp"
+
+namespace {
+    constexpr size_t GROUP = 16;
+    constexpr int8_t EMPTY = -128;
+    constexpr int8_t DELETED = -2;
+
+    // 哈希值的高位决定探测的起点，低 7 位存入控制字节
+    size_t h1(size_t hash) { return hash >> 7; }
+
+    int8_t h2(size_t hash) { return (int8_t) (hash & 0x7F); }
+
+    // 一组控制字节，返回的位图中第 i 位对应组内第 i 个槽位
+    struct Group {
+#if defined(__SSE2__)
+        __m128i ctrl;
+
+        explicit Group(const int8_t *p) : ctrl{_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))} {}
+
+        uint32_t match(int8_t h) const {
+            return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h)));
+        }
+
+        // EMPTY 和 DELETED 都是负数，直接取每个字节的符号位
+        uint32_t matchFree() const {
+            return (uint32_t) _mm_movemask_epi8(ctrl);
+        }
+#else
+        int8_t ctrl[GROUP];
+
+        explicit Group(const int8_t *p) { std::memcpy(ctrl, p, GROUP); }
+
+        uint32_t match(int8_t h) const {
+            uint32_t bits = 0;
+            for (size_t i = 0; i < GROUP; ++i) bits |= (uint32_t) (ctrl[i] == h) << i;
+            return bits;
+        }
+
+        uint32_t matchFree() const {
+            uint32_t bits = 0;
+            for (size_t i = 0; i < GROUP; ++i) bits |= (uint32_t) (ctrl[i] < 0) << i;
+            return bits;
+        }
+#endif
+
+        uint32_t matchEmpty() const { return match(EMPTY); }
+    };
+
+    // 以组为单位按三角数步长探测，容量是 2 的幂时每一组都会被访问到
+    struct Probe {
+        size_t mask, pos, step{0};
+
+        Probe(size_t hash, size_t capacity) : mask{capacity - 1}, pos{h1(hash) & mask} {}
+
+        size_t slot(uint32_t bits) const { return (pos + std::countr_zero(bits)) & mask; }
+
+        void next() {
+            step += GROUP;
+            pos = (pos + step) & mask;
+        }
+    };
+
+    // 能容纳 count 个键的最小容量
+    size_t capacityFor(size_t count) {
+        size_t capacity = GROUP;
+        while (capacity / 8 * 7 < count) capacity *= 2;
+        return capacity;
+    }
+
+    const LoxString &keyOf(const LoxValuePtr &value) {
+        auto key = dynamic_cast<LoxString *>(value.get());
+        if (!key) throw native_error{"Map keys must be strings."};
+        return *key;
+    }
+
+    const LoxMap::Method methods[]{
+            {"len", 0, [](LoxMap &map, std::span<LoxValuePtr>) {
+                return LoxInt::of((int64_t) map.size());
+            }},
+            {"has", 1, [](LoxMap &map, std::span<LoxValuePtr> args) {
+                return LoxBool::of(map.contains(keyOf(args[0])));
+            }},
+            // 键不存在时返回第二个参数
+            {"get", 2, [](LoxMap &map, std::span<LoxValuePtr> args) {
+                auto value = map.get(keyOf(args[0]));
+                return value ? value : args[1];
+            }},
+            {"remove", 1, [](LoxMap &map, std::span<LoxValuePtr> args) {
+                return LoxBool::of(map.remove(keyOf(args[0])));
+            }},
+            {"keys", 0, [](LoxMap &map, std::span<LoxValuePtr>) -> LoxValuePtr {
+                auto keys = std::make_shared<LoxList>(ElementType::STR, false);
+                keys->reserve(map.size());
+                map.forEach([&](const auto &key, const auto &) { keys->append(key); });
+                return keys;
+            }},
+            {"values", 0, [](LoxMap &map, std::span<LoxValuePtr>) -> LoxValuePtr {
+                auto values = std::make_shared<LoxList>(map.valueType(), false);
+                values->reserve(map.size());
+                map.forEach([&](const auto &, const auto &value) { values->append(value); });
+                return values;
+            }},
+            {"clear", 0, [](LoxMap &map, std::span<LoxValuePtr>) {
+                map.clear();
+                return LoxNil::instance();
+            }},
+            {"reserve", 1, [](LoxMap &map, std::span<LoxValuePtr> args) {
+                auto count = native::Arg<int64_t>::get(args[0], 0);
+                if (count < 0) throw native_error{"The capacity must not be negative."};
+                map.reserve((size_t) count);
+                return LoxNil::instance();
+            }},
+    };
+}
+
+std::string LoxMap::typeName() const {
+    return std::string{TYPE} + "[" + std::string{elementTypeName(type_)} + "]";
+}
+
+size_t LoxMap::find(std::string_view key, size_t hash) const {
+    if (slots_.empty()) return NOT_FOUND;
+    for (Probe probe{hash, capacity()};; probe.next()) {
+        Group group{&ctrl_[probe.pos]};
+        for (auto bits = group.match(h2(hash)); bits; bits &= bits - 1) {
+            auto slot = probe.slot(bits);
+            const auto &entry = entries_[slots_[slot]];
+            if (entry.hash == hash and entry.key->value_ == key) return slot;
+        }
+        // 负载因子不超过 7/8，探测总会遇到空槽
+        if (group.matchEmpty()) return NOT_FOUND;
+    }
+}
+
+size_t LoxMap::claim(size_t hash) {
+    auto freeSlot = [this, hash] {
+        for (Probe probe{hash, capacity()};; probe.next()) {
+            if (auto bits = Group{&ctrl_[probe.pos]}.matchFree()) return probe.slot(bits);
+        }
+    };
+    if (slots_.empty()) rehash(GROUP);
+    auto slot = freeSlot();
+    // 复用 DELETED 的槽位不会增加负载
+    if (ctrl_[slot] == EMPTY and growthLeft_ == 0) {
+        rehash(capacityFor(size_ + 1));
+        slot = freeSlot();
+    }
+    if (ctrl_[slot] == EMPTY) --growthLeft_;
+    setCtrl(slot, h2(hash));
+    return slot;
+}
+
+void LoxMap::setCtrl(size_t slot, int8_t value) {
+    ctrl_[slot] = value;
+    if (slot < GROUP) ctrl_[capacity() + slot] = value;
+}
+
+void LoxMap::rehash(size_t capacity) {
+    if (entries_.size() != size_) {
+        std::erase_if(entries_, [](const Entry &entry) { return !entry.key; });
+    }
+    slots_.assign(capacity, 0);
+    ctrl_.assign(capacity + GROUP, EMPTY);
+    growthLeft_ = capacity / 8 * 7;
+    for (uint32_t i = 0; i < entries_.size(); ++i) {
+        slots_[claim(entries_[i].hash)] = i;
+    }
+}
+
+LoxValuePtr LoxMap::get(const LoxString &key) const {
+    auto slot = find(key.value_, key.hash());
+    return slot == NOT_FOUND ? nullptr : entries_[slots_[slot]].value;
+}
+
+bool LoxMap::contains(const LoxString &key) const {
+    return find(key.value_, key.hash()) != NOT_FOUND;
+}
+
+bool LoxMap::set(const std::shared_ptr<LoxString> &key, const LoxValuePtr &value) {
+    if (!acceptsElement(type_, value.get())) {
+        if (declared_) return false;
+        type_ = ElementType::ANY;
+    }
+    auto stored = storedElement(type_, value);
+
+    auto hash = key->hash();
+    auto slot = find(key->value_, hash);
+    if (slot != NOT_FOUND) {
+        entries_[slots_[slot]].value = std::move(stored);
+        return true;
+    }
+    slot = claim(hash);
+    slots_[slot] = (uint32_t) entries_.size();
+    entries_.push_back(Entry{key, std::move(stored), hash});
+    ++size_;
+    return true;
+}
+
+bool LoxMap::remove(const LoxString &key) {
+    auto slot = find(key.value_, key.hash());
+    if (slot == NOT_FOUND) return false;
+    auto &entry = entries_[slots_[slot]];
+    entry.key = nullptr;
+    entry.value = nullptr;
+    setCtrl(slot, DELETED);
+    --size_;
+    // 删除的键值对多于剩下的时整理 entries_
+    if (entries_.size() > GROUP and entries_.size() - size_ > size_) rehash(capacity());
+    return true;
+}
+
+void LoxMap::clear() {
+    entries_.clear();
+    slots_.clear();
+    ctrl_.clear();
+    size_ = 0;
+    growthLeft_ = 0;
+}
+
+void LoxMap::reserve(size_t count) {
+    auto target = capacityFor(count);
+    if (target > capacity()) rehash(target);
+    entries_.reserve(count);
+}
+
+std::ostream &LoxMap::operator<<(std::ostream &o) {
+    o << '{';
+    bool first = true;
+    forEach([&](const auto &key, const auto &value) {
+        if (!first) o << ", ";
+        first = false;
+        o << '"' << key->value_ << "\": ";
+        if (auto string = dynamic_cast<LoxString *>(value.get())) o << '"' << string->value_ << '"';
+        else o << *value;
+    });
+    return o << '}';
+}
+
+const LoxMap::Method *LoxMap::findMethod(std::string_view name) {
+    return ::findMethod(methods, name);
+}
+
+LoxValuePtr LoxMap::bind(std::shared_ptr<LoxMap> map, const Method &method) {
+    return std::make_shared<BoundMethod<LoxMap>>(std::move(map), method);
+}
@@ -0,0 +1,133 @@
+#include "lox_math.hpp"
+
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <tuple>
+
+#include "environment.hpp"
+#include "native.hpp"
+
+namespace {
+    template<typename F>
+    struct Function {
+        std::string_view name;
+        F function;
+    };
+
+    template<typename F>
+    Function(std::string_view, F) -> Function<F>;
+
+    const LoxInt *asInt(const LoxValuePtr &value) {
+        return dynamic_cast<const LoxInt *>(value.get());
+    }
+
+    double number(const LoxValuePtr &value, size_t index) {
+        return native::Arg<double>::get(value, index);
+    }
+
+    // 参数都是整数时结果为整数，否则为浮点数
+    LoxValuePtr minimum(const LoxValuePtr &a, const LoxValuePtr &b) {
+        auto x = asInt(a), y = asInt(b);
+        if (x and y) return LoxInt::of(std::min(x->value_, y->value_));
+        return native::box(std::fmin(number(a, 0), number(b, 1)));
+    }
+
+    LoxValuePtr maximum(const LoxValuePtr &a, const LoxValuePtr &b) {
+        auto x = asInt(a), y = asInt(b);
+        if (x and y) return LoxInt::of(std::max(x->value_, y->value_));
+        return native::box(std::fmax(number(a, 0), number(b, 1)));
+    }
+
+    // 编号为下标加 1，新的函数只能加在末尾，否则缓存中的编号会失效
+    constexpr auto functions = std::make_tuple(
+            Function{"sqrt", [](double x) { return std::sqrt(x); }},
+            Function{"abs", [](const LoxValuePtr &x) -> LoxValuePtr {
+                if (auto integer = asInt(x)) return LoxInt::of(integer->value_ < 0 ? -integer->value_ : integer->value_);
+                return native::box(std::fabs(number(x, 0)));
+            }},
+            Function{"floor", [](double x) { return std::floor(x); }},
+            Function{"ceil", [](double x) { return std::ceil(x); }},
+            Function{"round", [](double x) { return std::round(x); }},
+            Function{"trunc", [](double x) { return std::trunc(x); }},
+            Function{"min", minimum},
+            Function{"max", maximum},
+            Function{"clamp", [](const LoxValuePtr &x, const LoxValuePtr &low, const LoxValuePtr &high) {
+                return minimum(maximum(x, low), high);
+            }},
+            Function{"sin", [](double x) { return std::sin(x); }},
+            Function{"cos", [](double x) { return std::cos(x); }},
+            Function{"tan", [](double x) { return std::tan(x); }},
+            Function{"asin", [](double x) { return std::asin(x); }},
+            Function{"acos", [](double x) { return std::acos(x); }},
+            Function{"atan", [](double x) { return std::atan(x); }},
+            Function{"atan2", [](double y, double x) { return std::atan2(y, x); }},
+            Function{"exp", [](double x) { return std::exp(x); }},
+            Function{"log", [](double x) { return std::log(x); }},
+            Function{"log2", [](double x) { return std::log2(x); }},
+            Function{"log10", [](double x) { return std::log10(x); }},
+            Function{"pow", [](const LoxValuePtr &base, const LoxValuePtr &exponent) -> LoxValuePtr {
+                auto x = asInt(base), y = asInt(exponent);
+                if (x and y and y->value_ >= 0) return LoxInt::of(LoxMath::power(x->value_, y->value_));
+                return native::box(std::pow(number(base, 0), number(exponent, 1)));
+            }},
+            Function{"hypot", [](double x, double y) { return std::hypot(x, y); }}
+    );
+
+    constexpr size_t COUNT = std::tuple_size_v<decltype(functions)>;
+
+    template<size_t I>
+    using FunctionType = decltype(std::get<I>(functions).function);
+
+    template<size_t I>
+    LoxValuePtr kernel(Interpreter &interpreter, std::span<LoxValuePtr> args) {
+        auto function = std::get<I>(functions).function;
+        return native::invoke(function, interpreter, args);
+    }
+
+    struct Intrinsic {
+        std::string_view name;
+        size_t arity;
+        LoxValuePtr (*kernel)(Interpreter &, std::span<LoxValuePtr>);
+    };
+
+    template<size_t... I>
+    constexpr std::array<Intrinsic, COUNT> intrinsicsOf(std::index_sequence<I...>) {
+        return {Intrinsic{std::get<I>(functions).name, native::Signature<FunctionType<I>>::Layout::ARITY, kernel<I>}...};
+    }
+
+    constexpr auto intrinsics = intrinsicsOf(std::make_index_sequence<COUNT>{});
+
+    template<size_t... I>
+    void defineAll(Environment &module, std::index_sequence<I...>) {
+        (module.define(intrinsics[I].name, makeNative(std::string{intrinsics[I].name}, std::get<I>(functions).function)),
+                ...);
+    }
+}
+
+void LoxMath::define(Environment &module) {
+    defineAll(module, std::make_index_sequence<COUNT>{});
+    module.define("PI", std::make_shared<LoxFloat>(std::numbers::pi));
+    module.define("E", std::make_shared<LoxFloat>(std::numbers::e));
+}
+
+uint8_t LoxMath::intrinsic(std::string_view name, size_t argc) {
+    for (size_t i = 0; i < intrinsics.size(); ++i) {
+        if (intrinsics[i].name == name and intrinsics[i].arity == argc) return (uint8_t) (i + 1);
+    }
+    return 0;
+}
+
+LoxValuePtr LoxMath::call(uint8_t intrinsic, Interpreter &interpreter, std::span<LoxValuePtr> args) {
+    return intrinsics[intrinsic - 1].kernel(interpreter, args);
+}
+
+int64_t LoxMath::power(int64_t base, int64_t exponent) {
+    // 用无符号数计算，溢出时回绕而不是未定义行为
+    uint64_t result = 1, factor = (uint64_t) base;
+    for (auto e = (uint64_t) exponent; e; e >>= 1) {
+        if (e & 1) result *= factor;
+        factor *= factor;
+    }
+    return (int64_t) result;
+}
@@ -0,0 +1,51 @@
+#include "lox_module.hpp"
+#include "interpreter.hpp"
+#include "lox_array.hpp"
+#include "lox_bench.hpp"
+#include "lox_math.hpp"
+
+LoxModule::Native LoxModule::findNative(std::string_view name) {
+    if (name == LoxMath::MODULE) return LoxMath::define;
+    if (name == LoxBench::MODULE) return LoxBench::define;
+    if (name == LoxArray::MODULE) return LoxArray::define;
+    return nullptr;
+}
+
+void LoxModule::initialize(Interpreter &interpreter, const Token &token) {
+    if (auto native = findNative(name_)) {
+        auto members = std::make_shared<Environment>();
+        native(*members);
+        unit_ = std::make_shared<Unit>(Unit{nullptr, members, {}});
+        return;
+    }
+
+    module_ = ModuleRegistry::instance().load(name_, interpreter.err);
+    if (!module_) throw interpreter_error{token, "Could not load module '" + name_ + "'."};
+
+    // 先记下环境再执行，循环导入时另一方能看到已经定义的部分
+    auto globals = std::make_shared<Environment>();
+    Interpreter::defineNatives(*globals);
+    unit_ = std::make_shared<Unit>(Unit{&module_->program->tokens, globals, {}});
+
+    UnitGuard unitGuard{interpreter, unit_};
+    EnvGuard envGuard{interpreter.env, interpreter.env};
+    interpreter.env = globals;
+    try {
+        for (const auto &statement: module_->program->statements) {
+            interpreter.execute(statement);
+        }
+    } catch (interpreter_error &) {
+        unit_ = nullptr;
+        throw;
+    }
+}
+
+LoxValuePtr LoxModule::get(Interpreter &interpreter, const Token &name) {
+    if (!unit_) initialize(interpreter, name);
+
+    auto value = unit_->global->lookup(name.lexeme);
+    if (!value) {
+        throw interpreter_error{name, "Undefined member '" + std::string{name.lexeme} + "' in module '" + name_ + "'."};
+    }
+    return value;
+}
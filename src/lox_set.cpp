@@ -0,0 +1,534 @@
+#include "lox_set.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "native.hpp"
+
+namespace {
+    using StrPtr = std::shared_ptr<LoxString>;
+
+    constexpr uint8_t EMPTY = 0, FULL = 1, DELETED = 2;
+    constexpr size_t NOT_FOUND = -1;
+    constexpr size_t MIN_CAPACITY = 16;
+
+    // 整数和浮点数的哈希值要打散低位，否则线性探测时连续的值会挤在一起
+    uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    size_t hashOf(int64_t value) { return mix((uint64_t) value); }
+
+    size_t hashOf(double value) {
+        if (value == 0) value = 0;  // -0.0 与 0.0 相等
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return mix(bits);
+    }
+
+    size_t hashOf(const LoxString &value) { return value.hash(); }
+
+    bool equal(int64_t a, int64_t b) { return a == b; }
+
+    bool equal(double a, double b) { return a == b; }
+
+    bool equal(const StrPtr &a, const LoxString &b) { return a->value_ == b.value_; }
+
+    int64_t keyOf(int64_t value) { return value; }
+
+    double keyOf(double value) { return value; }
+
+    const LoxString &keyOf(const StrPtr &value) { return *value; }
+
+    // 能以不超过 1/2 的负载容纳 count 个元素的容量
+    size_t capacityFor(size_t count) {
+        return std::max(MIN_CAPACITY, std::bit_ceil(count * 2));
+    }
+
+    int64_t alignDown(int64_t value) { return value & ~(int64_t) 63; }
+
+    // [low, high] 内的 count 个整数是否足够集中，可以用位图保存
+    bool dense(int64_t low, int64_t high, size_t count) {
+        auto span = (uint64_t) high - (uint64_t) alignDown(low);
+        return span / SetElements<int64_t>::DENSE_FACTOR < (uint64_t) count;
+    }
+
+    LoxSet &setArg(const LoxValuePtr &value) {
+        auto set = dynamic_cast<LoxSet *>(value.get());
+        if (!set) throw native_error{"Argument 1 must be a set."};
+        return *set;
+    }
+
+    // 不可变的集合不能修改
+    LoxSet &mutableSet(LoxSet &set) {
+        if (set.frozen()) throw native_error{"Cannot modify an immutable set, use union() or difference() to get a modified copy."};
+        return set;
+    }
+
+    template<auto Operation>
+    LoxValuePtr combine(LoxSet &set, std::span<LoxValuePtr> args) {
+        auto &other = setArg(args[0]);
+        auto result = Operation(set, other);
+        if (!result) throw native_error{"Cannot combine a " + set.typeName() + " with a " + other.typeName() + "."};
+        return result;
+    }
+
+    const LoxSet::Method methods[]{
+            {"add", 1, [](LoxSet &set, std::span<LoxValuePtr> args) {
+                auto added = mutableSet(set).insert(args[0]);
+                if (!added) throw native_error{"Cannot add this value to a " + set.typeName() + "."};
+                return LoxBool::of(*added);
+            }},
+            {"remove", 1, [](LoxSet &set, std::span<LoxValuePtr> args) {
+                return LoxBool::of(mutableSet(set).remove(args[0].get()));
+            }},
+            {"has", 1, [](LoxSet &set, std::span<LoxValuePtr> args) {
+                return LoxBool::of(set.contains(args[0].get()));
+            }},
+            {"len", 0, [](LoxSet &set, std::span<LoxValuePtr>) {
+                return LoxInt::of((int64_t) set.size());
+            }},
+            {"clear", 0, [](LoxSet &set, std::span<LoxValuePtr>) {
+                mutableSet(set).clear();
+                return LoxNil::instance();
+            }},
+            {"reserve", 1, [](LoxSet &set, std::span<LoxValuePtr> args) {
+                auto count = native::Arg<int64_t>::get(args[0], 0);
+                if (count < 0) throw native_error{"The capacity must not be negative."};
+                mutableSet(set).reserve((size_t) count);
+                return LoxNil::instance();
+            }},
+            {"union", 1, combine<LoxSet::unite>},
+            {"intersection", 1, combine<LoxSet::intersect>},
+            {"difference", 1, combine<LoxSet::subtract>},
+    };
+}
+
+template<typename T>
+bool SetElements<T>::contains(Key key) const {
+    switch (mode_) {
+        case SetMode::SMALL:
+            for (size_t i = 0; i < size_; ++i) {
+                if (equal(small_[i], key)) return true;
+            }
+            return false;
+        case SetMode::DENSE:
+            if constexpr (std::is_same_v<T, int64_t>) {
+                auto offset = (uint64_t) key - (uint64_t) base_;
+                return key >= base_ and offset / 64 < bits_.size() and (bits_[offset / 64] >> (offset % 64)) & 1;
+            }
+            return false;
+        case SetMode::HASH:
+            return findSlot(key) != NOT_FOUND;
+    }
+    return false;
+}
+
+template<typename T>
+size_t SetElements<T>::findSlot(Key key) const {
+    auto mask = slots_.size() - 1;
+    for (auto slot = hashOf(key) & mask;; slot = (slot + 1) & mask) {
+        if (ctrl_[slot] == EMPTY) return NOT_FOUND;
+        if (ctrl_[slot] == FULL and equal(slots_[slot], key)) return slot;
+    }
+}
+
+template<typename T>
+bool SetElements<T>::insert(const T &value) {
+    if (contains(keyOf(value))) return false;
+    switch (mode_) {
+        case SetMode::SMALL:
+            if (size_ < SMALL) {
+                small_[size_] = value;
+                break;
+            }
+            if constexpr (std::is_same_v<T, int64_t>) {
+                auto [low, high] = std::minmax_element(small_.begin(), small_.end());
+                if (dense(std::min(*low, value), std::max(*high, value), size_ + 1)) {
+                    mode_ = SetMode::DENSE;
+                    base_ = alignDown(std::min(*low, value));
+                    bits_.clear();
+                    for (auto element: small_) setBit(element);
+                    setBit(value);
+                    break;
+                }
+            }
+            toHash(size_ + 1);
+            insertHash(value);
+            break;
+        case SetMode::DENSE:
+            if constexpr (std::is_same_v<T, int64_t>) {
+                if (setBit(value)) break;
+            }
+            toHash(size_ + 1);
+            insertHash(value);
+            break;
+        case SetMode::HASH:
+            insertHash(value);
+            break;
+    }
+    ++size_;
+    return true;
+}
+
+// 超出位图的范围时在密度允许的情况下扩展位图，否则返回 false
+template<typename T>
+bool SetElements<T>::setBit(int64_t value) {
+    if (value < base_ or ((uint64_t) value - (uint64_t) base_) / 64 >= bits_.size()) {
+        auto end = base_ + (int64_t) bits_.size() * 64 - 1;
+        auto low = std::min(base_, value), high = bits_.empty() ? value : std::max(end, value);
+        if (!bits_.empty() and !dense(low, high, size_ + 1)) return false;
+        auto newBase = alignDown(low);
+        auto words = ((uint64_t) high - (uint64_t) newBase) / 64 + 1;
+        if (newBase < base_ and !bits_.empty()) {
+            // 向低处扩展时整字移动，并多留出一半的空间，使递减插入的移动次数为对数级
+            auto needed = ((uint64_t) base_ - (uint64_t) newBase) / 64;
+            auto room = ((uint64_t) base_ - (uint64_t) INT64_MIN) / 64;
+            auto shift = std::min(std::max<uint64_t>(needed, bits_.size() / 2), room);
+            bits_.insert(bits_.begin(), shift, 0);
+            base_ = (int64_t) ((uint64_t) base_ - shift * 64);
+        } else if (bits_.empty()) {
+            base_ = newBase;
+        }
+        bits_.resize(std::max<size_t>(bits_.size(), words), 0);
+    }
+    auto offset = (uint64_t) value - (uint64_t) base_;
+    bits_[offset / 64] |= uint64_t{1} << (offset % 64);
+    return true;
+}
+
+template<typename T>
+void SetElements<T>::toHash(size_t count) {
+    std::vector<T> values;
+    values.reserve(size_);
+    forEach([&values](const T &value) { values.push_back(value); });
+    mode_ = SetMode::HASH;
+    small_ = {};
+    bits_.clear();
+    slots_.assign(capacityFor(count), T{});
+    ctrl_.assign(slots_.size(), EMPTY);
+    used_ = 0;
+    for (const auto &value: values) insertHash(value);
+}
+
+template<typename T>
+void SetElements<T>::insertHash(const T &value) {
+    // 删除过的槽位也计入负载，重建时一并清除
+    if ((used_ + 1) * 2 > slots_.size()) toHash(size_ + 1);
+    auto mask = slots_.size() - 1;
+    auto slot = hashOf(keyOf(value)) & mask;
+    while (ctrl_[slot] == FULL) slot = (slot + 1) & mask;
+    if (ctrl_[slot] == EMPTY) ++used_;
+    ctrl_[slot] = FULL;
+    slots_[slot] = value;
+}
+
+template<typename T>
+bool SetElements<T>::remove(Key key) {
+    switch (mode_) {
+        case SetMode::SMALL:
+            for (size_t i = 0; i < size_; ++i) {
+                if (!equal(small_[i], key)) continue;
+                small_[i] = std::move(small_[size_ - 1]);
+                small_[size_ - 1] = T{};
+                --size_;
+                return true;
+            }
+            return false;
+        case SetMode::DENSE:
+            if constexpr (std::is_same_v<T, int64_t>) {
+                if (!contains(key)) return false;
+                auto offset = (uint64_t) key - (uint64_t) base_;
+                bits_[offset / 64] &= ~(uint64_t{1} << (offset % 64));
+                --size_;
+                return true;
+            }
+            return false;
+        case SetMode::HASH: {
+            auto slot = findSlot(key);
+            if (slot == NOT_FOUND) return false;
+            ctrl_[slot] = DELETED;
+            slots_[slot] = T{};
+            --size_;
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename T>
+void SetElements<T>::clear() {
+    *this = SetElements{};
+}
+
+template<typename T>
+void SetElements<T>::reserve(size_t count) {
+    // int 的集合可能改用位图，不提前建哈希表
+    if constexpr (!std::is_same_v<T, int64_t>) {
+        if (count > SMALL and mode_ == SetMode::SMALL) toHash(count);
+    }
+    if (mode_ == SetMode::HASH and capacityFor(count) > slots_.size()) toHash(count);
+}
+
+template<typename T>
+void SetElements<T>::forEach(const std::function<void(const T &)> &f) const {
+    switch (mode_) {
+        case SetMode::SMALL:
+            for (size_t i = 0; i < size_; ++i) f(small_[i]);
+            break;
+        case SetMode::DENSE:
+            if constexpr (std::is_same_v<T, int64_t>) {
+                for (size_t word = 0; word < bits_.size(); ++word) {
+                    for (auto bits = bits_[word]; bits; bits &= bits - 1) {
+                        f(base_ + (int64_t) (word * 64 + std::countr_zero(bits)));
+                    }
+                }
+            }
+            break;
+        case SetMode::HASH:
+            for (size_t slot = 0; slot < slots_.size(); ++slot) {
+                if (ctrl_[slot] == FULL) f(slots_[slot]);
+            }
+            break;
+    }
+}
+
+template<typename T>
+SetElements<T> SetElements<T>::unite(const SetElements &a, const SetElements &b) {
+    if constexpr (std::is_same_v<T, int64_t>) {
+        if (a.mode_ == SetMode::DENSE and b.mode_ == SetMode::DENSE) {
+            auto base = std::min(a.base_, b.base_);
+            auto end = std::max(a.base_ + (int64_t) a.bits_.size() * 64, b.base_ + (int64_t) b.bits_.size() * 64) - 1;
+            if (dense(base, end, a.size_ + b.size_)) {
+                SetElements result;
+                result.mode_ = SetMode::DENSE;
+                result.base_ = base;
+                result.bits_.assign(((uint64_t) end - (uint64_t) base) / 64 + 1, 0);
+                for (const auto *set: {&a, &b}) {
+                    auto offset = ((uint64_t) set->base_ - (uint64_t) base) / 64;
+                    for (size_t i = 0; i < set->bits_.size(); ++i) result.bits_[offset + i] |= set->bits_[i];
+                }
+                for (auto word: result.bits_) result.size_ += std::popcount(word);
+                return result;
+            }
+        }
+    }
+    const auto &larger = a.size_ >= b.size_ ? a : b;
+    const auto &smaller = a.size_ >= b.size_ ? b : a;
+    auto result = larger;
+    smaller.forEach([&result](const T &value) { result.insert(value); });
+    return result;
+}
+
+template<typename T>
+SetElements<T> SetElements<T>::intersect(const SetElements &a, const SetElements &b) {
+    if constexpr (std::is_same_v<T, int64_t>) {
+        if (a.mode_ == SetMode::DENSE and b.mode_ == SetMode::DENSE) {
+            auto base = std::max(a.base_, b.base_);
+            auto end = std::min(a.base_ + (int64_t) a.bits_.size() * 64, b.base_ + (int64_t) b.bits_.size() * 64);
+            SetElements result;
+            if (base >= end) return result;
+            result.mode_ = SetMode::DENSE;
+            result.base_ = base;
+            result.bits_.resize(((uint64_t) end - (uint64_t) base) / 64);
+            auto offsetA = ((uint64_t) base - (uint64_t) a.base_) / 64, offsetB = ((uint64_t) base - (uint64_t) b.base_) / 64;
+            for (size_t i = 0; i < result.bits_.size(); ++i) {
+                result.bits_[i] = a.bits_[offsetA + i] & b.bits_[offsetB + i];
+                result.size_ += std::popcount(result.bits_[i]);
+            }
+            return result;
+        }
+    }
+    const auto &larger = a.size_ >= b.size_ ? a : b;
+    const auto &smaller = a.size_ >= b.size_ ? b : a;
+    SetElements result;
+    smaller.forEach([&](const T &value) {
+        if (larger.contains(keyOf(value))) result.insert(value);
+    });
+    return result;
+}
+
+template<typename T>
+SetElements<T> SetElements<T>::subtract(const SetElements &a, const SetElements &b) {
+    if constexpr (std::is_same_v<T, int64_t>) {
+        if (a.mode_ == SetMode::DENSE and b.mode_ == SetMode::DENSE) {
+            auto result = a;
+            for (size_t i = 0; i < result.bits_.size(); ++i) {
+                auto value = result.base_ + (int64_t) i * 64;
+                if (value < b.base_ or ((uint64_t) value - (uint64_t) b.base_) / 64 >= b.bits_.size()) continue;
+                auto word = ((uint64_t) value - (uint64_t) b.base_) / 64;
+                result.size_ -= std::popcount(result.bits_[i] & b.bits_[word]);
+                result.bits_[i] &= ~b.bits_[word];
+            }
+            return result;
+        }
+    }
+    SetElements result;
+    a.forEach([&](const T &value) {
+        if (!b.contains(keyOf(value))) result.insert(value);
+    });
+    return result;
+}
+
+template class SetElements<int64_t>;
+
+template class SetElements<double>;
+
+template class SetElements<StrPtr>;
+
+LoxSet::LoxSet(ElementType type) : type_{type} {
+    if (type == ElementType::FLOAT) elements_.emplace<SetElements<double>>();
+    else if (type == ElementType::STR) elements_.emplace<SetElements<StrPtr>>();
+}
+
+std::string LoxSet::typeName() const {
+    return (frozen_ ? "immutable " : "") + std::string{TYPE} + "[" + std::string{elementTypeName(type_)} + "]";
+}
+
+std::shared_ptr<LoxSet> LoxSet::freeze() const {
+    auto set = std::make_shared<LoxSet>(*this);
+    set->frozen_ = true;
+    return set;
+}
+
+SetMode LoxSet::mode() const {
+    return std::visit([](const auto &elements) { return elements.mode(); }, elements_);
+}
+
+size_t LoxSet::size() const {
+    return std::visit([](const auto &elements) { return elements.size(); }, elements_);
+}
+
+bool LoxSet::contains(const LoxValue *value) const {
+    if (auto integer = dynamic_cast<const LoxInt *>(value)) {
+        if (auto ints = std::get_if<SetElements<int64_t>>(&elements_)) return ints->contains(integer->value_);
+        if (auto floats = std::get_if<SetElements<double>>(&elements_)) return floats->contains((double) integer->value_);
+        return false;
+    }
+    if (auto floating = dynamic_cast<const LoxFloat *>(value)) {
+        if (auto floats = std::get_if<SetElements<double>>(&elements_)) return floats->contains(floating->value_);
+        // 与 == 一致，2.0 in {1, 2} 为 true
+        auto ints = std::get_if<SetElements<int64_t>>(&elements_);
+        auto integral = std::trunc(floating->value_);
+        return ints and integral == floating->value_ and std::fabs(integral) < 0x1p63 and ints->contains((int64_t) integral);
+    }
+    if (auto string = dynamic_cast<const LoxString *>(value)) {
+        auto strings = std::get_if<SetElements<StrPtr>>(&elements_);
+        return strings and strings->contains(*string);
+    }
+    return false;
+}
+
+std::optional<bool> LoxSet::insert(const LoxValuePtr &value) {
+    if (auto ints = std::get_if<SetElements<int64_t>>(&elements_)) {
+        auto integer = dynamic_cast<LoxInt *>(value.get());
+        if (!integer) return std::nullopt;
+        return ints->insert(integer->value_);
+    }
+    if (auto floats = std::get_if<SetElements<double>>(&elements_)) {
+        if (auto floating = dynamic_cast<LoxFloat *>(value.get())) return floats->insert(floating->value_);
+        if (auto integer = dynamic_cast<LoxInt *>(value.get())) return floats->insert((double) integer->value_);
+        return std::nullopt;
+    }
+    auto string = std::dynamic_pointer_cast<LoxString>(value);
+    if (!string) return std::nullopt;
+    return std::get<SetElements<StrPtr>>(elements_).insert(string);
+}
+
+bool LoxSet::remove(const LoxValue *value) {
+    if (auto ints = std::get_if<SetElements<int64_t>>(&elements_)) {
+        auto integer = dynamic_cast<const LoxInt *>(value);
+        return integer and ints->remove(integer->value_);
+    }
+    if (auto floats = std::get_if<SetElements<double>>(&elements_)) {
+        if (auto floating = dynamic_cast<const LoxFloat *>(value)) return floats->remove(floating->value_);
+        if (auto integer = dynamic_cast<const LoxInt *>(value)) return floats->remove((double) integer->value_);
+        return false;
+    }
+    auto string = dynamic_cast<const LoxString *>(value);
+    return string and std::get<SetElements<StrPtr>>(elements_).remove(*string);
+}
+
+void LoxSet::clear() {
+    std::visit([](auto &elements) { elements.clear(); }, elements_);
+}
+
+void LoxSet::reserve(size_t count) {
+    std::visit([count](auto &elements) { elements.reserve(count); }, elements_);
+}
+
+void LoxSet::forEach(const std::function<void(const LoxValuePtr &)> &f) const {
+    if (auto ints = std::get_if<SetElements<int64_t>>(&elements_)) {
+        ints->forEach([&f](int64_t value) { f(LoxInt::of(value)); });
+    } else if (auto floats = std::get_if<SetElements<double>>(&elements_)) {
+        floats->forEach([&f](double value) { f(std::make_shared<LoxFloat>(value)); });
+    } else {
+        std::get<SetElements<StrPtr>>(elements_).forEach([&f](const StrPtr &value) { f(value); });
+    }
+}
+
+// 两个集合的元素按同一种类型运算，int 与 float 混合时先把 int 的集合转为 float
+template<typename Operation>
+static std::shared_ptr<LoxSet> combineSets(const LoxSet &a, const LoxSet &b, Operation operation) {
+    if (a.elementType() == b.elementType()) return operation(a, b);
+    auto numeric = [](ElementType type) { return type == ElementType::INT or type == ElementType::FLOAT; };
+    if (!numeric(a.elementType()) or !numeric(b.elementType())) return nullptr;
+    auto toFloat = [](const LoxSet &set) {
+        LoxSet floats{ElementType::FLOAT};
+        floats.reserve(set.size());
+        set.forEach([&floats](const LoxValuePtr &value) { floats.insert(value); });
+        return floats;
+    };
+    return a.elementType() == ElementType::INT ? operation(toFloat(a), b) : operation(a, toFloat(b));
+}
+
+#define SET_OPERATION(name)                                                                    \
+    [](const LoxSet &x, const LoxSet &y) {                                                     \
+        auto result = std::make_shared<LoxSet>(x.type_);                                       \
+        std::visit([&](const auto &elements) {                                                 \
+            using Elements = std::decay_t<decltype(elements)>;                                 \
+            result->elements_ = Elements::name(elements, std::get<Elements>(y.elements_));     \
+        }, x.elements_);                                                                       \
+        return result;                                                                         \
+    }
+
+std::shared_ptr<LoxSet> LoxSet::unite(const LoxSet &a, const LoxSet &b) {
+    return combineSets(a, b, SET_OPERATION(unite));
+}
+
+std::shared_ptr<LoxSet> LoxSet::intersect(const LoxSet &a, const LoxSet &b) {
+    return combineSets(a, b, SET_OPERATION(intersect));
+}
+
+std::shared_ptr<LoxSet> LoxSet::subtract(const LoxSet &a, const LoxSet &b) {
+    return combineSets(a, b, SET_OPERATION(subtract));
+}
+
+#undef SET_OPERATION
+
+std::ostream &LoxSet::operator<<(std::ostream &o) {
+    o << '{';
+    bool first = true;
+    forEach([&](const LoxValuePtr &value) {
+        if (!first) o << ", ";
+        first = false;
+        if (auto string = dynamic_cast<LoxString *>(value.get())) o << '"' << string->value_ << '"';
+        else o << *value;
+    });
+    return o << '}';
+}
+
+const LoxSet::Method *LoxSet::findMethod(std::string_view name) {
+    return ::findMethod(methods, name);
+}
+
+LoxValuePtr LoxSet::bind(std::shared_ptr<LoxSet> set, const Method &method) {
+    return std::make_shared<BoundMethod<LoxSet>>(std::move(set), method);
+}
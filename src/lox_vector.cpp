@@ -0,0 +1,256 @@
+#include "lox_vector.hpp"
+
+#include <format>
+#include <vector>
+
+#include "lox_list.hpp"
+#include "native.hpp"
+
+namespace {
+    size_t indexOf(const LoxVector &vector, const LoxValuePtr &value) {
+        auto index = native::Arg<int64_t>::get(value, 0);
+        if (index < 0 or (size_t) index >= vector.size()) {
+            throw native_error{std::format("Index {} out of range for a list of size {}.", index, vector.size())};
+        }
+        return (size_t) index;
+    }
+
+    const LoxVector::Method methods[]{
+            {"len", 0, [](LoxVector &vector, std::span<LoxValuePtr>) {
+                return LoxInt::of((int64_t) vector.size());
+            }},
+            // 以下三个方法返回新的列表，原列表不变
+            {"add", 1, [](LoxVector &vector, std::span<LoxValuePtr> args) -> LoxValuePtr {
+                auto result = vector.push(args[0]);
+                if (!result) throw native_error{"Cannot add this value to an " + vector.typeName() + "."};
+                return result;
+            }},
+            {"set", 2, [](LoxVector &vector, std::span<LoxValuePtr> args) -> LoxValuePtr {
+                auto result = vector.set(indexOf(vector, args[0]), args[1]);
+                if (!result) throw native_error{"Cannot store this value in an " + vector.typeName() + "."};
+                return result;
+            }},
+            {"removeLast", 0, [](LoxVector &vector, std::span<LoxValuePtr>) -> LoxValuePtr {
+                if (vector.size() == 0) throw native_error{"Remove from an empty list."};
+                return vector.pop();
+            }},
+            // 可修改的副本
+            {"toList", 0, [](LoxVector &vector, std::span<LoxValuePtr>) -> LoxValuePtr {
+                auto list = std::make_shared<LoxList>(vector.elementType(), false);
+                list->reserve(vector.size());
+                vector.items().forEach([&](const LoxValuePtr &value) { return list->append(value); });
+                return list;
+            }},
+    };
+}
+
+PersistentVector::PersistentVector() : root_{std::make_shared<Branch>()}, tail_{std::make_shared<Leaf>()} {}
+
+PersistentVector::PersistentVector(std::span<const LoxValuePtr> values) : PersistentVector() {
+    if (values.empty()) return;
+    size_ = values.size();
+    auto tailStart = tailOffset();
+    auto tail = std::make_shared<Leaf>();
+    std::copy(values.begin() + (ptrdiff_t) tailStart, values.end(), tail->values.begin());
+    tail_ = std::move(tail);
+
+    // 先建出所有叶子，再逐层每 32 个节点合成一个父节点
+    std::vector<NodePtr> level;
+    for (size_t i = 0; i < tailStart; i += WIDTH) {
+        auto leaf = std::make_shared<Leaf>();
+        std::copy_n(values.begin() + (ptrdiff_t) i, WIDTH, leaf->values.begin());
+        level.push_back(std::move(leaf));
+    }
+    while (level.size() > WIDTH) {
+        std::vector<NodePtr> parents;
+        for (size_t i = 0; i < level.size(); i += WIDTH) {
+            auto branch = std::make_shared<Branch>();
+            auto count = std::min(WIDTH, level.size() - i);
+            std::move(level.begin() + (ptrdiff_t) i, level.begin() + (ptrdiff_t) (i + count), branch->children.begin());
+            parents.push_back(std::move(branch));
+        }
+        level = std::move(parents);
+        shift_ += BITS;
+    }
+    auto root = std::make_shared<Branch>();
+    std::move(level.begin(), level.end(), root->children.begin());
+    root_ = std::move(root);
+}
+
+const PersistentVector::Leaf &PersistentVector::leafFor(size_t index) const {
+    if (index >= tailOffset()) return *tail_;
+    const void *node = root_.get();
+    for (auto level = shift_; level > 0; level -= BITS) {
+        node = static_cast<const Branch *>(node)->children[(index >> level) & MASK].get();
+    }
+    return *static_cast<const Leaf *>(node);
+}
+
+PersistentVector PersistentVector::push(LoxValuePtr value) const {
+    auto result = *this;
+    auto inTail = size_ - tailOffset();
+    if (inTail < WIDTH) {
+        auto tail = std::make_shared<Leaf>(*tail_);
+        tail->values[inTail] = std::move(value);
+        result.tail_ = std::move(tail);
+    } else {
+        // 尾部已满：放入树中，根节点也满了时树增高一层
+        if ((size_ >> BITS) > ((size_t) 1 << shift_)) {
+            auto root = std::make_shared<Branch>();
+            root->children[0] = root_;
+            root->children[1] = newPath(shift_, tail_);
+            result.root_ = std::move(root);
+            result.shift_ += BITS;
+        } else {
+            result.root_ = pushTail(shift_, root_.get(), tail_);
+        }
+        auto tail = std::make_shared<Leaf>();
+        tail->values[0] = std::move(value);
+        result.tail_ = std::move(tail);
+    }
+    ++result.size_;
+    return result;
+}
+
+std::shared_ptr<const PersistentVector::Branch>
+PersistentVector::pushTail(size_t level, const Branch *parent, const NodePtr &tail) const {
+    auto branch = parent ? std::make_shared<Branch>(*parent) : std::make_shared<Branch>();
+    auto sub = ((size_ - 1) >> level) & MASK;
+    if (level == BITS) {
+        branch->children[sub] = tail;
+    } else {
+        auto child = static_cast<const Branch *>(branch->children[sub].get());
+        branch->children[sub] = child ? pushTail(level - BITS, child, tail) : newPath(level - BITS, tail);
+    }
+    return branch;
+}
+
+PersistentVector::NodePtr PersistentVector::newPath(size_t level, NodePtr node) {
+    if (level == 0) return node;
+    auto branch = std::make_shared<Branch>();
+    branch->children[0] = newPath(level - BITS, std::move(node));
+    return branch;
+}
+
+PersistentVector PersistentVector::set(size_t index, LoxValuePtr value) const {
+    auto result = *this;
+    if (index >= tailOffset()) {
+        auto tail = std::make_shared<Leaf>(*tail_);
+        tail->values[index & MASK] = std::move(value);
+        result.tail_ = std::move(tail);
+    } else {
+        result.root_ = std::static_pointer_cast<const Branch>(assoc(shift_, root_, index, std::move(value)));
+    }
+    return result;
+}
+
+PersistentVector::NodePtr PersistentVector::assoc(size_t level, const NodePtr &node, size_t index, LoxValuePtr value) {
+    if (level == 0) {
+        auto leaf = std::make_shared<Leaf>(*static_cast<const Leaf *>(node.get()));
+        leaf->values[index & MASK] = std::move(value);
+        return leaf;
+    }
+    auto branch = std::make_shared<Branch>(*static_cast<const Branch *>(node.get()));
+    auto sub = (index >> level) & MASK;
+    branch->children[sub] = assoc(level - BITS, branch->children[sub], index, std::move(value));
+    return branch;
+}
+
+PersistentVector PersistentVector::pop() const {
+    if (size_ == 1) return PersistentVector{};
+    auto result = *this;
+    --result.size_;
+    auto inTail = size_ - tailOffset();
+    if (inTail > 1) {
+        auto tail = std::make_shared<Leaf>(*tail_);
+        tail->values[inTail - 1] = nullptr;
+        result.tail_ = std::move(tail);
+        return result;
+    }
+
+    // 尾部只剩一个元素：树中最后一个叶子成为新的尾部
+    const Branch *parent = root_.get();
+    for (auto level = shift_; level > BITS; level -= BITS) {
+        parent = static_cast<const Branch *>(parent->children[((size_ - 2) >> level) & MASK].get());
+    }
+    result.tail_ = std::static_pointer_cast<const Leaf>(parent->children[((size_ - 2) >> BITS) & MASK]);
+
+    auto root = popTail(shift_, root_.get());
+    if (!root) root = std::make_shared<Branch>();
+    // 根节点只剩一个子节点时树降低一层
+    if (shift_ > BITS and !root->children[1]) {
+        root = std::static_pointer_cast<const Branch>(root->children[0]);
+        result.shift_ -= BITS;
+    }
+    result.root_ = std::move(root);
+    return result;
+}
+
+std::shared_ptr<const PersistentVector::Branch> PersistentVector::popTail(size_t level, const Branch *node) const {
+    auto sub = ((size_ - 2) >> level) & MASK;
+    if (level > BITS) {
+        auto child = popTail(level - BITS, static_cast<const Branch *>(node->children[sub].get()));
+        if (!child and sub == 0) return nullptr;
+        auto branch = std::make_shared<Branch>(*node);
+        branch->children[sub] = std::move(child);
+        return branch;
+    }
+    if (sub == 0) return nullptr;
+    auto branch = std::make_shared<Branch>(*node);
+    branch->children[sub] = nullptr;
+    return branch;
+}
+
+std::string LoxVector::typeName() const {
+    return std::string{TYPE} + "[" + std::string{elementTypeName(type_)} + "]";
+}
+
+std::optional<ElementType> LoxVector::typeFor(const LoxValuePtr &value) const {
+    if (acceptsElement(type_, value.get())) return type_;
+    if (declared_) return std::nullopt;
+    return ElementType::ANY;
+}
+
+std::shared_ptr<LoxVector> LoxVector::push(const LoxValuePtr &value) const {
+    auto type = typeFor(value);
+    if (!type) return nullptr;
+    return std::make_shared<LoxVector>(*type, declared_, items_.push(storedElement(*type, value)));
+}
+
+std::shared_ptr<LoxVector> LoxVector::set(size_t index, const LoxValuePtr &value) const {
+    auto type = typeFor(value);
+    if (!type) return nullptr;
+    return std::make_shared<LoxVector>(*type, declared_, items_.set(index, storedElement(*type, value)));
+}
+
+std::shared_ptr<LoxVector> LoxVector::pop() const {
+    return std::make_shared<LoxVector>(type_, declared_, items_.pop());
+}
+
+std::shared_ptr<LoxVector> LoxVector::slice(size_t begin, size_t end) const {
+    std::vector<LoxValuePtr> values;
+    values.reserve(end - begin);
+    for (auto i = begin; i < end; ++i) values.push_back(items_.get(i));
+    return std::make_shared<LoxVector>(type_, declared_, PersistentVector{values});
+}
+
+std::ostream &LoxVector::operator<<(std::ostream &o) {
+    o << '[';
+    bool first = true;
+    items_.forEach([&](const LoxValuePtr &value) {
+        if (!first) o << ", ";
+        first = false;
+        if (auto string = dynamic_cast<LoxString *>(value.get())) o << '"' << string->value_ << '"';
+        else o << *value;
+        return true;
+    });
+    return o << ']';
+}
+
+const LoxVector::Method *LoxVector::findMethod(std::string_view name) {
+    return ::findMethod(methods, name);
+}
+
+LoxValuePtr LoxVector::bind(std::shared_ptr<LoxVector> vector, const Method &method) {
+    return std::make_shared<BoundMethod<LoxVector>>(std::move(vector), method);
+}
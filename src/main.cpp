@@ -1,55 +1,195 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
-#include "parser.hpp"
-#include "resolver.hpp"
+#include <new>
+#include "source.hpp"
+#include "compiler.hpp"
 #include "interpreter.hpp"
+#include "snapshot.hpp"
+#include "server.hpp"
+#include "lox_bench.hpp"
+#include "coroutine.hpp"
 
+// 统计每个线程的堆分配次数，供 bench 模块报告
+static thread_local uint64_t allocations = 0;
 
-void run(std::string &source) {
-    // 词法解析
-    Scanner scanner{source};
-    auto tokens = scanner.getTokens();
-    if (!tokens) return;
+/* 替换全部形式的 operator new / delete（普通、数组、对齐、nothrow），都经过同一对分配和释放函数，
+ * 各种形式的分配都被计数，释放也与分配相匹配
+ * */
+static void *allocate(size_t size, size_t alignment) {
+    ++allocations;
+    size = size ? size : 1;
+    while (true) {
+        void *p = nullptr;
+        if (alignment <= alignof(std::max_align_t)) {
+            p = std::malloc(size);
+        } else if (size <= SIZE_MAX - alignment) {
+            // aligned_alloc 要求大小是对齐的整数倍
+            p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        }
+        if (p) return p;
+        auto handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc{};
+        handler();
+    }
+}
 
-    // 语法解析
-    Parser parser(tokens.value());
-    auto ast = parser.parse();
-    if (!ast) return;
+static void *allocate(size_t size, size_t alignment, const std::nothrow_t &) noexcept {
+    try {
+        return allocate(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
 
-    // 语义分析
-    Interpreter interpreter;
-    Resolver resolver{interpreter};
-    bool resolve_result = resolver.resolve(ast.value());
-    if (!resolve_result) return;
+static void deallocate(void *p) noexcept { std::free(p); }
 
-    // 解释执行
-    interpreter.interpret(ast.value());
+static constexpr size_t DEFAULT_ALIGNMENT = alignof(std::max_align_t);
+
+void *operator new(size_t size) { return allocate(size, DEFAULT_ALIGNMENT); }
+
+void *operator new[](size_t size) { return allocate(size, DEFAULT_ALIGNMENT); }
+
+void *operator new(size_t size, std::align_val_t align) { return allocate(size, (size_t) align); }
+
+void *operator new[](size_t size, std::align_val_t align) { return allocate(size, (size_t) align); }
+
+void *operator new(size_t size, const std::nothrow_t &tag) noexcept {
+    return allocate(size, DEFAULT_ALIGNMENT, tag);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+    return allocate(size, DEFAULT_ALIGNMENT, tag);
+}
+
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &tag) noexcept {
+    return allocate(size, (size_t) align, tag);
 }
 
-void runFromFile(const char *path) {
-    std::ifstream file{path, std::ios_base::in | std::ios_base::binary};
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &tag) noexcept {
+    return allocate(size, (size_t) align, tag);
+}
+
+void operator delete(void *p) noexcept { deallocate(p); }
+
+void operator delete[](void *p) noexcept { deallocate(p); }
+
+void operator delete(void *p, size_t) noexcept { deallocate(p); }
+
+void operator delete[](void *p, size_t) noexcept { deallocate(p); }
 
-    if (!file.is_open()) {
+void operator delete(void *p, std::align_val_t) noexcept { deallocate(p); }
+
+void operator delete[](void *p, std::align_val_t) noexcept { deallocate(p); }
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept { deallocate(p); }
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { deallocate(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept { deallocate(p); }
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept { deallocate(p); }
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { deallocate(p); }
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { deallocate(p); }
+
+struct RunOptions {
+    CompileOptions compile;
+    const char *loadSnapshot{nullptr};  // 运行前从快照恢复全局环境
+    const char *saveSnapshot{nullptr};  // 运行结束后把全局环境保存为快照
+    const char *serve{nullptr};     // 作为常驻进程在该套接字上等待请求
+    const char *connect{nullptr};   // 把脚本交给该套接字上的常驻进程运行
+    std::vector<std::string> arguments; // 传给脚本的参数
+};
+
+void runFromFile(const char *path, const RunOptions &options) {
+    // 源码在整个运行期间保持映射，词法单元直接引用其中的内容
+    auto source = Source::fromFile(path);
+
+    if (!source) {
         std::cerr << "Could not open file: " << path << std::endl;
         exit(-1);
     }
 
-    std::string source;
+    // 模块先在主脚本所在的目录中查找
+    std::string_view script{path};
+    auto slash = script.rfind('/');
+    std::string directory{slash == std::string_view::npos ? "." : script.substr(0, std::max<size_t>(slash, 1))};
+    ModuleRegistry::instance().configure({directory}, options.compile);
 
-    file.seekg(0, std::ios_base::end);
-    source.resize(file.tellg());
-    file.seekg(0, std::ios_base::beg);
-    file.read(&source[0], (int) source.size());
+    Interpreter interpreter;
+    interpreter.arguments = options.arguments;
+    std::shared_ptr<Snapshot> snapshot;
+    if (options.loadSnapshot) {
+        snapshot = Snapshot::load(options.loadSnapshot, interpreter);
+        if (!snapshot) {
+            std::cerr << "Could not load snapshot: " << options.loadSnapshot << std::endl;
+            exit(-1);
+        }
+    }
+
+    auto program = compile(*source, options.compile);
+    if (!program) return;
+    ModuleRegistry::instance().preload(*program);
+
+    // 解释执行
+    bool succeeded = interpreter.interpret(program->statements, program->tokens);
 
-    run(source);
+    if (succeeded and options.saveSnapshot) {
+        if (not Snapshot::save(options.saveSnapshot, *program, interpreter)) exit(-1);
+    }
 }
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cout << "Usage: " << argv[0] << " [script]" << std::endl;
+    LoxBench::setAllocationCounter([] { return allocations; });
+
+    RunOptions options;
+    const char *script = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        if (arg == "--lazy-parse") {
+            options.compile.lazyParse = true;
+        } else if (arg == "--no-cache") {
+            options.compile.useCache = false;
+        } else if (arg == "--jobs" and i + 1 < argc) {
+            options.compile.jobs = (unsigned) std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--stack-size" and i + 1 < argc) {
+            // 生成器和异步函数的栈大小，单位 KB
+            Coroutine::setStackSize((size_t) std::strtoul(argv[++i], nullptr, 10) << 10);
+        } else if (arg == "--load-snapshot" and i + 1 < argc) {
+            options.loadSnapshot = argv[++i];
+        } else if (arg == "--save-snapshot" and i + 1 < argc) {
+            options.saveSnapshot = argv[++i];
+        } else if (arg == "--serve" and i + 1 < argc) {
+            options.serve = argv[++i];
+        } else if (arg == "--connect" and i + 1 < argc) {
+            options.connect = argv[++i];
+        } else if (not arg.starts_with("--")) {
+            // 脚本之后的内容都是传给脚本的参数
+            script = argv[i];
+            options.arguments.assign(argv + i + 1, argv + argc);
+            break;
+        } else {
+            script = nullptr;
+            break;
+        }
+    }
+
+    if (options.serve and script == nullptr) {
+        Server server{options.serve, options.compile};
+        return server.serve() ? 0 : 1;
+    }
+    if (script == nullptr or options.serve) {
+        std::cout << "Usage: " << argv[0]
+                  << " [--lazy-parse] [--no-cache] [--jobs n] [--stack-size kb] [--load-snapshot file]"
+                  << " [--save-snapshot file] [--connect socket] [script [args...]]\n"
+                  << "       " << argv[0] << " [--lazy-parse] [--no-cache] [--jobs n] [--stack-size kb] --serve socket"
+                  << std::endl;
         return 1;
-    } else {
-        runFromFile(argv[1]);
     }
+    if (options.connect) return Server::connect(options.connect, script, options.arguments);
+    runFromFile(script, options);
     return 0;
 }
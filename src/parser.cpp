@@ -7,198 +7,68 @@ ExprPtr Parser::parseExpression() {
 }
 
 ExprPtr Parser::parseAssignment() {
-    auto expr = parseOr();
+    auto expr = parseBinary();
     if (match(TokenType::EQUAL)) {
         if (auto var = std::dynamic_pointer_cast<VariableExpr>(expr)) {
             return std::make_shared<AssignExpr>(var->name_, parseAssignment());
         } else if (auto get = std::dynamic_pointer_cast<GetExpr>(expr)) {
             // someObject.someProperty = value;
             return std::make_shared<SetExpr>(get->expr_, get->name_, parseAssignment());
+        } else if (auto index = std::dynamic_pointer_cast<IndexExpr>(expr)) {
+            // someList[i] = value;
+            return std::make_shared<IndexSetExpr>(index->object_, index->bracket_, index->index_, parseAssignment());
         }
         error(previous(), "Invalid assignment target.");
     }
-    if (match(TokenType::PLUS_EQUAL)) {
-        auto equals = previous();
+    // 复合赋值 `a += b` 解析为 `a = a + b`
+    auto binaryType = compoundOperator(peekType());
+    if (binaryType != TokenType::ENDMARKER) {
+        auto equals = advance();
         auto value = parseAssignment();
+        auto op = tokens.synthesize(binaryType, equals);
         if (auto var = std::dynamic_pointer_cast<VariableExpr>(expr)) {
-            equals->type = TokenType::PLUS;
-            equals->lexeme = "+";
-            value = std::make_shared<BinaryExpr>(var, equals, value);
-            return std::make_shared<AssignExpr>(var->name_, value);
-        }
-        error(equals, "Invalid assignment target.");
-    }
-    if (match(TokenType::MINUS_EQUAL)) {
-        auto equals = previous();
-        auto value = parseAssignment();
-        if (auto var = std::dynamic_pointer_cast<VariableExpr>(expr)) {
-            equals->type = TokenType::MINUS;
-            equals->lexeme = "-";
-            value = std::make_shared<BinaryExpr>(var, equals, value);
-            return std::make_shared<AssignExpr>(var->name_, value);
-        }
-        error(equals, "Invalid assignment target.");
-    }
-    if (match(TokenType::STAR_EQUAL)) {
-        auto equals = previous();
-        auto value = parseAssignment();
-        if (auto var = std::dynamic_pointer_cast<VariableExpr>(expr)) {
-            equals->type = TokenType::STAR;
-            equals->lexeme = "*";
-            value = std::make_shared<BinaryExpr>(var, equals, value);
-            return std::make_shared<AssignExpr>(var->name_, value);
-        }
-        error(equals, "Invalid assignment target.");
-    }
-    if (match(TokenType::SLASH_EQUAL)) {
-        auto equals = previous();
-        auto value = parseAssignment();
-        if (auto var = std::dynamic_pointer_cast<VariableExpr>(expr)) {
-            equals->type = TokenType::SLASH;
-            equals->lexeme = "/";
-            value = std::make_shared<BinaryExpr>(var, equals, value);
-            return std::make_shared<AssignExpr>(var->name_, value);
-        }
-        error(equals, "Invalid assignment target.");
-    }
-    if (match(TokenType::MOD_EQUAL)) {
-        auto equals = previous();
-        auto value = parseAssignment();
-        if (auto var = std::dynamic_pointer_cast<VariableExpr>(expr)) {
-            equals->type = TokenType::MOD;
-            equals->lexeme = "%";
-            value = std::make_shared<BinaryExpr>(var, equals, value);
-            return std::make_shared<AssignExpr>(var->name_, value);
+            return std::make_shared<AssignExpr>(var->name_, std::make_shared<BinaryExpr>(var, op, value));
+        } else if (auto get = std::dynamic_pointer_cast<GetExpr>(expr)) {
+            return std::make_shared<SetExpr>(get->expr_, get->name_, std::make_shared<BinaryExpr>(get, op, value));
+        } else if (auto index = std::dynamic_pointer_cast<IndexExpr>(expr)) {
+            return std::make_shared<IndexSetExpr>(index->object_, index->bracket_, index->index_,
+                                                  std::make_shared<BinaryExpr>(index, op, value));
         }
         error(equals, "Invalid assignment target.");
     }
     return expr;
 }
 
-ExprPtr Parser::parseOr() {
-    auto expr = parseAnd();
-    while (match(TokenType::OR)) {
-        expr = std::make_shared<LogicalExpr>(expr, previous(), parseAnd());
-    }
-    return expr;
-}
-
-ExprPtr Parser::parseAnd() {
-    auto expr = parseEquality();
-    while (match(TokenType::AND)) {
-        expr = std::make_shared<LogicalExpr>(expr, previous(), parseEquality());
-    }
-    return expr;
-}
-
-ExprPtr Parser::parseEquality() {
-    auto expr = parseComparison();
-    while (match(TokenType::NOT_EQUAL, TokenType::EQUAL_EQUAL)) {
-        auto p = previous();
-        auto e = parseComparison();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
-    }
-    return expr;
-}
-
-ExprPtr Parser::parseComparison() {
-    auto expr = parseInIsExpr();
-    while (match(TokenType::LESS, TokenType::LESS_EQUAL, TokenType::GREATER, TokenType::GREATER_EQUAL)) {
-        auto p = previous();
-        auto e = parseInIsExpr();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
-    }
-    return expr;
-}
-
-// 是否需要左边的表达式(when语句中不需要),默认需要
-ExprPtr Parser::parseInIsExpr(bool needLeft) {
-    ExprPtr expr = needLeft ? parseRangeExpr() : nullptr;
-    if (check(TokenType::NOT) and not atEnd()) {
-        auto next = tokens[current + 1];
-        if (next->type == TokenType::IN or next->type == TokenType::IS) {
-            auto p = advance(); // NOT
-            p->type = check(TokenType::IN) ? TokenType::NOTIN : TokenType::NOTIS;
-            p->lexeme = check(TokenType::IN) ? "not in" : "not is";
-            advance();  // consume IN or IS
-            auto e = parseRangeExpr();
-            return std::make_shared<BinaryExpr>(expr, p, e);
+/* 运算符优先级解析（Pratt）
+ * 每个二元运算符的优先级和结合性都记录在 binaryRules 表中，
+ * 解析一个操作数后只需在循环中查表，而不必为每个操作数逐层下降。
+ * */
+ExprPtr Parser::parseBinary(int minPrecedence) {
+    auto expr = parseUnary();
+    int ceiling = PREC_MAX + 1;  // 不可结合的运算符（in、is、..）之后不能再出现同级运算符
+    while (true) {
+        auto type = peekType();
+        bool negated = false;
+        if (type == TokenType::NOT) {   // not in / not is
+            auto next = tokens.type(current + 1);
+            if (next != TokenType::IN and next != TokenType::IS) break;
+            type = next == TokenType::IN ? TokenType::NOTIN : TokenType::NOTIS;
+            negated = true;
         }
-    }
-    if (match(TokenType::IN, TokenType::IS)) {
-        auto p = previous();
-        auto e = parseRangeExpr();
-        return std::make_shared<BinaryExpr>(expr, p, e);
-    }
-    return expr;
-}
-
-ExprPtr Parser::parseRangeExpr() {
-    auto expr = parseBitOr();
-    if (match(TokenType::RANGE)) {
-        auto p = previous();
-        auto e = parseBitOr();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
-    }
-    return expr;
-}
-
-ExprPtr Parser::parseBitOr() {
-    auto expr = parseBitXor();
-    while (match(TokenType::BIT_OR)) {
-        auto p = previous();
-        auto e = parseBitXor();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
-    }
-    return expr;
-}
-
-ExprPtr Parser::parseBitXor() {
-    auto expr = parseBitAnd();
-    while (match(TokenType::BIT_XOR)) {
-        auto p = previous();
-        auto e = parseBitAnd();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
-    }
-    return expr;
-}
-
-ExprPtr Parser::parseBitAnd() {
-    auto expr = parseBitShift();
-    while (match(TokenType::BIT_AND)) {
-        auto p = previous();
-        auto e = parseBitShift();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
-    }
-    return expr;
-}
 
-ExprPtr Parser::parseBitShift() {
-    auto expr = parseTerm();
-    while (match(TokenType::SHIFT_L, TokenType::SHIFT_R, TokenType::SHIFT_RA)) {
-        auto p = previous();
-        auto e = parseTerm();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
-    }
-    return expr;
-}
+        auto rule = binaryRules[(size_t) type];
+        if (rule.precedence < minPrecedence or rule.precedence >= ceiling) break;
 
-ExprPtr Parser::parseTerm() {
-    auto expr = parseFactor();
-    while (match(TokenType::MINUS, TokenType::PLUS)) {
-        auto p = previous();
-        auto e = parseFactor();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
-    }
-    return expr;
-}
+        auto op = advance();
+        if (negated) op = tokens.synthesize(type, op), advance();   // consume IN or IS
 
-ExprPtr Parser::parseFactor() {
-    auto expr = parseUnary();
-    while (match(TokenType::STAR, TokenType::SLASH, TokenType::MOD)) {
-        auto p = previous();
-        auto e = parseUnary();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
+        auto right = parseBinary(rule.associativity == Associativity::RIGHT ? rule.precedence : rule.precedence + 1);
+        if (rule.logical) {
+            expr = std::make_shared<LogicalExpr>(expr, op, right);
+        } else {
+            expr = std::make_shared<BinaryExpr>(expr, op, right);
+        }
+        if (rule.associativity == Associativity::NONE) ceiling = rule.precedence;
     }
     return expr;
 }
@@ -206,20 +76,15 @@ ExprPtr Parser::parseFactor() {
 ExprPtr Parser::parseUnary() {
     if (match(TokenType::MINUS, TokenType::NOT, TokenType::BIT_NOT)) {
         auto p = previous();
-        auto e = parseUnary();
+        // 幂运算的优先级高于一元运算符：-2 ** 2 == -(2 ** 2)
+        auto e = parseBinary(PREC_POWER);
         return std::make_shared<UnaryExpr>(p, e);
     }
-    return parsePower();
-}
-
-ExprPtr Parser::parsePower() {
-    auto expr = parseCall();
-    while (match(TokenType::POWER)) {
-        auto p = previous();
-        auto e = parseUnary();
-        expr = std::make_shared<BinaryExpr>(expr, p, e);
+    if (match(TokenType::AWAIT)) {
+        auto keyword = previous();
+        return std::make_shared<AwaitExpr>(keyword, parseUnary());
     }
-    return expr;
+    return parseCall();
 }
 
 ExprPtr Parser::parseCall() {
@@ -230,6 +95,17 @@ ExprPtr Parser::parseCall() {
         } else if (match(TokenType::DOT)) {
             auto name = consume(TokenType::IDENTIFIER, "Expect property name after '.'");
             expr = std::make_shared<GetExpr>(expr, name);
+        } else if (match(TokenType::LEFT_SQUARE)) {
+            auto bracket = previous();
+            auto index = check(TokenType::COLON) ? nullptr : parseBinary();
+            if (match(TokenType::COLON)) {
+                auto end = check(TokenType::RIGHT_SQUARE) ? nullptr : parseBinary();
+                consume(TokenType::RIGHT_SQUARE, "Expected ']' after slice");
+                expr = std::make_shared<SliceExpr>(expr, bracket, index, end);
+                continue;
+            }
+            consume(TokenType::RIGHT_SQUARE, "Expected ']' after index");
+            expr = std::make_shared<IndexExpr>(expr, bracket, index);
         } else {
             break;
         }
@@ -242,7 +118,7 @@ ExprPtr Parser::finishCall(const ExprPtr &expr) {
     if (not check(TokenType::RIGHT_PAREN)) {
         do {
             if (args->size() >= 255) error(peek(), "Can't have more than 255 arguments");
-            args->push_back(parseOr());
+            args->push_back(parseBinary());
         } while (match(TokenType::COMMA));
     }
     auto paren = consume(TokenType::RIGHT_PAREN, "Expected ')' after arguments");
@@ -251,7 +127,7 @@ ExprPtr Parser::finishCall(const ExprPtr &expr) {
 
 ExprPtr Parser::parsePrimary() {
     if (match(TokenType::INTEGER, TokenType::FLOATING)) {
-        return std::make_shared<LiteralExpr>(previous()->value);
+        return std::make_shared<LiteralExpr>(tokens.literal(previous()), tokens.newLiteralSlot());
     }
     if (match(TokenType::IDENTIFIER)) {
         return std::make_shared<VariableExpr>(previous());
@@ -260,25 +136,65 @@ ExprPtr Parser::parsePrimary() {
         auto strs = std::make_shared<std::vector<ExprPtr>>();
         while (true) {
             if (match(TokenType::STRING)) {
-                strs->emplace_back(std::make_shared<LiteralExpr>(previous()->value));
+                strs->emplace_back(std::make_shared<LiteralExpr>(tokens.literal(previous()), tokens.newLiteralSlot()));
             } else if (match(TokenType::STR_END)) {
                 break;
             } else {
-                strs->emplace_back(parseOr());
+                strs->emplace_back(parseBinary());
             }
         }
         return std::make_shared<StrExpr>(strs);
     }
     if (match(TokenType::TRUE, TokenType::FALSE)) {
-        return std::make_shared<LiteralExpr>(std::make_shared<LoxBool>(previous()->type == TokenType::TRUE));
+        return std::make_shared<LiteralExpr>(std::make_shared<LoxBool>(tokens.type(previous()) == TokenType::TRUE),
+                                             tokens.newLiteralSlot());
     }
     if (match(TokenType::LEFT_PAREN)) {
-        auto exp = parseOr();
+        auto exp = parseBinary();
         consume(TokenType::RIGHT_PAREN, "Expected ')' after expression");
         return std::make_shared<GroupingExpr>(exp);
     }
+    if (match(TokenType::LEFT_SQUARE)) {
+        auto bracket = previous();
+        auto elements = std::make_shared<std::vector<ExprPtr>>();
+        if (not check(TokenType::RIGHT_SQUARE)) {
+            do {
+                if (check(TokenType::RIGHT_SQUARE)) break;  // 允许末尾的逗号
+                elements->push_back(parseBinary());
+            } while (match(TokenType::COMMA));
+        }
+        consume(TokenType::RIGHT_SQUARE, "Expected ']' after list elements");
+        return std::make_shared<ListExpr>(bracket, elements);
+    }
+    if (match(TokenType::LEFT_BRACE)) {
+        auto brace = previous();
+        auto keys = std::make_shared<std::vector<ExprPtr>>();
+        auto values = std::make_shared<std::vector<ExprPtr>>();
+        // 第一个元素之后没有 ':' 时是集合；{} 是空字典，空集合由类型标注得到
+        if (not check(TokenType::RIGHT_BRACE)) {
+            keys->push_back(parseBinary());
+            if (not check(TokenType::COLON)) {
+                while (match(TokenType::COMMA)) {
+                    if (check(TokenType::RIGHT_BRACE)) break;   // 允许末尾的逗号
+                    keys->push_back(parseBinary());
+                }
+                consume(TokenType::RIGHT_BRACE, "Expected '}' after set elements");
+                return std::make_shared<SetLiteralExpr>(brace, keys);
+            }
+            consume(TokenType::COLON, "Expected ':' after map key");
+            values->push_back(parseBinary());
+            while (match(TokenType::COMMA)) {
+                if (check(TokenType::RIGHT_BRACE)) break;   // 允许末尾的逗号
+                keys->push_back(parseBinary());
+                consume(TokenType::COLON, "Expected ':' after map key");
+                values->push_back(parseBinary());
+            }
+        }
+        consume(TokenType::RIGHT_BRACE, "Expected '}' after map entries");
+        return std::make_shared<MapExpr>(brace, keys, values);
+    }
     if (match(TokenType::NIL)) {
-        return std::make_shared<LiteralExpr>(std::make_shared<LoxNil>());
+        return std::make_shared<LiteralExpr>(std::make_shared<LoxNil>(), tokens.newLiteralSlot());
     }
     if (match(TokenType::THIS)) {
         return std::make_shared<ThisExpr>(previous());
@@ -294,7 +210,7 @@ ExprPtr Parser::parsePrimary() {
 
 StmtPtr Parser::parseIfStmt() {
     consume(TokenType::LEFT_PAREN, "Expected '(' after if");
-    auto cond = parseOr();
+    auto cond = parseBinary();
     consume(TokenType::RIGHT_PAREN, "Expected ')' after condition");
     auto then = parseStatement();
 
@@ -302,7 +218,7 @@ StmtPtr Parser::parseIfStmt() {
     IfStmtPtr lastElse = nullptr;
     while (match(TokenType::ELIF)) {
         consume(TokenType::LEFT_PAREN, "Expected '(' after elif");
-        auto elifCond = parseOr();
+        auto elifCond = parseBinary();
         consume(TokenType::RIGHT_PAREN, "Expected ')' after elif condition");
         auto elifThen = parseStatement();
 
@@ -322,7 +238,7 @@ StmtPtr Parser::parseIfStmt() {
 
 StmtPtr Parser::parseWhileStmt() {
     consume(TokenType::LEFT_PAREN, "Expected '(' after while");
-    auto cond = parseOr();
+    auto cond = parseBinary();
     consume(TokenType::RIGHT_PAREN, "Expected ')' after condition");
     auto whileBlock = parseStatement();
     return std::make_shared<WhileStmt>(cond, whileBlock);
@@ -332,7 +248,7 @@ StmtPtr Parser::parseForStmt() {
     consume(TokenType::LEFT_PAREN, "Expected '(' after for");
     auto variable = consume(TokenType::IDENTIFIER, "Expected class name.");
     consume(TokenType::IN, "Expected 'in' after variable");
-    auto iterable = parseRangeExpr();
+    auto iterable = parseBinary(PREC_RANGE);
     consume(TokenType::RIGHT_PAREN, "Expected ')' after  iterable");
     auto body = parseStatement();
     return std::make_shared<ForStmt>(variable, iterable, body);
@@ -340,7 +256,7 @@ StmtPtr Parser::parseForStmt() {
 
 StmtPtr Parser::parseWhenStmt() {
     consume(TokenType::LEFT_PAREN, "Expected '(' after when");
-    auto whenCond = parseOr();  // 条件的一半
+    auto whenCond = parseBinary();  // 条件的一半
     consume(TokenType::RIGHT_PAREN, "Expected ')' after condition");
     consume(TokenType::LEFT_BRACE, "Expected '{' after ')'");
 
@@ -348,21 +264,19 @@ StmtPtr Parser::parseWhenStmt() {
     do {
         auto conds = std::vector<ExprPtr>();
         do {
-            auto cond = parseInIsExpr(false);
-            if (cond == nullptr) error(previous(), "Condition error.");
-            if (auto right = std::dynamic_pointer_cast<BinaryExpr>(cond)) {
-                if (right->op_->type == TokenType::IN or right->op_->type == TokenType::IS
-                    or right->op_->type == TokenType::NOTIN or right->op_->type == TokenType::NOTIS) {
-                    right->left_ = whenCond;
-                    conds.push_back(right);
-                } else { // 不是 IN IS 的情况
-                    error(right->op_, "Unsupported condition.");
-                }
-            } else {    // 单个条件
-                auto eq
-                        = std::make_shared<Token>(TokenType::EQUAL_EQUAL, nullptr, "==", previous()->line);
-                conds.emplace_back(std::make_shared<BinaryExpr>(whenCond, eq, cond));
+            // `in x`、`is T`、`not in x`、`not is T` 省略了左侧的 when 表达式，其余情况与 when 表达式比较是否相等
+            TokenId op;
+            if (match(TokenType::IN, TokenType::IS)) {
+                op = previous();
+            } else if (check(TokenType::NOT) and (tokens.type(current + 1) == TokenType::IN
+                                                  or tokens.type(current + 1) == TokenType::IS)) {
+                op = tokens.synthesize(tokens.type(current + 1) == TokenType::IN ? TokenType::NOTIN : TokenType::NOTIS,
+                                       advance());
+                advance();  // consume IN or IS
+            } else {
+                op = tokens.synthesize(TokenType::EQUAL_EQUAL, peek());
             }
+            conds.emplace_back(std::make_shared<BinaryExpr>(whenCond, op, parseBinary(PREC_RANGE)));
         } while (match(TokenType::COMMA));
         consume(TokenType::ARROW, "Expected '->' after cond");
         auto block = parseStatement();
@@ -391,12 +305,22 @@ StmtPtr Parser::parseReturnStmt() {
     auto returnToken = previous();
     ExprPtr value;
     if (not check(TokenType::SEMICOLON)) {
-        value = parseOr();
+        value = parseBinary();
     }
     consume(TokenType::SEMICOLON, "Expected ';' after return statement.");
     return std::make_shared<ReturnStmt>(returnToken, value);
 }
 
+StmtPtr Parser::parseYieldStmt() {
+    auto keyword = previous();
+    ExprPtr value;
+    if (not check(TokenType::SEMICOLON)) {
+        value = parseBinary();
+    }
+    consume(TokenType::SEMICOLON, "Expected ';' after yield statement.");
+    return std::make_shared<YieldStmt>(keyword, value);
+}
+
 std::shared_ptr<std::vector<StmtPtr>> Parser::parseBlock() {
     auto statements = std::make_shared<std::vector<StmtPtr>>();
     while (not check(TokenType::RIGHT_BRACE) and not atEnd()) {
@@ -406,9 +330,13 @@ std::shared_ptr<std::vector<StmtPtr>> Parser::parseBlock() {
     return statements;
 }
 
-// todo: 解析import语句
 StmtPtr Parser::parseImport() {
-    return nullptr;
+    auto path = std::make_shared<std::vector<TokenId>>();
+    do {
+        path->push_back(consume(TokenType::IDENTIFIER, "Expected module name."));
+    } while (match(TokenType::DOT));
+    consume(TokenType::SEMICOLON, "Expected ';' after import.");
+    return std::make_shared<ImportStmt>(path);
 }
 
 StmtPtr Parser::parseExpressionStmt() {
@@ -430,6 +358,9 @@ StmtPtr Parser::parseStatement() {
     if (match(TokenType::RETURN)) {
         return parseReturnStmt();
     }
+    if (match(TokenType::YIELD)) {
+        return parseYieldStmt();
+    }
     if (match(TokenType::WHEN)) {
         return parseWhenStmt();
     }
@@ -449,28 +380,45 @@ StmtPtr Parser::parseStatement() {
     return parseExpressionStmt();
 }
 
+// 类型标注：name 或 name[element]
+TypeAnnotationPtr Parser::parseType() {
+    auto type = std::make_shared<TypeAnnotation>();
+    type->name_ = consume(TokenType::IDENTIFIER, "Expected type name.");
+    if (match(TokenType::LEFT_SQUARE)) {
+        type->element_ = parseType();
+        consume(TokenType::RIGHT_SQUARE, "Expected ']' after element type.");
+    }
+    return type;
+}
+
 StmtPtr Parser::parseLetDeclaration() {
     auto identifier = consume(TokenType::IDENTIFIER, "Expected let name.");
-    consume(TokenType::EQUAL, "'" + identifier->lexeme + "' must be initialized.");
+    TypeAnnotationPtr type = match(TokenType::COLON) ? parseType() : nullptr;
+    consume(TokenType::EQUAL, "'" + std::string{tokens.lexeme(identifier)} + "' must be initialized.");
     ExprPtr init = parseExpression();
     consume(TokenType::SEMICOLON, "Expected ';' after let declaration");
-    return std::make_shared<LetStmt>(identifier, init);
+    auto let = std::make_shared<LetStmt>(identifier, init);
+    let->type_ = type;
+    return let;
 }
 
 StmtPtr Parser::parseVarDeclaration() {
     auto identifier = consume(TokenType::IDENTIFIER, "Expected variable name.");
+    TypeAnnotationPtr type = match(TokenType::COLON) ? parseType() : nullptr;
     ExprPtr init = nullptr;
     if (match(TokenType::EQUAL)) {
         init = parseExpression();
     }
     consume(TokenType::SEMICOLON, "Expected ';' after var declaration");
-    return std::make_shared<VarStmt>(identifier, init);
+    auto var = std::make_shared<VarStmt>(identifier, init);
+    var->type_ = type;
+    return var;
 }
 
 FunctionStmtPtr Parser::parseFunction(const std::string &kind) {
     auto name = consume(TokenType::IDENTIFIER, "Expected " + kind + " name.");
     consume(TokenType::LEFT_PAREN, "Expected '(' after " + kind + " name.");
-    auto params = std::make_shared<std::vector<TokenPtr>>();
+    auto params = std::make_shared<std::vector<TokenId>>();
     if (not check(TokenType::RIGHT_PAREN)) {
         do {
             if (params->size() >= 255) error(peek(), "Can't have more than 255 parameters.");
@@ -479,6 +427,19 @@ FunctionStmtPtr Parser::parseFunction(const std::string &kind) {
     }
     consume(TokenType::RIGHT_PAREN, "Expected ')' after parameters.");
     consume(TokenType::LEFT_BRACE, "Expected '{' before " + kind + " body.");
+    if (lazy_) {
+        // 预解析：只匹配括号，跳过整个函数体
+        auto begin = current;
+        for (int depth = 1; depth > 0;) {
+            if (atEnd()) throw error(peek(), "Expected '}' after block");
+            auto type = tokens.type(advance());
+            if (type == TokenType::LEFT_BRACE) ++depth;
+            else if (type == TokenType::RIGHT_BRACE) --depth;
+        }
+        auto function = std::make_shared<FunctionStmt>(name, params, nullptr);
+        function->lazy_ = std::make_shared<LazyBody>(LazyBody{&tokens, begin, {}});
+        return function;
+    }
     auto body = parseBlock();
     return std::make_shared<FunctionStmt>(name, params, body);
 }
@@ -492,9 +453,11 @@ StmtPtr Parser::parseClass() {
     }
     consume(TokenType::LEFT_BRACE, "Expected '{' before class body.");
     auto methods = std::make_shared<std::vector<FunctionStmtPtr>>();
-    while (not check(TokenType::RIGHT_BRACE) or not atEnd()) {
+    while (not check(TokenType::RIGHT_BRACE) and not atEnd()) {
+        bool async = match(TokenType::ASYNC);
         consume(TokenType::FUN, "Expected the 'fun' keyword in the class body.");
         methods->push_back(parseFunction("method"));
+        methods->back()->async_ = async;
     }
     consume(TokenType::RIGHT_BRACE, "Expected '}' after class body.");
     return std::make_shared<ClassStmt>(name, superClass, methods);
@@ -519,6 +482,12 @@ StmtPtr Parser::parseDeclaration() {
         if (match(TokenType::FUN)) {
             return parseFunction("function");
         }
+        if (match(TokenType::ASYNC)) {
+            consume(TokenType::FUN, "Expected 'fun' after 'async'.");
+            auto function = parseFunction("function");
+            function->async_ = true;
+            return function;
+        }
         if (match(TokenType::CLASS)) {
             return parseClass();
         }
@@ -537,11 +506,12 @@ StmtPtr Parser::parseDeclaration() {
 void Parser::synchronize() {
     advance();
     while (not atEnd()) {
-        if (previous()->type == TokenType::SEMICOLON) return;
-        switch (peek()->type) {
+        if (tokens.type(previous()) == TokenType::SEMICOLON) return;
+        switch (peekType()) {
             default:break;
             case TokenType::IF:
             case TokenType::FUN:
+            case TokenType::ASYNC:
             case TokenType::LET:
             case TokenType::VAR:
             case TokenType::FOR:
@@ -551,6 +521,7 @@ void Parser::synchronize() {
             case TokenType::WHILE:
             case TokenType::IMPORT:
             case TokenType::RETURN:
+            case TokenType::YIELD:
             case TokenType::CONTINUE: return;
         }
         advance();
@@ -567,3 +538,12 @@ std::optional<std::vector<StmtPtr>> Parser::parse() {
 
     return statements;
 }
+
+std::shared_ptr<std::vector<StmtPtr>> Parser::parseBody(TokenId begin) {
+    current = begin;
+    try {
+        auto body = parseBlock();
+        if (not parsing_failed) return body;
+    } catch (parsing_error &error) {}
+    return nullptr;
+}
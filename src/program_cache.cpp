@@ -0,0 +1,694 @@
+#include "program_cache.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+
+namespace {
+    constexpr char MAGIC[8] = {'I', 'D', 'U', 'N', 'C', 'A', 'C', 'H'};
+
+    enum class ValueTag : uint8_t {
+        NONE, NIL, BOOL, INT, FLOAT, STRING
+    };
+
+    enum class NodeTag : uint8_t {
+        NONE,
+        // 表达式
+        ASSIGN, BINARY, GROUPING, LITERAL, STR, UNARY, VARIABLE, LOGICAL, CALL, GET, SET, THIS, SUPER, LIST, INDEX,
+        INDEX_SET, MAP, SET_LITERAL, SLICE, AWAIT,
+        // 语句
+        IF, WHILE, CONTINUE, BREAK, FOR, WHEN, BLOCK, EXPRESSION, LET, VAR, FUNCTION, RETURN, CLASS, IMPORT,
+        YIELD
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t sourceHash;
+        uint64_t sourceSize;
+        uint64_t payloadHash;   // 防止读到被截断或损坏的文件
+    };
+    // 文件内容依次为 Header、源码（加载时逐字节比较，哈希值相同的不同源码不会误用缓存）、程序的编码
+
+    // 语法树按先序写出，空指针写作 NodeTag::NONE
+    class ProgramWriter : public Expr::AbstractVisitor, public Stmt::AbstractVisitor {
+    public:
+        ProgramWriter(std::string &out, std::unordered_map<const FunctionStmt *, uint32_t> *functions)
+                : out{out}, functions{functions} {}
+
+        template<typename T>
+        void put(T value) {
+            out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        void put(std::string_view text) {
+            put((uint32_t) text.size());
+            out.append(text);
+        }
+
+        void put(NodeTag tag) { put((uint8_t) tag); }
+
+        void put(const LoxValuePtr &value) {
+            if (auto v = std::dynamic_pointer_cast<LoxString>(value)) {
+                put((uint8_t) ValueTag::STRING), put(std::string_view{v->value_});
+            } else if (auto i = std::dynamic_pointer_cast<LoxInt>(value)) {
+                put((uint8_t) ValueTag::INT), put(i->value_);
+            } else if (auto f = std::dynamic_pointer_cast<LoxFloat>(value)) {
+                put((uint8_t) ValueTag::FLOAT), put(f->value_);
+            } else if (auto b = std::dynamic_pointer_cast<LoxBool>(value)) {
+                put((uint8_t) ValueTag::BOOL), put((uint8_t) b->value_);
+            } else if (std::dynamic_pointer_cast<LoxNil>(value)) {
+                put((uint8_t) ValueTag::NIL);
+            } else {
+                put((uint8_t) ValueTag::NONE);
+            }
+        }
+
+        void tokens(const TokenBuffer &buffer) {
+            put((uint32_t) buffer.size());
+            buffer.saveColumns(out);
+            put((uint32_t) buffer.literals().size());
+            for (const auto &[id, value]: buffer.literals()) {
+                put(id), put(value);
+            }
+        }
+
+        void write(const ExprPtr &expr) {
+            if (!expr) return put(NodeTag::NONE);
+            expr->accept(*this);
+        }
+
+        void write(const StmtPtr &stmt) {
+            if (!stmt) return put(NodeTag::NONE);
+            stmt->accept(*this);
+        }
+
+        void write(const std::vector<ExprPtr> &exprs) {
+            put((uint32_t) exprs.size());
+            for (const auto &expr: exprs) write(expr);
+        }
+
+        void write(const std::vector<StmtPtr> &stmts) {
+            put((uint32_t) stmts.size());
+            for (const auto &stmt: stmts) write(stmt);
+        }
+
+        void write(const TypeAnnotationPtr &type) {
+            if (!type) return put((uint8_t) 0);
+            put((uint8_t) 1), put(type->name_), write(type->element_);
+        }
+
+        void visitAssignExpr(AssignExpr *expr) override {
+            put(NodeTag::ASSIGN), put(expr->name_), write(expr->value_), put((int32_t) expr->depth_);
+        }
+
+        void visitBinaryExpr(BinaryExpr *expr) override {
+            put(NodeTag::BINARY), write(expr->left_), put(expr->op_), write(expr->right_);
+        }
+
+        void visitGroupingExpr(GroupingExpr *expr) override {
+            put(NodeTag::GROUPING), write(expr->expression_);
+        }
+
+        void visitLiteralExpr(LiteralExpr *expr) override {
+            put(NodeTag::LITERAL), put(expr->value_);
+        }
+
+        void visitStrExpr(StrExpr *expr) override {
+            put(NodeTag::STR), write(*expr->strs);
+        }
+
+        void visitUnaryExpr(UnaryExpr *expr) override {
+            put(NodeTag::UNARY), put(expr->op_), write(expr->right_);
+        }
+
+        void visitVariableExpr(VariableExpr *expr) override {
+            put(NodeTag::VARIABLE), put(expr->name_), put((int32_t) expr->depth_);
+        }
+
+        void visitLogicalExpr(LogicalExpr *expr) override {
+            put(NodeTag::LOGICAL), write(expr->left_), put(expr->op_), write(expr->right_);
+        }
+
+        void visitCallExpr(CallExpr *expr) override {
+            put(NodeTag::CALL), write(expr->callee_), put(expr->paren_), write(*expr->args_), put(expr->intrinsic_);
+        }
+
+        void visitGetExpr(GetExpr *expr) override {
+            put(NodeTag::GET), write(expr->expr_), put(expr->name_);
+        }
+
+        void visitSetExpr(SetExpr *expr) override {
+            put(NodeTag::SET), write(expr->expr_), put(expr->name_), write(expr->value_);
+        }
+
+        void visitThisExpr(ThisExpr *expr) override {
+            put(NodeTag::THIS), put(expr->keyword_), put((int32_t) expr->depth_);
+        }
+
+        void visitSuperExpr(SuperExpr *expr) override {
+            put(NodeTag::SUPER), put(expr->keyword_), put(expr->method_), put((int32_t) expr->depth_);
+        }
+
+        void visitListExpr(ListExpr *expr) override {
+            put(NodeTag::LIST), put(expr->bracket_), write(*expr->elements_), write(expr->elementType_);
+        }
+
+        void visitIndexExpr(IndexExpr *expr) override {
+            put(NodeTag::INDEX), write(expr->object_), put(expr->bracket_), write(expr->index_);
+        }
+
+        void visitIndexSetExpr(IndexSetExpr *expr) override {
+            put(NodeTag::INDEX_SET), write(expr->object_), put(expr->bracket_), write(expr->index_), write(expr->value_);
+        }
+
+        void visitMapExpr(MapExpr *expr) override {
+            put(NodeTag::MAP), put(expr->brace_), write(*expr->keys_), write(*expr->values_), write(expr->valueType_);
+        }
+
+        void visitSliceExpr(SliceExpr *expr) override {
+            put(NodeTag::SLICE), write(expr->object_), put(expr->bracket_), write(expr->begin_), write(expr->end_);
+        }
+
+        void visitAwaitExpr(AwaitExpr *expr) override {
+            put(NodeTag::AWAIT), put(expr->keyword_), write(expr->value_);
+        }
+
+        void visitSetLiteralExpr(SetLiteralExpr *expr) override {
+            put(NodeTag::SET_LITERAL), put(expr->brace_), write(*expr->elements_), write(expr->elementType_);
+        }
+
+        void visitIfStmt(IfStmt *stmt) override {
+            put(NodeTag::IF), write(stmt->condition_), write(stmt->thenStmt_), write(stmt->elseStmt_);
+        }
+
+        void visitWhileStmt(WhileStmt *stmt) override {
+            put(NodeTag::WHILE), write(stmt->condition_), write(stmt->statements_);
+        }
+
+        void visitContinueStmt(ContinueStmt *stmt) override {
+            put(NodeTag::CONTINUE), put(stmt->keyword_);
+        }
+
+        void visitBreakStmt(BreakStmt *stmt) override {
+            put(NodeTag::BREAK), put(stmt->keyword_);
+        }
+
+        void visitForStmt(ForStmt *stmt) override {
+            put(NodeTag::FOR), put(stmt->variable_), write(stmt->iterable_), write(stmt->body_);
+        }
+
+        void visitWhenStmt(WhenStmt *stmt) override {
+            put(NodeTag::WHEN), put((uint32_t) stmt->branches->size());
+            for (const auto &[conds, body]: *stmt->branches) {
+                write(conds), write(body);
+            }
+            write(stmt->else_);
+        }
+
+        void visitBlockStmt(BlockStmt *stmt) override {
+            put(NodeTag::BLOCK), write(*stmt->statements_);
+        }
+
+        void visitExpressionStmt(ExpressionStmt *stmt) override {
+            put(NodeTag::EXPRESSION), write(stmt->expression_);
+        }
+
+        void visitLetStmt(LetStmt *stmt) override {
+            put(NodeTag::LET), put(stmt->name_), write(stmt->initializer_), write(stmt->type_);
+        }
+
+        void visitVarStmt(VarStmt *stmt) override {
+            put(NodeTag::VAR), put(stmt->name_), write(stmt->initializer_), write(stmt->type_);
+        }
+
+        void visitFunctionStmt(FunctionStmt *stmt) override {
+            if (functions) functions->emplace(stmt, (uint32_t) functions->size());
+            put(NodeTag::FUNCTION), put(stmt->name_);
+            put((uint32_t) stmt->params_->size());
+            for (auto param: *stmt->params_) put(param);
+            put((uint8_t) stmt->async_);
+
+            if (stmt->body_) {
+                put((uint8_t) 0), put((uint8_t) stmt->generator_), write(*stmt->body_);
+                return;
+            }
+            // 尚未解析的函数体只保存其位置和声明时的作用域
+            const auto &lazy = *stmt->lazy_;
+            put((uint8_t) 1), put(lazy.begin);
+            put(lazy.functionType), put(lazy.classType), put(lazy.blockType);
+            put((uint32_t) lazy.scopes.size());
+            for (const auto &scope: lazy.scopes) {
+                put((uint32_t) scope.size());
+                for (const auto &[name, state]: scope) {
+                    put(std::string_view{name}), put(state);
+                }
+            }
+        }
+
+        void visitReturnStmt(ReturnStmt *stmt) override {
+            put(NodeTag::RETURN), put(stmt->keyword_), write(stmt->value_);
+        }
+
+        void visitYieldStmt(YieldStmt *stmt) override {
+            put(NodeTag::YIELD), put(stmt->keyword_), write(stmt->value_);
+        }
+
+        void visitClassStmt(ClassStmt *stmt) override {
+            put(NodeTag::CLASS), put(stmt->name_), write(stmt->superClass_);
+            put((uint32_t) stmt->methods_->size());
+            for (const auto &method: *stmt->methods_) write(method);
+        }
+
+        void visitImportStmt(ImportStmt *stmt) override {
+            put(NodeTag::IMPORT), put((uint32_t) stmt->path_->size());
+            for (auto name: *stmt->path_) put(name);
+        }
+
+    private:
+        std::string &out;
+        std::unordered_map<const FunctionStmt *, uint32_t> *functions;
+    };
+
+    // 与 ProgramWriter 对应；数据不完整时置 failed，之后读出的都是零值
+    class ProgramReader {
+    public:
+        ProgramReader(std::string_view data, CompiledProgram &program, std::vector<FunctionStmtPtr> *functions)
+                : data{data}, functions{functions}, program{program} {}
+
+        bool failed{false};
+
+        template<typename T>
+        T get() {
+            T value{};
+            if (data.size() < sizeof(T)) {
+                failed = true;
+                return value;
+            }
+            std::memcpy(&value, data.data(), sizeof(T));
+            data.remove_prefix(sizeof(T));
+            return value;
+        }
+
+        std::string getString() {
+            auto size = get<uint32_t>();
+            if (data.size() < size) {
+                failed = true;
+                return {};
+            }
+            std::string text{data.substr(0, size)};
+            data.remove_prefix(size);
+            return text;
+        }
+
+        TokenId getToken() {
+            auto id = get<TokenId>();
+            if (id >= program.tokens.size()) failed = true;
+            return failed ? 0 : id;
+        }
+
+        LoxValuePtr getValue() {
+            switch ((ValueTag) get<uint8_t>()) {
+                case ValueTag::NONE:return nullptr;
+                case ValueTag::NIL:return std::make_shared<LoxNil>();
+                case ValueTag::BOOL:return std::make_shared<LoxBool>(get<uint8_t>() != 0);
+                case ValueTag::INT:return std::make_shared<LoxInt>(get<int64_t>());
+                case ValueTag::FLOAT:return std::make_shared<LoxFloat>(get<double>());
+                case ValueTag::STRING:return std::make_shared<LoxString>(getString());
+                default:failed = true;
+                    return nullptr;
+            }
+        }
+
+        void tokens() {
+            auto &buffer = program.tokens;
+            if (not buffer.restoreColumns(data, get<uint32_t>())) {
+                failed = true;
+                return;
+            }
+            auto literals = get<uint32_t>();
+            for (uint32_t i = 0; i < literals and not failed; ++i) {
+                auto id = getToken();
+                buffer.setLiteral(id, getValue());
+            }
+        }
+
+        // 恢复 Resolver 计算出的作用域深度
+        template<typename T>
+        std::shared_ptr<T> resolved(std::shared_ptr<T> expr) {
+            expr->depth_ = get<int32_t>();
+            return expr;
+        }
+
+        std::shared_ptr<std::vector<ExprPtr>> exprs() {
+            auto list = std::make_shared<std::vector<ExprPtr>>();
+            auto count = get<uint32_t>();
+            for (uint32_t i = 0; i < count and not failed; ++i) list->push_back(expr());
+            return list;
+        }
+
+        TypeAnnotationPtr type() {
+            if (get<uint8_t>() == 0) return nullptr;
+            auto type = std::make_shared<TypeAnnotation>();
+            type->name_ = getToken();
+            type->element_ = this->type();
+            return type;
+        }
+
+        std::shared_ptr<std::vector<StmtPtr>> stmts() {
+            auto list = std::make_shared<std::vector<StmtPtr>>();
+            auto count = get<uint32_t>();
+            for (uint32_t i = 0; i < count and not failed; ++i) list->push_back(stmt());
+            return list;
+        }
+
+        ExprPtr expr() {
+            switch ((NodeTag) get<uint8_t>()) {
+                case NodeTag::NONE:return nullptr;
+                case NodeTag::ASSIGN: {
+                    auto name = getToken();
+                    auto value = expr();
+                    return resolved(std::make_shared<AssignExpr>(name, value));
+                }
+                case NodeTag::BINARY: {
+                    auto left = expr();
+                    auto op = getToken();
+                    return std::make_shared<BinaryExpr>(left, op, expr());
+                }
+                case NodeTag::GROUPING:return std::make_shared<GroupingExpr>(expr());
+                case NodeTag::LITERAL: {
+                    auto value = getValue();
+                    return std::make_shared<LiteralExpr>(value, program.tokens.newLiteralSlot());
+                }
+                case NodeTag::STR:return std::make_shared<StrExpr>(exprs());
+                case NodeTag::UNARY: {
+                    auto op = getToken();
+                    return std::make_shared<UnaryExpr>(op, expr());
+                }
+                case NodeTag::VARIABLE:return resolved(std::make_shared<VariableExpr>(getToken()));
+                case NodeTag::LOGICAL: {
+                    auto left = expr();
+                    auto op = getToken();
+                    return std::make_shared<LogicalExpr>(left, op, expr());
+                }
+                case NodeTag::CALL: {
+                    auto callee = expr();
+                    auto paren = getToken();
+                    auto call = std::make_shared<CallExpr>(callee, paren, exprs());
+                    call->intrinsic_ = get<uint8_t>();
+                    return call;
+                }
+                case NodeTag::GET: {
+                    auto object = expr();
+                    return std::make_shared<GetExpr>(object, getToken());
+                }
+                case NodeTag::SET: {
+                    auto object = expr();
+                    auto name = getToken();
+                    return std::make_shared<SetExpr>(object, name, expr());
+                }
+                case NodeTag::THIS:return resolved(std::make_shared<ThisExpr>(getToken()));
+                case NodeTag::SUPER: {
+                    auto keyword = getToken();
+                    auto method = getToken();
+                    return resolved(std::make_shared<SuperExpr>(keyword, method));
+                }
+                case NodeTag::LIST: {
+                    auto bracket = getToken();
+                    auto list = std::make_shared<ListExpr>(bracket, exprs());
+                    list->elementType_ = type();
+                    return list;
+                }
+                case NodeTag::INDEX: {
+                    auto object = expr();
+                    auto bracket = getToken();
+                    return std::make_shared<IndexExpr>(object, bracket, expr());
+                }
+                case NodeTag::INDEX_SET: {
+                    auto object = expr();
+                    auto bracket = getToken();
+                    auto index = expr();
+                    return std::make_shared<IndexSetExpr>(object, bracket, index, expr());
+                }
+                case NodeTag::MAP: {
+                    auto brace = getToken();
+                    auto keys = exprs();
+                    auto map = std::make_shared<MapExpr>(brace, keys, exprs());
+                    map->valueType_ = type();
+                    return map;
+                }
+                case NodeTag::SLICE: {
+                    auto object = expr();
+                    auto bracket = getToken();
+                    auto begin = expr();
+                    return std::make_shared<SliceExpr>(object, bracket, begin, expr());
+                }
+                case NodeTag::AWAIT: {
+                    auto keyword = getToken();
+                    return std::make_shared<AwaitExpr>(keyword, expr());
+                }
+                case NodeTag::SET_LITERAL: {
+                    auto brace = getToken();
+                    auto set = std::make_shared<SetLiteralExpr>(brace, exprs());
+                    set->elementType_ = type();
+                    return set;
+                }
+                default:failed = true;
+                    return nullptr;
+            }
+        }
+
+        StmtPtr stmt() {
+            switch ((NodeTag) get<uint8_t>()) {
+                case NodeTag::NONE:return nullptr;
+                case NodeTag::IF: {
+                    auto condition = expr();
+                    auto thenStmt = stmt();
+                    return std::make_shared<IfStmt>(condition, thenStmt, stmt());
+                }
+                case NodeTag::WHILE: {
+                    auto condition = expr();
+                    return std::make_shared<WhileStmt>(condition, stmt());
+                }
+                case NodeTag::CONTINUE:return std::make_shared<ContinueStmt>(getToken());
+                case NodeTag::BREAK:return std::make_shared<BreakStmt>(getToken());
+                case NodeTag::FOR: {
+                    auto variable = getToken();
+                    auto iterable = expr();
+                    return std::make_shared<ForStmt>(variable, iterable, stmt());
+                }
+                case NodeTag::WHEN: {
+                    auto branches = std::make_shared<std::vector<std::pair<std::vector<ExprPtr>, StmtPtr>>>();
+                    auto count = get<uint32_t>();
+                    for (uint32_t i = 0; i < count and not failed; ++i) {
+                        auto conds = exprs();
+                        branches->emplace_back(std::move(*conds), stmt());
+                    }
+                    return std::make_shared<WhenStmt>(branches, stmt());
+                }
+                case NodeTag::BLOCK:return std::make_shared<BlockStmt>(stmts());
+                case NodeTag::EXPRESSION:return std::make_shared<ExpressionStmt>(expr());
+                case NodeTag::LET: {
+                    auto name = getToken();
+                    auto let = std::make_shared<LetStmt>(name, expr());
+                    let->type_ = type();
+                    return let;
+                }
+                case NodeTag::VAR: {
+                    auto name = getToken();
+                    auto var = std::make_shared<VarStmt>(name, expr());
+                    var->type_ = type();
+                    return var;
+                }
+                case NodeTag::FUNCTION:return function();
+                case NodeTag::IMPORT: {
+                    auto path = std::make_shared<std::vector<TokenId>>();
+                    auto count = get<uint32_t>();
+                    for (uint32_t i = 0; i < count and not failed; ++i) path->push_back(getToken());
+                    if (path->empty()) failed = true;
+                    return std::make_shared<ImportStmt>(path);
+                }
+                case NodeTag::RETURN: {
+                    auto keyword = getToken();
+                    return std::make_shared<ReturnStmt>(keyword, expr());
+                }
+                case NodeTag::YIELD: {
+                    auto keyword = getToken();
+                    return std::make_shared<YieldStmt>(keyword, expr());
+                }
+                case NodeTag::CLASS: {
+                    auto name = getToken();
+                    auto superClass = std::dynamic_pointer_cast<VariableExpr>(expr());
+                    auto methods = std::make_shared<std::vector<FunctionStmtPtr>>();
+                    auto count = get<uint32_t>();
+                    for (uint32_t i = 0; i < count and not failed; ++i) {
+                        if ((NodeTag) get<uint8_t>() != NodeTag::FUNCTION) {
+                            failed = true;
+                            break;
+                        }
+                        methods->push_back(function());
+                    }
+                    return std::make_shared<ClassStmt>(name, superClass, methods);
+                }
+                default:failed = true;
+                    return nullptr;
+            }
+        }
+
+        FunctionStmtPtr function() {
+            auto name = getToken();
+            auto params = std::make_shared<std::vector<TokenId>>();
+            auto count = get<uint32_t>();
+            for (uint32_t i = 0; i < count and not failed; ++i) params->push_back(getToken());
+
+            // 先登记再读函数体，编号与写出时的先序一致
+            auto function = std::make_shared<FunctionStmt>(name, params, nullptr);
+            if (functions) functions->push_back(function);
+            function->async_ = get<uint8_t>();
+
+            if (get<uint8_t>() == 0) {
+                function->generator_ = get<uint8_t>();
+                function->body_ = stmts();
+                return function;
+            }
+
+            auto lazy = std::make_shared<LazyBody>(LazyBody{&program.tokens, getToken(), {}});
+            lazy->functionType = get<uint8_t>();
+            lazy->classType = get<uint8_t>();
+            lazy->blockType = get<uint8_t>();
+            auto scopes = get<uint32_t>();
+            for (uint32_t s = 0; s < scopes and not failed; ++s) {
+                auto &scope = lazy->scopes.emplace_back();
+                auto entries = get<uint32_t>();
+                for (uint32_t i = 0; i < entries and not failed; ++i) {
+                    auto variable = getString();
+                    scope.insert_or_assign(std::move(variable), get<uint8_t>());
+                }
+            }
+            function->lazy_ = lazy;
+            return function;
+        }
+
+        std::string_view data;
+        std::vector<FunctionStmtPtr> *functions{nullptr};
+
+    private:
+        CompiledProgram &program;
+    };
+
+    std::filesystem::path cacheDirectory() {
+        if (auto dir = std::getenv("IDUN_CACHE_DIR"); dir and *dir) return dir;
+        if (auto dir = std::getenv("XDG_CACHE_HOME"); dir and *dir) return std::filesystem::path{dir} / "idun";
+        if (auto dir = std::getenv("HOME"); dir and *dir) return std::filesystem::path{dir} / ".cache" / "idun";
+        return {};
+    }
+}
+
+// 按 8 字节一组处理的 FNV-1a 变体
+uint64_t ProgramCache::contentHash(std::string_view data) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data.data() + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 32;
+    }
+    for (; i < data.size(); ++i) {
+        hash = (hash ^ (unsigned char) data[i]) * 0x100000001b3ULL;
+    }
+    return hash ^ data.size();
+}
+
+void ProgramCache::encode(std::string &out, const TokenBuffer &tokens, const std::vector<StmtPtr> &statements,
+                          std::unordered_map<const FunctionStmt *, uint32_t> *functions) {
+    ProgramWriter writer{out, functions};
+    writer.tokens(tokens);
+    writer.write(statements);
+}
+
+bool ProgramCache::decode(std::string_view &data, CompiledProgram &program, std::vector<FunctionStmtPtr> *functions) {
+    ProgramReader reader{data, program, functions};
+    reader.tokens();
+    auto count = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < count and not reader.failed; ++i) {
+        program.statements.push_back(reader.stmt());
+    }
+    data = reader.data;
+    return not reader.failed;
+}
+
+ProgramCache::ProgramCache(const Source &source, bool lazyParse)
+        : source_{source.text()}, hash_{contentHash(source.text())}, flags_{lazyParse ? 1u : 0u} {
+    auto dir = cacheDirectory();
+    if (dir.empty()) return;
+    // 同一源码按不同的方式（如惰性解析）编译的结果分别缓存
+    char name[40];
+    std::snprintf(name, sizeof(name), "%016llx-%u.idunc", (unsigned long long) hash_, flags_);
+    path_ = (dir / name).string();
+}
+
+std::unique_ptr<CompiledProgram> ProgramCache::load() const {
+    if (path_.empty()) return nullptr;
+    auto file = Source::fromFile(path_);
+    if (!file or file->text().size() < sizeof(Header)) return nullptr;
+
+    auto data = file->text();
+    Header header{};
+    std::memcpy(&header, data.data(), sizeof(Header));
+    data.remove_prefix(sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 or header.version != VERSION
+        or header.flags != flags_ or header.sourceHash != hash_ or header.sourceSize != source_.size()
+        or data.substr(0, source_.size()) != source_) {
+        return nullptr;
+    }
+    data.remove_prefix(source_.size());
+    if (header.payloadHash != contentHash(data)) return nullptr;
+
+    auto program = std::make_unique<CompiledProgram>(source_);
+    if (not decode(data, *program)) return nullptr;
+    return program;
+}
+
+void ProgramCache::store(const TokenBuffer &tokens, const std::vector<StmtPtr> &statements) const {
+    if (path_.empty()) return;
+
+    std::string payload;
+    encode(payload, tokens, statements);
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.flags = flags_;
+    header.sourceHash = hash_;
+    header.sourceSize = source_.size();
+    header.payloadHash = contentHash(payload);
+
+    // 先写临时文件再改名，并发运行的进程不会读到写了一半的缓存
+    std::error_code ec;
+    auto path = std::filesystem::path{path_};
+    std::filesystem::create_directories(path.parent_path(), ec);
+    // 同一进程内的多个线程可能同时写入内容相同的模块，临时文件名同时区分进程和线程
+    auto thread = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    auto temp = path_ + "." + std::to_string(getpid()) + "." + std::to_string(thread) + ".tmp";
+    {
+        std::ofstream out{temp, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc};
+        if (!out.is_open()) return;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        out.write(source_.data(), (std::streamsize) source_.size());
+        out.write(payload.data(), (std::streamsize) payload.size());
+        if (!out.good()) {
+            out.close();
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(temp, path, ec);
+    if (ec) std::filesystem::remove(temp, ec);
+}
@@ -1,97 +1,168 @@
 #include <iostream>
 #include "resolver.hpp"
-#include "interpreter.hpp"
+#include "lox_list.hpp"
+#include "lox_map.hpp"
+#include "lox_math.hpp"
+#include "lox_set.hpp"
 
 
-void Resolver::visitAssignExpr(AssignExprPtr expr) {
-    // todo: 在这里可以处理let变量的重新赋值问题
+void Resolver::visitAssignExpr(AssignExpr *expr) {
     resolve(expr->value_);
-    resolveLocal(expr, expr->name_);
+    expr->depth_ = resolveLocal(expr->name_);
+    auto name = tokens.lexeme(expr->name_);
+    bool let = expr->depth_ < 0 ? globalLets.contains(name)
+                                : scopes[scopes.size() - 1 - expr->depth_].find(name)->second == LET;
+    if (let) {
+        err << "Line [" << tokens.line(expr->name_) << "]: Can't reassign let variable '" << name << "'.\n";
+        has_error_ = true;
+    }
 }
 
-void Resolver::visitBinaryExpr(BinaryExprPtr expr) {
+void Resolver::visitBinaryExpr(BinaryExpr *expr) {
     resolve(expr->left_);
     resolve(expr->right_);
 }
 
-void Resolver::visitGroupingExpr(GroupingExprPtr expr) {
+void Resolver::visitGroupingExpr(GroupingExpr *expr) {
     resolve(expr->expression_);
 }
 
-void Resolver::visitLiteralExpr(LiteralExprPtr expr) {}
+void Resolver::visitLiteralExpr(LiteralExpr *) {}
 
-void Resolver::visitStrExpr(StrExprPtr expr) {
+void Resolver::visitStrExpr(StrExpr *expr) {
     for (const auto &str: *expr->strs) {
         resolve(str);
     }
 }
 
-void Resolver::visitUnaryExpr(UnaryExprPtr expr) {
+void Resolver::visitUnaryExpr(UnaryExpr *expr) {
     resolve(expr->right_);
 }
 
-void Resolver::visitVariableExpr(VariableExprPtr expr) {
+void Resolver::visitVariableExpr(VariableExpr *expr) {
     if (!scopes.empty()) {
-        auto it = scopes.back().find(expr->name_->lexeme);
+        auto it = scopes.back().find(tokens.lexeme(expr->name_));
         // 检查变量只声明未赋值
-        if (it != scopes.back().end() && !it->second) {
-            std::cerr << "Line [" << expr->name_->line << "]: Can't read local variable in its own initializer.\n";
+        if (it != scopes.back().end() && it->second == DECLARED) {
+            err << "Line [" << tokens.line(expr->name_) << "]: Can't read local variable in its own initializer.\n";
             has_error_ = true;
         }
     }
-    resolveLocal(expr, expr->name_);
+    expr->depth_ = resolveLocal(expr->name_);
 }
 
-void Resolver::visitLogicalExpr(LogicalExprPtr expr) {
+void Resolver::visitLogicalExpr(LogicalExpr *expr) {
     resolve(expr->left_);
     resolve(expr->right_);
 }
 
-void Resolver::visitCallExpr(CallExprPtr expr) {
+void Resolver::visitCallExpr(CallExpr *expr) {
     resolve(expr->callee_);
     for (const auto &arg: *expr->args_) {
         resolve(arg);
     }
+
+    // math.sqrt(x) 形式的调用记下内建函数的编号，运行时再确认 math 确实是数学模块
+    if (auto get = dynamic_cast<GetExpr *>(expr->callee_.get())) {
+        auto module = dynamic_cast<VariableExpr *>(get->expr_.get());
+        if (module and (tokens.lexeme(module->name_) == LoxMath::MODULE or tokens.lexeme(module->name_) == "Math")) {
+            expr->intrinsic_ = LoxMath::intrinsic(tokens.lexeme(get->name_), expr->args_->size());
+        }
+    }
 }
 
-void Resolver::visitGetExpr(GetExprPtr expr) {
+void Resolver::visitGetExpr(GetExpr *expr) {
     resolve(expr->expr_);
 }
 
-void Resolver::visitSetExpr(SetExprPtr expr) {
+void Resolver::visitSetExpr(SetExpr *expr) {
     resolve(expr->value_);
     resolve(expr->expr_);
 }
 
-void Resolver::visitThisExpr(ThisExprPtr expr) {
+void Resolver::visitListExpr(ListExpr *expr) {
+    for (const auto &element: *expr->elements_) {
+        resolve(element);
+    }
+    // 空列表无法推断元素类型
+    if (expr->elements_->empty() and not expr->elementType_) {
+        err << "Line [" << tokens.line(expr->bracket_) << "]: Empty list needs a type annotation, like 'list[int]'.\n";
+        has_error_ = true;
+    }
+}
+
+void Resolver::visitIndexExpr(IndexExpr *expr) {
+    resolve(expr->object_);
+    resolve(expr->index_);
+}
+
+void Resolver::visitIndexSetExpr(IndexSetExpr *expr) {
+    resolve(expr->value_);
+    resolve(expr->object_);
+    resolve(expr->index_);
+}
+
+void Resolver::visitSliceExpr(SliceExpr *expr) {
+    resolve(expr->object_);
+    if (expr->begin_) resolve(expr->begin_);
+    if (expr->end_) resolve(expr->end_);
+}
+
+// 顶层代码中的 await 直接运行事件循环等待；普通函数中不能暂停，只有异步函数可以
+void Resolver::visitAwaitExpr(AwaitExpr *expr) {
+    if (currentFunction != FunctionType::NONE and not currentDeclaration->async_) {
+        err << "Line [" << tokens.line(expr->keyword_) << "]: Can only await inside an async function or at the top level." << std::endl;
+        has_error_ = true;
+    }
+    resolve(expr->value_);
+}
+
+void Resolver::visitMapExpr(MapExpr *expr) {
+    for (size_t i = 0; i < expr->keys_->size(); ++i) {
+        resolve((*expr->keys_)[i]);
+        resolve((*expr->values_)[i]);
+    }
+    if (expr->keys_->empty() and not expr->valueType_) {
+        err << "Line [" << tokens.line(expr->brace_) << "]: Empty map needs a type annotation, like 'map[int]'.\n";
+        has_error_ = true;
+    }
+}
+
+void Resolver::visitSetLiteralExpr(SetLiteralExpr *expr) {
+    for (const auto &element: *expr->elements_) {
+        resolve(element);
+    }
+}
+
+void Resolver::visitThisExpr(ThisExpr *expr) {
     if (currentClass == ClassType::NONE) {
-        std::cerr << "Line [" << expr->keyword_->line << "]: Can't use 'this' outside of a class.\n";
+        err << "Line [" << tokens.line(expr->keyword_) << "]: Can't use 'this' outside of a class.\n";
         has_error_ = true;
         return;
     }
 
-    resolveLocal(expr, expr->keyword_);
+    expr->depth_ = resolveLocal(expr->keyword_);
 }
 
-void Resolver::visitSuperExpr(SuperExprPtr expr) {
+void Resolver::visitSuperExpr(SuperExpr *expr) {
     if (currentClass == ClassType::NONE) {
-        std::cerr << "Line [" << expr->keyword_->line << "]: Can't use 'super' outside of a class.\n";
+        err << "Line [" << tokens.line(expr->keyword_) << "]: Can't use 'super' outside of a class.\n";
         has_error_ = true;
     } else if (currentClass != ClassType::SUBCLASS) {
-        std::cerr << "Line [" << expr->keyword_->line << "]: Can't use 'super' in a class with no superclass.\n";
+        err << "Line [" << tokens.line(expr->keyword_) << "]: Can't use 'super' in a class with no superclass.\n";
         has_error_ = true;
     }
 
-    resolveLocal(expr, expr->keyword_);
+    expr->depth_ = resolveLocal(expr->keyword_);
 }
 
-void Resolver::visitIfStmt(IfStmtPtr stmt) {
+void Resolver::visitIfStmt(IfStmt *stmt) {
     resolve(stmt->condition_);
     resolve(stmt->thenStmt_);
     if (stmt->elseStmt_) resolve(stmt->elseStmt_);
 }
 
-void Resolver::visitWhileStmt(WhileStmtPtr stmt) {
+void Resolver::visitWhileStmt(WhileStmt *stmt) {
     // 处理是否在循环之中
     auto previousType = currentBlock;
     currentBlock = BlockType::LOOP;
@@ -102,27 +173,36 @@ void Resolver::visitWhileStmt(WhileStmtPtr stmt) {
     currentBlock = previousType;
 }
 
-void Resolver::visitContinueStmt(ContinueStmtPtr stmt) {
+void Resolver::visitContinueStmt(ContinueStmt *stmt) {
     if (currentBlock != BlockType::LOOP) {
-        std::cerr << "Line [" << stmt->keyword_->line << "]: 'continue' can only be used in loops." << std::endl;
+        err << "Line [" << tokens.line(stmt->keyword_) << "]: 'continue' can only be used in loops." << std::endl;
         has_error_ = true;
     }
 }
 
-void Resolver::visitBreakStmt(BreakStmtPtr stmt) {
+void Resolver::visitBreakStmt(BreakStmt *stmt) {
     if (currentBlock != BlockType::LOOP) {
-        std::cerr << "Line [" << stmt->keyword_->line << "]: 'break' can only be used in loops." << std::endl;
+        err << "Line [" << tokens.line(stmt->keyword_) << "]: 'break' can only be used in loops." << std::endl;
         has_error_ = true;
     }
 }
 
-void Resolver::visitForStmt(ForStmtPtr stmt) {
-    declare(stmt->variable_);
+void Resolver::visitForStmt(ForStmt *stmt) {
     resolve(stmt->iterable_);
+    auto previousType = currentBlock;
+    currentBlock = BlockType::LOOP;
+
+    // 循环变量在包围循环体的作用域中
+    beginScope();
+    declare(stmt->variable_);
+    define(stmt->variable_);
     resolve(stmt->body_);
+    endScope();
+
+    currentBlock = previousType;
 }
 
-void Resolver::visitWhenStmt(WhenStmtPtr stmt) {
+void Resolver::visitWhenStmt(WhenStmt *stmt) {
     // when的所有分支
     for (const auto &conds_block: *stmt->branches) {
         // 某个分支的所有条件
@@ -134,51 +214,70 @@ void Resolver::visitWhenStmt(WhenStmtPtr stmt) {
     resolve(stmt->else_);  // 最后的else分支
 }
 
-void Resolver::visitBlockStmt(BlockStmtPtr stmt) {
+void Resolver::visitBlockStmt(BlockStmt *stmt) {
     beginScope();
     resolve(stmt->statements_);
     endScope();
 }
 
-void Resolver::visitExpressionStmt(ExpressionStmtPtr stmt) {
+void Resolver::visitExpressionStmt(ExpressionStmt *stmt) {
     resolve(stmt->expression_);
 }
 
-void Resolver::visitLetStmt(LetStmtPtr stmt) {
+void Resolver::visitLetStmt(LetStmt *stmt) {
     declare(stmt->name_);
+    checkType(stmt->type_, stmt->initializer_);
     resolve(stmt->initializer_);
-    define(stmt->name_);
+    define(stmt->name_, LET);
 }
 
-void Resolver::visitVarStmt(VarStmtPtr stmt) {
+void Resolver::visitVarStmt(VarStmt *stmt) {
     declare(stmt->name_);
+    checkType(stmt->type_, stmt->initializer_);
     if (stmt->initializer_) {
         resolve(stmt->initializer_);
     }
     define(stmt->name_);
 }
 
-void Resolver::visitFunctionStmt(FunctionStmtPtr stmt) {
+void Resolver::visitFunctionStmt(FunctionStmt *stmt) {
     declare(stmt->name_);
     define(stmt->name_);
     resolveFunction(stmt, FunctionType::FUNCTION);
 }
 
-void Resolver::visitReturnStmt(ReturnStmtPtr stmt) {
+void Resolver::visitReturnStmt(ReturnStmt *stmt) {
     if (currentFunction == FunctionType::NONE) {
-        std::cerr << "Line [" << stmt->keyword_->line << "]: Can't return from top-level code." << std::endl;
+        err << "Line [" << tokens.line(stmt->keyword_) << "]: Can't return from top-level code." << std::endl;
         has_error_ = true;
     }
     if (stmt->value_) {
         if (currentFunction == FunctionType::INITIALIZER) {
-            std::cerr << "Line [" << stmt->keyword_->line << "]: Can't return a value from an initializer." << std::endl;
+            err << "Line [" << tokens.line(stmt->keyword_) << "]: Can't return a value from an initializer." << std::endl;
             has_error_ = true;
         }
         resolve(stmt->value_);
     }
 }
 
-void Resolver::visitClassStmt(ClassStmtPtr stmt) {
+// 含有 yield 的函数是生成器，调用时不执行函数体而是返回生成器
+void Resolver::visitYieldStmt(YieldStmt *stmt) {
+    if (currentFunction == FunctionType::NONE) {
+        err << "Line [" << tokens.line(stmt->keyword_) << "]: Can't yield from top-level code." << std::endl;
+        has_error_ = true;
+    } else if (currentFunction == FunctionType::INITIALIZER) {
+        err << "Line [" << tokens.line(stmt->keyword_) << "]: Can't yield from an initializer." << std::endl;
+        has_error_ = true;
+    } else if (currentDeclaration->async_) {
+        err << "Line [" << tokens.line(stmt->keyword_) << "]: Can't yield from an async function." << std::endl;
+        has_error_ = true;
+    } else {
+        currentDeclaration->generator_ = true;
+    }
+    if (stmt->value_) resolve(stmt->value_);
+}
+
+void Resolver::visitClassStmt(ClassStmt *stmt) {
     ClassType enclosingClass = currentClass;
     currentClass = ClassType::CLASS;
 
@@ -186,8 +285,8 @@ void Resolver::visitClassStmt(ClassStmtPtr stmt) {
     define(stmt->name_);
 
     if (stmt->superClass_) {
-        if (stmt->name_->lexeme == stmt->superClass_->name_->lexeme) {
-            std::cerr << "Line [" << stmt->superClass_->name_->line << "]: A class can't inherit from itself." << std::endl;
+        if (tokens.lexeme(stmt->name_) == tokens.lexeme(stmt->superClass_->name_)) {
+            err << "Line [" << tokens.line(stmt->superClass_->name_) << "]: A class can't inherit from itself." << std::endl;
             has_error_ = true;
         }
         currentClass = ClassType::SUBCLASS;
@@ -196,18 +295,22 @@ void Resolver::visitClassStmt(ClassStmtPtr stmt) {
 
     if (stmt->superClass_) {
         beginScope();
-        scopes.back().insert_or_assign("super", true);
+        scopes.back().insert_or_assign("super", DEFINED);
     }
 
     beginScope();
-    scopes.back().insert_or_assign("this", true);
+    scopes.back().insert_or_assign("this", DEFINED);
 
     for (const auto &method: *stmt->methods_) {
         auto declaration = FunctionType::METHOD;
-        if (method->name_->lexeme == "init") {
+        if (tokens.lexeme(method->name_) == "init") {
             declaration = FunctionType::INITIALIZER;
+            if (method->async_) {
+                err << "Line [" << tokens.line(method->name_) << "]: An initializer can't be async." << std::endl;
+                has_error_ = true;
+            }
         }
-        resolveFunction(method, declaration);
+        resolveFunction(method.get(), declaration);
     }
 
     endScope();
@@ -217,6 +320,11 @@ void Resolver::visitClassStmt(ClassStmtPtr stmt) {
     currentClass = enclosingClass;
 }
 
+void Resolver::visitImportStmt(ImportStmt *stmt) {
+    declare(stmt->path_->back());
+    define(stmt->path_->back());
+}
+
 void Resolver::resolve(const std::shared_ptr<std::vector<StmtPtr>> &stmts) {
     for (const auto &stmt: *stmts) {
         resolve(stmt);
@@ -231,21 +339,34 @@ void Resolver::resolve(const ExprPtr &expr) {
     expr->accept(*this);
 }
 
-void Resolver::resolveLocal(const ExprPtr &expr, const TokenPtr &name) {
+int Resolver::resolveLocal(TokenId name) {
     for (int i = (int) scopes.size() - 1; i >= 0; --i) {
-        if (scopes.at(i).contains(name->lexeme)) {
+        if (scopes.at(i).contains(tokens.lexeme(name))) {
             // depth参数表示以当前作用域为0，父作用域依次+1
-            interpreter.resolve(expr, (int) scopes.size() - i - 1);
-            return;
+            return (int) scopes.size() - i - 1;
         }
     }
+    return -1;
 }
 
-void Resolver::resolveFunction(const FunctionStmtPtr &stmt, FunctionType type) {
+void Resolver::resolveFunction(FunctionStmt *stmt, FunctionType type) {
     // 处理是否在函数声明
     auto previousType = currentFunction;
     currentFunction = type;
 
+    if (not stmt->body_) {
+        // 函数体尚未解析，记下当前作用域，首次调用时再分析
+        auto &lazy = *stmt->lazy_;
+        lazy.scopes = scopes;
+        lazy.functionType = (uint8_t) type;
+        lazy.classType = (uint8_t) currentClass;
+        lazy.blockType = (uint8_t) currentBlock;
+        currentFunction = previousType;
+        return;
+    }
+
+    auto previousDeclaration = currentDeclaration;
+    currentDeclaration = stmt;
     beginScope();
 
     for (const auto &param: *stmt->params_) {
@@ -256,6 +377,7 @@ void Resolver::resolveFunction(const FunctionStmtPtr &stmt, FunctionType type) {
 
     endScope();
 
+    currentDeclaration = previousDeclaration;
     currentFunction = previousType;
 }
 
@@ -268,20 +390,25 @@ void Resolver::endScope() {
 }
 
 // 声明变量
-void Resolver::declare(const TokenPtr &name) {
+void Resolver::declare(TokenId name) {
     if (scopes.empty()) return;
     auto &scope = scopes.back();
-    if (scope.contains(name->lexeme)) {
-        std::cerr << "Line [" << name->line << "]: Already a variable with this name in this scope" << std::endl;
+    if (scope.contains(tokens.lexeme(name))) {
+        err << "Line [" << tokens.line(name) << "]: Already a variable with this name in this scope" << std::endl;
         has_error_ = true;
     }
-    scope.insert({name->lexeme, false});
+    scope.emplace(std::string{tokens.lexeme(name)}, DECLARED);
 }
 
 // 变量定义
-void Resolver::define(const TokenPtr &name) {
-    if (scopes.empty()) return;
-    scopes.back().insert_or_assign(name->lexeme, true);
+void Resolver::define(TokenId name, VariableState state) {
+    if (scopes.empty()) {
+        // 全局变量可以重新定义，var 等重新定义后不再是 let 变量
+        if (state == LET) globalLets.emplace(tokens.lexeme(name));
+        else if (!globalLets.empty()) globalLets.erase(std::string{tokens.lexeme(name)});
+        return;
+    }
+    scopes.back().insert_or_assign(std::string{tokens.lexeme(name)}, state);
 }
 
 bool Resolver::resolve(const std::vector<StmtPtr> &ast) {
@@ -289,4 +416,49 @@ bool Resolver::resolve(const std::vector<StmtPtr> &ast) {
         resolve(stmt);
     }
     return !has_error_;
-}
\ No newline at end of file
+}
+
+bool Resolver::resolveBody(FunctionStmt *function) {
+    auto &lazy = *function->lazy_;
+    scopes = std::move(lazy.scopes);
+    currentClass = (ClassType) lazy.classType;
+    currentBlock = (BlockType) lazy.blockType;
+    resolveFunction(function, (FunctionType) lazy.functionType);
+    return !has_error_;
+}
+
+// 集合的元素类型必须是已知的类型；初始值是集合的字面量时，其元素类型取自类型标注
+void Resolver::checkType(const TypeAnnotationPtr &type, ExprPtr &initializer) {
+    if (!type) return;
+    auto name = tokens.lexeme(type->name_);
+    if (name != LoxList::TYPE and name != LoxMap::TYPE and name != LoxSet::TYPE) return;
+    // {} 按字典解析，标注为集合时改为空集合
+    if (auto map = dynamic_cast<MapExpr *>(initializer.get()); map and map->keys_->empty() and name == LoxSet::TYPE) {
+        initializer = std::make_shared<SetLiteralExpr>(map->brace_, map->keys_);
+    }
+    if (!type->element_) {
+        err << "Line [" << tokens.line(type->name_) << "]: Expected the element type of the " << name << ", like '"
+            << name << "[int]'.\n";
+        has_error_ = true;
+        return;
+    }
+    auto element = elementTypeOf(tokens.lexeme(type->element_->name_));
+    if (type->element_->element_ or !element) {
+        err << "Line [" << tokens.line(type->element_->name_) << "]: Unknown element type '"
+            << tokens.lexeme(type->element_->name_) << "'.\n";
+        has_error_ = true;
+        return;
+    }
+    if (name == LoxSet::TYPE and !LoxSet::supports(*element)) {
+        err << "Line [" << tokens.line(type->element_->name_) << "]: A set can only hold int, float or str.\n";
+        has_error_ = true;
+        return;
+    }
+    if (auto list = dynamic_cast<ListExpr *>(initializer.get()); list and name == LoxList::TYPE) {
+        list->elementType_ = type->element_;
+    } else if (auto map = dynamic_cast<MapExpr *>(initializer.get()); map and name == LoxMap::TYPE) {
+        map->valueType_ = type->element_;
+    } else if (auto set = dynamic_cast<SetLiteralExpr *>(initializer.get()); set and name == LoxSet::TYPE) {
+        set->elementType_ = type->element_;
+    }
+}
@@ -1,34 +1,194 @@
 #include "scanner.hpp"
 #include <iostream>
 #include <regex>
+#include <charconv>
+#include <bit>
+#include <cstring>
 
-void Scanner::fillStrRefers(const std::string &content) {
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    struct Keyword {
+        std::string_view text;
+        TokenType type;
+    };
+
+    constexpr Keyword keywords[] = {
+            {"and",      TokenType::AND},
+            {"or",       TokenType::OR},
+            {"not",      TokenType::NOT},
+            {"async",    TokenType::ASYNC},
+            {"await",    TokenType::AWAIT},
+            {"break",    TokenType::BREAK},
+            {"class",    TokenType::CLASS},
+            {"continue", TokenType::CONTINUE},
+            {"else",     TokenType::ELSE},
+            {"elif",     TokenType::ELIF},
+            {"enum",     TokenType::ENUM},
+            {"false",    TokenType::FALSE},
+            {"fun",      TokenType::FUN},
+            {"for",      TokenType::FOR},
+            {"if",       TokenType::IF},
+            {"import",   TokenType::IMPORT},
+            {"in",       TokenType::IN},
+            {"is",       TokenType::IS},
+            {"let",      TokenType::LET},
+            {"nil",      TokenType::NIL},
+            {"return",   TokenType::RETURN},
+            {"super",    TokenType::SUPER},
+            {"this",     TokenType::THIS},
+            {"true",     TokenType::TRUE},
+            {"var",      TokenType::VAR},
+            {"when",     TokenType::WHEN},
+            {"while",    TokenType::WHILE},
+            {"yield",    TokenType::YIELD}
+    };
+
+    constexpr size_t KEYWORD_MIN_LEN = 2, KEYWORD_MAX_LEN = 8;
+    constexpr uint32_t KEYWORD_SLOT_BITS = 6;
+
+    // 关键字的完美哈希：由前两个字符、末字符和长度组成键，乘以种子后取高位作为槽位
+    constexpr uint32_t keywordKey(std::string_view text) {
+        return (uint32_t) (uint8_t) text[0] << 24 | (uint32_t) (uint8_t) text[1] << 16
+               | (uint32_t) (uint8_t) text.back() << 8 | (uint32_t) text.length();
+    }
+
+    constexpr uint32_t keywordSlot(uint32_t key, uint32_t seed) {
+        return (key * seed) >> (32 - KEYWORD_SLOT_BITS);
+    }
+
+    // 编译期搜索一个让所有关键字互不冲突的种子，增删关键字后会自动重新计算
+    consteval uint32_t findKeywordSeed() {
+        for (uint32_t seed = 1; seed < 10'000'000; seed += 2) {
+            bool used[1 << KEYWORD_SLOT_BITS]{};
+            bool collision = false;
+            for (const auto &keyword: keywords) {
+                auto slot = keywordSlot(keywordKey(keyword.text), seed);
+                if (used[slot]) {
+                    collision = true;
+                    break;
+                }
+                used[slot] = true;
+            }
+            if (not collision) return seed;
+        }
+        return 0;
+    }
+
+    constexpr uint32_t KEYWORD_SEED = findKeywordSeed();
+    static_assert(KEYWORD_SEED != 0, "No perfect hash seed for the keyword set.");
+
+    constexpr auto keywordSlots = [] {
+        std::array<int8_t, 1 << KEYWORD_SLOT_BITS> slots{};
+        slots.fill(-1);
+        for (size_t i = 0; i < std::size(keywords); ++i) {
+            slots[keywordSlot(keywordKey(keywords[i].text), KEYWORD_SEED)] = (int8_t) i;
+        }
+        return slots;
+    }();
+
+#if defined(__SSE2__)
+    // SIMD：每次检查 16 个字节，返回从低地址开始连续满足条件的字节数
+    constexpr size_t RUN_WIDTH = 16;
+
+    unsigned identifierRun(const char *p) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // 转为小写后减去 'a'，无符号地落在 [0, 25] 内即为字母
+        __m128i letter = _mm_sub_epi8(_mm_or_si128(x, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(25)), letter);
+        __m128i digit = _mm_sub_epi8(x, _mm_set1_epi8('0'));
+        __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+        __m128i isUnderscore = _mm_cmpeq_epi8(x, _mm_set1_epi8('_'));
+        auto mask = (unsigned) _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(isLetter, isDigit), isUnderscore));
+        return std::countr_one(mask);
+    }
+
+    unsigned blankRun(const char *p) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\t')));
+        return std::countr_one((unsigned) _mm_movemask_epi8(blank));
+    }
+#else
+    // SWAR：把 8 个字节装进一个 64 位整数并行判断，结果中每个命中字节的最高位被置 1
+    constexpr size_t RUN_WIDTH = std::endian::native == std::endian::little ? 8 : 0;
+
+    constexpr uint64_t ONES = 0x0101010101010101ULL;
+    constexpr uint64_t HIGHS = 0x8080808080808080ULL;
+    constexpr uint64_t LOWS = 0x7F7F7F7F7F7F7F7FULL;
+
+    uint64_t load8(const char *p) {
+        uint64_t x;
+        std::memcpy(&x, p, sizeof(x));
+        return x;
+    }
+
+    // 等于 c 的字节
+    uint64_t bytesEqual(uint64_t x, char c) {
+        uint64_t y = x ^ (ONES * (uint8_t) c);
+        return ~(((y & LOWS) + LOWS) | y) & HIGHS;
+    }
+
+    // 位于 [lo, hi] 之间的字节，最高位为 1 的字节一律不命中
+    uint64_t bytesBetween(uint64_t x, uint8_t lo, uint8_t hi) {
+        uint64_t low7 = x & LOWS;
+        return (ONES * (127 + hi + 1) - low7) & ~x & (low7 + ONES * (127 - (lo - 1))) & HIGHS;
+    }
+
+    unsigned identifierRun(const char *p) {
+        uint64_t x = load8(p);
+        uint64_t ident = bytesBetween(x, 'a', 'z') | bytesBetween(x, 'A', 'Z') | bytesBetween(x, '0', '9')
+                         | bytesEqual(x, '_');
+        uint64_t stop = ~ident & HIGHS;
+        return stop ? std::countr_zero(stop) / 8 : 8;
+    }
+
+    unsigned blankRun(const char *p) {
+        uint64_t x = load8(p);
+        uint64_t stop = ~(bytesEqual(x, ' ') | bytesEqual(x, '\t')) & HIGHS;
+        return stop ? std::countr_zero(stop) / 8 : 8;
+    }
+#endif
+}
+
+TokenType Scanner::identifierType(std::string_view text) {
+    if (text.length() < KEYWORD_MIN_LEN or text.length() > KEYWORD_MAX_LEN) return TokenType::IDENTIFIER;
+    auto index = keywordSlots[keywordSlot(keywordKey(text), KEYWORD_SEED)];
+    if (index >= 0 and keywords[index].text == text) return keywords[index].type;
+    return TokenType::IDENTIFIER;
+}
+
+void Scanner::fillStrRefers(std::string_view content) {
     // 定义一个正则表达式来匹配 ${...} 和 \${...}
-    std::regex pattern(R"(\$\{[^{}]*\}|\\\$\{[^{}]*\})");
+    static const std::regex pattern(R"(\$\{[^{}]*\}|\\\$\{[^{}]*\})");
 
-    // 创建迭代器，首先获取非匹配的子串，然后获取匹配的子串
-    std::sregex_token_iterator iter(content.begin(), content.end(), pattern, {-1, 0});
-    std::sregex_token_iterator end;
+    // 创建迭代器，首先获取非匹配的子串，然后获取匹配的子串（直接在源码上迭代，不复制内容）
+    std::cregex_token_iterator iter(content.data(), content.data() + content.size(), pattern, {-1, 0});
+    std::cregex_token_iterator end;
     // 匹配字符串模板错误情况
-    std::regex pattern2(R"([${}"])");
-    std::smatch match;
+    static const std::regex pattern2(R"([${}"])");
 
     // 遍历并打印结果
     while (iter != end) {
-        std::string token = *iter++;
+        auto sub = *iter++;    // 子匹配只保存指向源码的指针
+        std::string_view token{sub.first, (size_t) sub.length()};
         if (!token.empty()) {
             if (token.front() == '$') { // 判断是否为匹配的子串
                 token = token.substr(2, token.length() - 3);
-                if (std::regex_search(token, match, pattern2)) {
+                if (std::regex_search(token.begin(), token.end(), pattern2)) {
                     throw std::runtime_error{"string-expression error."};
                 }
-                Scanner scanner{token};
-                scanner.line = line;
-                scanner.getTokens();
-                tokens.insert(tokens.cend(), scanner.tokens.cbegin(), scanner.tokens.cend() - 1);
+                // 模板中的表达式直接在同一份源码上扫描，词法单元追加到同一个缓冲区
+                auto savedCurrent = current, savedStart = start, savedLimit = limit;
+                current = token.data() - program.data();
+                limit = current + token.length();
+                scanTokens();
+                current = savedCurrent, start = savedStart, limit = savedLimit;
             } else {
-                LoxValuePtr v = std::make_shared<LoxString>(token);
-                tokens.emplace_back(std::make_shared<Token>(TokenType::STRING, v, token, 0));
+                start = token.data() - program.data();
+                tokens.addLiteral(TokenType::STRING, (uint32_t) start, (uint32_t) token.length(), line, column(),
+                                  std::make_shared<LoxString>(std::string{token}));
             }
         }
     }
@@ -39,18 +199,18 @@ void Scanner::parseString() {
     addToken(TokenType::STR_START);
 
     // 检查字符串完整性
-    int i = start + 1;
-    for (; i < program.length(); ++i) {
+    size_t i = start + 1;
+    for (; i < limit; ++i) {
         if (program[i] == '"' and program[i - 1] != '\\') break; // 有效的结束双引号
     }
-    if (i == program.length()) {
-        std::cerr << "Line: " << line << ", Unterminated string." << std::endl;
+    if (i == limit) {
+        err << "Line: " << line << ", Unterminated string." << std::endl;
         current = i;
         hasError = true;
         return;
     }
 
-    auto ts = program.substr(current, i - start - 1);
+    auto ts = program.substr(current, i - start - 1);   // 源码视图，不复制
     fillStrRefers(ts); // 获取可能是字符串模板的token数组
 
     start = i;
@@ -65,45 +225,75 @@ void Scanner::parseNumber() {
         isFloat = true;
         do advance(); while (isNum(peek()));
     }
-    std::string value = program.substr(start, (current - start));
+    const char *first = program.data() + start, *last = program.data() + current;
     if (isFloat) {
-        addToken(TokenType::FLOATING, std::make_shared<LoxFloat>(std::stod(value)));
+        double value;
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc{}) return numberError();
+        addToken(TokenType::FLOATING, std::make_shared<LoxFloat>(value));
     } else {
-        addToken(TokenType::INTEGER, std::make_shared<LoxInt>(std::stoll(value)));
+        int64_t value;
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc{}) return numberError();
+        addToken(TokenType::INTEGER, std::make_shared<LoxInt>(value));
     }
 }
 
 void Scanner::parseIdentifier() {
+    // 大多数标识符很短，先逐字节查表；更长的标识符再按块（SIMD/SWAR）跳过
+    for (int i = 0; i < 7; ++i) {
+        if (not isAlphaNum(peek())) return addToken(identifierType(program.substr(start, (current - start))));
+        advance();
+    }
+    if constexpr (RUN_WIDTH > 0) {
+        while (current + RUN_WIDTH <= limit) {
+            auto run = identifierRun(program.data() + current);
+            current += run;
+            if (run < RUN_WIDTH) break;
+        }
+    }
     while (isAlphaNum(peek())) advance();
-    std::string value = program.substr(start, (current - start));
-    TokenType tokenType;
-    auto it = keywords.find(value);
-    if (it != keywords.end()) {
-        tokenType = it->second;
-    } else {
-        tokenType = TokenType::IDENTIFIER;
+    addToken(identifierType(program.substr(start, (current - start))));
+}
+
+void Scanner::skipSpaces() {
+    if constexpr (RUN_WIDTH > 0) {
+        while (current + RUN_WIDTH <= limit) {
+            auto run = blankRun(program.data() + current);
+            current += run;
+            if (run < RUN_WIDTH) break;
+        }
     }
-    addToken(tokenType);
+    while (isSpace(peek())) advance();
 }
 
 void Scanner::parseComments() {
-    if (match('/')) { // One_line comments
-        while (not atEnd() and peek() != '\n') advance();
+    const char *data = program.data();
+    if (match('/')) { // One_line comments，直接用 memchr 找到行尾
+        auto newline = static_cast<const char *>(std::memchr(data + current, '\n', limit - current));
+        current = newline ? newline - data : limit;
         return;
     }
-    if (match('*')) { // Cross-line comments
-        while (not(atEnd() or (peek() == '*' and peekNext() == '/'))) {
-            if (peek() == '\n') line++;
-            advance();
-        }
-        if (not atEnd()) {
-            advance();
-            advance();
+    if (match('*')) { // Cross-line comments，每次跳到下一个 '*'，并统计跳过的换行
+        while (not atEnd()) {
+            auto star = static_cast<const char *>(std::memchr(data + current, '*', limit - current));
+            const char *stop = star ? star : data + limit;
+            for (auto p = data + current;
+                 (p = static_cast<const char *>(std::memchr(p, '\n', stop - p))) != nullptr; ++p) {
+                line++;
+                lineStart = p - data + 1;
+            }
+            if (!star) {
+                current = limit;
+                return;
+            }
+            current = star - data + 1;
+            if (match('/')) return;
         }
     }
 }
 
-std::optional<std::vector<TokenPtr>> Scanner::getTokens() {
+void Scanner::scanTokens() {
     while (not atEnd()) {
         start = current;
         switch (char c = advance()) {
@@ -125,7 +315,7 @@ std::optional<std::vector<TokenPtr>> Scanner::getTokens() {
                 break;
             case ';':addToken(TokenType::SEMICOLON);
                 break;
-            case '\n':line++;
+            case '\n':newLine();
                 break;
             case '^':addToken(TokenType::BIT_XOR);
                 break;
@@ -194,23 +384,30 @@ std::optional<std::vector<TokenPtr>> Scanner::getTokens() {
             case '\t':
             case '\r':
             case '\f':
-            case '\v':break;
+            case '\v':skipSpaces();
+                break;
             default:
                 if (isNum(c)) {
                     parseNumber();
                 } else if (isAlpha(c)) {
                     parseIdentifier();
                 } else {
-                    std::cerr << "Line: " << line << ", Unexpected character [" << c << "]" << std::endl;
+                    err << "Line: " << line << ", Unexpected character [" << c << "]" << std::endl;
                     hasError = true;
                 }
         }
     }
+}
+
+std::optional<TokenBuffer> Scanner::getTokens() {
+    tokens.reserve(program.length() / 6 + 1);   // 按典型代码的词法单元密度预留，避免反复扩容
+    scanTokens();
 
     if (hasError) {
         return std::nullopt;
     } else {
+        start = current;
         addToken(TokenType::ENDMARKER);
-        return tokens;
+        return std::move(tokens);
     }
 }
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "interpreter.hpp"
+
+namespace {
+    // 请求来自套接字上的任意进程，先检查大小再分配内存
+    constexpr uint32_t MAX_ARGUMENTS = 4096;
+    constexpr uint32_t MAX_STRING = 1 << 20;
+    constexpr size_t MAX_REQUEST = 8 << 20;
+    // 请求依次处理，读写套接字超时的客户端直接断开，以免一个停住的客户端使之后的请求一直等待
+    constexpr timeval IO_TIMEOUT{10, 0};
+
+    bool sendAll(int fd, const char *data, size_t size) {
+        while (size > 0) {
+            auto sent = send(fd, data, size, MSG_NOSIGNAL);
+            if (sent <= 0) return false;
+            data += sent, size -= (size_t) sent;
+        }
+        return true;
+    }
+
+    bool recvAll(int fd, char *data, size_t size) {
+        while (size > 0) {
+            auto received = recv(fd, data, size, 0);
+            if (received <= 0) return false;
+            data += received, size -= (size_t) received;
+        }
+        return true;
+    }
+
+    bool sendFrame(int fd, Server::Frame kind, std::string_view data) {
+        char header[5];
+        header[0] = (char) kind;
+        auto size = (uint32_t) data.size();
+        std::memcpy(header + 1, &size, sizeof(size));
+        return sendAll(fd, header, sizeof(header)) and sendAll(fd, data.data(), data.size());
+    }
+
+    bool sendString(int fd, std::string_view text) {
+        auto size = (uint32_t) text.size();
+        return sendAll(fd, reinterpret_cast<const char *>(&size), sizeof(size)) and sendAll(fd, text.data(), size);
+    }
+
+    // 连接断开或长度超过 limit 时返回 false，后者同时把 tooLarge 设为 true 且不读取内容
+    bool recvString(int fd, std::string &text, size_t limit, bool &tooLarge) {
+        uint32_t size;
+        if (not recvAll(fd, reinterpret_cast<char *>(&size), sizeof(size))) return false;
+        if (size > limit) {
+            tooLarge = true;
+            return false;
+        }
+        text.resize(size);
+        return recvAll(fd, text.data(), size);
+    }
+
+    // 把写入的内容按帧发给客户端，缓冲区满或 flush（如 std::endl）时发送；客户端断开后丢弃输出
+    class FrameBuffer : public std::streambuf {
+    public:
+        FrameBuffer(int fd, Server::Frame kind) : fd_{fd}, kind_{kind} {
+            setp(buffer_, buffer_ + sizeof(buffer_));
+        }
+
+        ~FrameBuffer() override {
+            sync();
+        }
+
+    protected:
+        int_type overflow(int_type c) override {
+            sync();
+            if (not traits_type::eq_int_type(c, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        int sync() override {
+            std::string_view data{pbase(), (size_t) (pptr() - pbase())};
+            setp(buffer_, buffer_ + sizeof(buffer_));
+            if (not data.empty() and connected_) connected_ = sendFrame(fd_, kind_, data);
+            return 0;
+        }
+
+    private:
+        int fd_;
+        Server::Frame kind_;
+        bool connected_{true};
+        char buffer_[4096];
+    };
+
+    sockaddr_un address(const std::string &path) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return addr;
+    }
+}
+
+Server::~Server() {
+    if (listener_ >= 0) {
+        close(listener_);
+        unlink(path_.c_str());
+    }
+}
+
+bool Server::serve() {
+    if (path_.size() >= sizeof(sockaddr_un::sun_path)) {
+        std::cerr << "Socket path too long: " << path_ << std::endl;
+        return false;
+    }
+    listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener_ < 0) {
+        std::cerr << "Could not create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // 清理上次异常退出时留下的套接字文件
+    unlink(path_.c_str());
+    auto addr = address(path_);
+    if (bind(listener_, (sockaddr *) &addr, sizeof(addr)) != 0 or listen(listener_, SOMAXCONN) != 0) {
+        std::cerr << "Could not listen on " << path_ << ": " << std::strerror(errno) << std::endl;
+        close(listener_);
+        listener_ = -1;
+        return false;
+    }
+
+    while (true) {
+        int client = accept(listener_, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Could not accept connection: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &IO_TIMEOUT, sizeof(IO_TIMEOUT));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &IO_TIMEOUT, sizeof(IO_TIMEOUT));
+        // 一个请求出错（如内存不足）不影响之后的请求
+        try {
+            handle(client);
+        } catch (const std::exception &e) {
+            std::cerr << "Could not handle request: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Could not handle request." << std::endl;
+        }
+        close(client);
+    }
+}
+
+void Server::handle(int client) {
+    uint32_t count;
+    if (not recvAll(client, reinterpret_cast<char *>(&count), sizeof(count)) or count == 0) return;
+
+    // 参数过多或过长的请求直接拒绝
+    bool tooLarge = count > MAX_ARGUMENTS;
+    std::vector<std::string> request;
+    size_t total = 0;
+    for (uint32_t i = 0; i < count and not tooLarge; ++i) {
+        auto &text = request.emplace_back();
+        auto limit = std::min<size_t>(MAX_STRING, MAX_REQUEST - total);
+        if (not recvString(client, text, limit, tooLarge) and not tooLarge) return;
+        total += text.size();
+    }
+
+    int status = 1;
+    {
+        FrameBuffer outBuffer{client, Frame::OUTPUT}, errBuffer{client, Frame::ERROR};
+        std::ostream out{&outBuffer}, err{&errBuffer};
+        if (tooLarge) {
+            err << "Request too large." << std::endl;
+        } else {
+            try {
+                status = run(request, out, err);
+            } catch (const std::exception &e) {
+                err << "Internal error: " << e.what() << std::endl;
+            } catch (...) {
+                err << "Internal error." << std::endl;
+            }
+        }
+    }
+    int32_t code = status;
+    sendFrame(client, Frame::EXIT, {reinterpret_cast<const char *>(&code), sizeof(code)});
+}
+
+int Server::run(const std::vector<std::string> &request, std::ostream &out, std::ostream &err) {
+    const auto &path = request[0];
+    auto slash = path.rfind('/');
+    ModuleRegistry::instance().configure({slash == 0 ? "/" : path.substr(0, slash)}, options_);
+    ModuleRegistry::instance().refresh();
+
+    auto compiled = program(path, err);
+    if (!compiled) return 1;
+    ModuleRegistry::instance().preload(*compiled);
+
+    Interpreter interpreter{out, err};
+    interpreter.arguments.assign(request.begin() + 1, request.end());
+    return interpreter.interpret(compiled->statements, compiled->tokens) ? 0 : 1;
+}
+
+const CompiledProgram *Server::program(const std::string &path, std::ostream &err) {
+    auto it = scripts_.find(path);
+    if (it != scripts_.end() and Source::modifiedTime(path) == it->second.source->modified()) {
+        return it->second.program.get();
+    }
+    if (it != scripts_.end()) scripts_.erase(it);
+
+    auto source = Source::fromFile(path);
+    if (!source) {
+        err << "Could not open file: " << path << std::endl;
+        return nullptr;
+    }
+    auto compiled = compile(*source, options_, err);
+    if (!compiled) return nullptr;
+
+    auto &script = scripts_[path];
+    script.source = std::move(source);
+    script.program = std::move(compiled);
+    return script.program.get();
+}
+
+int Server::connect(const std::string &path, const std::string &script, const std::vector<std::string> &args) {
+    // 常驻进程的工作目录与客户端不同，脚本路径先转换为绝对路径
+    char resolved[PATH_MAX];
+    if (!realpath(script.c_str(), resolved)) {
+        std::cerr << "Could not open file: " << script << std::endl;
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    auto addr = address(path);
+    if (fd < 0 or ::connect(fd, (sockaddr *) &addr, sizeof(addr)) != 0) {
+        std::cerr << "Could not connect to " << path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+
+    auto count = (uint32_t) (args.size() + 1);
+    bool sent = sendAll(fd, reinterpret_cast<const char *>(&count), sizeof(count)) and sendString(fd, resolved);
+    for (const auto &arg: args) sent = sent and sendString(fd, arg);
+
+    int status = 1;
+    std::string data;
+    char header[5];
+    while (sent and recvAll(fd, header, sizeof(header))) {
+        uint32_t size;
+        std::memcpy(&size, header + 1, sizeof(size));
+        data.resize(size);
+        if (not recvAll(fd, data.data(), size)) break;
+
+        auto kind = (Frame) header[0];
+        if (kind == Frame::OUTPUT) {
+            std::cout << data << std::flush;
+        } else if (kind == Frame::ERROR) {
+            std::cerr << data << std::flush;
+        } else if (kind == Frame::EXIT and size == sizeof(int32_t)) {
+            int32_t code;
+            std::memcpy(&code, data.data(), sizeof(code));
+            status = code;
+            break;
+        }
+    }
+    close(fd);
+    return status;
+}
@@ -0,0 +1,545 @@
+#include "snapshot.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_set>
+#include <unistd.h>
+
+#include "interpreter.hpp"
+#include "lox_array.hpp"
+#include "lox_async.hpp"
+#include "lox_generator.hpp"
+#include "lox_hamt.hpp"
+#include "lox_instance.hpp"
+#include "lox_iterator.hpp"
+#include "lox_list.hpp"
+#include "lox_map.hpp"
+#include "lox_module.hpp"
+#include "lox_set.hpp"
+#include "lox_vector.hpp"
+#include "native.hpp"
+
+namespace {
+    constexpr char MAGIC[8] = {'I', 'D', 'U', 'N', 'S', 'N', 'A', 'P'};
+
+    constexpr uint32_t NO_OBJECT = UINT32_MAX;
+
+    enum class ObjectTag : uint8_t {
+        NIL, BOOL, INT, FLOAT, STRING, NATIVE, FUNCTION, CLASS, INSTANCE, MODULE,
+        LIST, MAP, SET, VECTOR, HAMT
+    };
+
+    // 不能保存的值的类型名，用于错误信息
+    template<typename... T>
+    std::string_view typeOf(const LoxValue *value) {
+        std::string_view name = "unknown";
+        ((dynamic_cast<const T *>(value) ? (name = T::TYPE, true) : false) or ...);
+        return name;
+    }
+
+    bool isElementType(uint8_t type) {
+        return type <= (uint8_t) ElementType::ANY;
+    }
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t sourceSize;    // 准备脚本的源码紧跟在文件头之后
+        uint64_t payloadHash;
+    };
+}
+
+/* 对象图以编号引用，先写出所有对象，再写出环境和实例中的变量。
+ * 对象按“构造依赖”（父类、方法、实例所属的类、不可变集合的元素）的后序编号，读取时按顺序构造即可；
+ * 环境、实例字段以及可变的列表和字典可能形成环，先构造为空，放到最后统一连接。
+ * int、float、bool 的列表和集合中的元素直接写出数值，恢复后仍是不装箱的存储。
+ * */
+class Snapshot::Writer {
+public:
+    Writer(const CompiledProgram &program, const std::unordered_map<const FunctionStmt *, uint32_t> &functions)
+            : program{program}, functions{functions} {
+        // 内置函数不保存内容，只记下它在全局环境中的名字，恢复时取新解释器中的同名对象
+        Interpreter fresh;
+        for (const auto &[name, value]: fresh.global->values) {
+            if (dynamic_cast<NativeCallable *>(value.get())) natives.insert(name);
+        }
+    }
+
+    bool write(std::string &out, const Interpreter &interpreter) {
+        environment(interpreter.global.get());
+
+        std::string envLinks, fieldLinks, collectionLinks;
+        uint32_t instanceCount = 0, collectionCount = 0;
+        size_t e = 0, k = 0, c = 0;
+        while (e < envs.size() or k < instances.size() or c < collections.size()) {
+            for (; e < envs.size(); ++e) {
+                put(envLinks, environment(envs[e]->parentEnv.get()));
+                put(envLinks, (uint32_t) envs[e]->values.size());
+                for (const auto &[name, value]: envs[e]->values) {
+                    owner = (e == 0 ? "global '" : "variable '") + name + "'";
+                    put(envLinks, std::string_view{name}), put(envLinks, object(value.get()));
+                    put(envLinks, (uint8_t) envs[e]->lets.contains(name));
+                }
+            }
+            for (; k < instances.size(); ++k, ++instanceCount) {
+                put(fieldLinks, objectIds.at(instances[k]));
+                put(fieldLinks, (uint32_t) instances[k]->fields_.size());
+                for (const auto &[name, value]: instances[k]->fields_) {
+                    owner = "field '" + name + "'";
+                    put(fieldLinks, std::string_view{name}), put(fieldLinks, object(value.get()));
+                }
+            }
+            for (; c < collections.size(); ++c, ++collectionCount) {
+                owner = collections[c].second;
+                link(collectionLinks, collections[c].first);
+            }
+        }
+        if (failed) return false;
+
+        put(out, (uint32_t) envs.size());
+        put(out, objectCount);
+        out += objects;
+        out += envLinks;
+        put(out, instanceCount);
+        out += fieldLinks;
+        put(out, collectionCount);
+        out += collectionLinks;
+        return true;
+    }
+
+    bool failed{false};
+    std::string reason;
+
+private:
+    template<typename T>
+    static void put(std::string &out, T value) {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    static void put(std::string &out, std::string_view text) {
+        put(out, (uint32_t) text.size());
+        out.append(text);
+    }
+
+    void fail(std::string message) {
+        if (not failed) reason = std::move(message);
+        failed = true;
+    }
+
+    uint32_t environment(const Environment *env) {
+        if (!env) return NO_OBJECT;
+        auto [it, inserted] = envIds.emplace(env, (uint32_t) envs.size());
+        if (inserted) envs.push_back(env);
+        return it->second;
+    }
+
+    uint32_t object(LoxValue *value) {
+        if (!value) return NO_OBJECT;
+        if (auto it = objectIds.find(value); it != objectIds.end()) return it->second;
+
+        std::string record;
+        if (auto function = dynamic_cast<LoxFunction *>(value)) {
+            auto it = functions.find(function->declaration_);
+            if (function->unit_->tokens != &program.tokens or it == functions.end()) {
+                fail("function '" + std::string{function->unit_->tokens->lexeme(function->declaration_->name_)}
+                     + "' was not defined by the setup script");
+                return NO_OBJECT;
+            }
+            put(record, (uint8_t) ObjectTag::FUNCTION), put(record, it->second);
+            put(record, environment(function->closure_.get())), put(record, (uint8_t) function->isInitializer_);
+        } else if (auto loxClass = dynamic_cast<LoxClass *>(value)) {
+            auto super = object(loxClass->super_.get());
+            put(record, (uint8_t) ObjectTag::CLASS), put(record, std::string_view{loxClass->name_});
+            put(record, super), put(record, (uint32_t) loxClass->methods_.size());
+            for (const auto &[name, method]: loxClass->methods_) {
+                auto id = object(method.get());
+                put(record, std::string_view{name}), put(record, id);
+            }
+        } else if (auto instance = dynamic_cast<LoxInstance *>(value)) {
+            put(record, (uint8_t) ObjectTag::INSTANCE), put(record, object(instance->class_.get()));
+            instances.push_back(instance);
+        } else if (auto string = dynamic_cast<LoxString *>(value)) {
+            put(record, (uint8_t) ObjectTag::STRING), put(record, std::string_view{string->value_});
+        } else if (auto integer = dynamic_cast<LoxInt *>(value)) {
+            put(record, (uint8_t) ObjectTag::INT), put(record, integer->value_);
+        } else if (auto floating = dynamic_cast<LoxFloat *>(value)) {
+            put(record, (uint8_t) ObjectTag::FLOAT), put(record, floating->value_);
+        } else if (auto boolean = dynamic_cast<LoxBool *>(value)) {
+            put(record, (uint8_t) ObjectTag::BOOL), put(record, (uint8_t) boolean->value_);
+        } else if (auto module = dynamic_cast<LoxModule *>(value)) {
+            // 模块只记下名字，恢复后首次访问时重新初始化
+            put(record, (uint8_t) ObjectTag::MODULE), put(record, std::string_view{module->name_});
+        } else if (dynamic_cast<LoxNil *>(value)) {
+            put(record, (uint8_t) ObjectTag::NIL);
+        } else if (auto native = dynamic_cast<NativeCallable *>(value); native and natives.contains(native->name_)) {
+            put(record, (uint8_t) ObjectTag::NATIVE), put(record, std::string_view{native->name_});
+        } else if (auto list = dynamic_cast<LoxList *>(value)) {
+            // 切片恢复为独立的列表，写时复制本来就使它与原列表互不影响
+            put(record, (uint8_t) ObjectTag::LIST), put(record, (uint8_t) list->elementType());
+            put(record, (uint8_t) list->declared());
+            collections.emplace_back(value, owner);
+        } else if (auto map = dynamic_cast<LoxMap *>(value)) {
+            put(record, (uint8_t) ObjectTag::MAP), put(record, (uint8_t) map->valueType());
+            put(record, (uint8_t) map->declared());
+            collections.emplace_back(value, owner);
+        } else if (auto set = dynamic_cast<LoxSet *>(value)) {
+            put(record, (uint8_t) ObjectTag::SET), put(record, (uint8_t) set->elementType());
+            put(record, (uint8_t) set->frozen()), put(record, (uint32_t) set->size());
+            set->forEach([&](const LoxValuePtr &element) { scalar(record, set->elementType(), element.get()); });
+        } else if (auto vector = dynamic_cast<LoxVector *>(value)) {
+            std::vector<uint32_t> ids;
+            ids.reserve(vector->size());
+            vector->items().forEach([&](const LoxValuePtr &element) {
+                ids.push_back(object(element.get()));
+                return true;
+            });
+            put(record, (uint8_t) ObjectTag::VECTOR), put(record, (uint8_t) vector->elementType());
+            put(record, (uint8_t) vector->declared()), put(record, (uint32_t) ids.size());
+            for (auto id: ids) put(record, id);
+        } else if (auto hamt = dynamic_cast<LoxHamt *>(value)) {
+            std::string entries;
+            hamt->items().forEach([&](const std::shared_ptr<LoxString> &key, const LoxValuePtr &item) {
+                auto id = object(item.get());
+                put(entries, key->value_), put(entries, id);
+            });
+            put(record, (uint8_t) ObjectTag::HAMT), put(record, (uint8_t) hamt->valueType());
+            put(record, (uint8_t) hamt->declared()), put(record, (uint32_t) hamt->size());
+            record += entries;
+        } else {
+            std::string_view type = dynamic_cast<NativeCallable *>(value)
+                                    ? "native function"
+                                    : typeOf<LoxArray, LoxRange, LoxIterator, LoxGenerator, LoxFuture>(value);
+            fail(owner + " holds a value of type " + std::string{type} + " that cannot be saved");
+            return NO_OBJECT;
+        }
+
+        objects += record;
+        objectIds.emplace(value, objectCount);
+        return objectCount++;
+    }
+
+    // int、float、bool 直接写出数值，str 写出内容
+    static void scalar(std::string &out, ElementType type, const LoxValue *value) {
+        switch (type) {
+            case ElementType::INT:put(out, static_cast<const LoxInt *>(value)->value_);
+                break;
+            case ElementType::FLOAT:put(out, static_cast<const LoxFloat *>(value)->value_);
+                break;
+            case ElementType::BOOL:put(out, (uint8_t) static_cast<const LoxBool *>(value)->value_);
+                break;
+            default:put(out, static_cast<const LoxString *>(value)->value_);
+        }
+    }
+
+    // 可变集合的内容：int、float、bool 的列表直接写出数值，其它元素写出对象编号
+    void link(std::string &out, LoxValue *value) {
+        put(out, objectIds.at(value));
+        if (auto list = dynamic_cast<LoxList *>(value)) {
+            auto type = list->elementType();
+            bool unboxed = type == ElementType::INT or type == ElementType::FLOAT or type == ElementType::BOOL;
+            put(out, (uint32_t) list->size());
+            for (size_t i = 0; i < list->size(); ++i) {
+                auto element = list->get(i);
+                if (unboxed) scalar(out, type, element.get());
+                else put(out, object(element.get()));
+            }
+        } else if (auto map = dynamic_cast<LoxMap *>(value)) {
+            put(out, (uint32_t) map->size());
+            map->forEach([&](const std::shared_ptr<LoxString> &key, const LoxValuePtr &item) {
+                put(out, key->value_), put(out, object(item.get()));
+            });
+        }
+    }
+
+    const CompiledProgram &program;
+    const std::unordered_map<const FunctionStmt *, uint32_t> &functions;
+    std::unordered_set<std::string> natives;
+    std::string owner;  // 正在写出的变量或字段，用于错误信息
+
+    std::unordered_map<const Environment *, uint32_t> envIds;
+    std::vector<const Environment *> envs;
+    std::unordered_map<const LoxValue *, uint32_t> objectIds;
+    std::vector<const LoxInstance *> instances;
+    std::vector<std::pair<LoxValue *, std::string>> collections;  // 待写出内容的列表和字典，以及引用它的变量
+    std::string objects;
+    uint32_t objectCount{0};
+};
+
+class Snapshot::Reader {
+public:
+    Reader(std::string_view data, const CompiledProgram &program, const std::vector<FunctionStmtPtr> &functions)
+            : data{data}, program{program}, functions{functions} {}
+
+    bool read(Interpreter &interpreter) {
+        auto envCount = get<uint32_t>();
+        auto objectCount = get<uint32_t>();
+        if (failed or envCount == 0) return false;
+
+        unit = std::make_shared<Unit>(Unit{&program.tokens, interpreter.global, {}});
+        envs.reserve(envCount);
+        envs.push_back(interpreter.global);
+        for (uint32_t i = 1; i < envCount; ++i) envs.push_back(std::make_shared<Environment>());
+
+        objects.reserve(objectCount);
+        for (uint32_t i = 0; i < objectCount and not failed; ++i) {
+            objects.push_back(object(interpreter));
+        }
+
+        for (uint32_t i = 0; i < envCount and not failed; ++i) {
+            auto parent = get<uint32_t>();
+            if (i > 0) envs[i]->parentEnv = parent == NO_OBJECT ? nullptr : at(envs, parent);
+            auto count = get<uint32_t>();
+            for (uint32_t j = 0; j < count and not failed; ++j) {
+                auto name = getString();
+                envs[i]->values.insert_or_assign(std::string{name}, objectAt(get<uint32_t>()));
+                if (get<uint8_t>()) envs[i]->lets.emplace(name);
+            }
+        }
+
+        auto instanceCount = get<uint32_t>();
+        for (uint32_t i = 0; i < instanceCount and not failed; ++i) {
+            auto instance = std::dynamic_pointer_cast<LoxInstance>(objectAt(get<uint32_t>()));
+            if (!instance) return false;
+            auto count = get<uint32_t>();
+            for (uint32_t j = 0; j < count and not failed; ++j) {
+                auto name = getString();
+                instance->fields_.insert_or_assign(std::string{name}, objectAt(get<uint32_t>()));
+            }
+        }
+
+        auto collectionCount = get<uint32_t>();
+        for (uint32_t i = 0; i < collectionCount and not failed; ++i) link();
+        return not failed and data.empty();
+    }
+
+private:
+    template<typename T>
+    T get() {
+        T value{};
+        if (data.size() < sizeof(T)) {
+            failed = true;
+            return value;
+        }
+        std::memcpy(&value, data.data(), sizeof(T));
+        data.remove_prefix(sizeof(T));
+        return value;
+    }
+
+    std::string_view getString() {
+        auto size = get<uint32_t>();
+        if (data.size() < size) {
+            failed = true;
+            return {};
+        }
+        auto text = data.substr(0, size);
+        data.remove_prefix(size);
+        return text;
+    }
+
+    template<typename T>
+    T at(const std::vector<T> &list, uint32_t id) {
+        if (id >= list.size()) {
+            failed = true;
+            return nullptr;
+        }
+        return list[id];
+    }
+
+    // 引用的对象必须已经构造
+    LoxValuePtr objectAt(uint32_t id) {
+        return id == NO_OBJECT ? nullptr : at(objects, id);
+    }
+
+    LoxValuePtr scalar(ElementType type) {
+        switch (type) {
+            case ElementType::INT:return LoxInt::of(get<int64_t>());
+            case ElementType::FLOAT:return std::make_shared<LoxFloat>(get<double>());
+            case ElementType::BOOL:return LoxBool::of(get<uint8_t>() != 0);
+            default:return std::make_shared<LoxString>(std::string{getString()});
+        }
+    }
+
+    // 填入可变集合的内容，元素类型不符时失败
+    void link() {
+        auto value = objectAt(get<uint32_t>());
+        auto count = get<uint32_t>();
+        if (auto list = std::dynamic_pointer_cast<LoxList>(value)) {
+            auto type = list->elementType();
+            bool unboxed = type == ElementType::INT or type == ElementType::FLOAT or type == ElementType::BOOL;
+            list->reserve(std::min<size_t>(count, data.size()));
+            for (uint32_t i = 0; i < count and not failed; ++i) {
+                auto element = unboxed ? scalar(type) : objectAt(get<uint32_t>());
+                if (!element or !list->append(element)) failed = true;
+            }
+        } else if (auto map = std::dynamic_pointer_cast<LoxMap>(value)) {
+            for (uint32_t i = 0; i < count and not failed; ++i) {
+                auto key = std::make_shared<LoxString>(std::string{getString()});
+                auto item = objectAt(get<uint32_t>());
+                if (!item or !map->set(key, item)) failed = true;
+            }
+        } else {
+            failed = true;
+        }
+    }
+
+    LoxValuePtr object(Interpreter &interpreter) {
+        auto tag = (ObjectTag) get<uint8_t>();
+        switch (tag) {
+            case ObjectTag::NIL:return LoxNil::instance();
+            case ObjectTag::BOOL:return LoxBool::of(get<uint8_t>() != 0);
+            case ObjectTag::INT:return LoxInt::of(get<int64_t>());
+            case ObjectTag::FLOAT:return std::make_shared<LoxFloat>(get<double>());
+            case ObjectTag::STRING:return std::make_shared<LoxString>(std::string{getString()});
+            case ObjectTag::NATIVE: {
+                auto it = interpreter.global->values.find(getString());
+                if (it == interpreter.global->values.end()) break;
+                return it->second;
+            }
+            case ObjectTag::FUNCTION: {
+                auto declaration = at(functions, get<uint32_t>());
+                auto closure = at(envs, get<uint32_t>());
+                bool isInitializer = get<uint8_t>() != 0;
+                if (failed) break;
+                return std::make_shared<LoxFunction>(declaration.get(), closure, unit, isInitializer);
+            }
+            case ObjectTag::CLASS: {
+                std::string name{getString()};
+                auto super = std::dynamic_pointer_cast<LoxClass>(objectAt(get<uint32_t>()));
+                StringMap<std::shared_ptr<LoxFunction>> methods;
+                auto count = get<uint32_t>();
+                for (uint32_t i = 0; i < count and not failed; ++i) {
+                    auto method = getString();
+                    methods.emplace(method, std::dynamic_pointer_cast<LoxFunction>(objectAt(get<uint32_t>())));
+                }
+                return std::make_shared<LoxClass>(std::move(name), super, std::move(methods));
+            }
+            case ObjectTag::INSTANCE: {
+                auto loxClass = std::dynamic_pointer_cast<LoxClass>(objectAt(get<uint32_t>()));
+                if (!loxClass) break;
+                return std::make_shared<LoxInstance>(loxClass);
+            }
+            case ObjectTag::MODULE: {
+                std::string name{getString()};
+                auto [it, _] = interpreter.modules.try_emplace(name, std::make_shared<LoxModule>(name));
+                return it->second;
+            }
+            case ObjectTag::LIST:
+            case ObjectTag::MAP: {
+                auto type = get<uint8_t>();
+                bool declared = get<uint8_t>() != 0;
+                if (failed or not isElementType(type)) break;
+                if (tag == ObjectTag::LIST) return std::make_shared<LoxList>((ElementType) type, declared);
+                return std::make_shared<LoxMap>((ElementType) type, declared);
+            }
+            case ObjectTag::SET: {
+                auto type = (ElementType) get<uint8_t>();
+                bool frozen = get<uint8_t>() != 0;
+                auto count = get<uint32_t>();
+                if (failed or not LoxSet::supports(type)) break;
+                auto set = std::make_shared<LoxSet>(type);
+                for (uint32_t i = 0; i < count and not failed; ++i) set->insert(scalar(type));
+                return frozen ? set->freeze() : set;
+            }
+            case ObjectTag::VECTOR: {
+                auto type = get<uint8_t>();
+                bool declared = get<uint8_t>() != 0;
+                auto count = get<uint32_t>();
+                if (failed or not isElementType(type) or count > data.size() / sizeof(uint32_t)) break;
+                std::vector<LoxValuePtr> values;
+                values.reserve(count);
+                for (uint32_t i = 0; i < count and not failed; ++i) values.push_back(objectAt(get<uint32_t>()));
+                if (failed) break;
+                return std::make_shared<LoxVector>((ElementType) type, declared, PersistentVector{values});
+            }
+            case ObjectTag::HAMT: {
+                auto type = get<uint8_t>();
+                bool declared = get<uint8_t>() != 0;
+                auto count = get<uint32_t>();
+                if (failed or not isElementType(type)) break;
+                PersistentMap items;
+                for (uint32_t i = 0; i < count and not failed; ++i) {
+                    auto key = std::make_shared<LoxString>(std::string{getString()});
+                    items = items.set(key, objectAt(get<uint32_t>()));
+                }
+                if (failed) break;
+                return std::make_shared<LoxHamt>((ElementType) type, declared, std::move(items));
+            }
+        }
+        failed = true;
+        return nullptr;
+    }
+
+    std::string_view data;
+    bool failed{false};
+    const CompiledProgram &program;
+    const std::vector<FunctionStmtPtr> &functions;
+    UnitPtr unit;   // 恢复出的函数都属于准备脚本
+    std::vector<std::shared_ptr<Environment>> envs;
+    std::vector<LoxValuePtr> objects;
+};
+
+bool Snapshot::save(const std::string &path, const CompiledProgram &program, const Interpreter &interpreter) {
+    auto source = program.tokens.source();
+
+    std::string payload;
+    payload.append(source);
+    std::unordered_map<const FunctionStmt *, uint32_t> functions;
+    ProgramCache::encode(payload, program.tokens, program.statements, &functions);
+
+    Writer writer{program, functions};
+    if (not writer.write(payload, interpreter)) {
+        std::cerr << "Could not create snapshot: " << writer.reason << std::endl;
+        return false;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sourceSize = (uint32_t) source.size();
+    header.payloadHash = ProgramCache::contentHash(payload);
+
+    auto temp = path + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream out{temp, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc};
+        out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        out.write(payload.data(), (std::streamsize) payload.size());
+        if (!out.good()) {
+            std::cerr << "Could not write snapshot: " << path << std::endl;
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Could not write snapshot: " << path << std::endl;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<Snapshot> Snapshot::load(const std::string &path, Interpreter &interpreter) {
+    std::shared_ptr<Snapshot> snapshot{new Snapshot()};
+    snapshot->file_ = Source::fromFile(path);
+    if (!snapshot->file_ or snapshot->file_->text().size() < sizeof(Header)) return nullptr;
+
+    auto data = snapshot->file_->text();
+    Header header{};
+    std::memcpy(&header, data.data(), sizeof(Header));
+    data.remove_prefix(sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 or header.version != VERSION
+        or header.sourceSize > data.size() or header.payloadHash != ProgramCache::contentHash(data)) {
+        return nullptr;
+    }
+
+    // 源码留在映射中，词法单元直接引用
+    snapshot->program_ = std::make_unique<CompiledProgram>(data.substr(0, header.sourceSize));
+    data.remove_prefix(header.sourceSize);
+    std::vector<FunctionStmtPtr> functions;
+    if (not ProgramCache::decode(data, *snapshot->program_, &functions)) return nullptr;
+
+    Reader reader{data, *snapshot->program_, functions};
+    if (not reader.read(interpreter)) return nullptr;
+    return snapshot;
+}
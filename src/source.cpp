@@ -0,0 +1,59 @@
+#include "source.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+Source::~Source() {
+    if (mapping_) munmap(mapping_, size_);
+}
+
+std::shared_ptr<Source> Source::fromFile(const std::string &path) {
+    std::shared_ptr<Source> source{new Source()};
+    source->name_ = path;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st{};
+    bool exists = fstat(fd, &st) == 0;
+    if (exists) source->modified_ = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    if (exists and S_ISREG(st.st_mode) and st.st_size > 0) {
+        void *addr = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            madvise(addr, (size_t) st.st_size, MADV_SEQUENTIAL);
+            source->mapping_ = addr;
+            source->data_ = static_cast<const char *>(addr);
+            source->size_ = (size_t) st.st_size;
+            close(fd);
+            return source;
+        }
+    }
+    close(fd);
+
+    // 无法映射（空文件、管道等）时退化为一次性读入
+    std::ifstream file{path, std::ios_base::in | std::ios_base::binary};
+    if (!file.is_open()) return nullptr;
+    source->buffer_.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+    source->data_ = source->buffer_.data();
+    source->size_ = source->buffer_.size();
+    return source;
+}
+
+int64_t Source::modifiedTime(const std::string &path) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) return -1;
+    return (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+std::shared_ptr<Source> Source::fromString(std::string text, std::string name) {
+    std::shared_ptr<Source> source{new Source()};
+    source->name_ = std::move(name);
+    source->buffer_ = std::move(text);
+    source->data_ = source->buffer_.data();
+    source->size_ = source->buffer_.size();
+    return source;
+}
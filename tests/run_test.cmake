@@ -0,0 +1,28 @@
+# 运行一个脚本测试：cmake -DIDUN=<解释器> -DTEST=<tests/ 中的测试名> -DWORK=<工作目录> -P run_test.cmake
+# 有 <测试名>.setup.idun 时先运行它并保存快照，再加载快照运行 <测试名>.idun；
+# 两次运行的输出（标准输出和标准错误）依次拼接，与 <测试名>.out 比较。
+get_filename_component(DIR ${CMAKE_CURRENT_LIST_FILE} DIRECTORY)
+set(SNAPSHOT ${WORK}/${TEST}.snapshot)
+file(REMOVE ${SNAPSHOT})
+set(OUTPUT "")
+
+if (EXISTS ${DIR}/${TEST}.setup.idun)
+    execute_process(COMMAND ${IDUN} --no-cache --save-snapshot ${SNAPSHOT} ${DIR}/${TEST}.setup.idun
+            OUTPUT_VARIABLE STDOUT ERROR_VARIABLE STDERR)
+    string(APPEND OUTPUT "${STDOUT}${STDERR}")
+endif ()
+
+if (EXISTS ${DIR}/${TEST}.idun)
+    set(LOAD "")
+    if (EXISTS ${SNAPSHOT})
+        set(LOAD --load-snapshot ${SNAPSHOT})
+    endif ()
+    execute_process(COMMAND ${IDUN} --no-cache ${LOAD} ${DIR}/${TEST}.idun
+            OUTPUT_VARIABLE STDOUT ERROR_VARIABLE STDERR)
+    string(APPEND OUTPUT "${STDOUT}${STDERR}")
+endif ()
+
+file(READ ${DIR}/${TEST}.out EXPECTED)
+if (NOT OUTPUT STREQUAL EXPECTED)
+    message(FATAL_ERROR "Output of ${TEST} differs.\n--- expected\n${EXPECTED}--- actual\n${OUTPUT}")
+endif ()